@@ -96,6 +96,21 @@ Esys_SetTimeout(
     ESYS_CONTEXT *esys_context,
     int32_t timeout);
 
+TSS2_RC
+Esys_SetResidentObjectLimit(
+    ESYS_CONTEXT *esys_context,
+    size_t limit);
+
+TSS2_RC
+Esys_SetRandomPool(
+    ESYS_CONTEXT *esys_context,
+    size_t reseedInterval);
+
+TSS2_RC
+Esys_SetNvBufferMax(
+    ESYS_CONTEXT *esys_context,
+    UINT32 size);
+
 TSS2_RC
 Esys_TR_Serialize(
     ESYS_CONTEXT *esys_context,
@@ -180,6 +195,29 @@ Esys_TRSess_GetAuthRequired(
     ESYS_TR esys_handle,
     TPMI_YES_NO *auth_needed);
 
+TSS2_RC
+Esys_SessionPool_SetSize(
+    ESYS_CONTEXT *esys_context,
+    size_t size);
+
+TSS2_RC
+Esys_SessionPool_Acquire(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR tpmKey,
+    TPMT_SYM_DEF const *symmetric,
+    TPMI_ALG_HASH authHash,
+    ESYS_TR *session);
+
+TSS2_RC
+Esys_SessionPool_Release(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR *session);
+
+TSS2_RC
+Esys_SessionPool_Evict(
+    ESYS_CONTEXT *esys_context,
+    TPMI_YES_NO flush);
+
 /* Table 5 - TPM2_Startup Command */
 
 TSS2_RC
@@ -1056,6 +1094,28 @@ Esys_GetRandom_Finish(
     ESYS_CONTEXT *esysContext,
     TPM2B_DIGEST **randomBytes);
 
+TSS2_RC
+Esys_GetRandomBulk(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t *randomBytes,
+    size_t size);
+
+TSS2_RC
+Esys_GetRandomBulk_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t *randomBytes,
+    size_t size);
+
+TSS2_RC
+Esys_GetRandomBulk_Finish(
+    ESYS_CONTEXT *esysContext);
+
 /* Table 68 - TPM2_StirRandom Command */
 
 TSS2_RC
@@ -3028,6 +3088,34 @@ TSS2_RC
 Esys_NV_Write_Finish(
     ESYS_CONTEXT *esysContext);
 
+TSS2_RC
+Esys_NV_WriteStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t const *data,
+    UINT16 size,
+    UINT16 offset);
+
+TSS2_RC
+Esys_NV_WriteStream_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t const *data,
+    UINT16 size,
+    UINT16 offset);
+
+TSS2_RC
+Esys_NV_WriteStream_Finish(
+    ESYS_CONTEXT *esysContext);
+
 /* Table 215 - TPM2_NV_Increment Command */
 
 TSS2_RC
@@ -3180,6 +3268,34 @@ Esys_NV_Read_Finish(
     ESYS_CONTEXT *esysContext,
     TPM2B_MAX_NV_BUFFER **data);
 
+TSS2_RC
+Esys_NV_ReadStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 size,
+    UINT16 offset,
+    uint8_t **data);
+
+TSS2_RC
+Esys_NV_ReadStream_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 size,
+    UINT16 offset);
+
+TSS2_RC
+Esys_NV_ReadStream_Finish(
+    ESYS_CONTEXT *esysContext,
+    uint8_t **data);
+
 /* Table 227 - TPM2_NV_ReadLock Command */
 
 TSS2_RC
@@ -584,6 +584,62 @@ TSS2_RC Fapi_VerifyQuote_Async(
 TSS2_RC Fapi_VerifyQuote_Finish(
     FAPI_CONTEXT   *context);
 
+TSS2_RC Fapi_VerifyQuoteIncremental(
+    FAPI_CONTEXT   *context,
+    char     const *publicKeyPath,
+    uint8_t  const *qualifyingData,
+    size_t          qualifyingDataSize,
+    char     const *quoteInfo,
+    uint8_t  const *signature,
+    size_t          signatureSize,
+    char     const *pcrLog,
+    size_t          pcrLogOffset,
+    char     const *pcrState,
+    char          **newPcrState);
+
+TSS2_RC Fapi_VerifyQuoteIncremental_Async(
+    FAPI_CONTEXT   *context,
+    char     const *publicKeyPath,
+    uint8_t  const *qualifyingData,
+    size_t          qualifyingDataSize,
+    char     const *quoteInfo,
+    uint8_t  const *signature,
+    size_t          signatureSize,
+    char     const *pcrLog,
+    size_t          pcrLogOffset,
+    char     const *pcrState);
+
+TSS2_RC Fapi_VerifyQuoteIncremental_Finish(
+    FAPI_CONTEXT   *context,
+    char          **newPcrState);
+
+TSS2_RC Fapi_VerifyQuoteBatch(
+    FAPI_CONTEXT   *context,
+    size_t          numQuotes,
+    char     const *const *publicKeyPaths,
+    uint8_t  const *const *qualifyingData,
+    size_t   const *qualifyingDataSizes,
+    char     const *const *quoteInfos,
+    uint8_t  const *const *signatures,
+    size_t   const *signatureSizes,
+    char     const *const *pcrLogs,
+    TSS2_RC       **results);
+
+TSS2_RC Fapi_VerifyQuoteBatch_Async(
+    FAPI_CONTEXT   *context,
+    size_t          numQuotes,
+    char     const *const *publicKeyPaths,
+    uint8_t  const *const *qualifyingData,
+    size_t   const *qualifyingDataSizes,
+    char     const *const *quoteInfos,
+    uint8_t  const *const *signatures,
+    size_t   const *signatureSizes,
+    char     const *const *pcrLogs);
+
+TSS2_RC Fapi_VerifyQuoteBatch_Finish(
+    FAPI_CONTEXT   *context,
+    TSS2_RC       **results);
+
 /* NV functions */
 
 TSS2_RC Fapi_CreateNv(
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+#ifndef TSS2_TCTI_CACHE_H
+#define TSS2_TCTI_CACHE_H
+
+#include <stdint.h>
+
+#include "tss2_tcti.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t hits;          /* responses served from the cache */
+    uint64_t misses;        /* cacheable commands sent to the TPM */
+    uint64_t invalidations; /* number of times the cache was flushed */
+} TSS2_TCTI_CACHE_STATS;
+
+TSS2_RC Tss2_Tcti_Cache_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf);
+
+TSS2_RC Tss2_Tcti_Cache_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_CACHE_STATS *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_TCTI_CACHE_H */
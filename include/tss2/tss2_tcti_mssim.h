@@ -6,6 +6,8 @@
 #ifndef TCTI_SOCKET_H
 #define TCTI_SOCKET_H
 
+#include <stdint.h>
+
 #include "tss2_tcti.h"
 
 /*
@@ -24,6 +26,11 @@
 extern "C" {
 #endif
 
+typedef struct {
+    uint32_t reconnects;       /* connections to the simulator reestablished */
+    uint32_t connect_failures; /* failed connection attempts */
+} TSS2_TCTI_MSSIM_STATS;
+
 TSS2_RC tcti_platform_command(
     TSS2_TCTI_CONTEXT *tctiContext,
     UINT32 cmd);
@@ -33,6 +40,10 @@ TSS2_RC Tss2_Tcti_Mssim_Init (
     size_t *size,
     const char *conf);
 
+TSS2_RC Tss2_Tcti_Mssim_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_MSSIM_STATS *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+#ifndef TSS2_TCTI_POOL_H
+#define TSS2_TCTI_POOL_H
+
+#include "tss2_tcti.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+TSS2_RC Tss2_Tcti_Pool_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf);
+
+TSS2_RC Tss2_Tcti_Pool_InitClient (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    TSS2_TCTI_CONTEXT *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_TCTI_POOL_H */
@@ -6,17 +6,28 @@
 #ifndef TSS2_TCTI_SWTPM_H
 #define TSS2_TCTI_SWTPM_H
 
+#include <stdint.h>
+
 #include "tss2_tcti.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+    uint32_t reconnects;       /* connections to the swtpm reestablished */
+    uint32_t connect_failures; /* failed connection attempts */
+} TSS2_TCTI_SWTPM_STATS;
+
 TSS2_RC Tss2_Tcti_Swtpm_Init (
     TSS2_TCTI_CONTEXT *tctiContext,
     size_t *size,
     const char *conf);
 
+TSS2_RC Tss2_Tcti_Swtpm_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_SWTPM_STATS *stats);
+
 TSS2_RC Tss2_Tcti_Swtpm_Reset(
     TSS2_TCTI_CONTEXT *tctiContext);
 
@@ -163,6 +163,8 @@ Esys_ContextLoad_Async(
     context = &tpmContext;
 
 
+    /* No object may be swapped in once the command is prepared */
+    esysContext->resident_swap_in = 0;
     /* Initial invocation of SAPI to prepare the command buffer with parameters */
     r = Tss2_Sys_ContextLoad_Prepare(esysContext->sys, context);
     return_state_if_error(r, _ESYS_STATE_INIT, "SAPI Prepare returned error.");
@@ -140,6 +140,8 @@ Esys_ContextSave_Async(
     r = esys_GetResourceObject(esysContext, saveHandle, &saveHandleNode);
     return_state_if_error(r, _ESYS_STATE_INIT, "saveHandle unknown.");
 
+    /* No object may be swapped in once the command is prepared */
+    esysContext->resident_swap_in = 0;
     /* Initial invocation of SAPI to prepare the command buffer with parameters */
     r = Tss2_Sys_ContextSave_Prepare(esysContext->sys,
                                      (saveHandleNode == NULL) ? TPM2_RH_NULL
@@ -137,6 +137,8 @@ Esys_FlushContext_Async(
     r = esys_GetResourceObject(esysContext, flushHandle, &flushHandleNode);
     return_state_if_error(r, _ESYS_STATE_INIT, "flushHandle unknown.");
 
+    /* No object may be swapped in once the command is prepared */
+    esysContext->resident_swap_in = 0;
     /* Initial invocation of SAPI to prepare the command buffer with parameters */
     r = Tss2_Sys_FlushContext_Prepare(esysContext->sys,
                                       (flushHandleNode == NULL) ? TPM2_RH_NULL
@@ -184,39 +184,27 @@ Esys_GetRandom_Async(
     return r;
 }
 
-/** Asynchronous finish function for TPM2_GetRandom
+/** Asynchronous finish function for TPM2_GetRandom without allocation
  *
- * This function returns the results of a TPM2_GetRandom command
- * invoked via Esys_GetRandom_Finish. All non-simple output parameters
- * are allocated by the function's implementation. NULL can be passed for every
- * output parameter if the value is not required.
+ * Receives the response like Esys_GetRandom_Finish, but writes the random
+ * octets to a buffer of the caller. This is used for bulk random requests,
+ * which are split into many TPM2_GetRandom commands.
  *
  * @param[in,out] esysContext The ESYS_CONTEXT.
- * @param[out] randomBytes The random octets.
- *             (callee-allocated)
+ * @param[out] randomBytes The random octets. May be NULL.
  * @retval TSS2_RC_SUCCESS on success
- * @retval ESYS_RC_SUCCESS if the function call was a success.
- * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or required input
- *         pointers or required output handle references are NULL.
- * @retval TSS2_ESYS_RC_BAD_CONTEXT: if esysContext corruption is detected.
- * @retval TSS2_ESYS_RC_MEMORY: if the ESAPI cannot allocate enough memory for
- *         internal operations or return parameters.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
  * @retval TSS2_ESYS_RC_BAD_SEQUENCE: if the context has an asynchronous
  *         operation already pending.
  * @retval TSS2_ESYS_RC_TRY_AGAIN: if the timeout counter expires before the
  *         TPM response is received.
- * @retval TSS2_ESYS_RC_INSUFFICIENT_RESPONSE: if the TPM's response does not
- *         at least contain the tag, response length, and response code.
- * @retval TSS2_ESYS_RC_RSP_AUTH_FAILED: if the response HMAC from the TPM did
- *         not verify.
- * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE: if the TPM's response is corrupted.
  * @retval TSS2_RCs produced by lower layers of the software stack may be
  *         returned to the caller unaltered unless handled internally.
  */
 TSS2_RC
-Esys_GetRandom_Finish(
+iesys_GetRandom_Finish(
     ESYS_CONTEXT *esysContext,
-    TPM2B_DIGEST **randomBytes)
+    TPM2B_DIGEST *randomBytes)
 {
     TSS2_RC r;
     LOG_TRACE("context=%p, randomBytes=%p",
@@ -235,20 +223,12 @@ Esys_GetRandom_Finish(
     }
     esysContext->state = _ESYS_STATE_INTERNALERROR;
 
-    /* Allocate memory for response parameters */
-    if (randomBytes != NULL) {
-        *randomBytes = calloc(sizeof(TPM2B_DIGEST), 1);
-        if (*randomBytes == NULL) {
-            return_error(TSS2_ESYS_RC_MEMORY, "Out of memory");
-        }
-    }
-
     /*Receive the TPM response and handle resubmissions if necessary. */
     r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
     if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
-        goto error_cleanup;
+        return r;
     }
     /* This block handle the resubmission of TPM commands given a certain set of
      * TPM response codes. */
@@ -258,7 +238,7 @@ Esys_GetRandom_Finish(
         if (esysContext->submissionCount++ >= _ESYS_MAX_SUBMISSIONS) {
             LOG_WARNING("Maximum number of (re)submissions has been reached.");
             esysContext->state = _ESYS_STATE_INIT;
-            goto error_cleanup;
+            return r;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
         r = Tss2_Sys_ExecuteAsync(esysContext->sys);
@@ -266,21 +246,21 @@ Esys_GetRandom_Finish(
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
              * state of the _async function. */
-            goto error_cleanup;
+            return r;
         }
         r = TSS2_ESYS_RC_TRY_AGAIN;
         LOG_DEBUG("Resubmission initiated and returning RC_TRY_AGAIN.");
-        goto error_cleanup;
+        return r;
     }
     /* The following is the "regular error" handling. */
     if (iesys_tpm_error(r)) {
         LOG_WARNING("Received TPM Error");
         esysContext->state = _ESYS_STATE_INIT;
-        goto error_cleanup;
+        return r;
     } else if (r != TSS2_RC_SUCCESS) {
         LOG_ERROR("Received a non-TPM Error");
         esysContext->state = _ESYS_STATE_INTERNALERROR;
-        goto error_cleanup;
+        return r;
     }
 
     /*
@@ -288,26 +268,75 @@ Esys_GetRandom_Finish(
      * parameter decryption have to be done.
      */
     r = iesys_check_response(esysContext);
-    goto_state_if_error(r, _ESYS_STATE_INTERNALERROR, "Error: check response",
-                        error_cleanup);
+    return_state_if_error(r, _ESYS_STATE_INTERNALERROR, "Error: check response");
 
     /*
      * After the verification of the response we call the complete function
      * to deliver the result.
      */
-    r = Tss2_Sys_GetRandom_Complete(esysContext->sys,
-                                    (randomBytes != NULL) ? *randomBytes
-                                     : NULL);
-    goto_state_if_error(r, _ESYS_STATE_INTERNALERROR,
-                        "Received error from SAPI unmarshaling" ,
-                        error_cleanup);
+    r = Tss2_Sys_GetRandom_Complete(esysContext->sys, randomBytes);
+    return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
+                          "Received error from SAPI unmarshaling");
 
     esysContext->state = _ESYS_STATE_INIT;
 
     return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous finish function for TPM2_GetRandom
+ *
+ * This function returns the results of a TPM2_GetRandom command
+ * invoked via Esys_GetRandom_Finish. All non-simple output parameters
+ * are allocated by the function's implementation. NULL can be passed for every
+ * output parameter if the value is not required.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[out] randomBytes The random octets.
+ *             (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval ESYS_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or required input
+ *         pointers or required output handle references are NULL.
+ * @retval TSS2_ESYS_RC_BAD_CONTEXT: if esysContext corruption is detected.
+ * @retval TSS2_ESYS_RC_MEMORY: if the ESAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN: if the timeout counter expires before the
+ *         TPM response is received.
+ * @retval TSS2_ESYS_RC_INSUFFICIENT_RESPONSE: if the TPM's response does not
+ *         at least contain the tag, response length, and response code.
+ * @retval TSS2_ESYS_RC_RSP_AUTH_FAILED: if the response HMAC from the TPM did
+ *         not verify.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE: if the TPM's response is corrupted.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_GetRandom_Finish(
+    ESYS_CONTEXT *esysContext,
+    TPM2B_DIGEST **randomBytes)
+{
+    TSS2_RC r;
+    LOG_TRACE("context=%p, randomBytes=%p",
+              esysContext, randomBytes);
+
+    if (esysContext == NULL) {
+        LOG_ERROR("esyscontext is NULL.");
+        return TSS2_ESYS_RC_BAD_REFERENCE;
+    }
+
+    /* Allocate memory for response parameters */
+    if (randomBytes != NULL) {
+        *randomBytes = calloc(sizeof(TPM2B_DIGEST), 1);
+        if (*randomBytes == NULL) {
+            return_error(TSS2_ESYS_RC_MEMORY, "Out of memory");
+        }
+    }
 
-error_cleanup:
-    if (randomBytes != NULL)
+    r = iesys_GetRandom_Finish(esysContext,
+                               (randomBytes != NULL) ? *randomBytes : NULL);
+    if (r != TSS2_RC_SUCCESS && randomBytes != NULL)
         SAFE_FREE(*randomBytes);
 
     return r;
@@ -438,6 +438,8 @@ Esys_StartAuthSession_Finish(
                 LOG_ERROR("Error: initialize auth session (%x).", r);
                 return r;
             }
+            /* The salt key is part of the match key of the session pool. */
+            sessionHandleNode->salt_key = tpmKeyNode->rsrc.name;
         }
         r = iesys_crypto_hash_get_digest_size(esysContext->in.StartAuthSession.
                                               authHash,&authHash_size);
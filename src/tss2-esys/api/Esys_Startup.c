@@ -117,6 +117,8 @@ Esys_Startup_Async(
         return r;
     esysContext->state = _ESYS_STATE_INTERNALERROR;
 
+    /* No object may be swapped in once the command is prepared */
+    esysContext->resident_swap_in = 0;
     /* Initial invocation of SAPI to prepare the command buffer with parameters */
     r = Tss2_Sys_Startup_Prepare(esysContext->sys, startupType);
     return_state_if_error(r, _ESYS_STATE_INIT, "SAPI Prepare returned error.");
@@ -115,6 +115,10 @@ Esys_Finalize(ESYS_CONTEXT ** esys_context)
         return;
     }
 
+    /* Flush the sessions of the session pool from the TPM first; unlike
+       all other resource objects they are owned by the context */
+    iesys_session_pool_finalize(*esys_context);
+
     /* Flush from TPM and free all resource objects first */
     iesys_DeleteAllResourceObjects(*esys_context);
 
@@ -139,6 +143,15 @@ Esys_Finalize(ESYS_CONTEXT ** esys_context)
         Tss2_TctiLdr_Finalize(&tctcontext);
     }
 
+    /* Free the buffer of an unfinished NV stream */
+    SAFE_FREE((*esys_context)->nv_stream.data);
+
+    /* Wipe the DRBG state of the random pool */
+    iesys_random_wipe(*esys_context);
+
+    /* Release the crypto contexts kept for reuse by this thread */
+    iesys_crypto_pool_release();
+
     /* Free esys_context */
     free(*esys_context);
     *esys_context = NULL;
@@ -220,6 +233,52 @@ Esys_SetTimeout(ESYS_CONTEXT * esys_context, int32_t timeout)
     return TSS2_RC_SUCCESS;
 }
 
+/** Set the maximum number of transient objects loaded by the ESYS_CONTEXT.
+ *
+ * If a limit is set, the ESYS_CONTEXT swaps the least recently used transient
+ * objects out of the TPM (TPM2_ContextSave and TPM2_FlushContext) before a
+ * command is sent, such that at most limit - 1 objects stay loaded and the
+ * command may load or create another object. Swapped out objects keep their
+ * ESYS_TR and are loaded again (TPM2_ContextLoad) when a command uses them.
+ * Thus an application may use more objects than the TPM has transient object
+ * slots. The TPM handle of an object may change when it is loaded again.
+ * Since the objects used by a single command are never swapped out, the limit
+ * should be at least 3. The limit is 0 (disabled) by default; objects swapped
+ * out before are still loaded when they are used.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param limit [in] The maximum number of loaded transient objects or 0.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ */
+TSS2_RC
+Esys_SetResidentObjectLimit(ESYS_CONTEXT * esys_context, size_t limit)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    esys_context->resident_limit = limit;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Set the NV buffer size used by the streaming NV functions.
+ *
+ * Esys_NV_ReadStream() and Esys_NV_WriteStream() split the data into commands
+ * of at most TPM2_PT_NV_BUFFER_MAX octets, which they read from the TPM before
+ * the first stream of the ESYS_CONTEXT. Callers which already know the value
+ * can pass it here to save this command. Values above TPM2_MAX_NV_BUFFER_SIZE
+ * are reduced to it; 0 makes the next stream read the value from the TPM.
+ * @param esys_context [in,out] The ESYS_CONTEXT.
+ * @param size [in] The TPM2_PT_NV_BUFFER_MAX of the TPM or 0.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ */
+TSS2_RC
+Esys_SetNvBufferMax(ESYS_CONTEXT * esys_context, UINT32 size)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    esys_context->nv_buffer_max = (size > TPM2_MAX_NV_BUFFER_SIZE) ?
+        TPM2_MAX_NV_BUFFER_SIZE : size;
+    return TSS2_RC_SUCCESS;
+}
+
 /** Helper function that returns sys contest from the give esys context.
  *
  * Function returns sys contest from the give esys context.
@@ -131,6 +131,7 @@ TSS2_RC iesys_cryptmbed_get_ecdh_point(
 #define iesys_crypto_sym_aes_decrypt iesys_cryptmbed_sym_aes_decrypt
 
 #define iesys_crypto_init(...) TSS2_RC_SUCCESS;
+#define iesys_crypto_pool_release(...)
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -12,6 +12,10 @@
 #include <openssl/aes.h>
 #include <openssl/rsa.h>
 #include <openssl/engine.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+#include <pthread.h>
 #include <stdio.h>
 
 #include "tss2_esys.h"
@@ -50,6 +54,10 @@ iesys_bn2binpad(const BIGNUM *bn, unsigned char *bin, int bin_length)
     return 1;
 }
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_reset(ctx) EVP_MD_CTX_cleanup(ctx)
+#endif
+
 /** Context to hold temporary values for iesys_crypto */
 typedef struct _IESYS_CRYPTO_CONTEXT {
     enum {
@@ -63,16 +71,122 @@ typedef struct _IESYS_CRYPTO_CONTEXT {
             size_t hash_len;
         } hash; /**< the state variables for a hash context */
         struct {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            EVP_MAC_CTX *ossl_context;
+#else
             EVP_MD_CTX *ossl_context;
+#endif
             const EVP_MD *ossl_hash_alg;
             size_t hmac_len;
         } hmac; /**< the state variables for an hmac context */
     };
+    struct _IESYS_CRYPTO_CONTEXT *next; /**< The next unused context of the pool */
 } IESYS_CRYPTOSSL_CONTEXT;
 
+/** Number of unused contexts kept per thread and context type. */
+#define IESYS_CRYPTOSSL_POOL_SIZE 4
+
+/** Unused contexts of finished computations of one thread.
+ *
+ * The crypto functions are called several times per authorized command;
+ * reusing the OpenSSL contexts avoids their allocation and setup. The pool is
+ * thread local since the crypto functions have no reference to the ESYS
+ * context which is used by one thread at a time. It is released when the
+ * thread exits (see context_pool_key) or when the library is unloaded (see
+ * iesys_cryptossl_unload()).
+ */
+typedef struct _IESYS_CRYPTOSSL_POOL {
+    struct {
+        IESYS_CRYPTOSSL_CONTEXT *head;
+        size_t count;
+    } types[2];                         /**< indexed by context type - 1 */
+    int registered;                     /**< the pool is in pool_list */
+    struct _IESYS_CRYPTOSSL_POOL *prev; /**< previous pool of pool_list */
+    struct _IESYS_CRYPTOSSL_POOL *next; /**< next pool of pool_list */
+} IESYS_CRYPTOSSL_POOL;
+
+static __thread IESYS_CRYPTOSSL_POOL context_pool;
+
+/** The registered pools of all threads. */
+static IESYS_CRYPTOSSL_POOL *pool_list;
+static pthread_mutex_t pool_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Key whose destructor releases the pool of an exiting thread. */
+static pthread_key_t context_pool_key;
+static pthread_once_t context_pool_once = PTHREAD_ONCE_INIT;
+static int context_pool_key_valid;
+
+static void context_pool_thread_exit(void *pool);
+
+static void
+context_pool_key_create(void)
+{
+    context_pool_key_valid =
+        pthread_key_create(&context_pool_key, context_pool_thread_exit) == 0;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/** Algorithms fetched once; the implicit fetch of EVP_sha256() and friends
+ *  is repeated by OpenSSL 3 for every initialization. They are freed by
+ *  iesys_cryptossl_unload(). */
+static EVP_MD *ossl_hash_md[4];
+static EVP_MAC *ossl_hmac;
+
+static const EVP_MD *
+fetch_hash_md(EVP_MD **slot, const char *name)
+{
+    EVP_MD *expected = NULL;
+    EVP_MD *md = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+    if (md)
+        return md;
+    if (!(md = EVP_MD_fetch(NULL, name, NULL)))
+        return NULL;
+    /* Another thread may have fetched the digest concurrently. */
+    if (!__atomic_compare_exchange_n(slot, &expected, md, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        EVP_MD_free(md);
+        return expected;
+    }
+    return md;
+}
+
+static EVP_MAC *
+fetch_hmac(void)
+{
+    EVP_MAC *expected = NULL;
+    EVP_MAC *mac = __atomic_load_n(&ossl_hmac, __ATOMIC_ACQUIRE);
+
+    if (mac)
+        return mac;
+    if (!(mac = EVP_MAC_fetch(NULL, "HMAC", NULL)))
+        return NULL;
+    if (!__atomic_compare_exchange_n(&ossl_hmac, &expected, mac, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        EVP_MAC_free(mac);
+        return expected;
+    }
+    return mac;
+}
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
 const EVP_MD *
 get_ossl_hash_md(TPM2_ALG_ID hashAlg)
 {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    switch (hashAlg) {
+    case TPM2_ALG_SHA1:
+        return fetch_hash_md(&ossl_hash_md[0], "SHA1");
+    case TPM2_ALG_SHA256:
+        return fetch_hash_md(&ossl_hash_md[1], "SHA256");
+    case TPM2_ALG_SHA384:
+        return fetch_hash_md(&ossl_hash_md[2], "SHA384");
+    case TPM2_ALG_SHA512:
+        return fetch_hash_md(&ossl_hash_md[3], "SHA512");
+    default:
+        return NULL;
+    }
+#else
     switch (hashAlg) {
     case TPM2_ALG_SHA1:
         return EVP_sha1();
@@ -89,11 +203,249 @@ get_ossl_hash_md(TPM2_ALG_ID hashAlg)
     default:
         return NULL;
     }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+}
+
+/** Release a context and its OpenSSL context.
+ *
+ * @param[in] mycontext The context to be released.
+ */
+static void
+context_free(IESYS_CRYPTOSSL_CONTEXT *mycontext)
+{
+    if (mycontext->type == IESYS_CRYPTOSSL_TYPE_HASH) {
+        EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
+    } else {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC_CTX_free(mycontext->hmac.ossl_context);
+#else
+        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
+#endif
+    }
+    free(mycontext);
+}
+
+/** Get an unused context from the pool or create a new one.
+ *
+ * @param[in] type The type of the context.
+ * @retval The context or NULL if memory cannot be allocated.
+ */
+static IESYS_CRYPTOSSL_CONTEXT *
+context_pool_get(int type)
+{
+    IESYS_CRYPTOSSL_CONTEXT *mycontext = context_pool.types[type - 1].head;
+
+    if (mycontext) {
+        context_pool.types[type - 1].head = mycontext->next;
+        context_pool.types[type - 1].count -= 1;
+        mycontext->next = NULL;
+        return mycontext;
+    }
+
+    mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
+    if (!mycontext)
+        return NULL;
+    mycontext->type = type;
+
+    if (type == IESYS_CRYPTOSSL_TYPE_HASH) {
+        mycontext->hash.ossl_context = EVP_MD_CTX_create();
+        if (mycontext->hash.ossl_context)
+            return mycontext;
+    } else {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC *mac = fetch_hmac();
+        if (mac)
+            mycontext->hmac.ossl_context = EVP_MAC_CTX_new(mac);
+#else
+        mycontext->hmac.ossl_context = EVP_MD_CTX_create();
+#endif
+        if (mycontext->hmac.ossl_context)
+            return mycontext;
+    }
+    free(mycontext);
+    return NULL;
+}
+
+/** Remove the key of a finished HMAC computation from its context.
+ *
+ * @param[in,out] mycontext The HMAC context.
+ * @retval 1 on success, 0 if the context cannot be reused.
+ */
+static int
+context_cleanse(IESYS_CRYPTOSSL_CONTEXT *mycontext)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    static const unsigned char zero_key[1] = { 0 };
+
+    /* The HMAC implementation clears the former key when a new one is set. */
+    return EVP_MAC_init(mycontext->hmac.ossl_context, zero_key,
+                        sizeof(zero_key), NULL) == 1;
+#else
+    /* Frees the EVP_PKEY with the key. */
+    EVP_MD_CTX_reset(mycontext->hmac.ossl_context);
+    return 1;
+#endif
+}
+
+/** Register the pool of the calling thread for its release.
+ *
+ * Without the key the pool is only released with the ESYS context or when
+ * the library is unloaded.
+ */
+static void
+context_pool_register(void)
+{
+    pthread_once(&context_pool_once, context_pool_key_create);
+    if (context_pool_key_valid)
+        pthread_setspecific(context_pool_key, &context_pool);
+
+    pthread_mutex_lock(&pool_list_mutex);
+    context_pool.prev = NULL;
+    context_pool.next = pool_list;
+    if (pool_list)
+        pool_list->prev = &context_pool;
+    pool_list = &context_pool;
+    context_pool.registered = 1;
+    pthread_mutex_unlock(&pool_list_mutex);
+}
+
+/** Return a context of a finished computation to the pool.
+ *
+ * The OpenSSL context is kept for the next computation; it is reinitialized
+ * when the context is taken from the pool again. The key of a HMAC context
+ * is removed before it is pooled.
+ *
+ * @param[in] mycontext The context to be reused.
+ */
+static void
+context_pool_put(IESYS_CRYPTOSSL_CONTEXT *mycontext)
+{
+    int type = mycontext->type;
+
+    if (context_pool.types[type - 1].count >= IESYS_CRYPTOSSL_POOL_SIZE ||
+        (type == IESYS_CRYPTOSSL_TYPE_HMAC && !context_cleanse(mycontext))) {
+        context_free(mycontext);
+        return;
+    }
+    if (!context_pool.registered)
+        context_pool_register();
+    mycontext->next = context_pool.types[type - 1].head;
+    context_pool.types[type - 1].head = mycontext;
+    context_pool.types[type - 1].count += 1;
+}
+
+/** Free the unused contexts of a pool.
+ *
+ * @param[in,out] pool The pool to be emptied.
+ */
+static void
+context_pool_drain(IESYS_CRYPTOSSL_POOL *pool)
+{
+    IESYS_CRYPTOSSL_CONTEXT *mycontext;
+    size_t i;
+
+    for (i = 0; i < sizeof(pool->types) / sizeof(pool->types[0]); i++) {
+        while ((mycontext = pool->types[i].head)) {
+            pool->types[i].head = mycontext->next;
+            context_free(mycontext);
+        }
+        pool->types[i].count = 0;
+    }
+}
+
+/** Release the unused contexts of the calling thread.
+ *
+ * Called when an ESYS context is finalized to free the memory of the pool of
+ * the finalizing thread. The pools of other threads are released when these
+ * threads exit or the library is unloaded; they hold no key material since
+ * HMAC contexts are cleansed before they are pooled.
+ */
+void
+iesys_cryptossl_pool_release(void)
+{
+    context_pool_drain(&context_pool);
+}
+
+/** Destructor of context_pool_key, releases the pool of an exiting thread.
+ *
+ * @param[in] pool The pool of the thread set by context_pool_register().
+ */
+static void
+context_pool_thread_exit(void *pool)
+{
+    IESYS_CRYPTOSSL_POOL *mypool = pool;
+
+    pthread_mutex_lock(&pool_list_mutex);
+    if (mypool->registered) {
+        if (mypool->prev)
+            mypool->prev->next = mypool->next;
+        else
+            pool_list = mypool->next;
+        if (mypool->next)
+            mypool->next->prev = mypool->prev;
+        mypool->registered = 0;
+    }
+    pthread_mutex_unlock(&pool_list_mutex);
+    context_pool_drain(mypool);
+}
+
+/** Release the pools of all threads and the fetched algorithms.
+ *
+ * Runs when the library is unloaded by dlclose() or at process exit. The key
+ * is deleted so that no thread exits into the unloaded destructor. At process
+ * exit OpenSSL may already be cleaned up by its atexit handler, then its
+ * objects are gone and must not be freed again.
+ */
+static void __attribute__((destructor))
+iesys_cryptossl_unload(void)
+{
+    IESYS_CRYPTOSSL_POOL *pool;
+    int ossl_alive;
+
+    if (context_pool_key_valid) {
+        pthread_key_delete(context_pool_key);
+        context_pool_key_valid = 0;
+    }
+
+    pthread_mutex_lock(&pool_list_mutex);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (!pool_list && !ossl_hmac && !ossl_hash_md[0] && !ossl_hash_md[1] &&
+        !ossl_hash_md[2] && !ossl_hash_md[3]) {
+#else
+    if (!pool_list) {
+#endif
+        pthread_mutex_unlock(&pool_list_mutex);
+        return;
+    }
+    /* Returns 0 after OPENSSL_cleanup(), the error state is gone then. */
+    ossl_alive = OPENSSL_init_crypto(0, NULL);
+
+    while ((pool = pool_list)) {
+        pool_list = pool->next;
+        pool->registered = 0;
+        if (ossl_alive)
+            context_pool_drain(pool);
+    }
+    pthread_mutex_unlock(&pool_list_mutex);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (ossl_alive) {
+        size_t i;
+
+        for (i = 0; i < sizeof(ossl_hash_md) / sizeof(ossl_hash_md[0]); i++) {
+            EVP_MD_free(ossl_hash_md[i]);
+            ossl_hash_md[i] = NULL;
+        }
+        EVP_MAC_free(ossl_hmac);
+        ossl_hmac = NULL;
+    }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 }
 
 /** Provide the context for the computation of a hash digest.
  *
- * The context will be created and initialized according to the hash function.
+ * The context will be taken from the pool of unused contexts or created and
+ * initialized according to the hash function.
  * @param[out] context The created context (callee-allocated).
  * @param[in] hashAlg The hash algorithm for the creation of the context.
  * @retval TSS2_RC_SUCCESS on success.
@@ -106,30 +458,26 @@ iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
                            TPM2_ALG_ID hashAlg)
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
+    const EVP_MD *md;
+    size_t hash_len;
     LOG_TRACE("call: context=%p hashAlg=%"PRIu16, context, hashAlg);
     return_if_null(context, "Context is NULL", TSS2_ESYS_RC_BAD_REFERENCE);
     return_if_null(context, "Null-Pointer passed for context", TSS2_ESYS_RC_BAD_REFERENCE);
     IESYS_CRYPTOSSL_CONTEXT *mycontext;
-    mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
-    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
-    mycontext->type = IESYS_CRYPTOSSL_TYPE_HASH;
-
-    if (!(mycontext->hash.ossl_hash_alg = get_ossl_hash_md(hashAlg))) {
-        goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
-                   "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
-    }
 
-    if (iesys_crypto_hash_get_digest_size(hashAlg, &mycontext->hash.hash_len)) {
-        goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
-                   "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
+    if (!(md = get_ossl_hash_md(hashAlg)) ||
+        iesys_crypto_hash_get_digest_size(hashAlg, &hash_len)) {
+        LOG_ERROR("Unsupported hash algorithm (%"PRIu16")", hashAlg);
+        return TSS2_ESYS_RC_NOT_IMPLEMENTED;
     }
 
-    if (!(mycontext->hash.ossl_context =  EVP_MD_CTX_create())) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Error EVP_MD_CTX_create", cleanup);
-    }
+    mycontext = context_pool_get(IESYS_CRYPTOSSL_TYPE_HASH);
+    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+    mycontext->hash.ossl_hash_alg = md;
+    mycontext->hash.hash_len = hash_len;
 
-    if (1 != EVP_DigestInit(mycontext->hash.ossl_context,
-                               mycontext->hash.ossl_hash_alg)) {
+    if (1 != EVP_DigestInit_ex(mycontext->hash.ossl_context,
+                               mycontext->hash.ossl_hash_alg, NULL)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Errror EVP_DigestInit", cleanup);
     }
 
@@ -138,9 +486,7 @@ iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
     return TSS2_RC_SUCCESS;
 
  cleanup:
-    if (mycontext->hash.ossl_context)
-        EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    SAFE_FREE(mycontext);
+    context_free(mycontext);
 
     return r;
 }
@@ -232,7 +578,7 @@ iesys_cryptossl_hash_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
         return_error(TSS2_ESYS_RC_BAD_SIZE, "Buffer too small");
     }
 
-    if (1 != EVP_DigestFinal(mycontext->hash.ossl_context, buffer, &digest_size)) {
+    if (1 != EVP_DigestFinal_ex(mycontext->hash.ossl_context, buffer, &digest_size)) {
         return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "Ossl error.");
     }
 
@@ -244,8 +590,7 @@ iesys_cryptossl_hash_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
     LOGBLOB_TRACE(buffer, mycontext->hash.hash_len, "read hash result");
 
     *size = mycontext->hash.hash_len;
-    EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    free(mycontext);
+    context_pool_put(mycontext);
     *context = NULL;
 
     return TSS2_RC_SUCCESS;
@@ -271,8 +616,7 @@ iesys_cryptossl_hash_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
         return;
     }
 
-    EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    free(mycontext);
+    context_pool_put(mycontext);
     *context = NULL;
 }
 
@@ -297,7 +641,13 @@ iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
                            const uint8_t * key, size_t size)
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
+    const EVP_MD *md;
+    size_t hmac_len;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[2], *digest_params = NULL;
+#else
     EVP_PKEY *hkey = NULL;
+#endif
 
     LOG_TRACE("called for context-pointer %p and hmacAlg %d", context, hashAlg);
     LOGBLOB_TRACE(key, size, "Starting  hmac with");
@@ -305,49 +655,64 @@ iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
         return_error(TSS2_ESYS_RC_BAD_REFERENCE,
                      "Null-Pointer passed in for context");
     }
-    IESYS_CRYPTOSSL_CONTEXT *mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
-    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
 
-    if (!(mycontext->hmac.ossl_hash_alg = get_ossl_hash_md(hashAlg))) {
-        goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
-                   "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
+    if (!(md = get_ossl_hash_md(hashAlg))) {
+        LOG_ERROR("Unsupported hash algorithm (%"PRIu16")", hashAlg);
+        return TSS2_ESYS_RC_NOT_IMPLEMENTED;
     }
 
-    if (iesys_crypto_hash_get_digest_size(hashAlg, &mycontext->hmac.hmac_len)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
+    if (iesys_crypto_hash_get_digest_size(hashAlg, &hmac_len)) {
+        LOG_ERROR("Unsupported hash algorithm (%"PRIu16")", hashAlg);
+        return TSS2_ESYS_RC_GENERAL_FAILURE;
     }
 
-    if (!(mycontext->hmac.ossl_context =  EVP_MD_CTX_create())) {
+    IESYS_CRYPTOSSL_CONTEXT *mycontext = context_pool_get(IESYS_CRYPTOSSL_TYPE_HMAC);
+    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /* The digest of a reused context only has to be set if it changes. */
+    if (mycontext->hmac.ossl_hash_alg != md) {
+        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                     (char *)EVP_MD_get0_name(md), 0);
+        params[1] = OSSL_PARAM_construct_end();
+        digest_params = &params[0];
+    }
+    mycontext->hmac.ossl_hash_alg = md;
+    mycontext->hmac.hmac_len = hmac_len;
+
+    if (1 != EVP_MAC_init(mycontext->hmac.ossl_context, key, size, digest_params)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Error EVP_MD_CTX_create", cleanup);
+                   "EVP_MAC_init", cleanup);
     }
+#else
+    mycontext->hmac.ossl_hash_alg = md;
+    mycontext->hmac.hmac_len = hmac_len;
 
     if (!(hkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, key, size))) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
                    "EVP_PKEY_new_mac_key", cleanup);
     }
 
+    EVP_MD_CTX_reset(mycontext->hmac.ossl_context);
     if(1 != EVP_DigestSignInit(mycontext->hmac.ossl_context, NULL,
                                mycontext->hmac.ossl_hash_alg, NULL, hkey)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
                    "DigestSignInit", cleanup);
     }
 
-    mycontext->type = IESYS_CRYPTOSSL_TYPE_HMAC;
+    EVP_PKEY_free(hkey);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 
     *context = (IESYS_CRYPTO_CONTEXT_BLOB *) mycontext;
 
-    EVP_PKEY_free(hkey);
-
     return TSS2_RC_SUCCESS;
 
  cleanup:
-    if (mycontext->hmac.ossl_context)
-        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
+    context_free(mycontext);
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
     if(hkey)
         EVP_PKEY_free(hkey);
-    SAFE_FREE(mycontext);
+#endif
     return r;
 }
 
@@ -378,7 +743,11 @@ iesys_cryptossl_hmac_update(IESYS_CRYPTO_CONTEXT_BLOB * context,
     LOGBLOB_TRACE(buffer, size, "Updating hmac with");
 
     /* Call update with the message */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if(1 != EVP_MAC_update(mycontext->hmac.ossl_context, buffer, size)) {
+#else
     if(1 != EVP_DigestSignUpdate(mycontext->hmac.ossl_context, buffer, size)) {
+#endif
         return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "OSSL HMAC update");
     }
 
@@ -439,15 +808,23 @@ iesys_cryptossl_hmac_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
         return_error(TSS2_ESYS_RC_BAD_SIZE, "Buffer too small");
     }
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (1 != EVP_MAC_final(mycontext->hmac.ossl_context, buffer, size, *size)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "EVP_MAC_final", cleanup);
+    }
+#else
     if (1 != EVP_DigestSignFinal(mycontext->hmac.ossl_context, buffer, size)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "DigestSignFinal", cleanup);
     }
+#endif
 
     LOGBLOB_TRACE(buffer, *size, "read hmac result");
+    context_pool_put(mycontext);
+    *context = NULL;
+    return r;
 
  cleanup:
-    EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
-    SAFE_FREE(mycontext);
+    context_free(mycontext);
     *context = NULL;
     return r;
 }
@@ -497,9 +874,7 @@ iesys_cryptossl_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
             return;
         }
 
-        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
-
-        free(mycontext);
+        context_pool_put(mycontext);
         *context = NULL;
     }
 }
@@ -1113,5 +1488,13 @@ TSS2_RC
 iesys_cryptossl_init() {
     ENGINE_load_builtin_engines();
     OpenSSL_add_all_algorithms();
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    /* Resolve the algorithms once instead of for every computation. */
+    get_ossl_hash_md(TPM2_ALG_SHA1);
+    get_ossl_hash_md(TPM2_ALG_SHA256);
+    get_ossl_hash_md(TPM2_ALG_SHA384);
+    get_ossl_hash_md(TPM2_ALG_SHA512);
+    fetch_hmac();
+#endif
     return TSS2_RC_SUCCESS;
 }
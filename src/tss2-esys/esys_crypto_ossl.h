@@ -135,6 +135,10 @@ TSS2_RC iesys_cryptossl_init();
 
 #define iesys_crypto_init iesys_cryptossl_init
 
+void iesys_cryptossl_pool_release(void);
+
+#define iesys_crypto_pool_release iesys_cryptossl_pool_release
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -7,25 +7,130 @@
 #define ESYS_INT_H
 
 #include <stdint.h>
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
 #include "esys_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** Linked list type for object meta data.
+/** A list of resource objects, ordered by their last use. */
+typedef struct RSRC_LIST_T {
+    struct RSRC_NODE_T *head;   /**< The most recently used object. */
+    struct RSRC_NODE_T *tail;   /**< The least recently used object. */
+    size_t count;               /**< The number of objects in the list. */
+} RSRC_LIST_T;
+
+/** Hash bucket list type for object meta data.
  *
- * This structure represents a linked list to store meta data information of
- * type IESYS_RESOURCE.
+ * This structure represents an entry of the resource table of an ESYS_CONTEXT
+ * to store meta data information of type IESYS_RESOURCE. Entries with the
+ * same hash value are chained in a singly linked list.
  */
 typedef struct RSRC_NODE_T {
     ESYS_TR esys_handle;        /**< The ESYS_TR handle used by the application
                                      to reference this entry. */
     TPM2B_AUTH auth;            /**< The authValue for this resource object. */
     IESYS_RESOURCE rsrc;        /**< The meta data for this resource object. */
-    struct RSRC_NODE_T * next;  /**< The next object in the linked list. */
+    TPMS_CONTEXT *swap_context; /**< The saved context of a transient object
+                                     which was swapped out of the TPM, NULL if
+                                     the object is loaded. */
+    UINT64 last_use;            /**< The command counter of the last use of a
+                                     transient object. */
+    RSRC_LIST_T *lru_list;      /**< The LRU list of the ESYS_CONTEXT which
+                                     holds the object, or NULL. */
+    struct RSRC_NODE_T *lru_prev; /**< The next more recently used object. */
+    struct RSRC_NODE_T *lru_next; /**< The next less recently used object. */
+    TPM2B_NAME salt_key;        /**< The name of the key which encrypted the
+                                     salt of a session, empty if the session
+                                     is not salted or the key is unknown. */
+    struct RSRC_NODE_T * next;  /**< The next object in the same bucket of
+                                     the resource table. */
 } RSRC_NODE_T;
 
+/** An idle session kept for reuse in the session pool of the ESYS_CONTEXT. */
+typedef struct {
+    ESYS_TR session;            /**< The ESYS_TR of the session, ESYS_TR_NONE
+                                     if the session was saved. */
+    TPMS_CONTEXT *saved;        /**< The context of a session evicted with
+                                     TPM2_ContextSave or NULL. */
+    TPMT_SYM_DEF symmetric;     /**< The parameter encryption of the session. */
+    TPMI_ALG_HASH authHash;     /**< The hash algorithm of the session. */
+    TPM2B_NAME salt_key;        /**< The name of the salt key of the session,
+                                     empty if the session is not salted. */
+    UINT64 last_use;            /**< The time of the last use for LRU eviction.*/
+} IESYS_POOL_SESSION;
+
+/** The states of a streaming NV read or write. */
+typedef enum {
+    _ESYS_NV_STREAM_IDLE = 0,   /**< No stream is in progress. */
+    _ESYS_NV_STREAM_GET_CAP,    /**< TPM2_PT_NV_BUFFER_MAX was requested. */
+    _ESYS_NV_STREAM_READ,       /**< A TPM2_NV_Read of one chunk was sent. */
+    _ESYS_NV_STREAM_WRITE       /**< A TPM2_NV_Write of one chunk was sent. */
+} IESYS_NV_STREAM_STATE;
+
+/** The state of a NV read or write which is split into several commands. */
+typedef struct {
+    IESYS_NV_STREAM_STATE state; /**< The state of the stream. */
+    TPM2_CC command;            /**< TPM2_CC_NV_Read or TPM2_CC_NV_Write. */
+    ESYS_TR authHandle;         /**< The authorization handle of the NV index.*/
+    ESYS_TR nvIndex;            /**< The NV index. */
+    ESYS_TR shandle1;           /**< The first session used for all chunks. */
+    ESYS_TR shandle2;           /**< The second session used for all chunks. */
+    ESYS_TR shandle3;           /**< The third session used for all chunks. */
+    UINT16 offset;              /**< The offset of the first octet. */
+    UINT16 size;                /**< The total number of octets. */
+    UINT16 done;                /**< The number of octets transferred so far. */
+    UINT16 chunk;               /**< The number of octets of the current
+                                     command. */
+    uint8_t *data;              /**< The data read or to be written. */
+} IESYS_NV_STREAM;
+
+/** The size of the key and value of the HMAC-SHA256 DRBG of the random pool. */
+#define _ESYS_RANDOM_DRBG_SIZE 32
+
+/** The number of TPM random octets used to seed the random pool. */
+#define _ESYS_RANDOM_SEED_SIZE 48
+
+/** The states of a bulk random request. */
+typedef enum {
+    _ESYS_RANDOM_IDLE = 0,      /**< No request is in progress. */
+    _ESYS_RANDOM_SENT,          /**< A TPM2_GetRandom of one chunk was sent. */
+    _ESYS_RANDOM_DONE           /**< The request was served by the pool. */
+} IESYS_RANDOM_STATE;
+
+/** The state of bulk random requests and of the optional random pool.
+ *
+ * The pool is a HMAC-SHA256 DRBG (NIST SP 800-90A) which is seeded and
+ * reseeded with random octets of the TPM.
+ */
+typedef struct {
+    IESYS_RANDOM_STATE state;   /**< The state of the current request. */
+    ESYS_TR shandle1;           /**< The first session used for all chunks. */
+    ESYS_TR shandle2;           /**< The second session used for all chunks. */
+    ESYS_TR shandle3;           /**< The third session used for all chunks. */
+    uint8_t *buffer;            /**< The buffer of the caller. */
+    size_t size;                /**< The number of octets requested. */
+    size_t filled;              /**< The number of octets generated by the pool. */
+    uint8_t *target;            /**< The buffer for the TPM random octets,
+                                     either buffer or seed. */
+    size_t target_size;         /**< The number of TPM random octets needed. */
+    size_t done;                /**< The number of TPM octets received. */
+    size_t reseed_interval;     /**< The number of octets generated by the pool
+                                     between two reseeds, 0 if the pool is
+                                     disabled. */
+    size_t generated;           /**< Octets generated since the last reseed. */
+    int seeded;                 /**< Whether the pool was seeded. */
+#ifndef _WIN32
+    pid_t pid;                  /**< The process that seeded the pool. */
+#endif
+    uint8_t seed[_ESYS_RANDOM_SEED_SIZE];   /**< The seed being received. */
+    uint8_t key[_ESYS_RANDOM_DRBG_SIZE];    /**< The key of the DRBG. */
+    uint8_t value[_ESYS_RANDOM_DRBG_SIZE];  /**< The value of the DRBG. */
+} IESYS_RANDOM;
+
 typedef struct {
     ESYS_TR tpmKey;
     ESYS_TR bind;
@@ -156,7 +261,11 @@ struct ESYS_CONTEXT {
     TSS2_SYS_CONTEXT *sys;       /**< The SYS context used internally to talk to
                                       the TPM. */
     ESYS_TR esys_handle_cnt;     /**< The next free ESYS_TR number. */
-    RSRC_NODE_T *rsrc_list;      /**< The linked list of all ESYS_TR objects. */
+    RSRC_NODE_T **rsrc_table;    /**< The hash table of all ESYS_TR objects,
+                                      indexed by the ESYS_TR value. */
+    size_t rsrc_table_size;      /**< The number of buckets of rsrc_table
+                                      (always a power of two). */
+    size_t rsrc_count;           /**< The number of objects in rsrc_table. */
     int32_t timeout;             /**< The timeout to be used during
                                       Tss2_Sys_ExecuteFinish. */
     ESYS_TR session_type[3];     /**< The list of TPM session handles in the
@@ -182,6 +291,27 @@ struct ESYS_CONTEXT {
                                       automatically loaded. */
     IESYS_SESSION *enc_session;  /**< Ptr to the enc param session.
                                       Used to restore session attributes */
+    IESYS_POOL_SESSION *session_pool; /**< The idle sessions kept for reuse. */
+    size_t session_pool_size;    /**< The maximum number of pooled sessions. */
+    size_t session_pool_count;   /**< The number of pooled sessions. */
+    UINT64 session_pool_clock;   /**< Counter for the last use of sessions. */
+    size_t resident_limit;       /**< The maximum number of loaded transient
+                                      objects, 0 if objects are not swapped
+                                      out. */
+    UINT64 resident_clock;       /**< Counter of the commands for the last use
+                                      of transient objects. */
+    RSRC_LIST_T resident;        /**< The loaded transient objects. */
+    RSRC_LIST_T unsorted;        /**< The objects created since objects were
+                                      last swapped out, which are moved to
+                                      resident if they are loaded transient
+                                      objects. */
+    int resident_swap_in;        /**< Set while a command resolves its
+                                      handles, swapped out objects are loaded
+                                      again then. */
+    UINT16 nv_buffer_max;        /**< The TPM2_PT_NV_BUFFER_MAX of the TPM, 0 if
+                                      it was neither read nor set yet. */
+    IESYS_NV_STREAM nv_stream;   /**< The state of a streaming NV command. */
+    IESYS_RANDOM random;         /**< The state of bulk random requests. */
 };
 
 /** The number of authomatic resubmissions.
@@ -191,6 +321,14 @@ struct ESYS_CONTEXT {
  */
 #define _ESYS_MAX_SUBMISSIONS 5
 
+/** The initial number of buckets of the resource table.
+ *
+ * The table is doubled whenever the number of objects exceeds the number of
+ * buckets. Since ESYS_TR values are handed out sequentially, masking the
+ * handle with the table size distributes objects evenly across buckets.
+ */
+#define _ESYS_RSRC_TABLE_INIT_SIZE 64
+
 /** Makro testing parameters against null.
  */
 #define _ESYS_ASSERT_NON_NULL(x) \
@@ -117,6 +117,10 @@ init_session_tab(ESYS_CONTEXT *esys_context,
 {
     TSS2_RC r = TPM2_RC_SUCCESS;
     ESYS_TR handle_tab[3] = { shandle1, shandle2, shandle3 };
+
+    /* The command is prepared in the SYS context, such that no object may be
+       swapped in anymore. */
+    esys_context->resident_swap_in = 0;
     for (int i = 0; i < 3; i++) {
         esys_context->session_type[i] = handle_tab[i];
         if (handle_tab[i] == ESYS_TR_NONE || handle_tab[i] == ESYS_TR_PASSWORD) {
@@ -138,7 +142,9 @@ init_session_tab(ESYS_CONTEXT *esys_context,
 
 /** Delete all resource objects stored in the esys context.
  *
- * All resource objects stored in a linked list of the esys context are deleted.
+ * All resource objects stored in the resource table of the esys context are
+ * deleted and the table itself is freed. The saved contexts of swapped out
+ * objects are discarded.
  * @param[in,out] esys_context The ESYS_CONTEXT
  */
 void
@@ -146,13 +152,147 @@ iesys_DeleteAllResourceObjects(ESYS_CONTEXT * esys_context)
 {
     RSRC_NODE_T *node_rsrc;
     RSRC_NODE_T *next_node_rsrc;
-    for (node_rsrc = esys_context->rsrc_list; node_rsrc != NULL;
-         node_rsrc = next_node_rsrc) {
-        next_node_rsrc = node_rsrc->next;
-        SAFE_FREE(node_rsrc);
+    for (size_t i = 0; i < esys_context->rsrc_table_size; i++) {
+        for (node_rsrc = esys_context->rsrc_table[i]; node_rsrc != NULL;
+             node_rsrc = next_node_rsrc) {
+            next_node_rsrc = node_rsrc->next;
+            SAFE_FREE(node_rsrc->swap_context);
+            SAFE_FREE(node_rsrc);
+        }
     }
-    esys_context->rsrc_list = NULL;
+    SAFE_FREE(esys_context->rsrc_table);
+    esys_context->rsrc_table_size = 0;
+    esys_context->rsrc_count = 0;
+    memset(&esys_context->resident, 0, sizeof(esys_context->resident));
+    memset(&esys_context->unsorted, 0, sizeof(esys_context->unsorted));
+}
+
+/** Remove a resource object from its LRU list.
+ *
+ * @param[in,out] node The resource object.
+ */
+static void
+iesys_lru_unlink(RSRC_NODE_T *node)
+{
+    RSRC_LIST_T *list = node->lru_list;
+
+    if (list == NULL)
+        return;
+    if (node->lru_prev)
+        node->lru_prev->lru_next = node->lru_next;
+    else
+        list->head = node->lru_next;
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        list->tail = node->lru_prev;
+    list->count -= 1;
+    node->lru_list = NULL;
+    node->lru_prev = node->lru_next = NULL;
+}
+
+/** Insert a resource object as most recently used object into a LRU list.
+ *
+ * @param[in,out] list The LRU list.
+ * @param[in,out] node The resource object, which must not be in a list.
+ */
+static void
+iesys_lru_push(RSRC_LIST_T *list, RSRC_NODE_T *node)
+{
+    node->lru_list = list;
+    node->lru_prev = NULL;
+    node->lru_next = list->head;
+    if (list->head)
+        list->head->lru_prev = node;
+    else
+        list->tail = node;
+    list->head = node;
+    list->count += 1;
 }
+
+/** Compute the bucket of the resource table for an esys handle.
+ *
+ * @param[in] esys_context The ESYS_CONTEXT
+ * @param[in] esys_handle The esys handle.
+ * @retval The address of the head of the bucket list.
+ */
+static RSRC_NODE_T **
+iesys_rsrc_bucket(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle)
+{
+    return &esys_context->rsrc_table[esys_handle &
+                                     (esys_context->rsrc_table_size - 1)];
+}
+
+/** Resize the resource table of the esys context.
+ *
+ * All objects are rehashed into a newly allocated table with new_size buckets.
+ * @param[in,out] esys_context The ESYS_CONTEXT
+ * @param[in] new_size The new number of buckets (a power of two).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY if the table can not be allocated.
+ */
+static TSS2_RC
+iesys_rsrc_table_resize(ESYS_CONTEXT * esys_context, size_t new_size)
+{
+    RSRC_NODE_T **old_table = esys_context->rsrc_table;
+    size_t old_size = esys_context->rsrc_table_size;
+    RSRC_NODE_T *node_rsrc;
+    RSRC_NODE_T *next_node_rsrc;
+    RSRC_NODE_T **bucket;
+
+    RSRC_NODE_T **new_table = calloc(new_size, sizeof(RSRC_NODE_T *));
+    if (new_table == NULL)
+        return_error(TSS2_ESYS_RC_MEMORY, "Out of memory.");
+
+    esys_context->rsrc_table = new_table;
+    esys_context->rsrc_table_size = new_size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        for (node_rsrc = old_table[i]; node_rsrc != NULL;
+             node_rsrc = next_node_rsrc) {
+            next_node_rsrc = node_rsrc->next;
+            bucket = iesys_rsrc_bucket(esys_context, node_rsrc->esys_handle);
+            node_rsrc->next = *bucket;
+            *bucket = node_rsrc;
+        }
+    }
+    SAFE_FREE(old_table);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Remove a resource object from the esys context.
+ *
+ * The object is unlinked from the resource table and freed.
+ * @param[in,out] esys_context The ESYS_CONTEXT
+ * @param[in] esys_handle The esys handle of the object to be deleted.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_TR if no object with this handle exists.
+ */
+TSS2_RC
+esys_DeleteResourceObject(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle)
+{
+    RSRC_NODE_T *node;
+    RSRC_NODE_T **update_ptr;
+
+    if (esys_context->rsrc_table == NULL)
+        return TSS2_ESYS_RC_BAD_TR;
+
+    for (update_ptr = iesys_rsrc_bucket(esys_context, esys_handle),
+         node = *update_ptr;
+         node != NULL;
+         update_ptr = &node->next, node = node->next) {
+        if (node->esys_handle == esys_handle) {
+            *update_ptr = node->next;
+            iesys_lru_unlink(node);
+            SAFE_FREE(node->swap_context);
+            SAFE_FREE(node);
+            esys_context->rsrc_count -= 1;
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    return TSS2_ESYS_RC_BAD_TR;
+}
+
 /**  Compute the TPM nonce of the session used for parameter encryption.
  *
  * Since only encryption session can be used an error is signaled if
@@ -316,8 +456,9 @@ iesys_compute_rp_hashtab(ESYS_CONTEXT * esys_context,
 }
 /** Create an esys resource object corresponding to a TPM object.
  *
- * The esys object is appended to the resource list stored in the esys context
- * (rsrc_list).
+ * The esys object is added to the resource table stored in the esys context
+ * (rsrc_table). The table is allocated on first use and grown when the number
+ * of objects exceeds the number of buckets.
  * @param[in] esys_context The ESYS_CONTEXT
  * @param[in] esys_handle The esys handle which will be used for this object.
  * @param[out] esys_object The new resource object.
@@ -328,20 +469,38 @@ TSS2_RC
 esys_CreateResourceObject(ESYS_CONTEXT * esys_context,
                           ESYS_TR esys_handle, RSRC_NODE_T ** esys_object)
 {
+    TSS2_RC r;
+    RSRC_NODE_T **bucket;
+
+    if (esys_context->rsrc_table == NULL) {
+        r = iesys_rsrc_table_resize(esys_context, _ESYS_RSRC_TABLE_INIT_SIZE);
+        return_if_error(r, "Creating resource table.");
+    } else if (esys_context->rsrc_count >= esys_context->rsrc_table_size) {
+        r = iesys_rsrc_table_resize(esys_context,
+                                    esys_context->rsrc_table_size * 2);
+        if (r != TSS2_RC_SUCCESS) {
+            /* The old table is still intact, only lookups get slower. */
+            LOG_WARNING("Resource table could not be resized.");
+        }
+    }
+
     RSRC_NODE_T *new_esys_object = calloc(1, sizeof(RSRC_NODE_T));
     if (new_esys_object == NULL)
         return_error(TSS2_ESYS_RC_MEMORY, "Out of memory.");
-    if (esys_context->rsrc_list == NULL) {
-        /* The first object of the list will be added */
-        esys_context->rsrc_list = new_esys_object;
-        new_esys_object->next = NULL;
-    } else {
-        /* The new object will become the first element of the list */
-        new_esys_object->next = esys_context->rsrc_list;
-        esys_context->rsrc_list = new_esys_object;
-    }
+
+    /* The new object will become the first element of its bucket */
+    bucket = iesys_rsrc_bucket(esys_context, esys_handle);
+    new_esys_object->next = *bucket;
+    *bucket = new_esys_object;
+    esys_context->rsrc_count += 1;
+
     *esys_object = new_esys_object;
     new_esys_object->esys_handle = esys_handle;
+
+    /* The TPM handle is set by the caller; whether the object is a loaded
+       transient object is checked at the start of the next command. */
+    new_esys_object->last_use = esys_context->resident_clock;
+    iesys_lru_push(&esys_context->unsorted, new_esys_object);
     return TSS2_RC_SUCCESS;
 }
 
@@ -1041,6 +1200,142 @@ iesys_compute_session_value(RSRC_NODE_T * session,
     session->rsrc.misc.rsrc_session.sizeHmacValue += auth_value->size;
 }
 
+/** Check whether an object is a loaded transient object.
+ *
+ * @param[in] node The resource object.
+ * @retval true if the object is a transient object loaded in the TPM.
+ * @retval false if not.
+ */
+static bool
+iesys_is_resident(RSRC_NODE_T *node)
+{
+    return node->swap_context == NULL &&
+        node->rsrc.rsrcType != IESYSC_SESSION_RSRC &&
+        (node->rsrc.handle >> TPM2_HR_SHIFT) == TPM2_HT_TRANSIENT;
+}
+
+/** Swap a transient object out of the TPM.
+ *
+ * The context of the object is saved with TPM2_ContextSave and the object is
+ * flushed from the TPM. The ESYS_TR of the object stays valid.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in,out] node The resource object to be swapped out.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY if the context can not be allocated.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+static TSS2_RC
+iesys_swap_out(ESYS_CONTEXT *esys_context, RSRC_NODE_T *node)
+{
+    TSS2_RC r;
+    TPMS_CONTEXT *context = calloc(1, sizeof(TPMS_CONTEXT));
+
+    return_if_null(context, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+    r = Tss2_Sys_ContextSave(esys_context->sys, node->rsrc.handle, context);
+    goto_if_error(r, "Saving object context.", error_cleanup);
+
+    r = Tss2_Sys_FlushContext(esys_context->sys, node->rsrc.handle);
+    goto_if_error(r, "Flushing object.", error_cleanup);
+
+    LOG_DEBUG("Swapped out object 0x%08"PRIx32" (tpm handle 0x%08"PRIx32")",
+              node->esys_handle, node->rsrc.handle);
+    node->swap_context = context;
+    iesys_lru_unlink(node);
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    SAFE_FREE(context);
+    return r;
+}
+
+/** Move the objects created since the last swap out to the resident list.
+ *
+ * The objects are checked once for being loaded transient objects, after
+ * their TPM handle was set by the command which created them.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+static void
+iesys_lru_sort(ESYS_CONTEXT *esys_context)
+{
+    RSRC_NODE_T *node;
+
+    /* The oldest object first, such that the newest one becomes the head */
+    while ((node = esys_context->unsorted.tail) != NULL) {
+        iesys_lru_unlink(node);
+        if (iesys_is_resident(node))
+            iesys_lru_push(&esys_context->resident, node);
+    }
+}
+
+/** Swap out least recently used transient objects.
+ *
+ * Objects used by the current command are not swapped out. Since the resident
+ * list is ordered by the last use, these are the first ones of the list.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] max_resident The number of transient objects which may stay
+ *            loaded.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+static TSS2_RC
+iesys_swap_out_lru(ESYS_CONTEXT *esys_context, size_t max_resident)
+{
+    RSRC_NODE_T *lru;
+    TSS2_RC r;
+
+    iesys_lru_sort(esys_context);
+    while (esys_context->resident.count > max_resident) {
+        lru = esys_context->resident.tail;
+        if (lru->last_use == esys_context->resident_clock)
+            return TSS2_RC_SUCCESS;
+
+        r = iesys_swap_out(esys_context, lru);
+        return_if_error(r, "Swapping out object.");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Mark a transient object as used and load it if it was swapped out.
+ *
+ * If necessary, least recently used objects are swapped out before, such that
+ * the resident object limit of the ESYS_CONTEXT is kept.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in,out] node The resource object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+TSS2_RC
+iesys_swap_in(ESYS_CONTEXT *esys_context, RSRC_NODE_T *node)
+{
+    TPMI_DH_CONTEXT handle;
+    TSS2_RC r;
+
+    node->last_use = esys_context->resident_clock;
+    if (node->swap_context == NULL) {
+        if (node->lru_list == &esys_context->resident) {
+            iesys_lru_unlink(node);
+            iesys_lru_push(&esys_context->resident, node);
+        }
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (esys_context->resident_limit > 0) {
+        r = iesys_swap_out_lru(esys_context, esys_context->resident_limit - 1);
+        return_if_error(r, "Swapping out objects.");
+    }
+
+    r = Tss2_Sys_ContextLoad(esys_context->sys, node->swap_context, &handle);
+    return_if_error(r, "Loading object context.");
+
+    LOG_DEBUG("Swapped in object 0x%08"PRIx32" (tpm handle 0x%08"PRIx32")",
+              node->esys_handle, handle);
+    node->rsrc.handle = handle;
+    SAFE_FREE(node->swap_context);
+    iesys_lru_push(&esys_context->resident, node);
+    return TSS2_RC_SUCCESS;
+}
+
 /**
  * Lookup the object to a handle from inside the context.
  *
@@ -1051,6 +1346,8 @@ iesys_compute_session_value(RSRC_NODE_T * session,
  * same context, in which case this will be returned. Or they refer to a
  * "global", in which case the corresponding object will be created if it does
  * not exist yet.
+ * While an _async function resolves its handles, transient objects which were
+ * swapped out by the ESYS_CONTEXT are loaded into the TPM again.
  * @param[in,out] esys_context The esys context to issue the command on.
  * @param[in] esys_handle The handle to find the corresponding object for.
  * @param[out] esys_object The object containing the name, tpm handle and auth value
@@ -1077,16 +1374,23 @@ esys_GetResourceObject(ESYS_CONTEXT * esys_context,
     }
 
     /* The typical case is that we have a resource object already within the
-       esys context's linked list. We iterate through the list and search
-       for the corresponding object and return it if found.
+       esys context's resource table. We search the bucket of the handle for
+       the corresponding object and return it if found.
        If no object is found, this can be an erroneous handle number or it
        can be because of a reference "global" object that does not require
        previous initialization. */
-    for (esys_object_aux = esys_context->rsrc_list; esys_object_aux != NULL;
-         esys_object_aux = esys_object_aux->next) {
-        if (esys_object_aux->esys_handle == esys_handle) {
-            *esys_object = esys_object_aux;
-            return TPM2_RC_SUCCESS;
+    if (esys_context->rsrc_table != NULL) {
+        for (esys_object_aux = *iesys_rsrc_bucket(esys_context, esys_handle);
+             esys_object_aux != NULL;
+             esys_object_aux = esys_object_aux->next) {
+            if (esys_object_aux->esys_handle == esys_handle) {
+                if (esys_context->resident_swap_in) {
+                    r = iesys_swap_in(esys_context, esys_object_aux);
+                    return_if_error(r, "Swapping in object.");
+                }
+                *esys_object = esys_object_aux;
+                return TPM2_RC_SUCCESS;
+            }
         }
     }
 
@@ -1128,6 +1432,8 @@ esys_GetResourceObject(ESYS_CONTEXT * esys_context,
  * was such that an _async function can be called. This means that the internal
  * @state field is either @_ESYS_STATE_INIT, @_ESYS_STATE_ERRORRESPONSE,
  * @_ESYS_STATE_FINISHED.
+ * If a resident object limit is set, least recently used transient objects
+ * are swapped out of the TPM such that the command may load a new object.
  * @param[in,out] esys_context The esys context to issue the command on.
  * @retval TSS2_RC_SUCCESS on success.
  * @retval TSS2_RC_BAD_SEQUENCE if context is not ready for this function.
@@ -1146,6 +1452,17 @@ iesys_check_sequence_async(ESYS_CONTEXT * esys_context)
         return TSS2_ESYS_RC_BAD_SEQUENCE;
     }
     esys_context->submissionCount = 1;
+
+    /* Objects used by this command get a new mark of use */
+    esys_context->resident_clock += 1;
+    esys_context->resident_swap_in = 1;
+    if (esys_context->resident_limit > 0 &&
+        esys_context->state == _ESYS_STATE_INIT) {
+        TSS2_RC r = iesys_swap_out_lru(esys_context,
+                                       esys_context->resident_limit - 1);
+        if (r != TSS2_RC_SUCCESS)
+            LOG_WARNING("Swapping out objects failed: 0x%"PRIx32, r);
+    }
     return TSS2_RC_SUCCESS;
 }
 
@@ -45,6 +45,9 @@ TSS2_RC init_session_tab(
 void iesys_DeleteAllResourceObjects(
     ESYS_CONTEXT *esys_context);
 
+void iesys_session_pool_finalize(
+    ESYS_CONTEXT *esys_context);
+
 TSS2_RC iesys_compute_encrypt_nonce(
     ESYS_CONTEXT *esysContext,
     int *encryptNonceIdx,
@@ -70,6 +73,10 @@ TSS2_RC esys_CreateResourceObject(
     ESYS_TR esys_handle,
     RSRC_NODE_T **node);
 
+TSS2_RC esys_DeleteResourceObject(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR esys_handle);
+
 TSS2_RC iesys_handle_to_tpm_handle(
     ESYS_TR esys_handle,
     TPM2_HANDLE *tpm_handle);
@@ -83,6 +90,10 @@ TSS2_RC esys_GetResourceObject(
     ESYS_TR rsrc_handle,
     RSRC_NODE_T **node);
 
+TSS2_RC iesys_swap_in(
+    ESYS_CONTEXT *esys_context,
+    RSRC_NODE_T *node);
+
 TPM2_HT iesys_get_handle_type(
     TPM2_HANDLE handle);
 
@@ -171,6 +182,13 @@ TSS2_RC iesys_hash_long_auth_values(
     TPM2B_AUTH *auth_value,
     TPMI_ALG_HASH hash_alg);
 
+TSS2_RC iesys_GetRandom_Finish(
+    ESYS_CONTEXT *esysContext,
+    TPM2B_DIGEST *randomBytes);
+
+void iesys_random_wipe(
+    ESYS_CONTEXT *esys_context);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
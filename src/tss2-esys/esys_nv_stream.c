@@ -0,0 +1,524 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2017-2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** The NV buffer size every TPM supports.
+ *
+ * Used if the TPM does not report TPM2_PT_NV_BUFFER_MAX.
+ */
+#define NV_STREAM_MIN_BUFFER 64
+
+/** Reset the NV stream of the ESYS_CONTEXT.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+static void
+nv_stream_reset(ESYS_CONTEXT *esys_context)
+{
+    SAFE_FREE(esys_context->nv_stream.data);
+    memset(&esys_context->nv_stream, 0, sizeof(esys_context->nv_stream));
+}
+
+/** Send the next command of the NV stream.
+ *
+ * If TPM2_PT_NV_BUFFER_MAX was neither read yet nor set with
+ * Esys_SetNvBufferMax(), it is requested first.
+ * Otherwise the next chunk is read or written with the sessions of the
+ * stream.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS if the command was sent.
+ * @retval TSS2_RCs produced by the _Async functions.
+ */
+static TSS2_RC
+nv_stream_send(ESYS_CONTEXT *esys_context)
+{
+    IESYS_NV_STREAM *stream = &esys_context->nv_stream;
+    TSS2_RC r;
+
+    if (esys_context->nv_buffer_max == 0) {
+        r = Esys_GetCapability_Async(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                     ESYS_TR_NONE, TPM2_CAP_TPM_PROPERTIES,
+                                     TPM2_PT_NV_BUFFER_MAX, 1);
+        return_if_error(r, "Get NV buffer size.");
+
+        stream->state = _ESYS_NV_STREAM_GET_CAP;
+        return TSS2_RC_SUCCESS;
+    }
+
+    stream->chunk = stream->size - stream->done;
+    if (stream->chunk > esys_context->nv_buffer_max)
+        stream->chunk = esys_context->nv_buffer_max;
+
+    if (stream->command == TPM2_CC_NV_Read) {
+        r = Esys_NV_Read_Async(esys_context, stream->authHandle, stream->nvIndex,
+                               stream->shandle1, stream->shandle2,
+                               stream->shandle3, stream->chunk,
+                               stream->offset + stream->done);
+        return_if_error(r, "NV read chunk.");
+
+        stream->state = _ESYS_NV_STREAM_READ;
+    } else {
+        TPM2B_MAX_NV_BUFFER buffer = { .size = stream->chunk };
+
+        memcpy(&buffer.buffer[0], &stream->data[stream->done], stream->chunk);
+        r = Esys_NV_Write_Async(esys_context, stream->authHandle, stream->nvIndex,
+                                stream->shandle1, stream->shandle2,
+                                stream->shandle3, &buffer,
+                                stream->offset + stream->done);
+        return_if_error(r, "NV write chunk.");
+
+        stream->state = _ESYS_NV_STREAM_WRITE;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Start a NV stream.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] command TPM2_CC_NV_Read or TPM2_CC_NV_Write.
+ * @param[in] authHandle The handle indicating the source of the authorization
+ *            value.
+ * @param[in] nvIndex The NV index.
+ * @param[in] shandle1 Session handle for authorization of authHandle.
+ * @param[in] shandle2 Second session handle.
+ * @param[in] shandle3 Third session handle.
+ * @param[in] data The data to be written or NULL for reading.
+ * @param[in] size The number of octets.
+ * @param[in] offset The octet offset into the NV area.
+ * @retval TSS2_RC_SUCCESS if the first command was sent.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a stream is already in progress.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size is 0 or offset + size exceeds the
+ *         range of NV offsets.
+ * @retval TSS2_ESYS_RC_MEMORY if the memory for the data cannot be allocated.
+ * @retval TSS2_RCs produced by the _Async functions.
+ */
+static TSS2_RC
+nv_stream_start(ESYS_CONTEXT *esys_context, TPM2_CC command,
+                ESYS_TR authHandle, ESYS_TR nvIndex, ESYS_TR shandle1,
+                ESYS_TR shandle2, ESYS_TR shandle3, uint8_t const *data,
+                UINT16 size, UINT16 offset)
+{
+    IESYS_NV_STREAM *stream = &esys_context->nv_stream;
+    TSS2_RC r;
+
+    if (stream->state != _ESYS_NV_STREAM_IDLE) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+    if (size == 0 || (UINT32)offset + size > UINT16_MAX + 1) {
+        return_error(TSS2_ESYS_RC_BAD_VALUE, "Bad size or offset of NV data.");
+    }
+
+    stream->data = calloc(1, size);
+    return_if_null(stream->data, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+    if (data)
+        memcpy(stream->data, data, size);
+
+    stream->command = command;
+    stream->authHandle = authHandle;
+    stream->nvIndex = nvIndex;
+    stream->shandle1 = shandle1;
+    stream->shandle2 = shandle2;
+    stream->shandle3 = shandle3;
+    stream->offset = offset;
+    stream->size = size;
+    stream->done = 0;
+
+    r = nv_stream_send(esys_context);
+    if (r != TSS2_RC_SUCCESS)
+        nv_stream_reset(esys_context);
+    return r;
+}
+
+/** Receive the response of the current command of a NV stream.
+ *
+ * If data is left, the command for the next chunk is sent.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS if all data was transferred.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if the stream is not finished yet.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned less data than
+ *         requested.
+ * @retval TSS2_RCs produced by the _Async and _Finish functions.
+ */
+static TSS2_RC
+nv_stream_finish(ESYS_CONTEXT *esys_context)
+{
+    IESYS_NV_STREAM *stream = &esys_context->nv_stream;
+    TPMS_CAPABILITY_DATA *capability = NULL;
+    TPM2B_MAX_NV_BUFFER *buffer = NULL;
+    TSS2_RC r;
+
+    switch (stream->state) {
+    case _ESYS_NV_STREAM_GET_CAP:
+        r = Esys_GetCapability_Finish(esys_context, NULL, &capability);
+        if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+            return r;
+        return_if_error(r, "Get NV buffer size.");
+
+        if (capability->data.tpmProperties.count == 1 &&
+            capability->data.tpmProperties.tpmProperty[0].property ==
+            TPM2_PT_NV_BUFFER_MAX &&
+            capability->data.tpmProperties.tpmProperty[0].value > 0) {
+            UINT32 value = capability->data.tpmProperties.tpmProperty[0].value;
+            esys_context->nv_buffer_max = (value > TPM2_MAX_NV_BUFFER_SIZE) ?
+                TPM2_MAX_NV_BUFFER_SIZE : value;
+        } else {
+            /* Older TPMs may not report the property. */
+            esys_context->nv_buffer_max = NV_STREAM_MIN_BUFFER;
+        }
+        free(capability);
+        LOG_DEBUG("NV buffer size: %"PRIu16, esys_context->nv_buffer_max);
+        break;
+
+    case _ESYS_NV_STREAM_READ:
+        r = Esys_NV_Read_Finish(esys_context, &buffer);
+        if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+            return r;
+        return_if_error(r, "NV read chunk.");
+
+        if (buffer->size != stream->chunk) {
+            free(buffer);
+            return_error(TSS2_ESYS_RC_MALFORMED_RESPONSE,
+                         "TPM returned a short NV read.");
+        }
+        memcpy(&stream->data[stream->done], &buffer->buffer[0], buffer->size);
+        stream->done += buffer->size;
+        free(buffer);
+        break;
+
+    case _ESYS_NV_STREAM_WRITE:
+        r = Esys_NV_Write_Finish(esys_context);
+        if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+            return r;
+        return_if_error(r, "NV write chunk.");
+
+        stream->done += stream->chunk;
+        break;
+
+    default:
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    if (stream->done == stream->size)
+        return TSS2_RC_SUCCESS;
+
+    r = nv_stream_send(esys_context);
+    return_if_error(r, "Send next NV chunk.");
+
+    return TSS2_ESYS_RC_TRY_AGAIN;
+}
+
+/** One-Call function for reading a NV index in several chunks.
+ *
+ * Reads size octets with as many TPM2_NV_Read commands as the
+ * TPM2_PT_NV_BUFFER_MAX of the TPM requires. The capability is read once per
+ * ESYS_CONTEXT. All commands use the same sessions, which therefore need the
+ * attribute continueSession. Policy sessions are reset by the TPM after each
+ * command; with a policy session only data which fits into one command can
+ * be read.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle The handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index to be read.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  size Number of octets to read.
+ * @param[in]  offset Octet offset into the area.
+ * @param[out] data The size octets read.
+ *             (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size is 0 or offset + size exceeds the
+ *         range of NV offsets.
+ * @retval TSS2_ESYS_RC_MEMORY if the ESAPI cannot allocate enough memory.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned less data than
+ *         requested.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_ReadStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 size,
+    UINT16 offset,
+    uint8_t **data)
+{
+    TSS2_RC r;
+
+    _ESYS_ASSERT_NON_NULL(data);
+
+    r = Esys_NV_ReadStream_Async(esysContext, authHandle, nvIndex, shandle1,
+                                 shandle2, shandle3, size, offset);
+    return_if_error(r, "Error in async function");
+
+    /* Set the timeout to indefinite for now, since we want _Finish to block */
+    int32_t timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+    do {
+        r = Esys_NV_ReadStream_Finish(esysContext, data);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    /* Restore the timeout value to the original value */
+    esysContext->timeout = timeouttmp;
+    return_if_error(r, "Esys Finish");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for reading a NV index in several chunks.
+ *
+ * Sends the first command of the stream. In order to retrieve the data call
+ * Esys_NV_ReadStream_Finish until it does not return TSS2_ESYS_RC_TRY_AGAIN.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle The handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index to be read.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  size Number of octets to read.
+ * @param[in]  offset Octet offset into the area.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size is 0 or offset + size exceeds the
+ *         range of NV offsets.
+ * @retval TSS2_ESYS_RC_MEMORY if the ESAPI cannot allocate enough memory.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_ReadStream_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    UINT16 size,
+    UINT16 offset)
+{
+    LOG_TRACE("context=%p, authHandle=%"PRIx32 ", nvIndex=%"PRIx32 ","
+              "size=%04"PRIx16", offset=%04"PRIx16"",
+              esysContext, authHandle, nvIndex, size, offset);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+
+    return nv_stream_start(esysContext, TPM2_CC_NV_Read, authHandle, nvIndex,
+                           shandle1, shandle2, shandle3, NULL, size, offset);
+}
+
+/** Asynchronous finish function for reading a NV index in several chunks.
+ *
+ * Receives the response of the current chunk and sends the command for the
+ * next one.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[out] data The octets read; the size was passed to
+ *             Esys_NV_ReadStream_Async. May be NULL.
+ *             (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if no NV read stream is in progress.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if not all chunks were read yet.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned less data than
+ *         requested.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_ReadStream_Finish(
+    ESYS_CONTEXT *esysContext,
+    uint8_t **data)
+{
+    TSS2_RC r;
+    LOG_TRACE("context=%p, data=%p", esysContext, data);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (esysContext->nv_stream.state == _ESYS_NV_STREAM_IDLE ||
+        esysContext->nv_stream.command != TPM2_CC_NV_Read) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    r = nv_stream_finish(esysContext);
+    if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+        return r;
+
+    if (r == TSS2_RC_SUCCESS && data != NULL) {
+        *data = esysContext->nv_stream.data;
+        esysContext->nv_stream.data = NULL;
+    }
+    nv_stream_reset(esysContext);
+    return r;
+}
+
+/** One-Call function for writing a NV index in several chunks.
+ *
+ * Writes size octets with as many TPM2_NV_Write commands as the
+ * TPM2_PT_NV_BUFFER_MAX of the TPM requires. The capability is read once per
+ * ESYS_CONTEXT. All commands use the same sessions, which therefore need the
+ * attribute continueSession. Policy sessions are reset by the TPM after each
+ * command; with a policy session only data which fits into one command can
+ * be written.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle Handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index of the area to write.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  data The data to write.
+ * @param[in]  size Number of octets to write.
+ * @param[in]  offset The offset into the NV Area.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size is 0 or offset + size exceeds the
+ *         range of NV offsets.
+ * @retval TSS2_ESYS_RC_MEMORY if the ESAPI cannot allocate enough memory.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_WriteStream(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t const *data,
+    UINT16 size,
+    UINT16 offset)
+{
+    TSS2_RC r;
+
+    r = Esys_NV_WriteStream_Async(esysContext, authHandle, nvIndex, shandle1,
+                                  shandle2, shandle3, data, size, offset);
+    return_if_error(r, "Error in async function");
+
+    /* Set the timeout to indefinite for now, since we want _Finish to block */
+    int32_t timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+    do {
+        r = Esys_NV_WriteStream_Finish(esysContext);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    /* Restore the timeout value to the original value */
+    esysContext->timeout = timeouttmp;
+    return_if_error(r, "Esys Finish");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for writing a NV index in several chunks.
+ *
+ * The data is copied and the first command of the stream is sent. In order
+ * to complete the write call Esys_NV_WriteStream_Finish until it does not
+ * return TSS2_ESYS_RC_TRY_AGAIN.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  authHandle Handle indicating the source of the authorization
+ *             value.
+ * @param[in]  nvIndex The NV Index of the area to write.
+ * @param[in]  shandle1 Session handle for authorization of authHandle
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[in]  data The data to write.
+ * @param[in]  size Number of octets to write.
+ * @param[in]  offset The offset into the NV Area.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or data is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if size is 0 or offset + size exceeds the
+ *         range of NV offsets.
+ * @retval TSS2_ESYS_RC_MEMORY if the ESAPI cannot allocate enough memory.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_WriteStream_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR authHandle,
+    ESYS_TR nvIndex,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t const *data,
+    UINT16 size,
+    UINT16 offset)
+{
+    LOG_TRACE("context=%p, authHandle=%"PRIx32 ", nvIndex=%"PRIx32 ","
+              "data=%p, size=%04"PRIx16", offset=%04"PRIx16"",
+              esysContext, authHandle, nvIndex, data, size, offset);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(data);
+
+    return nv_stream_start(esysContext, TPM2_CC_NV_Write, authHandle, nvIndex,
+                           shandle1, shandle2, shandle3, data, size, offset);
+}
+
+/** Asynchronous finish function for writing a NV index in several chunks.
+ *
+ * Receives the response of the current chunk and sends the command for the
+ * next one.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if no NV write stream is in progress.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if not all chunks were written yet.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_NV_WriteStream_Finish(
+    ESYS_CONTEXT *esysContext)
+{
+    TSS2_RC r;
+    LOG_TRACE("context=%p", esysContext);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    if (esysContext->nv_stream.state == _ESYS_NV_STREAM_IDLE ||
+        esysContext->nv_stream.command != TPM2_CC_NV_Write) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    r = nv_stream_finish(esysContext);
+    if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+        return r;
+
+    nv_stream_reset(esysContext);
+    return r;
+}
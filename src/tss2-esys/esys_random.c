@@ -0,0 +1,517 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2017-2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** The maximum number of octets of one DRBG generate request.
+ *
+ * NIST SP 800-90A limits a request to 2^19 bits.
+ */
+#define DRBG_MAX_REQUEST 65536
+
+/** Wipe secret octets; unlike memset() the store is not optimized away.
+ *
+ * @param[out] data The octets to wipe.
+ * @param[in] size The number of octets.
+ */
+static void
+random_wipe(void *data, size_t size)
+{
+#ifdef HAVE_EXPLICIT_BZERO
+    explicit_bzero(data, size);
+#else
+    volatile uint8_t *p = data;
+
+    while (size--)
+        *p++ = 0;
+#endif
+}
+
+/** Compute one HMAC of the DRBG.
+ *
+ * out = HMAC(key, value || separator || data), where the separator and the
+ * data are optional.
+ * @param[in] key The DRBG key.
+ * @param[in] value The DRBG value.
+ * @param[in] separator The separator octet or NULL.
+ * @param[in] data The additional data or NULL.
+ * @param[in] size The size of data.
+ * @param[out] out The HMAC (_ESYS_RANDOM_DRBG_SIZE octets).
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by the crypto backend.
+ */
+static TSS2_RC
+drbg_hmac(const uint8_t *key, const uint8_t *value, const uint8_t *separator,
+          const uint8_t *data, size_t size, uint8_t *out)
+{
+    IESYS_CRYPTO_CONTEXT_BLOB *context;
+    size_t out_size = _ESYS_RANDOM_DRBG_SIZE;
+    TSS2_RC r;
+
+    r = iesys_crypto_hmac_start(&context, TPM2_ALG_SHA256, key,
+                                _ESYS_RANDOM_DRBG_SIZE);
+    return_if_error(r, "HMAC start.");
+
+    r = iesys_crypto_hmac_update(context, value, _ESYS_RANDOM_DRBG_SIZE);
+    goto_if_error(r, "HMAC update.", error_cleanup);
+    if (separator) {
+        r = iesys_crypto_hmac_update(context, separator, 1);
+        goto_if_error(r, "HMAC update.", error_cleanup);
+    }
+    if (size > 0) {
+        r = iesys_crypto_hmac_update(context, data, size);
+        goto_if_error(r, "HMAC update.", error_cleanup);
+    }
+    return iesys_crypto_hmac_finish(&context, out, &out_size);
+
+error_cleanup:
+    iesys_crypto_hmac_abort(&context);
+    return r;
+}
+
+/** The update function of the HMAC DRBG.
+ *
+ * @param[in,out] random The random state with the DRBG.
+ * @param[in] data The provided data or NULL.
+ * @param[in] size The size of data.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by the crypto backend.
+ */
+static TSS2_RC
+drbg_update(IESYS_RANDOM *random, const uint8_t *data, size_t size)
+{
+    const uint8_t separator[2] = { 0x00, 0x01 };
+    TSS2_RC r;
+
+    for (size_t i = 0; i < 2; i++) {
+        r = drbg_hmac(random->key, random->value, &separator[i], data, size,
+                      random->key);
+        return_if_error(r, "DRBG key.");
+
+        r = drbg_hmac(random->key, random->value, NULL, NULL, 0, random->value);
+        return_if_error(r, "DRBG value.");
+
+        if (size == 0)
+            break;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Seed or reseed the DRBG with the random octets received from the TPM.
+ *
+ * @param[in,out] random The random state with the DRBG.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by the crypto backend.
+ */
+static TSS2_RC
+drbg_seed(IESYS_RANDOM *random)
+{
+    TSS2_RC r;
+
+    if (!random->seeded) {
+        memset(random->key, 0x00, sizeof(random->key));
+        memset(random->value, 0x01, sizeof(random->value));
+    }
+    r = drbg_update(random, random->seed, sizeof(random->seed));
+    random_wipe(random->seed, sizeof(random->seed));
+    if (r != TSS2_RC_SUCCESS) {
+        random->seeded = 0;
+        return_error(r, "Seed DRBG.");
+    }
+
+    random->seeded = 1;
+    random->generated = 0;
+#ifndef _WIN32
+    random->pid = getpid();
+#endif
+    return TSS2_RC_SUCCESS;
+}
+
+/** Generate random octets with the DRBG.
+ *
+ * @param[in,out] random The random state with the DRBG.
+ * @param[out] buffer The buffer for the random octets.
+ * @param[in] size The number of octets.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_RCs produced by the crypto backend.
+ */
+static TSS2_RC
+drbg_generate(IESYS_RANDOM *random, uint8_t *buffer, size_t size)
+{
+    size_t request;
+    size_t chunk;
+    TSS2_RC r;
+
+    while (size > 0) {
+        request = (size > DRBG_MAX_REQUEST) ? DRBG_MAX_REQUEST : size;
+        size -= request;
+        random->generated += request;
+        while (request > 0) {
+            r = drbg_hmac(random->key, random->value, NULL, NULL, 0,
+                          random->value);
+            return_if_error(r, "DRBG generate.");
+
+            chunk = (request > sizeof(random->value)) ?
+                sizeof(random->value) : request;
+            memcpy(buffer, random->value, chunk);
+            buffer += chunk;
+            request -= chunk;
+        }
+        r = drbg_update(random, NULL, 0);
+        return_if_error(r, "DRBG update.");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Finish the current bulk random request.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+static void
+random_reset(ESYS_CONTEXT *esys_context)
+{
+    IESYS_RANDOM *random = &esys_context->random;
+
+    random->state = _ESYS_RANDOM_IDLE;
+    random->buffer = NULL;
+    random->target = NULL;
+    random->size = random->filled = random->target_size = random->done = 0;
+}
+
+/** Send the TPM2_GetRandom for the next chunk of the bulk random request.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS if the command was sent.
+ * @retval TSS2_RCs produced by Esys_GetRandom_Async.
+ */
+static TSS2_RC
+random_send(ESYS_CONTEXT *esys_context)
+{
+    IESYS_RANDOM *random = &esys_context->random;
+    size_t chunk = random->target_size - random->done;
+    TSS2_RC r;
+
+    /* The TPM returns at most the size of its largest digest. */
+    if (chunk > sizeof(TPMU_HA))
+        chunk = sizeof(TPMU_HA);
+
+    r = Esys_GetRandom_Async(esys_context, random->shandle1, random->shandle2,
+                             random->shandle3, chunk);
+    return_if_error(r, "GetRandom chunk.");
+
+    random->state = _ESYS_RANDOM_SENT;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Generate the octets of the bulk random request with the random pool.
+ *
+ * The pool generates at most reseed_interval octets per seed. A request that
+ * crosses this boundary is split; the pool is reseeded with random octets of
+ * the TPM before the remaining octets are generated. A pool inherited by a
+ * forked process is reseeded before its first use in the child.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS if all octets were generated (state
+ *         _ESYS_RANDOM_DONE) or the TPM2_GetRandom for the reseed was sent
+ *         (state _ESYS_RANDOM_SENT).
+ * @retval TSS2_RCs produced by the crypto backend or Esys_GetRandom_Async.
+ */
+static TSS2_RC
+random_pool_fill(ESYS_CONTEXT *esys_context)
+{
+    IESYS_RANDOM *random = &esys_context->random;
+    size_t chunk;
+    TSS2_RC r;
+
+#ifndef _WIN32
+    /* A forked child must not repeat the octets of its parent */
+    if (random->seeded && random->pid != getpid())
+        random->generated = random->reseed_interval;
+#endif
+
+    if (random->seeded && random->generated < random->reseed_interval) {
+        chunk = random->size - random->filled;
+        if (chunk > random->reseed_interval - random->generated)
+            chunk = random->reseed_interval - random->generated;
+
+        r = drbg_generate(random, &random->buffer[random->filled], chunk);
+        return_if_error(r, "Generate random octets.");
+        random->filled += chunk;
+    }
+
+    if (random->filled == random->size) {
+        random->state = _ESYS_RANDOM_DONE;
+        return TSS2_RC_SUCCESS;
+    }
+
+    /* (Re)seed the pool before generating the remaining octets */
+    random->target = random->seed;
+    random->target_size = sizeof(random->seed);
+    random->done = 0;
+    return random_send(esys_context);
+}
+
+/** Configure the random pool of an ESYS_CONTEXT.
+ *
+ * With the pool enabled, Esys_GetRandomBulk() generates the random octets
+ * with a HMAC-SHA256 DRBG (NIST SP 800-90A) of the crypto backend. The DRBG
+ * is seeded with random octets of the TPM on first use and reseeded after
+ * reseedInterval octets, also within a single request, and after fork().
+ * Thus most requests are served without TPM commands. The random octets of
+ * the TPM are only used directly if the pool is disabled, which is the
+ * default.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] reseedInterval The number of octets generated between two
+ *            reseeds, 0 disables the pool.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esys_context is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a bulk random request is pending.
+ */
+TSS2_RC
+Esys_SetRandomPool(ESYS_CONTEXT *esys_context, size_t reseedInterval)
+{
+    IESYS_RANDOM *random;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    random = &esys_context->random;
+    if (random->state != _ESYS_RANDOM_IDLE) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    if (reseedInterval == 0) {
+        /* Wipe the DRBG state of a disabled pool */
+        iesys_random_wipe(esys_context);
+    }
+    random->reseed_interval = reseedInterval;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Wipe the DRBG state of the random pool.
+ *
+ * Called when the pool is disabled and by Esys_Finalize() before the
+ * context is freed.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_random_wipe(ESYS_CONTEXT *esys_context)
+{
+    IESYS_RANDOM *random = &esys_context->random;
+
+    random_wipe(random->key, sizeof(random->key));
+    random_wipe(random->value, sizeof(random->value));
+    random_wipe(random->seed, sizeof(random->seed));
+    random->seeded = 0;
+}
+
+/** One-Call function for bulk random octets.
+ *
+ * Fills a buffer of the caller with random octets. Without the random pool
+ * (see Esys_SetRandomPool()) as many TPM2_GetRandom commands are sent as
+ * needed. All commands use the same sessions.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 First session handle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[out] randomBytes The buffer for the random octets.
+ *             (caller-allocated)
+ * @param[in]  size The number of random octets.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or randomBytes is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned no random
+ *         octets.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_GetRandomBulk(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t *randomBytes,
+    size_t size)
+{
+    TSS2_RC r;
+
+    r = Esys_GetRandomBulk_Async(esysContext, shandle1, shandle2, shandle3,
+                                 randomBytes, size);
+    return_if_error(r, "Error in async function");
+
+    /* Set the timeout to indefinite for now, since we want _Finish to block */
+    int32_t timeouttmp = esysContext->timeout;
+    esysContext->timeout = -1;
+    do {
+        r = Esys_GetRandomBulk_Finish(esysContext);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    /* Restore the timeout value to the original value */
+    esysContext->timeout = timeouttmp;
+    return_if_error(r, "Esys Finish");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for bulk random octets.
+ *
+ * Starts the request. The buffer must stay valid until
+ * Esys_GetRandomBulk_Finish does not return TSS2_ESYS_RC_TRY_AGAIN any more.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @param[in]  shandle1 First session handle.
+ * @param[in]  shandle2 Second session handle.
+ * @param[in]  shandle3 Third session handle.
+ * @param[out] randomBytes The buffer for the random octets.
+ *             (caller-allocated)
+ * @param[in]  size The number of random octets.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext or randomBytes is
+ *         NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_GetRandomBulk_Async(
+    ESYS_CONTEXT *esysContext,
+    ESYS_TR shandle1,
+    ESYS_TR shandle2,
+    ESYS_TR shandle3,
+    uint8_t *randomBytes,
+    size_t size)
+{
+    IESYS_RANDOM *random;
+    TSS2_RC r;
+    LOG_TRACE("context=%p, randomBytes=%p, size=%zu",
+              esysContext, randomBytes, size);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    _ESYS_ASSERT_NON_NULL(randomBytes);
+    random = &esysContext->random;
+    if (random->state != _ESYS_RANDOM_IDLE ||
+        esysContext->state != _ESYS_STATE_INIT) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    random->shandle1 = shandle1;
+    random->shandle2 = shandle2;
+    random->shandle3 = shandle3;
+    random->buffer = randomBytes;
+    random->size = size;
+    random->filled = 0;
+    random->done = 0;
+
+    if (random->reseed_interval > 0) {
+        r = random_pool_fill(esysContext);
+    } else if (size == 0) {
+        random->state = _ESYS_RANDOM_DONE;
+        return TSS2_RC_SUCCESS;
+    } else {
+        random->target = randomBytes;
+        random->target_size = size;
+        r = random_send(esysContext);
+    }
+    if (r != TSS2_RC_SUCCESS)
+        random_reset(esysContext);
+    return r;
+}
+
+/** Asynchronous finish function for bulk random octets.
+ *
+ * Receives the random octets of the current TPM2_GetRandom and sends the
+ * command for the next chunk.
+ *
+ * @param[in,out] esysContext The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if no bulk random request is pending.
+ * @retval TSS2_ESYS_RC_TRY_AGAIN if not all random octets were received yet.
+ * @retval TSS2_ESYS_RC_MALFORMED_RESPONSE if the TPM returned no random
+ *         octets.
+ * @retval TSS2_RCs produced by lower layers of the software stack may be
+ *         returned to the caller unaltered unless handled internally.
+ */
+TSS2_RC
+Esys_GetRandomBulk_Finish(
+    ESYS_CONTEXT *esysContext)
+{
+    IESYS_RANDOM *random;
+    TPM2B_DIGEST chunk;
+    TSS2_RC r;
+    LOG_TRACE("context=%p", esysContext);
+
+    _ESYS_ASSERT_NON_NULL(esysContext);
+    random = &esysContext->random;
+
+    switch (random->state) {
+    case _ESYS_RANDOM_DONE:
+        random_reset(esysContext);
+        return TSS2_RC_SUCCESS;
+    case _ESYS_RANDOM_SENT:
+        break;
+    default:
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    r = iesys_GetRandom_Finish(esysContext, &chunk);
+    if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+        return r;
+    goto_if_error(r, "GetRandom chunk.", error_cleanup);
+
+    if (chunk.size == 0 || chunk.size > random->target_size - random->done) {
+        goto_error(r, TSS2_ESYS_RC_MALFORMED_RESPONSE,
+                   "TPM returned a bad number of random octets.", error_cleanup);
+    }
+    memcpy(&random->target[random->done], &chunk.buffer[0], chunk.size);
+    random->done += chunk.size;
+    random_wipe(&chunk, sizeof(chunk));
+
+    if (random->done < random->target_size) {
+        r = random_send(esysContext);
+        goto_if_error(r, "Send next GetRandom.", error_cleanup);
+
+        return TSS2_ESYS_RC_TRY_AGAIN;
+    }
+
+    if (random->target == random->seed) {
+        r = drbg_seed(random);
+        goto_if_error(r, "Seed random pool.", error_cleanup);
+
+        r = random_pool_fill(esysContext);
+        goto_if_error(r, "Generate random octets.", error_cleanup);
+
+        if (random->state == _ESYS_RANDOM_SENT)
+            return TSS2_ESYS_RC_TRY_AGAIN;
+    }
+
+    random_reset(esysContext);
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    random_wipe(&chunk, sizeof(chunk));
+    random_wipe(random->seed, sizeof(random->seed));
+    random_reset(esysContext);
+    return r;
+}
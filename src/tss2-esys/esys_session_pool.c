@@ -0,0 +1,415 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2017-2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE esys
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** Compare two symmetric definitions of parameter encryption.
+ *
+ * @param[in] sym1 The first definition.
+ * @param[in] sym2 The second definition.
+ * @retval true if both definitions select the same algorithm.
+ * @retval false if not.
+ */
+static bool
+symmetric_equal(const TPMT_SYM_DEF *sym1, const TPMT_SYM_DEF *sym2)
+{
+    if (sym1->algorithm != sym2->algorithm)
+        return false;
+    if (sym1->algorithm == TPM2_ALG_NULL)
+        return true;
+    if (sym1->keyBits.sym != sym2->keyBits.sym)
+        return false;
+    return sym1->algorithm == TPM2_ALG_XOR || sym1->mode.sym == sym2->mode.sym;
+}
+
+/** Compare the names of the salt keys of two sessions.
+ *
+ * @param[in] name1 The first name, empty for an unsalted session.
+ * @param[in] name2 The second name, empty for an unsalted session.
+ * @retval true if both sessions were salted with the same key or both are
+ *         unsalted.
+ * @retval false if not.
+ */
+static bool
+salt_key_equal(const TPM2B_NAME *name1, const TPM2B_NAME *name2)
+{
+    return name1->size == name2->size &&
+        memcmp(&name1->name[0], &name2->name[0], name1->size) == 0;
+}
+
+/** Remove a session from the session pool.
+ *
+ * The saved context of the session is freed; the session itself is neither
+ * closed nor flushed.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] idx The index of the session in the pool.
+ */
+static void
+pool_remove(ESYS_CONTEXT *esys_context, size_t idx)
+{
+    SAFE_FREE(esys_context->session_pool[idx].saved);
+    esys_context->session_pool_count -= 1;
+    esys_context->session_pool[idx] =
+        esys_context->session_pool[esys_context->session_pool_count];
+}
+
+/** Check whether a loaded pool session is still known to the ESYS_CONTEXT.
+ *
+ * The application may have closed or flushed the ESYS_TR of a pooled session.
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @param[in] session The ESYS_TR of the session.
+ * @retval true if the session is valid.
+ * @retval false if not.
+ */
+static bool
+pool_session_valid(ESYS_CONTEXT *esys_context, ESYS_TR session)
+{
+    RSRC_NODE_T *esys_object;
+
+    if (esys_GetResourceObject(esys_context, session, &esys_object) != TSS2_RC_SUCCESS)
+        return false;
+    return esys_object && esys_object->rsrc.rsrcType == IESYSC_SESSION_RSRC;
+}
+
+/** Flush a session of the pool from the TPM and remove it from the pool.
+ *
+ * The session is flushed by its TPM handle with the SAPI, so this also works
+ * if the ESYS_CONTEXT is not in the initial state.
+ * Failures are only logged since the session is removed from the pool anyway.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] idx The index of the session in the pool.
+ */
+static void
+pool_flush(ESYS_CONTEXT *esys_context, size_t idx)
+{
+    IESYS_POOL_SESSION *entry = &esys_context->session_pool[idx];
+    RSRC_NODE_T *esys_object;
+    TSS2_RC r = TSS2_RC_SUCCESS;
+
+    if (entry->saved) {
+        /* The ESYS_TR of a saved session was closed by Esys_ContextSave. */
+        r = Tss2_Sys_FlushContext(esys_context->sys, entry->saved->savedHandle);
+    } else if (pool_session_valid(esys_context, entry->session)) {
+        esys_GetResourceObject(esys_context, entry->session, &esys_object);
+        r = Tss2_Sys_FlushContext(esys_context->sys, esys_object->rsrc.handle);
+        esys_DeleteResourceObject(esys_context, entry->session);
+    }
+    if (r != TSS2_RC_SUCCESS)
+        LOG_WARNING("Flushing pooled session failed: 0x%"PRIx32, r);
+
+    pool_remove(esys_context, idx);
+}
+
+/** Find the least recently used session of the pool.
+ *
+ * @param[in] esys_context The ESYS_CONTEXT.
+ * @param[in] loaded_only Only consider sessions which are loaded in the TPM.
+ * @retval The index of the session or session_pool_count if no session was
+ *         found.
+ */
+static size_t
+pool_lru(ESYS_CONTEXT *esys_context, bool loaded_only)
+{
+    size_t lru = esys_context->session_pool_count;
+
+    for (size_t i = 0; i < esys_context->session_pool_count; i++) {
+        if (loaded_only && esys_context->session_pool[i].saved)
+            continue;
+        if (lru == esys_context->session_pool_count ||
+            esys_context->session_pool[i].last_use <
+            esys_context->session_pool[lru].last_use)
+            lru = i;
+    }
+    return lru;
+}
+
+/** Set the number of sessions kept for reuse.
+ *
+ * The session pool keeps unbound HMAC sessions returned with
+ * Esys_SessionPool_Release() for later retrieval with
+ * Esys_SessionPool_Acquire(), such that the costly start of a (salted)
+ * session can be avoided. The pool is disabled by default (size 0).
+ * Pooled sessions occupy session slots of the TPM until they are acquired
+ * again, the pool is shrunk or the context is finalized with Esys_Finalize.
+ * If the size is reduced, the least recently used sessions are flushed from
+ * the TPM (synchronously).
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] size The maximum number of pooled sessions; 0 disables the pool.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esys_context is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command of the context is pending.
+ * @retval TSS2_ESYS_RC_MEMORY if memory for the pool can't be allocated.
+ */
+TSS2_RC
+Esys_SessionPool_SetSize(ESYS_CONTEXT *esys_context, size_t size)
+{
+    IESYS_POOL_SESSION *pool;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    while (esys_context->session_pool_count > size)
+        pool_flush(esys_context, pool_lru(esys_context, false));
+
+    if (size == 0) {
+        SAFE_FREE(esys_context->session_pool);
+    } else {
+        pool = realloc(esys_context->session_pool, size * sizeof(*pool));
+        return_if_null(pool, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+        esys_context->session_pool = pool;
+    }
+    esys_context->session_pool_size = size;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Take a session from the session pool.
+ *
+ * An unbound HMAC session with the passed parameters is searched in the pool.
+ * Sessions loaded in the TPM are preferred; a session which was evicted by
+ * Esys_SessionPool_Evict() will be loaded again (synchronously). The attributes
+ * of the session are kept from its last use and should be set by the caller.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] symmetric The algorithm used for parameter encryption.
+ * @param[in] authHash The hash algorithm of the session.
+ * @param[in] tpmKey The key used to encrypt the salt of the session or
+ *            ESYS_TR_NONE if an unsalted session is requested. Sessions are
+ *            matched by the name of the key.
+ * @param[out] session The ESYS_TR of the session or ESYS_TR_NONE if no matching
+ *             session is available.
+ * @retval TSS2_RC_SUCCESS on Success, also if no session was found.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esys_context or a pointer parameter
+ *         is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command of the context is pending.
+ * @retval TSS2_ESYS_RC_BAD_TR if tpmKey is not a valid ESYS_TR.
+ */
+TSS2_RC
+Esys_SessionPool_Acquire(ESYS_CONTEXT *esys_context,
+                         ESYS_TR tpmKey,
+                         TPMT_SYM_DEF const *symmetric,
+                         TPMI_ALG_HASH authHash,
+                         ESYS_TR *session)
+{
+    IESYS_POOL_SESSION *entry;
+    RSRC_NODE_T *esys_object;
+    TPM2B_NAME salt_key = { 0 };
+    size_t best = SIZE_MAX;
+    size_t lru;
+    TSS2_RC r;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(symmetric);
+    _ESYS_ASSERT_NON_NULL(session);
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+    *session = ESYS_TR_NONE;
+
+    r = esys_GetResourceObject(esys_context, tpmKey, &esys_object);
+    return_if_error(r, "tpmKey unknown.");
+    if (esys_object)
+        salt_key = esys_object->rsrc.name;
+
+    for (size_t i = 0; i < esys_context->session_pool_count; i++) {
+        entry = &esys_context->session_pool[i];
+        if (entry->authHash != authHash ||
+            !salt_key_equal(&entry->salt_key, &salt_key) ||
+            !symmetric_equal(&entry->symmetric, symmetric))
+            continue;
+        if (!entry->saved && !pool_session_valid(esys_context, entry->session)) {
+            LOG_DEBUG("Pooled session was closed by the application.");
+            pool_remove(esys_context, i--);
+            continue;
+        }
+        /* Prefer loaded sessions, then the most recently used one. */
+        if (best == SIZE_MAX ||
+            (!entry->saved && esys_context->session_pool[best].saved) ||
+            (!entry->saved == !esys_context->session_pool[best].saved &&
+             entry->last_use > esys_context->session_pool[best].last_use))
+            best = i;
+    }
+    if (best == SIZE_MAX)
+        return TSS2_RC_SUCCESS;
+
+    entry = &esys_context->session_pool[best];
+    if (entry->saved) {
+        r = Esys_ContextLoad(esys_context, entry->saved, session);
+        if (r == TPM2_RC_SESSION_MEMORY &&
+            (lru = pool_lru(esys_context, true)) < esys_context->session_pool_count) {
+            /* Make room by saving a loaded session which is not needed now. */
+            r = Esys_ContextSave(esys_context, esys_context->session_pool[lru].session,
+                                 &esys_context->session_pool[lru].saved);
+            if (r == TSS2_RC_SUCCESS) {
+                esys_context->session_pool[lru].session = ESYS_TR_NONE;
+                r = Esys_ContextLoad(esys_context, entry->saved, session);
+            }
+        }
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Loading pooled session failed: 0x%"PRIx32, r);
+            *session = ESYS_TR_NONE;
+            pool_flush(esys_context, best);
+            return TSS2_RC_SUCCESS;
+        }
+        /* The salt key is not part of the saved metadata of the session. */
+        r = esys_GetResourceObject(esys_context, *session, &esys_object);
+        return_if_error(r, "Loaded session unknown.");
+        esys_object->salt_key = entry->salt_key;
+    } else {
+        *session = entry->session;
+    }
+
+    pool_remove(esys_context, best);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Return a session to the session pool.
+ *
+ * Unbound HMAC sessions with the attribute continueSession can be pooled.
+ * Salted sessions are only pooled if they were started with
+ * Esys_StartAuthSession of this context, which records the salt key.
+ * If the session was added to the pool, the ESYS_TR is set to ESYS_TR_NONE
+ * and must not be used by the caller any more. Otherwise (pool disabled or
+ * full, session not poolable) the ESYS_TR is not changed and the caller is
+ * still responsible for flushing the session.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in,out] session The ESYS_TR of the session.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esys_context or session is NULL.
+ */
+TSS2_RC
+Esys_SessionPool_Release(ESYS_CONTEXT *esys_context, ESYS_TR *session)
+{
+    RSRC_NODE_T *esys_object;
+    IESYS_SESSION *rsrc_session;
+    IESYS_POOL_SESSION *entry;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(session);
+
+    if (esys_context->session_pool_count >= esys_context->session_pool_size ||
+        *session < ESYS_TR_MIN_OBJECT)
+        return TSS2_RC_SUCCESS;
+
+    if (esys_GetResourceObject(esys_context, *session, &esys_object) != TSS2_RC_SUCCESS ||
+        esys_object->rsrc.rsrcType != IESYSC_SESSION_RSRC)
+        return TSS2_RC_SUCCESS;
+
+    rsrc_session = &esys_object->rsrc.misc.rsrc_session;
+    if (rsrc_session->sessionType != TPM2_SE_HMAC ||
+        rsrc_session->bound_entity.size != 0 ||
+        !(rsrc_session->sessionAttributes & TPMA_SESSION_CONTINUESESSION) ||
+        (rsrc_session->sessionAttributes & TPMA_SESSION_AUDIT))
+        return TSS2_RC_SUCCESS;
+
+    /* Only salted sessions of unbound sessions have a session key. */
+    if (rsrc_session->sessionKey.size != 0 && esys_object->salt_key.size == 0) {
+        LOG_DEBUG("Salt key of the session unknown.");
+        return TSS2_RC_SUCCESS;
+    }
+
+    entry = &esys_context->session_pool[esys_context->session_pool_count++];
+    entry->session = *session;
+    entry->saved = NULL;
+    entry->symmetric = rsrc_session->symmetric;
+    entry->authHash = rsrc_session->authHash;
+    entry->salt_key = esys_object->salt_key;
+    entry->last_use = ++esys_context->session_pool_clock;
+
+    *session = ESYS_TR_NONE;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free TPM resources occupied by the session pool.
+ *
+ * Shall be called if the TPM runs out of session memory
+ * (TPM2_RC_SESSION_MEMORY) or session handles (TPM2_RC_SESSION_HANDLES).
+ * Without flush the least recently used loaded session is saved with
+ * TPM2_ContextSave, which frees its session slot but keeps it available for
+ * later use. With flush the least recently used session is flushed from the
+ * TPM and removed from the pool. The TPM commands are executed synchronously.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @param[in] flush TPM2_YES if the session shall be flushed.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if the esys_context is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command of the context is pending.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the pool holds no session to be evicted.
+ * @retval TSS2_RCs produced by lower layers of the software stack.
+ */
+TSS2_RC
+Esys_SessionPool_Evict(ESYS_CONTEXT *esys_context, TPMI_YES_NO flush)
+{
+    IESYS_POOL_SESSION *entry;
+    size_t lru;
+    TSS2_RC r;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Esys called in bad sequence.");
+    }
+
+    lru = pool_lru(esys_context, flush != TPM2_YES);
+    if (lru == esys_context->session_pool_count) {
+        LOG_DEBUG("No pooled session to be evicted.");
+        return TSS2_ESYS_RC_BAD_VALUE;
+    }
+
+    if (flush == TPM2_YES) {
+        pool_flush(esys_context, lru);
+        return TSS2_RC_SUCCESS;
+    }
+
+    entry = &esys_context->session_pool[lru];
+    if (!pool_session_valid(esys_context, entry->session)) {
+        pool_remove(esys_context, lru);
+        return TSS2_RC_SUCCESS;
+    }
+    r = Esys_ContextSave(esys_context, entry->session, &entry->saved);
+    return_if_error(r, "Save pooled session.");
+
+    /* The ESYS_TR of the session is closed by Esys_ContextSave. */
+    entry->session = ESYS_TR_NONE;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Flush all sessions of the session pool and free the pool.
+ *
+ * Called by Esys_Finalize. A response to a command which is still pending
+ * is received first, such that the sessions can be flushed whatever the
+ * state of the context is.
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_session_pool_finalize(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+
+    if (esys_context->session_pool_count > 0 &&
+        esys_context->state == _ESYS_STATE_SENT) {
+        r = Tss2_Sys_ExecuteFinish(esys_context->sys, TSS2_TCTI_TIMEOUT_BLOCK);
+        if (r != TSS2_RC_SUCCESS)
+            LOG_DEBUG("Response of pending command: 0x%"PRIx32, r);
+        esys_context->state = _ESYS_STATE_INIT;
+    }
+
+    while (esys_context->session_pool_count > 0)
+        pool_flush(esys_context, esys_context->session_pool_count - 1);
+    SAFE_FREE(esys_context->session_pool);
+    esys_context->session_pool_size = 0;
+}
@@ -339,23 +339,16 @@ Esys_TR_FromTPMPublic(ESYS_CONTEXT * esys_context,
 TSS2_RC
 Esys_TR_Close(ESYS_CONTEXT * esys_context, ESYS_TR * object)
 {
-    RSRC_NODE_T *node;
-    RSRC_NODE_T **update_ptr;
+    TSS2_RC r;
 
     _ESYS_ASSERT_NON_NULL(esys_context);
-    for (node = esys_context->rsrc_list,
-         update_ptr = &esys_context->rsrc_list;
-         node != NULL;
-         update_ptr = &node->next, node = node->next) {
-        if (node->esys_handle == *object) {
-            *update_ptr = node->next;
-            SAFE_FREE(node);
-            *object = ESYS_TR_NONE;
-            return TSS2_RC_SUCCESS;
-        }
+    r = esys_DeleteResourceObject(esys_context, *object);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("Error: Esys handle does not exist (%x).", TSS2_ESYS_RC_BAD_TR);
+        return TSS2_ESYS_RC_BAD_TR;
     }
-    LOG_ERROR("Error: Esys handle does not exist (%x).", TSS2_ESYS_RC_BAD_TR);
-    return TSS2_ESYS_RC_BAD_TR;
+    *object = ESYS_TR_NONE;
+    return TSS2_RC_SUCCESS;
 }
 
 /** Set the authorization value of an ESYS_TR.
@@ -581,6 +574,10 @@ Esys_TRSess_GetNonceTPM(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle,
  * TPM2_GetCapability or use of various handle bitwise comparisons. For example
  * the mask TPM2_HR_NV_INDEX.
  *
+ * A transient object which was swapped out by the ESYS_CONTEXT (see
+ * Esys_SetResidentObjectLimit()) is loaded again first. With a resident object
+ * limit the handle is only valid until the next ESYS command.
+ *
  * @param esys_context [in,out] The ESYS_CONTEXT.
  * @param esys_handle [in] The ESYS_TR object to retrieve the TPM2_HANDLE from.
  * @param tpm_handle [out] The TPM2_HANDLE retrieved from the ESYS_TR object.
@@ -590,6 +587,10 @@ Esys_TRSess_GetNonceTPM(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle,
  * @retval TSS2_ESYS_RC_BAD_VALUE if an unknown handle < ESYS_TR_MIN_OBJECT is
  *         passed.
  * @retval TSS2_ESYS_RC_BAD_REFERENCE For invalid ESYS_CONTEXT.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the object is swapped out and cannot
+ *         be loaded since a command is in progress.
+ * @retval TSS2_RCs produced by lower layers of the software stack if a swapped
+ *         out object cannot be loaded.
  */
 TSS2_RC
 Esys_TR_GetTpmHandle(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle,
@@ -608,6 +609,15 @@ Esys_TR_GetTpmHandle(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle,
     r = esys_GetResourceObject(esys_context, esys_handle, &esys_object);
     return_if_error(r, "Get resource object");
 
+    if (esys_object->swap_context != NULL) {
+        if (esys_context->state != _ESYS_STATE_INIT) {
+            LOG_ERROR("Object is swapped out and a command is in progress.");
+            return TSS2_ESYS_RC_BAD_SEQUENCE;
+        }
+        r = iesys_swap_in(esys_context, esys_object);
+        return_if_error(r, "Swapping in object.");
+    }
+
     *tpm_handle = esys_object->rsrc.handle;
 
     return TSS2_RC_SUCCESS;
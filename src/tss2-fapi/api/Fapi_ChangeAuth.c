@@ -172,6 +172,9 @@ Fapi_ChangeAuth_Async(
     r = ifapi_session_init(context);
     return_if_error(r, "Initialize Entity_ChangeAuth");
 
+    /* Saved contexts of keys with the old auth value must not be used. */
+    ifapi_key_cache_clear(&context->key_cache);
+
     /* Copy parameters to context for use during _Finish. */
     context->loadKey.parent_handle = ESYS_TR_NONE;
     command->handle = ESYS_TR_NONE;
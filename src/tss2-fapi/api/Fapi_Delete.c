@@ -400,6 +400,9 @@ Fapi_Delete_Async(
 
     command->path_idx = command->numPaths;
 
+    /* Saved contexts of deleted keys must not be used. */
+    ifapi_key_cache_clear(&context->key_cache);
+
     if (command->numPaths == 0) {
         if (strcmp(path, "") == 0 || strcmp(path, "/") == 0) {
             goto_error(r, TSS2_FAPI_RC_NOT_PROVISIONED, "FAPI not provisioned.", error_cleanup);
@@ -63,6 +63,8 @@ Fapi_Finalize(
 
     /* Finalize the keystore module. */
     ifapi_cleanup_ifapi_keystore(&(*context)->keystore);
+    ifapi_key_cache_clear(&(*context)->key_cache);
+    ifapi_policy_ticket_cache_clear(&(*context)->ticket_cache);
 
     /* Finalize the policy module. */
     SAFE_FREE((*context)->pstore.policydir);
@@ -264,6 +264,7 @@ Fapi_GetInfo_Finish(
 
         infoObj->fapi_version = PACKAGE_STRING;
         infoObj->fapi_config = context->config;
+        infoObj->object_cache = context->keystore.cache.stats;
 
         /* Serialize the information. */
         r = ifapi_json_IFAPI_INFO_serialize(infoObj, &jso);
@@ -195,7 +195,8 @@ Fapi_Initialize_Finish(
         goto_if_error(r, "Could not finish initialization", cleanup_return);
 
         /* Initialize the event log module. */
-        r = ifapi_eventlog_initialize(&((*context)->eventlog), (*context)->config.log_dir);
+        r = ifapi_eventlog_initialize(&((*context)->eventlog), (*context)->config.log_dir,
+                                      (*context)->config.eventlog_sync == TPM2_YES);
         goto_if_error(r, "Initializing eventlog module", cleanup_return);
 
         /* Initialize the keystore. */
@@ -205,6 +206,10 @@ Fapi_Initialize_Finish(
                                       (*context)->config.profile_name);
         goto_if_error2(r, "Keystore could not be initialized.", cleanup_return);
 
+        r = ifapi_keystore_cache_initialize(&((*context)->keystore),
+                                            (*context)->config.object_cache_size);
+        goto_if_error2(r, "Keystore cache could not be initialized.", cleanup_return);
+
         /* Initialize the policy store. */
         /* Policy directory will be placed in keystore dir */
         r = ifapi_policy_store_initialize(&((*context)->pstore),
@@ -230,6 +235,13 @@ Fapi_Initialize_Finish(
         r = Esys_Initialize(&((*context)->esys), fapi_tcti, NULL);
         goto_if_error(r, "Initialize esys context.", cleanup_return);
 
+        /* Keep the sessions of FAPI commands for reuse if configured. */
+        if ((*context)->config.session_pool_size > 0) {
+            r = Esys_SessionPool_SetSize((*context)->esys,
+                                         (*context)->config.session_pool_size);
+            goto_if_error(r, "Initialize session pool.", cleanup_return);
+        }
+
         /* Call Startup on the TPM. */
         r = Esys_Startup((*context)->esys, TPM2_SU_CLEAR);
         if (r != TSS2_RC_SUCCESS && r != TPM2_RC_INITIALIZE) {
@@ -269,6 +281,9 @@ Fapi_Initialize_Finish(
                ensures that data can be exchanged with the TPM. */
             (*context)->nv_buffer_max = 64;
         }
+        /* The streaming NV functions of ESYS need not read it again. */
+        r = Esys_SetNvBufferMax((*context)->esys, (*context)->nv_buffer_max);
+        goto_if_error(r, "Set NV buffer size.", cleanup_return);
         fallthrough;
 
     statecase((*context)->state, INITIALIZE_READ_PROFILE_INIT);
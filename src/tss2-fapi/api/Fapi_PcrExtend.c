@@ -250,25 +250,15 @@ Fapi_PcrExtend_Finish(
 
     switch (context->state) {
         statecase(context->state, PCR_EXTEND_WAIT_FOR_GET_CAP);
-            command->event_log_file = NULL;
             r = Esys_GetCapability_Finish(context->esys, &moreData, capabilityData);
             return_try_again(r);
             goto_if_error_reset_state(r, "GetCapablity_Finish", error_cleanup);
 
-            /* Construct the filename for the eventlog file */
-            r = ifapi_asprintf(&command->event_log_file, "%s/%s%i",
-                               context->eventlog.log_dir, IFAPI_PCR_LOG_FILE, command->pcrIndex);
-            return_if_error(r, "Out of memory.");
-
-            /* Check wheter the event log has to be read. */
-            if (ifapi_io_path_exists(command->event_log_file)) {
-                r = ifapi_io_read_async(&context->io, command->event_log_file);
-                goto_if_error_reset_state(r, "Read event log", error_cleanup);
-                context->eventlog.state = IFAPI_EVENTLOG_STATE_READING;
-            } else {
-                context->eventlog.state = IFAPI_EVENTLOG_STATE_APPENDING;
-                SAFE_FREE(command->event_log_file);
-            }
+            /* Prepare appending to the event log; only a log in the former
+               format has to be read completely. */
+            r = ifapi_eventlog_append_async(&context->eventlog, &context->io,
+                                            command->pcrIndex);
+            goto_if_error_reset_state(r, "Read event log", error_cleanup);
 
             fallthrough;
 
@@ -341,7 +331,6 @@ Fapi_PcrExtend_Finish(
 
 error_cleanup:
     /* Cleanup any intermediate results and state stored in the context. */
-    SAFE_FREE(command->event_log_file);
     SAFE_FREE(*capabilityData);
     SAFE_FREE(command->event_digests);
     SAFE_FREE(command->logData);
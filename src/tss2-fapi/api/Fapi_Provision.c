@@ -229,6 +229,10 @@ Fapi_Provision_Async(
     r = ifapi_session_init(context);
     goto_if_error(r, "Initialize Provision", end);
 
+    /* Keys of a former provisioning must not be used. */
+    ifapi_key_cache_clear(&context->key_cache);
+    ifapi_policy_ticket_cache_clear(&context->ticket_cache);
+
     memset(&context->cmd.Provision, 0, sizeof(IFAPI_Provision));
 
     /* First it will be checked whether the profile is already provisioned. */
@@ -0,0 +1,530 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tss2_fapi.h"
+#include "fapi_int.h"
+#include "fapi_util.h"
+#include "tss2_esys.h"
+#include "fapi_crypto.h"
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** The maximal number of threads verifying quotes */
+#define IFAPI_VERIFY_QUOTE_THREADS_MAX 64
+
+/** The work queue shared by the verification threads */
+typedef struct {
+    IFAPI_VerifyQuoteBatch *command;   /**< The quotes, keys and results */
+    pthread_mutex_t mutex;             /**< Protects next */
+    size_t next;                       /**< Index of the next quote */
+} IFAPI_VERIFY_QUOTE_QUEUE;
+
+static void
+cleanup_command(IFAPI_VerifyQuoteBatch *command)
+{
+    for (size_t i = 0; i < command->numQuotes; i++) {
+        if (command->keyPaths)
+            SAFE_FREE(command->keyPaths[i]);
+        if (command->quoteInfos)
+            SAFE_FREE(command->quoteInfos[i]);
+        if (command->signatures)
+            SAFE_FREE(command->signatures[i]);
+        if (command->pcrLogs)
+            SAFE_FREE(command->pcrLogs[i]);
+    }
+    for (size_t i = 0; i < command->numKeys; i++) {
+        ifapi_public_key_free(&command->keys[i]);
+    }
+    SAFE_FREE(command->keyPaths);
+    SAFE_FREE(command->qualifyingData);
+    SAFE_FREE(command->quoteInfos);
+    SAFE_FREE(command->signatures);
+    SAFE_FREE(command->signatureSizes);
+    SAFE_FREE(command->pcrLogs);
+    SAFE_FREE(command->results);
+    SAFE_FREE(command->keyIndex);
+    SAFE_FREE(command->keyNames);
+    SAFE_FREE(command->keys);
+    SAFE_FREE(command->keyResults);
+    command->numQuotes = 0;
+    command->numKeys = 0;
+}
+
+/** Start loading the next key which can be read from the keystore.
+ *
+ * Keys whose loading can not be started are marked as failed.
+ *
+ * @retval true if a key is being loaded.
+ * @retval false if all keys were loaded.
+ */
+static bool
+load_next_key(FAPI_CONTEXT *context, IFAPI_VerifyQuoteBatch *command)
+{
+    TSS2_RC r;
+
+    for (; command->key_idx < command->numKeys; command->key_idx++) {
+        r = ifapi_keystore_load_async(&context->keystore, &context->io,
+                                      command->keyNames[command->key_idx]);
+        if (r == TSS2_RC_SUCCESS)
+            return true;
+        LOG_ERROR("Could not open publicKeyPath %s",
+                  command->keyNames[command->key_idx]);
+        command->keyResults[command->key_idx] = r;
+    }
+    return false;
+}
+
+/** Verify one quote of the batch.
+ *
+ * Only the read-only data of the command is accessed, thus quotes can be
+ * verified concurrently.
+ */
+static TSS2_RC
+verify_quote(const IFAPI_VerifyQuoteBatch *command, size_t i)
+{
+    TSS2_RC r;
+    size_t key = command->keyIndex[i];
+    TPM2B_ATTEST attest2b;
+    TPM2B_DIGEST pcr_digest;
+    FAPI_QUOTE_INFO quote_info;
+    json_object *event_list;
+
+    if (command->keyResults[key] != TSS2_RC_SUCCESS)
+        return command->keyResults[key];
+
+    /* Recalculate the quote-info and attest2b buffer. */
+    r = ifapi_get_quote_info(command->quoteInfos[i], &attest2b, &quote_info);
+    return_if_error(r, "Get quote info.");
+
+    /* Check the nonce if one was passed. */
+    if (command->qualifyingData[i].size &&
+            (command->qualifyingData[i].size != quote_info.attest.extraData.size ||
+             memcmp(&command->qualifyingData[i].buffer[0],
+                    &quote_info.attest.extraData.buffer[0],
+                    quote_info.attest.extraData.size))) {
+        return_error2(TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED,
+                      "Qualifying data of quote %zu does not match.", i);
+    }
+
+    /* Verify the signature over the attest2b structure. */
+    r = ifapi_verify_signature_quote_key(command->keys[key],
+                                         command->signatures[i],
+                                         command->signatureSizes[i],
+                                         &attest2b.attestationData[0],
+                                         attest2b.size,
+                                         &quote_info.sig_scheme);
+    return_if_error(r, "Verify signature.");
+
+    /* If no log was provided the quote is verified. */
+    if (!command->pcrLogs[i])
+        return TSS2_RC_SUCCESS;
+
+    event_list = json_tokener_parse(command->pcrLogs[i]);
+    return_if_null(event_list, "Bad value for pcrLog", TSS2_FAPI_RC_BAD_VALUE);
+
+    /* Recalculate and verify the PCR digests. */
+    r = ifapi_calculate_pcr_digest(event_list, &quote_info, &pcr_digest);
+    json_object_put(event_list);
+    return_if_error(r, "Verify event list.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Verify quotes from the queue until all quotes are verified. */
+static void *
+verify_quote_worker(void *arg)
+{
+    IFAPI_VERIFY_QUOTE_QUEUE *queue = arg;
+    size_t i;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->mutex);
+        i = queue->next++;
+        pthread_mutex_unlock(&queue->mutex);
+        if (i >= queue->command->numQuotes)
+            return NULL;
+
+        queue->command->results[i] = verify_quote(queue->command, i);
+    }
+}
+
+/** Verify all quotes of the batch with a pool of threads.
+ *
+ * The calling thread takes part in the verification. If threads can not be
+ * created, the quotes are verified by fewer threads.
+ *
+ * @retval TSS2_RC_SUCCESS if all quotes were verified.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if at least one quote
+ *         could not be verified.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if the work queue can not be created.
+ */
+static TSS2_RC
+verify_quotes(IFAPI_VerifyQuoteBatch *command)
+{
+    IFAPI_VERIFY_QUOTE_QUEUE queue = { .command = command, .next = 0 };
+    pthread_t threads[IFAPI_VERIFY_QUOTE_THREADS_MAX];
+    size_t n_threads = 0, max_threads;
+    long n_cpus;
+
+    if (pthread_mutex_init(&queue.mutex, NULL) != 0) {
+        return_error(TSS2_FAPI_RC_GENERAL_FAILURE, "Initialize mutex.");
+    }
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = n_cpus > 1 ? (size_t)n_cpus - 1 : 0;
+    if (max_threads > IFAPI_VERIFY_QUOTE_THREADS_MAX)
+        max_threads = IFAPI_VERIFY_QUOTE_THREADS_MAX;
+    if (max_threads > command->numQuotes - 1)
+        max_threads = command->numQuotes - 1;
+
+    for (n_threads = 0; n_threads < max_threads; n_threads++) {
+        if (pthread_create(&threads[n_threads], NULL, verify_quote_worker,
+                           &queue) != 0) {
+            LOG_WARNING("Only %zu threads could be created.", n_threads);
+            break;
+        }
+    }
+    verify_quote_worker(&queue);
+    for (size_t i = 0; i < n_threads; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&queue.mutex);
+
+    for (size_t i = 0; i < command->numQuotes; i++) {
+        if (command->results[i] != TSS2_RC_SUCCESS) {
+            LOG_ERROR("Verification of quote %zu failed.", i);
+            return TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED;
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** One-Call function for Fapi_VerifyQuoteBatch
+ *
+ * Verifies that the data returned by several quotes is valid. The quotes are
+ * verified concurrently. Each distinct key is read from the keystore and
+ * decoded only once.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] numQuotes The number of quotes
+ * @param[in] publicKeyPaths The path to the signing key of each quote
+ * @param[in] qualifyingData The qualifying data nonce of each quote. May be
+ *            NULL. Entries may be NULL to skip the check of the nonce
+ * @param[in] qualifyingDataSizes The size of each qualifyingData in bytes.
+ *            May be NULL if qualifyingData is NULL
+ * @param[in] quoteInfos The quote information of each quote
+ * @param[in] signatures The signature of each quote
+ * @param[in] signatureSizes The size of each signature in bytes
+ * @param[in] pcrLogs The PCR's log of each quote. May be NULL. Entries may be
+ *            NULL
+ * @param[out] results The verification result of each quote. Must be freed
+ *             with Fapi_Free. Is set even if TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED
+ *             is returned.
+ *
+ * @retval TSS2_RC_SUCCESS: if all quotes were verified.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, publicKeyPaths, quoteInfos,
+ *         signatures, signatureSizes, results or one of their entries is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_VALUE: if numQuotes is 0 or a qualifyingData is
+ *         too large.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be read.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN if an I/O operation is not finished yet and
+ *         this function needs to be called again.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if at least one quote
+ *         could not be verified. The reason is returned in results.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ */
+TSS2_RC
+Fapi_VerifyQuoteBatch(
+    FAPI_CONTEXT  *context,
+    size_t         numQuotes,
+    char    const *const *publicKeyPaths,
+    uint8_t const *const *qualifyingData,
+    size_t  const *qualifyingDataSizes,
+    char    const *const *quoteInfos,
+    uint8_t const *const *signatures,
+    size_t  const *signatureSizes,
+    char    const *const *pcrLogs,
+    TSS2_RC      **results)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(publicKeyPaths);
+    check_not_null(quoteInfos);
+    check_not_null(signatures);
+    check_not_null(signatureSizes);
+    check_not_null(results);
+
+    r = Fapi_VerifyQuoteBatch_Async(context, numQuotes, publicKeyPaths,
+                                    qualifyingData, qualifyingDataSizes,
+                                    quoteInfos, signatures, signatureSizes,
+                                    pcrLogs);
+    return_if_error_reset_state(r, "Key_VerifyQuoteBatch");
+
+    do {
+        /* We wait for file I/O to be ready if the FAPI state automata
+           are in a file I/O state. */
+        r = ifapi_io_poll(&context->io);
+        return_if_error(r, "Something went wrong with IO polling");
+
+        /* Repeatedly call the finish function, until FAPI has transitioned
+           through all execution stages / states of this invocation. */
+        r = Fapi_VerifyQuoteBatch_Finish(context, results);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    return_if_error_reset_state(r, "Key_VerifyQuoteBatch");
+
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for Fapi_VerifyQuoteBatch
+ *
+ * Verifies that the data returned by several quotes is valid.
+ * Call Fapi_VerifyQuoteBatch_Finish to finish the execution of this command.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] numQuotes The number of quotes
+ * @param[in] publicKeyPaths The path to the signing key of each quote
+ * @param[in] qualifyingData The qualifying data nonce of each quote. May be
+ *            NULL. Entries may be NULL to skip the check of the nonce
+ * @param[in] qualifyingDataSizes The size of each qualifyingData in bytes.
+ *            May be NULL if qualifyingData is NULL
+ * @param[in] quoteInfos The quote information of each quote
+ * @param[in] signatures The signature of each quote
+ * @param[in] signatureSizes The size of each signature in bytes
+ * @param[in] pcrLogs The PCR's log of each quote. May be NULL. Entries may be
+ *            NULL
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, publicKeyPaths, quoteInfos,
+ *         signatures, signatureSizes or one of their entries is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_VALUE: if numQuotes is 0 or a qualifyingData is
+ *         too large.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be read.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ */
+TSS2_RC
+Fapi_VerifyQuoteBatch_Async(
+    FAPI_CONTEXT  *context,
+    size_t         numQuotes,
+    char    const *const *publicKeyPaths,
+    uint8_t const *const *qualifyingData,
+    size_t  const *qualifyingDataSizes,
+    char    const *const *quoteInfos,
+    uint8_t const *const *signatures,
+    size_t  const *signatureSizes,
+    char    const *const *pcrLogs)
+{
+    LOG_TRACE("called for context:%p", context);
+    LOG_TRACE("numQuotes: %zu", numQuotes);
+
+    TSS2_RC r;
+    size_t i, key;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(publicKeyPaths);
+    check_not_null(quoteInfos);
+    check_not_null(signatures);
+    check_not_null(signatureSizes);
+
+    /* Helpful alias pointers */
+    IFAPI_VerifyQuoteBatch * command = &context->cmd.VerifyQuoteBatch;
+
+    /* Check for invalid parameters */
+    if (numQuotes == 0) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "No quotes passed.");
+    }
+    if (qualifyingData && !qualifyingDataSizes) {
+        return_error(TSS2_FAPI_RC_BAD_REFERENCE, "qualifyingDataSizes is NULL.");
+    }
+    for (i = 0; i < numQuotes; i++) {
+        check_not_null(publicKeyPaths[i]);
+        check_not_null(quoteInfos[i]);
+        check_not_null(signatures[i]);
+        if (qualifyingData && qualifyingData[i] &&
+                qualifyingDataSizes[i] > sizeof(command->qualifyingData[i].buffer)) {
+            return_error2(TSS2_FAPI_RC_BAD_VALUE,
+                          "qualifyingDataSize of quote %zu too large.", i);
+        }
+    }
+
+    r = ifapi_non_tpm_mode_init(context);
+    return_if_error(r, "Initialize VerifyQuoteBatch");
+
+    memset(command, 0, sizeof(IFAPI_VerifyQuoteBatch));
+    command->numQuotes = numQuotes;
+
+    /* Copy parameters to context for use during _Finish. */
+    command->keyPaths = calloc(numQuotes, sizeof(char *));
+    command->qualifyingData = calloc(numQuotes, sizeof(TPM2B_DATA));
+    command->quoteInfos = calloc(numQuotes, sizeof(char *));
+    command->signatures = calloc(numQuotes, sizeof(uint8_t *));
+    command->signatureSizes = calloc(numQuotes, sizeof(size_t));
+    command->pcrLogs = calloc(numQuotes, sizeof(char *));
+    command->results = calloc(numQuotes, sizeof(TSS2_RC));
+    command->keyIndex = calloc(numQuotes, sizeof(size_t));
+    command->keyNames = calloc(numQuotes, sizeof(char *));
+    command->keys = calloc(numQuotes, sizeof(IFAPI_PUBLIC_KEY_BLOB *));
+    command->keyResults = calloc(numQuotes, sizeof(TSS2_RC));
+    if (!command->keyPaths || !command->qualifyingData || !command->quoteInfos ||
+            !command->signatures || !command->signatureSizes || !command->pcrLogs ||
+            !command->results || !command->keyIndex || !command->keyNames ||
+            !command->keys || !command->keyResults) {
+        goto_error(r, TSS2_FAPI_RC_MEMORY, "Out of memory", error_cleanup);
+    }
+
+    for (i = 0; i < numQuotes; i++) {
+        strdup_check(command->keyPaths[i], publicKeyPaths[i], r, error_cleanup);
+        strdup_check(command->quoteInfos[i], quoteInfos[i], r, error_cleanup);
+        if (pcrLogs) {
+            strdup_check(command->pcrLogs[i], pcrLogs[i], r, error_cleanup);
+        }
+        command->signatures[i] = malloc(signatureSizes[i]);
+        goto_if_null2(command->signatures[i], "Out of memory",
+                      r, TSS2_FAPI_RC_MEMORY, error_cleanup);
+        memcpy(command->signatures[i], signatures[i], signatureSizes[i]);
+        command->signatureSizes[i] = signatureSizes[i];
+        if (qualifyingData && qualifyingData[i]) {
+            FAPI_COPY_DIGEST(&command->qualifyingData[i].buffer[0],
+                             command->qualifyingData[i].size,
+                             qualifyingData[i], qualifyingDataSizes[i]);
+        }
+
+        /* Each distinct key is loaded only once. */
+        for (key = 0; key < command->numKeys; key++) {
+            if (strcmp(command->keyNames[key], command->keyPaths[i]) == 0)
+                break;
+        }
+        if (key == command->numKeys)
+            command->keyNames[command->numKeys++] = command->keyPaths[i];
+        command->keyIndex[i] = key;
+    }
+
+    /* Start loading the first key from the keystore. */
+    command->key_idx = 0;
+    load_next_key(context, command);
+
+    /* Initialize the context state for this operation. */
+    context->state = VERIFY_QUOTE_BATCH_READ_KEY;
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    /* Cleanup duplicated input parameters that were copied before. */
+    cleanup_command(command);
+    return r;
+}
+
+/** Asynchronous finish function for Fapi_VerifyQuoteBatch
+ *
+ * This function should be called after a previous Fapi_VerifyQuoteBatch_Async.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[out] results The verification result of each quote. Must be freed
+ *             with Fapi_Free. Is set even if TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED
+ *             is returned.
+ *
+ * @retval TSS2_RC_SUCCESS: if all quotes were verified.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context or results is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be read.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN: if the asynchronous operation is not yet
+ *         complete. Call this function again later.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if at least one quote
+ *         could not be verified. The reason is returned in results.
+ */
+TSS2_RC
+Fapi_VerifyQuoteBatch_Finish(
+    FAPI_CONTEXT  *context,
+    TSS2_RC      **results)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r;
+    IFAPI_OBJECT key_object;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(results);
+
+    /* Helpful alias pointers */
+    IFAPI_VerifyQuoteBatch * command = &context->cmd.VerifyQuoteBatch;
+
+    memset(&key_object, 0, sizeof(IFAPI_OBJECT));
+
+    switch (context->state) {
+        statecase(context->state, VERIFY_QUOTE_BATCH_READ_KEY);
+            /* Decode every key once for all quotes and threads. */
+            if (command->key_idx < command->numKeys) {
+                r = ifapi_keystore_load_finish(&context->keystore, &context->io,
+                                               &key_object);
+                return_try_again(r);
+                if (r == TSS2_RC_SUCCESS) {
+                    r = ifapi_public_key_load(&key_object,
+                                              &command->keys[command->key_idx]);
+                    ifapi_cleanup_ifapi_object(&key_object);
+                }
+                if (r != TSS2_RC_SUCCESS) {
+                    LOG_ERROR("Could not load key %s",
+                              command->keyNames[command->key_idx]);
+                }
+                command->keyResults[command->key_idx++] = r;
+
+                if (load_next_key(context, command))
+                    return TSS2_FAPI_RC_TRY_AGAIN;
+            }
+            fallthrough;
+
+        statecase(context->state, VERIFY_QUOTE_BATCH_VERIFY);
+            r = verify_quotes(command);
+            if (r == TSS2_RC_SUCCESS ||
+                    r == TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED) {
+                *results = command->results;
+                command->results = NULL;
+            }
+            context->state = _FAPI_STATE_INIT;
+            break;
+
+        statecasedefault(context->state);
+    }
+
+    /* Cleanup any intermediate results and state stored in the context. */
+    cleanup_command(command);
+    LOG_TRACE("finished");
+    return r;
+}
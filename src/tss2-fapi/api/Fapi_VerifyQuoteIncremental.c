@@ -0,0 +1,408 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+#include "fapi_int.h"
+#include "fapi_util.h"
+#include "tss2_esys.h"
+#include "fapi_crypto.h"
+#include "ifapi_json_serialize.h"
+#include "ifapi_json_deserialize.h"
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** One-Call function for Fapi_VerifyQuoteIncremental
+ *
+ * Verifies that the data returned by a quote is valid. In contrast to
+ * Fapi_VerifyQuote() the PCR values of the log are not replayed from the
+ * beginning. The replay continues from the state returned by an earlier
+ * verification of a quote of the same host, thus only the events added to the
+ * log since then have to be passed and replayed.
+ *
+ * The returned state must be stored integrity protected by the caller. If the
+ * PCRs of the host were reset, e.g. by a reboot, the verification has to be
+ * started again without state.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] publicKeyPath The path to the signing key
+ * @param[in] qualifyingData The qualifying data nonce. May be NULL
+ * @param[in] qualifyingDataSize The size of qualifyingData in bytes. Must be 0
+ *            if qualifyingData is NULL
+ * @param[in] quoteInfo The quote information
+ * @param[in] signature The quote's signature
+ * @param[in] signatureSize The size of signature in bytes
+ * @param[in] pcrLog The PCR's log starting with the event pcrLogOffset of the
+ *            complete log. May be NULL if no new events were logged
+ * @param[in] pcrLogOffset The index of the first event of pcrLog in the
+ *            complete log
+ * @param[in] pcrState The replay state returned by an earlier verification.
+ *            May be NULL to replay the complete log
+ * @param[out] newPcrState The replay state after the last event of pcrLog.
+ *             May be NULL
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, publicKeyPath, quoteInfo,
+ *         or signature is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_KEY_NOT_FOUND: if path does not map to a FAPI entity.
+ * @retval TSS2_FAPI_RC_BAD_KEY: if the entity at path is not a key, or is a key
+ *         that is unsuitable for the requested operation.
+ * @retval TSS2_FAPI_RC_BAD_VALUE: if quoteInfo, pcrLog, pcrState,
+ *         qualifyingData, or signature is invalid or pcrLog does not continue
+ *         pcrState.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be saved.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN if an I/O operation is not finished yet and
+ *         this function needs to be called again.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if the signature could not
+ *         be verified
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ */
+TSS2_RC
+Fapi_VerifyQuoteIncremental(
+    FAPI_CONTEXT  *context,
+    char    const *publicKeyPath,
+    uint8_t const *qualifyingData,
+    size_t         qualifyingDataSize,
+    char    const *quoteInfo,
+    uint8_t const *signature,
+    size_t         signatureSize,
+    char    const *pcrLog,
+    size_t         pcrLogOffset,
+    char    const *pcrState,
+    char         **newPcrState)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(publicKeyPath);
+    check_not_null(quoteInfo);
+    check_not_null(signature);
+
+    r = Fapi_VerifyQuoteIncremental_Async(context, publicKeyPath,
+                                          qualifyingData, qualifyingDataSize,
+                                          quoteInfo, signature, signatureSize,
+                                          pcrLog, pcrLogOffset, pcrState);
+    return_if_error_reset_state(r, "Key_VerifyQuoteIncremental");
+
+    do {
+        /* We wait for file I/O to be ready if the FAPI state automata
+           are in a file I/O state. */
+        r = ifapi_io_poll(&context->io);
+        return_if_error(r, "Something went wrong with IO polling");
+
+        /* Repeatedly call the finish function, until FAPI has transitioned
+           through all execution stages / states of this invocation. */
+        r = Fapi_VerifyQuoteIncremental_Finish(context, newPcrState);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    return_if_error_reset_state(r, "Key_VerifyQuoteIncremental");
+
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for Fapi_VerifyQuoteIncremental
+ *
+ * Verifies that the data returned by a quote is valid, continuing the replay
+ * of the PCR log from the state of an earlier verification.
+ * Call Fapi_VerifyQuoteIncremental_Finish to finish the execution of this
+ * command.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] publicKeyPath The path to the signing key
+ * @param[in] qualifyingData The qualifying data nonce. May be NULL
+ * @param[in] qualifyingDataSize The size of qualifyingData in bytes. Must be 0
+ *            if qualifyingData is NULL
+ * @param[in] quoteInfo The quote information
+ * @param[in] signature The quote's signature
+ * @param[in] signatureSize The size of signature in bytes
+ * @param[in] pcrLog The PCR's log starting with the event pcrLogOffset of the
+ *            complete log. May be NULL if no new events were logged
+ * @param[in] pcrLogOffset The index of the first event of pcrLog in the
+ *            complete log
+ * @param[in] pcrState The replay state returned by an earlier verification.
+ *            May be NULL to replay the complete log
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, publicKeyPath, quoteInfo,
+ *         or signature is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_KEY_NOT_FOUND: if path does not map to a FAPI entity.
+ * @retval TSS2_FAPI_RC_BAD_KEY: if the entity at path is not a key, or is a key
+ *         that is unsuitable for the requested operation.
+ * @retval TSS2_FAPI_RC_BAD_VALUE: if quoteInfo, pcrLog, pcrState,
+ *         qualifyingData, or signature is invalid.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be saved.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ */
+TSS2_RC
+Fapi_VerifyQuoteIncremental_Async(
+    FAPI_CONTEXT  *context,
+    char    const *publicKeyPath,
+    uint8_t const *qualifyingData,
+    size_t         qualifyingDataSize,
+    char    const *quoteInfo,
+    uint8_t const *signature,
+    size_t         signatureSize,
+    char    const *pcrLog,
+    size_t         pcrLogOffset,
+    char    const *pcrState)
+{
+    LOG_TRACE("called for context:%p", context);
+    LOG_TRACE("publicKeyPath: %s", publicKeyPath);
+    if (qualifyingData) {
+        LOGBLOB_TRACE(qualifyingData, qualifyingDataSize, "qualifyingData");
+    } else {
+        LOG_TRACE("qualifyingData: (null) qualifyingDataSize: %zi", qualifyingDataSize);
+    }
+    LOG_TRACE("quoteInfo: %s", quoteInfo);
+    if (signature) {
+        LOGBLOB_TRACE(signature, signatureSize, "signature");
+    } else {
+        LOG_TRACE("signature: (null) signatureSize: %zi", signatureSize);
+    }
+    LOG_TRACE("pcrLog: %s", pcrLog);
+    LOG_TRACE("pcrLogOffset: %zu", pcrLogOffset);
+    LOG_TRACE("pcrState: %s", pcrState);
+
+    TSS2_RC r;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(publicKeyPath);
+    check_not_null(quoteInfo);
+    check_not_null(signature);
+
+    /* Check for invalid parameters */
+    if (qualifyingData == NULL && qualifyingDataSize != 0) {
+        LOG_ERROR("qualifyingData is NULL but qualifyingDataSize is not 0");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+
+    /* Helpful alias pointers */
+    IFAPI_PCR * command = &context->cmd.pcr;
+
+    if (qualifyingDataSize > sizeof(command->qualifyingData.buffer)) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "qualifyingDataSize too large.");
+    }
+
+    r = ifapi_non_tpm_mode_init(context);
+    return_if_error(r, "Initialize VerifyQuoteIncremental");
+
+    /* Copy parameters to context for use during _Finish. */
+    uint8_t * signatureBuffer = malloc(signatureSize);
+    goto_if_null2(signatureBuffer, "Out of memory",
+            r, TSS2_FAPI_RC_MEMORY, error_cleanup);
+    memcpy(signatureBuffer, signature, signatureSize);
+    command->signature = signatureBuffer;
+    command->signatureSize = signatureSize;
+    command->logOffset = pcrLogOffset;
+    command->event_list = NULL;
+
+    strdup_check(command->keyPath, publicKeyPath, r, error_cleanup);
+    strdup_check(command->quoteInfo, quoteInfo, r, error_cleanup);
+    strdup_check(command->logData, pcrLog, r, error_cleanup);
+    strdup_check(command->pcrState, pcrState, r, error_cleanup);
+
+    if (qualifyingData != NULL) {
+        FAPI_COPY_DIGEST(&command->qualifyingData.buffer[0],
+                command->qualifyingData.size,
+                qualifyingData, qualifyingDataSize);
+    }
+
+    /* Load the key for verification from the keystore. */
+    r = ifapi_keystore_load_async(&context->keystore, &context->io, publicKeyPath);
+    goto_if_error(r, "Could not open publicKeyPath", error_cleanup);
+
+    /* Initialize the context state for this operation. */
+    context->state = VERIFY_QUOTE_INCREMENTAL_READ;
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    /* Cleanup duplicated input parameters that were copied before. */
+    SAFE_FREE(command->keyPath);
+    SAFE_FREE(signatureBuffer);
+    command->signature = NULL;
+    SAFE_FREE(command->quoteInfo);
+    SAFE_FREE(command->logData);
+    SAFE_FREE(command->pcrState);
+    return r;
+}
+
+/** Asynchronous finish function for Fapi_VerifyQuoteIncremental
+ *
+ * This function should be called after a previous
+ * Fapi_VerifyQuoteIncremental_Async.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[out] newPcrState The replay state after the last event of pcrLog.
+ *             May be NULL
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be saved.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN: if the asynchronous operation is not yet
+ *         complete. Call this function again later.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an invalid value was passed into
+ *         the function or pcrLog does not continue pcrState.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if the signature could not
+ *         be verified
+ */
+TSS2_RC
+Fapi_VerifyQuoteIncremental_Finish(
+    FAPI_CONTEXT  *context,
+    char         **newPcrState)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r;
+    IFAPI_OBJECT key_object;
+    TPM2B_ATTEST attest2b;
+    TPM2B_DIGEST pcr_digest;
+    json_object *jso = NULL;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+
+    /* Helpful alias pointers */
+    IFAPI_PCR * command = &context->cmd.pcr;
+
+    memset(&key_object, 0, sizeof(IFAPI_OBJECT));
+
+    switch (context->state) {
+        statecase(context->state, VERIFY_QUOTE_INCREMENTAL_READ);
+            r = ifapi_keystore_load_finish(&context->keystore, &context->io, &key_object);
+            return_try_again(r);
+            goto_if_error_reset_state(r, "read_finish failed", error_cleanup);
+
+            /* Recalculate the quote-info and attest2b buffer. */
+            r = ifapi_get_quote_info(command->quoteInfo, &attest2b,
+                                     &command->fapi_quote_info);
+            goto_if_error(r, "Get quote info.", error_cleanup);
+
+            /* Verify the signature over the attest2b structure. */
+            r = ifapi_verify_signature_quote(&key_object,
+                                             command->signature,
+                                             command->signatureSize,
+                                             &attest2b.attestationData[0],
+                                             attest2b.size,
+                                             &command->fapi_quote_info.sig_scheme);
+            goto_if_error(r, "Verify signature.", error_cleanup);
+
+            command->replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+            goto_if_null2(command->replay, "Out of memory",
+                          r, TSS2_FAPI_RC_MEMORY, error_cleanup);
+
+            /* Restore the PCR values of the earlier verification. */
+            if (command->pcrState) {
+                jso = json_tokener_parse(command->pcrState);
+                if (!jso) {
+                    goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Bad value for pcrState",
+                               error_cleanup);
+                }
+                r = ifapi_json_IFAPI_PCR_REPLAY_deserialize(jso, command->replay);
+                goto_if_error(r, "Deserialize pcrState.", error_cleanup);
+                json_object_put(jso);
+                jso = NULL;
+            }
+
+            /* Parse the logData JSON. */
+            if (command->logData) {
+                command->event_list = json_tokener_parse(command->logData);
+                if (!command->event_list) {
+                    goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Bad value for logData",
+                               error_cleanup);
+                }
+            }
+
+            /* Replay the new events and verify the PCR digest. */
+            r = ifapi_pcr_replay_select(command->replay,
+                    &command->fapi_quote_info.attest.attested.quote.pcrSelect);
+            goto_if_error(r, "Select PCRs.", error_cleanup);
+
+            r = ifapi_pcr_replay_events(command->replay, command->event_list,
+                                        command->logOffset);
+            goto_if_error(r, "Replay event list.", error_cleanup);
+
+            r = ifapi_pcr_replay_digest(command->replay, &command->fapi_quote_info,
+                                        &pcr_digest);
+            goto_if_error(r, "Verify event list.", error_cleanup);
+
+            /* Return the new replay state. */
+            if (newPcrState) {
+                r = ifapi_json_IFAPI_PCR_REPLAY_serialize(command->replay, &jso);
+                goto_if_error(r, "Serialize pcrState.", error_cleanup);
+
+                *newPcrState = strdup(json_object_to_json_string_ext(jso,
+                                      JSON_C_TO_STRING_PRETTY));
+                goto_if_null2(*newPcrState, "Out of memory",
+                              r, TSS2_FAPI_RC_MEMORY, error_cleanup);
+            }
+
+            context->state = _FAPI_STATE_INIT;
+            break;
+
+        statecasedefault(context->state);
+    }
+
+error_cleanup:
+    /* Cleanup any intermediate results and state stored in the context. */
+    if (key_object.objectType)
+        ifapi_cleanup_ifapi_object(&key_object);
+    if (jso)
+        json_object_put(jso);
+    if (command->event_list)
+        json_object_put(command->event_list);
+    command->event_list = NULL;
+    ifapi_cleanup_ifapi_object(&context->loadKey.auth_object);
+    ifapi_cleanup_ifapi_object(context->loadKey.key_object);
+    ifapi_cleanup_ifapi_object(&context->createPrimary.pkey_object);
+    SAFE_FREE(command->keyPath);
+    SAFE_FREE(command->signature);
+    SAFE_FREE(command->quoteInfo);
+    SAFE_FREE(command->logData);
+    SAFE_FREE(command->pcrState);
+    SAFE_FREE(command->replay);
+    LOG_TRACE("finished");
+    return r;
+}
@@ -1145,47 +1145,37 @@ cleanup:
 }
 
 /**
- * Verifies the signature created by a Quote command.
+ * Decodes the public key of a FAPI key object for signature verification.
  *
- * @param[in] keyObject A FAPI key with which the signature is verified
- * @param[in] signature A byte buffer holding the signature
- * @param[in] signatureSize The size of signature in bytes
- * @param[in] digest The digest of the signature
- * @param[in] digestSize The size of digest in bytes
- * @param[in] signatureScheme The signature scheme
+ * The decoded key is not modified by ifapi_verify_signature_quote_key() and
+ * thus may be used by several threads concurrently.
+ *
+ * @param[in] keyObject A FAPI key or external public key
+ * @param[out] publicKey The decoded public key. Must be freed with
+ *             ifapi_public_key_free()
  *
  * @retval TSS2_RC_SUCCESS on success
- * @retval TSS2_FAPI_RC_BAD_REFERENCE if keyObject, signature, digest
- *         or signatureScheme is NULL
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE if keyObject or publicKey is NULL
  * @retval TSS2_FAPI_RC_MEMORY if memory could not be allocated
  * @retval TSS2_FAPI_RC_BAD_VALUE if the PEM encoded key could not be decoded
+ *         or the object is no key
  * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an error occurs in the crypto library
- * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if the verification of the
- *         signature fails
  */
 TSS2_RC
-ifapi_verify_signature_quote(
+ifapi_public_key_load(
     const IFAPI_OBJECT *keyObject,
-    const uint8_t *signature,
-    size_t signatureSize,
-    const uint8_t *digest,
-    size_t digestSize,
-    const TPMT_SIG_SCHEME *signatureScheme)
+    IFAPI_PUBLIC_KEY_BLOB **publicKey)
 {
     /* Check for NULL parameters */
     return_if_null(keyObject, "keyObject is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
-    return_if_null(signature, "signature is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
-    return_if_null(digest, "digest is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
-    return_if_null(signatureScheme, "signatureScheme is NULL",
-            TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(publicKey, "publicKey is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
 
     TSS2_RC r = TSS2_RC_SUCCESS;
     char *public_pem_key = NULL;
     int pem_size;
-    EVP_PKEY *publicKey = NULL;
     BIO *bufio = NULL;
-    EVP_PKEY_CTX *pctx = NULL;
-    EVP_MD_CTX *mdctx = NULL;
+
+    *publicKey = NULL;
 
     /* Check whether or not the key is valid */
     if (keyObject->objectType == IFAPI_KEY_OBJ) {
@@ -1207,10 +1197,69 @@ ifapi_verify_signature_quote(
     goto_if_null(bufio, "BIO buffer could not be allocated.",
                  TSS2_FAPI_RC_MEMORY, error_cleanup);
 
-    publicKey = PEM_read_bio_PUBKEY(bufio, NULL, NULL, NULL);
-    goto_if_null(publicKey, "PEM format could not be decoded.",
+    *publicKey = PEM_read_bio_PUBKEY(bufio, NULL, NULL, NULL);
+    goto_if_null(*publicKey, "PEM format could not be decoded.",
                  TSS2_FAPI_RC_BAD_VALUE, error_cleanup);
 
+error_cleanup:
+    SAFE_FREE(public_pem_key);
+    BIO_free(bufio);
+    return r;
+}
+
+/**
+ * Frees a public key decoded by ifapi_public_key_load().
+ *
+ * @param[in,out] publicKey The public key. Will be set to NULL.
+ */
+void
+ifapi_public_key_free(
+    IFAPI_PUBLIC_KEY_BLOB **publicKey)
+{
+    if (publicKey) {
+        EVP_PKEY_free(*publicKey);
+        *publicKey = NULL;
+    }
+}
+
+/**
+ * Verifies the signature created by a Quote command with a decoded key.
+ *
+ * @param[in] publicKey A public key decoded by ifapi_public_key_load()
+ * @param[in] signature A byte buffer holding the signature
+ * @param[in] signatureSize The size of signature in bytes
+ * @param[in] digest The digest of the signature
+ * @param[in] digestSize The size of digest in bytes
+ * @param[in] signatureScheme The signature scheme
+ *
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE if publicKey, signature, digest
+ *         or signatureScheme is NULL
+ * @retval TSS2_FAPI_RC_MEMORY if memory could not be allocated
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an error occurs in the crypto library
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if the verification of the
+ *         signature fails
+ */
+TSS2_RC
+ifapi_verify_signature_quote_key(
+    const IFAPI_PUBLIC_KEY_BLOB *publicKey,
+    const uint8_t *signature,
+    size_t signatureSize,
+    const uint8_t *digest,
+    size_t digestSize,
+    const TPMT_SIG_SCHEME *signatureScheme)
+{
+    /* Check for NULL parameters */
+    return_if_null(publicKey, "publicKey is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(signature, "signature is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(digest, "digest is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(signatureScheme, "signatureScheme is NULL",
+            TSS2_FAPI_RC_BAD_REFERENCE);
+
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_MD_CTX *mdctx = NULL;
+
     /* Create the hash engine */
     if (!(mdctx = EVP_MD_CTX_create())) {
         goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "EVP_MD_CTX_create",
@@ -1224,7 +1273,8 @@ ifapi_verify_signature_quote(
     }
 
     /* Verify the digest of the signature */
-    if (1 != EVP_DigestVerifyInit(mdctx, &pctx, hashAlgorithm, NULL, publicKey)) {
+    if (1 != EVP_DigestVerifyInit(mdctx, &pctx, hashAlgorithm, NULL,
+                                  (EVP_PKEY *)publicKey)) {
         goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "EVP_DigestVerifyInit",
                    error_cleanup);
     }
@@ -1254,9 +1304,53 @@ error_cleanup:
     if (mdctx != NULL) {
         EVP_MD_CTX_destroy(mdctx);
     }
-    SAFE_FREE(public_pem_key);
-    EVP_PKEY_free(publicKey);
-    BIO_free(bufio);
+    return r;
+}
+
+/**
+ * Verifies the signature created by a Quote command.
+ *
+ * @param[in] keyObject A FAPI key with which the signature is verified
+ * @param[in] signature A byte buffer holding the signature
+ * @param[in] signatureSize The size of signature in bytes
+ * @param[in] digest The digest of the signature
+ * @param[in] digestSize The size of digest in bytes
+ * @param[in] signatureScheme The signature scheme
+ *
+ * @retval TSS2_RC_SUCCESS on success
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE if keyObject, signature, digest
+ *         or signatureScheme is NULL
+ * @retval TSS2_FAPI_RC_MEMORY if memory could not be allocated
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the PEM encoded key could not be decoded
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an error occurs in the crypto library
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED if the verification of the
+ *         signature fails
+ */
+TSS2_RC
+ifapi_verify_signature_quote(
+    const IFAPI_OBJECT *keyObject,
+    const uint8_t *signature,
+    size_t signatureSize,
+    const uint8_t *digest,
+    size_t digestSize,
+    const TPMT_SIG_SCHEME *signatureScheme)
+{
+    /* Check for NULL parameters */
+    return_if_null(keyObject, "keyObject is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(signature, "signature is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(digest, "digest is NULL", TSS2_FAPI_RC_BAD_REFERENCE);
+    return_if_null(signatureScheme, "signatureScheme is NULL",
+            TSS2_FAPI_RC_BAD_REFERENCE);
+
+    TSS2_RC r;
+    IFAPI_PUBLIC_KEY_BLOB *publicKey = NULL;
+
+    r = ifapi_public_key_load(keyObject, &publicKey);
+    return_if_error(r, "Decode public key.");
+
+    r = ifapi_verify_signature_quote_key(publicKey, signature, signatureSize,
+                                         digest, digestSize, signatureScheme);
+    ifapi_public_key_free(&publicKey);
     return r;
 }
 
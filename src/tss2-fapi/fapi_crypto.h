@@ -51,6 +51,23 @@ ifapi_verify_signature_quote(
     size_t                      digestSize,
     const TPMT_SIG_SCHEME       *signatureScheme);
 
+TSS2_RC
+ifapi_public_key_load(
+    const IFAPI_OBJECT          *keyObject,
+    IFAPI_PUBLIC_KEY_BLOB       **publicKey);
+
+void
+ifapi_public_key_free(
+    IFAPI_PUBLIC_KEY_BLOB       **publicKey);
+
+TSS2_RC
+ifapi_verify_signature_quote_key(
+    const IFAPI_PUBLIC_KEY_BLOB *publicKey,
+    const uint8_t               *signature,
+    size_t                      signatureSize,
+    const uint8_t               *digest,
+    size_t                      digestSize,
+    const TPMT_SIG_SCHEME       *signatureScheme);
 
 typedef struct _IFAPI_CRYPTO_CONTEXT IFAPI_CRYPTO_CONTEXT_BLOB;
 
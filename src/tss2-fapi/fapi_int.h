@@ -16,6 +16,8 @@
 #include "ifapi_keystore.h"
 #include "ifapi_policy_store.h"
 #include "ifapi_config.h"
+#include "ifapi_key_cache.h"
+#include "ifapi_policy_ticket_cache.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -38,6 +40,7 @@
 #define IFAPI_PCR_LOG_FILE "pcr.log"
 #define IFAPI_OBJECT_TYPE ".json"
 #define IFAPI_OBJECT_FILE "object.json"
+#define IFAPI_KEYSTORE_INDEX_FILE ".index"
 #define IFAPI_SRK_KEY_PATH "/HS/SRK"
 #define IFAPI_EK_KEY_PATH "/HE/EK"
 #define IFAPI_HS_PATH "/HS"
@@ -156,6 +159,7 @@ typedef struct {
     char                                 *fapi_version;    /**< The version string of FAPI */
     IFAPI_CONFIG                           fapi_config;    /**< The configuration information */
     IFAPI_CAP_INFO             cap[IFAPI_MAX_CAP_INFO];
+    IFAPI_CACHE_STATS                     object_cache;    /**< The statistics of the keystore object cache */
 } IFAPI_INFO;
 
 /** Type for representing FAPI template for keys
@@ -254,6 +258,47 @@ typedef struct {
     IFAPI_OBJECT *null_primaries;    /**< Array of the NULL hierarchy primaries. */
 } IFAPI_INITIALIZE;
 
+/** The replayed value of one PCR of one bank.
+ */
+typedef struct {
+    TPMI_ALG_HASH bank;                /**< The PCR bank */
+    TPM2_HANDLE pcr;                   /**< The PCR register */
+    UINT64 events;                     /**< Number of log events replayed */
+    TPM2B_DIGEST value;                /**< The PCR value after these events */
+} IFAPI_PCR_REPLAY_VALUE;
+
+/** The state of the replay of an event log.
+ *
+ * The state can be serialized and passed to a later verification of a
+ * quote from the same host, which then only replays the new events.
+ */
+typedef struct {
+    size_t count;                      /**< Number of used values */
+    IFAPI_PCR_REPLAY_VALUE values[TPM2_NUM_PCR_BANKS * TPM2_MAX_PCRS];
+} IFAPI_PCR_REPLAY;
+
+/** A public key decoded for signature verification. */
+typedef struct evp_pkey_st IFAPI_PUBLIC_KEY_BLOB;
+
+/** The data structure holding internal state of Fapi_VerifyQuoteBatch.
+ */
+typedef struct {
+    size_t numQuotes;                  /**< Number of quotes to be verified */
+    char **keyPaths;                   /**< The key path of each quote */
+    TPM2B_DATA *qualifyingData;        /**< The nonce of each quote */
+    char **quoteInfos;                 /**< The quote information of each quote */
+    uint8_t **signatures;              /**< The signature of each quote */
+    size_t *signatureSizes;            /**< The size of each signature */
+    char **pcrLogs;                    /**< The PCR log of each quote (may be NULL) */
+    TSS2_RC *results;                  /**< The verification result of each quote */
+    size_t *keyIndex;                  /**< Index of the key of each quote */
+    size_t numKeys;                    /**< Number of distinct keys */
+    const char **keyNames;             /**< The path of each distinct key */
+    IFAPI_PUBLIC_KEY_BLOB **keys;      /**< The decoded keys shared by all threads */
+    TSS2_RC *keyResults;               /**< The result of loading each key */
+    size_t key_idx;                    /**< Index of the key currently loaded */
+} IFAPI_VerifyQuoteBatch;
+
 /** The data structure holding internal state of Fapi_PCR commands.
  */
 typedef struct {
@@ -288,10 +333,12 @@ typedef struct {
     char *pcrLog;
     IFAPI_EVENT pcr_event;
     json_object *event_list;
+    size_t logOffset;                  /**< Index of the first event of logData */
+    char *pcrState;                    /**< Serialized replay state of earlier verification */
+    IFAPI_PCR_REPLAY *replay;          /**< The replay state of the event log */
     FAPI_QUOTE_INFO fapi_quote_info;
     uint8_t *pcrValue;
     size_t pcrValueSize;
-    char *event_log_file;
 } IFAPI_PCR;
 
 /** The data structure holding internal state of Fapi_SetDescription.
@@ -309,8 +356,6 @@ typedef struct {
  */
 typedef struct {
     size_t numBytes;              /**< The number of random bytes to be generated */
-    size_t idx;                   /**< Current position in output buffer.  */
-    UINT16 bytesRequested;        /**< Byted currently requested from TPM */
     uint8_t *data;                /**< The buffer for the random data */
     uint8_t *ret_data;            /**< The result buffer. */
 } IFAPI_GetRandom;
@@ -637,9 +682,12 @@ typedef struct {
 enum _FAPI_STATE_LOAD_KEY {
     LOAD_KEY_GET_PATH = 0,
     LOAD_KEY_READ_KEY,
+    LOAD_KEY_WAIT_FOR_CONTEXT,
+    LOAD_KEY_PUSH_KEY,
     LOAD_KEY_WAIT_FOR_PRIMARY,
     LOAD_KEY_LOAD_KEY,
     LOAD_KEY_AUTH,
+    LOAD_KEY_SAVE_CONTEXT,
     LOAD_KEY_AUTHORIZE
 };
 
@@ -757,6 +805,7 @@ typedef union {
     IFAPI_Key_VerifySignature Key_VerifySignature;
     IFAPI_Data_EncryptDecrypt Data_EncryptDecrypt;
     IFAPI_PCR pcr;
+    IFAPI_VerifyQuoteBatch VerifyQuoteBatch;
     IFAPI_INITIALIZE Initialize;
     IFAPI_Path_SetDescription path_set_info;
     IFAPI_Fapi_AuthorizePolicy Policy_AuthorizeNewPolicy;
@@ -1087,6 +1136,9 @@ enum _FAPI_STATE {
     POLICY_EXPORT_COMPUTE_POLICY_DIGEST,
 
     VERIFY_QUOTE_READ,
+    VERIFY_QUOTE_INCREMENTAL_READ,
+    VERIFY_QUOTE_BATCH_READ_KEY,
+    VERIFY_QUOTE_BATCH_VERIFY,
 
     GET_INFO_GET_CAP,
     GET_INFO_GET_CAP_MORE,
@@ -1144,6 +1196,9 @@ struct FAPI_CONTEXT {
     IFAPI_GetRandom get_random;
     IFAPI_CreatePrimary createPrimary;
     IFAPI_LoadKey loadKey;
+    IFAPI_KEY_CACHE key_cache;       /**< The saved contexts of loaded parent keys */
+    IFAPI_POLICY_TICKET_CACHE ticket_cache;
+                                     /**< The verification tickets of authorized policies */
     ESYS_TR session1;                /**< The first session used by FAPI  */
     ESYS_TR session2;                /**< The second session used by FAPI  */
     ESYS_TR policy_session;          /**< The policy session used by FAPI  */
@@ -1154,6 +1209,8 @@ struct FAPI_CONTEXT {
     IFAPI_SESSION_TYPE session_flags;
     TPMA_SESSION session1_attribute_flags;
     TPMA_SESSION session2_attribute_flags;
+    bool session_from_pool;          /**< The session currently created was taken
+                                          from the session pool */
     IFAPI_MAX_BUFFER aux_data; /**< tpm2b data to be transferred */
     IFAPI_POLICY_CTX policy;  /**< The context of current policy. */
     IFAPI_FILE_SEARCH_CTX fsearch;  /**< The context for object search in key/policy store */
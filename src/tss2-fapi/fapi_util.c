@@ -136,6 +136,67 @@ ifapi_get_session_finish(ESYS_CONTEXT *esys, ESYS_TR *session,
     return TSS2_RC_SUCCESS;
 }
 
+/** Take a session of a FAPI command from the session pool.
+ *
+ * If the session pool of the ESAPI context holds an idle session with the
+ * parameters needed, this session will be used instead of starting a new one
+ * and its attributes will be adjusted.
+ *
+ * @param[in] esys The ESYS_CONTEXT.
+ * @param[in] saltkey The key which is used for the encryption of the session
+ *            secret.
+ * @param[in] profile The FAPI profile with the sessions symmetric parameters.
+ * @param[in] hashAlg The hash algorithm used for the session.
+ * @param[in] flags The flags to adjust the session attributes.
+ * @param[out] session The session handle or ESYS_TR_NONE if no session of the
+ *             pool can be used.
+ *
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_* possible error codes of ESAPI.
+ */
+static TSS2_RC
+get_pooled_session(ESYS_CONTEXT *esys, ESYS_TR saltkey, const IFAPI_PROFILE *profile,
+                   TPMI_ALG_HASH hashAlg, TPMA_SESSION flags, ESYS_TR *session)
+{
+    TSS2_RC r;
+
+    r = Esys_SessionPool_Acquire(esys, saltkey, &profile->session_symmetric,
+                                 hashAlg, session);
+    return_if_error(r, "Get session from pool.");
+
+    if (*session == ESYS_TR_NONE)
+        return TSS2_RC_SUCCESS;
+
+    LOG_DEBUG("Reuse pooled session %"PRIx32, *session);
+    r = Esys_TRSess_SetAttributes(esys, *session,
+                                  flags | TPMA_SESSION_CONTINUESESSION, 0xff);
+    return_if_error(r, "Set session attributes.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free a session slot of the TPM occupied by the session pool.
+ *
+ * If a session could not be started because the TPM ran out of session memory,
+ * an idle session of the pool is saved with TPM2_ContextSave. If the TPM ran
+ * out of session handles, an idle session is flushed.
+ *
+ * @param[in] esys The ESYS_CONTEXT.
+ * @param[in] r The response code of the session start.
+ *
+ * @retval true if a session was evicted and the session start can be retried.
+ * @retval false otherwise.
+ */
+static bool
+evict_pooled_session(ESYS_CONTEXT *esys, TSS2_RC r)
+{
+    if (r == TPM2_RC_SESSION_MEMORY)
+        return Esys_SessionPool_Evict(esys, TPM2_NO) == TSS2_RC_SUCCESS;
+    if (r == TPM2_RC_SESSION_HANDLES)
+        return Esys_SessionPool_Evict(esys, TPM2_YES) == TSS2_RC_SUCCESS;
+    return false;
+}
+
 /** Get the digest size of the policy of a FAPI object.
  *
  * @param[in] object The object with the correspodning policy.
@@ -1118,6 +1179,10 @@ ifapi_cleanup_session(FAPI_CONTEXT *context)
 
     switch (context->cleanup_state) {
         statecase(context->cleanup_state, CLEANUP_INIT);
+            /* Sessions kept in the session pool must not be flushed. */
+            r = Esys_SessionPool_Release(context->esys, &context->session1);
+            return_if_error(r, "Release session.");
+
             if (context->session1 != ESYS_TR_NONE) {
                 r = Esys_FlushContext_Async(context->esys, context->session1);
                 try_again_or_error(r, "Flush session.");
@@ -1131,6 +1196,9 @@ ifapi_cleanup_session(FAPI_CONTEXT *context)
             }
             context->session1 = ESYS_TR_NONE;
 
+            r = Esys_SessionPool_Release(context->esys, &context->session2);
+            return_if_error(r, "Release session.");
+
             if (context->session2 != ESYS_TR_NONE) {
                 r = Esys_FlushContext_Async(context->esys, context->session2);
                 try_again_or_error(r, "Flush session.");
@@ -1316,19 +1384,38 @@ ifapi_get_sessions_finish(
             return TSS2_RC_SUCCESS;
         }
 
-        /* Initializing the first session for the caller */
+        /* Initializing the first session for the caller, a session of the
+           session pool is preferred. */
+
+        r = get_pooled_session(context->esys, context->srk_handle, profile,
+                               hash_alg, context->session1_attribute_flags,
+                               &context->session1);
+        return_if_error_reset_state(r, "Get FAPI session from pool");
 
-        r = ifapi_get_session_async(context->esys, context->srk_handle, profile,
-                                    hash_alg);
-        return_if_error_reset_state(r, "Create FAPI session async");
+        context->session_from_pool = (context->session1 != ESYS_TR_NONE);
+        if (!context->session_from_pool) {
+            r = ifapi_get_session_async(context->esys, context->srk_handle, profile,
+                                        hash_alg);
+            return_if_error_reset_state(r, "Create FAPI session async");
+        }
         fallthrough;
 
     statecase(context->session_state, SESSION_WAIT_FOR_SESSION1);
         LOG_TRACE("**STATE** SESSION_WAIT_FOR_SESSION1");
-        r = ifapi_get_session_finish(context->esys, &context->session1,
-                                     context->session1_attribute_flags);
-        return_try_again(r);
-        return_if_error_reset_state(r, "Create FAPI session finish");
+        if (!context->session_from_pool) {
+            r = ifapi_get_session_finish(context->esys, &context->session1,
+                                         context->session1_attribute_flags);
+            return_try_again(r);
+
+            if (evict_pooled_session(context->esys, r)) {
+                /* Retry with the session slot freed by the pool. */
+                r = ifapi_get_session_async(context->esys, context->srk_handle,
+                                            profile, hash_alg);
+                return_if_error_reset_state(r, "Create FAPI session async");
+                return TSS2_FAPI_RC_TRY_AGAIN;
+            }
+            return_if_error_reset_state(r, "Create FAPI session finish");
+        }
 
         if (!(context->session_flags & IFAPI_SESSION2)) {
             LOG_TRACE("finished");
@@ -1337,18 +1424,35 @@ ifapi_get_sessions_finish(
 
         /* Initializing the second session for the caller */
 
-        r = ifapi_get_session_async(context->esys, context->srk_handle, profile,
-                                    profile->nameAlg);
-        return_if_error_reset_state(r, "Create FAPI session async");
+        r = get_pooled_session(context->esys, context->srk_handle, profile,
+                               profile->nameAlg, context->session2_attribute_flags,
+                               &context->session2);
+        return_if_error_reset_state(r, "Get FAPI session from pool");
+
+        context->session_from_pool = (context->session2 != ESYS_TR_NONE);
+        if (!context->session_from_pool) {
+            r = ifapi_get_session_async(context->esys, context->srk_handle, profile,
+                                        profile->nameAlg);
+            return_if_error_reset_state(r, "Create FAPI session async");
+        }
         fallthrough;
 
     statecase(context->session_state, SESSION_WAIT_FOR_SESSION2);
         LOG_TRACE("**STATE** SESSION_WAIT_FOR_SESSION2");
-        r = ifapi_get_session_finish(context->esys, &context->session2,
-                                     context->session2_attribute_flags);
-        return_try_again(r);
+        if (!context->session_from_pool) {
+            r = ifapi_get_session_finish(context->esys, &context->session2,
+                                         context->session2_attribute_flags);
+            return_try_again(r);
 
-        return_if_error_reset_state(r, "Create FAPI session finish");
+            if (evict_pooled_session(context->esys, r)) {
+                /* Retry with the session slot freed by the pool. */
+                r = ifapi_get_session_async(context->esys, context->srk_handle,
+                                            profile, profile->nameAlg);
+                return_if_error_reset_state(r, "Create FAPI session async");
+                return TSS2_FAPI_RC_TRY_AGAIN;
+            }
+            return_if_error_reset_state(r, "Create FAPI session finish");
+        }
         break;
 
     statecasedefault(context->session_state);
@@ -1696,6 +1800,9 @@ ifapi_load_key_async(FAPI_CONTEXT *context, size_t position)
  *
  * A stack with all sup keys will be created and decremented during
  * the loading auf all keys.
+ * The contexts of loaded parent keys are saved in the key cache of the
+ * FAPI_CONTEXT. If the context of a key is found in the cache, the key is
+ * loaded with TPM2_ContextLoad and the keys above it need not be loaded.
  * The object of the loaded key will be stored in:
  * context->loadKey.auth_object
  *
@@ -1739,6 +1846,7 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
     IFAPI_OBJECT *key_object = NULL;
     IFAPI_KEY *key = NULL;
     ESYS_TR auth_session;
+    TPMS_CONTEXT *key_context = NULL;
 
     switch (context->loadKey.state) {
     statecase(context->loadKey.state, LOAD_KEY_GET_PATH);
@@ -1798,6 +1906,22 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
             return TSS2_FAPI_RC_TRY_AGAIN;
         }
 
+        /* The parent chain needs not to be loaded if the context of the key
+           was saved before. */
+        key_context = ifapi_key_cache_lookup(&context->key_cache,
+                                             context->loadKey.key_object->rel_path,
+                                             &key->name, &key->private);
+        if (key_context) {
+            r = Esys_ContextLoad_Async(context->esys, key_context);
+            goto_if_error(r, "Load context async", error_cleanup);
+
+            context->loadKey.state = LOAD_KEY_WAIT_FOR_CONTEXT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        fallthrough;
+
+    statecase(context->loadKey.state, LOAD_KEY_PUSH_KEY);
+        key = &context->loadKey.key_object->misc.key;
         if (key->private.size == 0) {
             /* Create a deep copy of the primary key */
             r = ifapi_copy_ifapi_key_object(&context->createPrimary.pkey_object,
@@ -1831,6 +1955,28 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
         context->loadKey.state = LOAD_KEY_GET_PATH;
         return TSS2_FAPI_RC_TRY_AGAIN;
 
+    statecase(context->loadKey.state, LOAD_KEY_WAIT_FOR_CONTEXT);
+        r = Esys_ContextLoad_Finish(context->esys, &context->loadKey.handle);
+        return_try_again(r);
+
+        if (r != TSS2_RC_SUCCESS) {
+            /* The saved contexts are invalid after a reset of the TPM. */
+            LOG_WARNING("Saved context of %s could not be loaded: 0x%" PRIx32,
+                        context->loadKey.key_object->rel_path, r);
+            ifapi_key_cache_clear(&context->key_cache);
+            context->loadKey.handle = ESYS_TR_NONE;
+            context->loadKey.state = LOAD_KEY_PUSH_KEY;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+
+        r = ifapi_copy_ifapi_key_object(&context->loadKey.auth_object,
+                                        context->loadKey.key_object);
+        goto_if_error(r, "Could not copy key object", error_cleanup);
+        context->loadKey.auth_object.handle = context->loadKey.handle;
+        ifapi_cleanup_ifapi_object(context->loadKey.key_object);
+        context->loadKey.state = LOAD_KEY_LOAD_KEY;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
     statecase(context->loadKey.state, LOAD_KEY_LOAD_KEY);
         if (!(context->loadKey.key_list)) {
             LOG_TRACE("All keys loaded.");
@@ -1898,7 +2044,33 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
             /* Object can be cleaned if it's not the last */
             ifapi_free_object(context, &top_obj);
         }
+        if (context->loadKey.key_list &&
+            !context->loadKey.auth_object.misc.key.persistent_handle) {
+            /* The key is a transient parent and its context will be kept. */
+            r = Esys_ContextSave_Async(context->esys, context->loadKey.handle);
+            goto_if_error(r, "Save context async", error_cleanup);
+        } else {
+            context->loadKey.state = LOAD_KEY_LOAD_KEY;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        fallthrough;
 
+    statecase(context->loadKey.state, LOAD_KEY_SAVE_CONTEXT);
+        r = Esys_ContextSave_Finish(context->esys, &key_context);
+        return_try_again(r);
+
+        if (r == TSS2_RC_SUCCESS) {
+            r = ifapi_key_cache_insert(&context->key_cache,
+                                       context->loadKey.auth_object.rel_path,
+                                       &context->loadKey.auth_object.misc.key.name,
+                                       &context->loadKey.auth_object.misc.key.private,
+                                       key_context);
+            goto_if_error(r, "Cache key context", error_cleanup);
+        } else {
+            /* The key can be used without saved context. */
+            LOG_WARNING("Context of %s could not be saved: 0x%" PRIx32,
+                        context->loadKey.auth_object.rel_path, r);
+        }
         context->loadKey.state = LOAD_KEY_LOAD_KEY;
         return TSS2_FAPI_RC_TRY_AGAIN;
 
@@ -1912,7 +2084,15 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
                 &context->createPrimary.pkey_object);
         goto_if_error(r, "Could not copy primary key", error_cleanup);
 
-        if (context->loadKey.key_list) {
+        if (context->loadKey.key_list &&
+            !context->loadKey.auth_object.misc.key.persistent_handle) {
+            /* The primary is a parent and its context will be kept. */
+            r = Esys_ContextSave_Async(context->esys, context->loadKey.handle);
+            goto_if_error(r, "Save context async", error_cleanup);
+
+            context->loadKey.state = LOAD_KEY_SAVE_CONTEXT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        } else if (context->loadKey.key_list) {
             context->loadKey.state = LOAD_KEY_LOAD_KEY;
             return TSS2_FAPI_RC_TRY_AGAIN;
         } else {
@@ -2088,11 +2268,34 @@ error:
     return r;
 }
 
+/** Determine the number of NV octets to be transferred with one authorization.
+ *
+ * HMAC and password sessions are used by ESAPI for all chunks of a NV stream.
+ * Policy sessions are reset by the TPM after each command. Thus with a policy
+ * at most nv_buffer_max octets can be transferred per authorization.
+ *
+ * @param[in] context The FAPI context.
+ * @param[in] auth_object The object used for authorization.
+ * @param[in] numBytes The number of octets left.
+ *
+ * @retval The number of octets for the next NV stream.
+ */
+static UINT16
+nv_stream_size(FAPI_CONTEXT *context, IFAPI_OBJECT *auth_object, size_t numBytes)
+{
+    size_t max_size = UINT16_MAX;
+
+    if (policy_digest_size(auth_object))
+        max_size = context->nv_buffer_max;
+
+    return (numBytes > max_size) ? max_size : numBytes;
+}
+
 /** State machine to write data to the NV ram of the TPM.
  *
  * The NV object will be read from object store and the data will be
- * written by one, or more than one if necessary, ESAPI calls to the NV ram of
- * the TPM.
+ * written to the NV ram of the TPM by one ESAPI NV stream, or by one stream
+ * per chunk if the authorization needs a policy session.
  * The sub context nv_cmd will be prepared:
  * - data The buffer for the data which has to be written
  * - offset The current offset for writing
@@ -2144,7 +2347,6 @@ ifapi_nv_write(
     ESYS_TR nv_index = context->nv_cmd.esys_handle;
     IFAPI_OBJECT *object = &context->nv_cmd.nv_object;
     IFAPI_OBJECT *auth_object = &context->nv_cmd.auth_object;
-    TPM2B_MAX_NV_BUFFER *aux_data = (TPM2B_MAX_NV_BUFFER *)&context->aux_data;
     char *nv_file_name = NULL;
     ESYS_TR auth_session;
 
@@ -2155,10 +2357,6 @@ ifapi_nv_write(
         context->nv_cmd.offset = param_offset;
         context->nv_cmd.numBytes = size;
         context->nv_cmd.data = data;
-        if (context->nv_cmd.numBytes > context->nv_buffer_max)
-            aux_data->size = context->nv_buffer_max;
-        else
-            aux_data->size = context->nv_cmd.numBytes;
         context->nv_cmd.data_idx = 0;
 
         /* Use calloc to ensure zero padding for write buffer. */
@@ -2167,7 +2365,6 @@ ifapi_nv_write(
                       TSS2_FAPI_RC_MEMORY,
                       error_cleanup);
         memcpy(context->nv_cmd.write_data, data, size);
-        memcpy(&aux_data->buffer[0], &context->nv_cmd.data[0], aux_data->size);
 
         /* Prepare reading of the key from keystore. */
         r = ifapi_keystore_load_async(&context->keystore, &context->io,
@@ -2226,15 +2423,19 @@ ifapi_nv_write(
         r = ifapi_authorize_object(context, auth_object, &auth_session);
         FAPI_SYNC(r, "Authorize NV object.", error_cleanup);
 
+        context->nv_cmd.bytesRequested =
+            nv_stream_size(context, auth_object, context->nv_cmd.numBytes);
+
         /* Prepare the writing to NV ram. */
-        r = Esys_NV_Write_Async(context->esys,
-                                context->nv_cmd.auth_index,
-                                nv_index,
-                                auth_session,
-                                context->session2,
-                                ESYS_TR_NONE,
-                                aux_data,
-                                context->nv_cmd.data_idx);
+        r = Esys_NV_WriteStream_Async(context->esys,
+                                      context->nv_cmd.auth_index,
+                                      nv_index,
+                                      auth_session,
+                                      context->session2,
+                                      ESYS_TR_NONE,
+                                      &context->nv_cmd.write_data[context->nv_cmd.data_idx],
+                                      context->nv_cmd.bytesRequested,
+                                      context->nv_cmd.data_idx);
         goto_if_error_reset_state(r, " Fapi_NvWrite_Async", error_cleanup);
 
         if (!(object->misc.nv.public.nvPublic.attributes & TPMA_NV_NO_DA))
@@ -2242,13 +2443,11 @@ ifapi_nv_write(
         else
             context->nv_cmd.nv_write_state = NV2_WRITE_NULL_AUTH_SENT;
 
-        context->nv_cmd.bytesRequested = aux_data->size;
-
         fallthrough;
 
     case NV2_WRITE_AUTH_SENT:
     case NV2_WRITE_NULL_AUTH_SENT:
-        r = Esys_NV_Write_Finish(context->esys);
+        r = Esys_NV_WriteStream_Finish(context->esys);
         return_try_again(r);
 
         if (number_rc(r) == TPM2_RC_BAD_AUTH) {
@@ -2262,16 +2461,17 @@ ifapi_nv_write(
                 goto_if_error_reset_state(r, " Fapi_NvWrite_Finish", error_cleanup);
 
                 /* Prepare the writing to NV ram. */
-                r = Esys_NV_Write_Async(context->esys,
-                                        context->nv_cmd.auth_index,
-                                        nv_index,
-                                        (!context->policy.session
-                                         || context->policy.session == ESYS_TR_NONE) ? context->session1 :
-                                        context->policy.session,
-                                        context->session2,
-                                        ESYS_TR_NONE,
-                                        aux_data,
-                                        context->nv_cmd.data_idx);
+                r = Esys_NV_WriteStream_Async(context->esys,
+                                              context->nv_cmd.auth_index,
+                                              nv_index,
+                                              (!context->policy.session
+                                               || context->policy.session == ESYS_TR_NONE) ? context->session1 :
+                                              context->policy.session,
+                                              context->session2,
+                                              ESYS_TR_NONE,
+                                              &context->nv_cmd.write_data[context->nv_cmd.data_idx],
+                                              context->nv_cmd.bytesRequested,
+                                              context->nv_cmd.data_idx);
                 goto_if_error_reset_state(r, "FAPI NV_Write_Async", error_cleanup);
 
                 context->nv_cmd.nv_write_state = NV2_WRITE_AUTH_SENT;
@@ -2283,32 +2483,29 @@ ifapi_nv_write(
         context->nv_cmd.numBytes -= context->nv_cmd.bytesRequested;
 
         if (context->nv_cmd.numBytes > 0) {
-            /* Increment data idx with number of transmitted bytes. */
-            context->nv_cmd.data_idx += aux_data->size;
-            if (context->nv_cmd.numBytes > context->nv_buffer_max)
-                aux_data->size = context->nv_buffer_max;
-            else
-                aux_data->size = context->nv_cmd.numBytes;
-            memcpy(&aux_data->buffer[0],
-                   &context->nv_cmd.write_data[context->nv_cmd.data_idx],
-                   aux_data->size);
+            /* Only a policy authorization has to be repeated for the next
+               chunk. Increment data idx with number of transmitted bytes. */
+            context->nv_cmd.data_idx += context->nv_cmd.bytesRequested;
 
             statecase(context->nv_cmd.nv_write_state, NV2_WRITE_AUTHORIZE2);
                 r = ifapi_authorize_object(context, auth_object, &auth_session);
                 FAPI_SYNC(r, "Authorize NV object.", error_cleanup);
 
+            context->nv_cmd.bytesRequested =
+                nv_stream_size(context, auth_object, context->nv_cmd.numBytes);
+
             /* Prepare the writing to NV ram */
-            r = Esys_NV_Write_Async(context->esys,
-                                    context->nv_cmd.auth_index,
-                                    nv_index,
-                                    auth_session,
-                                    context->session2,
-                                    ESYS_TR_NONE,
-                                    aux_data,
-                                    context->nv_cmd.data_idx);
+            r = Esys_NV_WriteStream_Async(context->esys,
+                                          context->nv_cmd.auth_index,
+                                          nv_index,
+                                          auth_session,
+                                          context->session2,
+                                          ESYS_TR_NONE,
+                                          &context->nv_cmd.write_data[context->nv_cmd.data_idx],
+                                          context->nv_cmd.bytesRequested,
+                                          context->nv_cmd.data_idx);
             goto_if_error_reset_state(r, "FAPI NV_Write", error_cleanup);
 
-            context->nv_cmd.bytesRequested = aux_data->size;
             context->nv_cmd.nv_write_state = NV2_WRITE_AUTH_SENT;
             return TSS2_FAPI_RC_TRY_AGAIN;
 
@@ -2353,6 +2550,9 @@ error_cleanup:
 }
 
 /** State machine to read data from the NV ram of the TPM.
+ *
+ * The data is read by one ESAPI NV stream, or by one stream per chunk if the
+ * authorization needs a policy session.
  *
  * Context nv_cmd has to be prepared before the call of this function:
  * - auth_index The ESAPI handle of the authorization object.
@@ -2393,7 +2593,7 @@ ifapi_nv_read(
 {
     TSS2_RC r;
     UINT16 aux_size;
-    TPM2B_MAX_NV_BUFFER *aux_data;
+    uint8_t *aux_data;
     UINT16 bytesRequested = context->nv_cmd.bytesRequested;
     size_t *numBytes = &context->nv_cmd.numBytes;
     ESYS_TR nv_index = context->nv_cmd.esys_handle;
@@ -2411,20 +2611,17 @@ ifapi_nv_read(
         r = ifapi_authorize_object(context, auth_object, &session);
         FAPI_SYNC(r, "Authorize NV object.", error_cleanup);
 
-        if (*numBytes > context->nv_buffer_max)
-            aux_size = context->nv_buffer_max;
-        else
-            aux_size = *numBytes;
+        aux_size = nv_stream_size(context, auth_object, *numBytes);
 
         /* Prepare the reading from NV ram. */
-        r = Esys_NV_Read_Async(context->esys,
-                               context->nv_cmd.auth_index,
-                               nv_index,
-                               session,
-                               ESYS_TR_NONE,
-                               ESYS_TR_NONE,
-                               aux_size,
-                               0);
+        r = Esys_NV_ReadStream_Async(context->esys,
+                                     context->nv_cmd.auth_index,
+                                     nv_index,
+                                     session,
+                                     ESYS_TR_NONE,
+                                     ESYS_TR_NONE,
+                                     aux_size,
+                                     0);
         goto_if_error_reset_state(r, " Fapi_NvRead_Async", error_cleanup);
 
         context->nv_cmd.nv_read_state = NV_READ_AUTH_SENT;
@@ -2442,7 +2639,7 @@ ifapi_nv_read(
         *data = context->nv_cmd.rdata;
         goto_if_null(*data, "Malloc failed", TSS2_FAPI_RC_MEMORY, error_cleanup);
 
-        r = Esys_NV_Read_Finish(context->esys, &aux_data);
+        r = Esys_NV_ReadStream_Finish(context->esys, &aux_data);
 
         if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
             return TSS2_FAPI_RC_TRY_AGAIN;
@@ -2459,34 +2656,29 @@ ifapi_nv_read(
 
         goto_if_error_reset_state(r, "FAPI NV_Read_Finish", error_cleanup);
 
-        if (aux_data->size < bytesRequested)
-            *numBytes = 0;
-        else
-            *numBytes -= aux_data->size;
-        memcpy(*data + context->nv_cmd.data_idx, &aux_data->buffer[0],
-               aux_data->size);
-        context->nv_cmd.data_idx += aux_data->size;
+        /* The NV stream returns exactly the number of requested bytes. */
+        *numBytes -= bytesRequested;
+        memcpy(*data + context->nv_cmd.data_idx, aux_data, bytesRequested);
+        context->nv_cmd.data_idx += bytesRequested;
         free(aux_data);
         if (*numBytes > 0) {
             statecase(context->nv_cmd.nv_read_state, NV_READ_AUTHORIZE2);
                 r = ifapi_authorize_object(context, auth_object, &session);
                 FAPI_SYNC(r, "Authorize NV object.", error_cleanup);
 
-            /* The reading of the NV data is not completed. The next
+            /* The reading of the NV data is not completed, since a new
+            policy authorization is needed for the next chunk. The next
             reading will be prepared. */
-            if (*numBytes > context->nv_buffer_max)
-                aux_size = context->nv_buffer_max;
-            else
-                aux_size = *numBytes;
-
-            r = Esys_NV_Read_Async(context->esys,
-                                   context->nv_cmd.auth_index,
-                                   nv_index,
-                                   session,
-                                   ESYS_TR_NONE,
-                                   ESYS_TR_NONE,
-                                   aux_size,
-                                   context->nv_cmd.data_idx);
+            aux_size = nv_stream_size(context, auth_object, *numBytes);
+
+            r = Esys_NV_ReadStream_Async(context->esys,
+                                         context->nv_cmd.auth_index,
+                                         nv_index,
+                                         session,
+                                         ESYS_TR_NONE,
+                                         ESYS_TR_NONE,
+                                         aux_size,
+                                         context->nv_cmd.data_idx);
             goto_if_error_reset_state(r, "FAPI NV_Read", error_cleanup);
             context->nv_cmd.bytesRequested = aux_size;
             context->nv_cmd.nv_read_state = NV_READ_AUTH_SENT;
@@ -2505,11 +2697,10 @@ error_cleanup:
     return r;
 }
 
-#define min(X,Y) (X>Y)?Y:X
-
 /** State machine to retrieve random data from TPM.
  *
- * If the buffer size exceeds the maximum size, several ESAPI calls are made.
+ * The random data is written directly to the result buffer by one ESAPI bulk
+ * random request, which makes as many TPM2_GetRandom calls as needed.
  *
  * @param[in,out] context for storing all state information.
  * @param[in] numBytes Number of random bytes to be computed.
@@ -2529,50 +2720,27 @@ TSS2_RC
 ifapi_get_random(FAPI_CONTEXT *context, size_t numBytes, uint8_t **data)
 {
     TSS2_RC r;
-    TPM2B_DIGEST *aux_data = NULL;
 
     switch (context->get_random_state) {
     statecase(context->get_random_state, GET_RANDOM_INIT);
         context->get_random.numBytes = numBytes;
         context->get_random.data = calloc(context->get_random.numBytes, 1);
-        context->get_random.idx = 0;
         return_if_null(context->get_random.data, "FAPI out of memory.",
                        TSS2_FAPI_RC_MEMORY);
 
         /* Prepare the creation of random data. */
-        r = Esys_GetRandom_Async(context->esys,
-                                 context->session1,
-                                 ESYS_TR_NONE, ESYS_TR_NONE,
-                                 min(context->get_random.numBytes, sizeof(TPMU_HA)));
+        r = Esys_GetRandomBulk_Async(context->esys,
+                                     context->session1,
+                                     ESYS_TR_NONE, ESYS_TR_NONE,
+                                     context->get_random.data,
+                                     context->get_random.numBytes);
         goto_if_error_reset_state(r, "FAPI GetRandom", error_cleanup);
         fallthrough;
 
     statecase(context->get_random_state, GET_RANDOM_SENT);
-        r = Esys_GetRandom_Finish(context->esys, &aux_data);
+        r = Esys_GetRandomBulk_Finish(context->esys);
         return_try_again(r);
         goto_if_error_reset_state(r, "FAPI GetRandom_Finish", error_cleanup);
-
-        if (aux_data -> size > context->get_random.numBytes) {
-            goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "TPM returned too many bytes",
-                       error_cleanup);
-        }
-
-        /* Save created random data. */
-        memcpy(context->get_random.data + context->get_random.idx, &aux_data->buffer[0],
-               aux_data->size);
-        context->get_random.numBytes -= aux_data->size;
-        context->get_random.idx += aux_data->size;
-        Esys_Free(aux_data);
-        aux_data = NULL;
-        if (context->get_random.numBytes > 0) {
-
-            /* Continue creaion of random data if needed. */
-            r = Esys_GetRandom_Async(context->esys, context->session1, ESYS_TR_NONE,
-                                     ESYS_TR_NONE, min(context->get_random.numBytes, sizeof(TPMU_HA)));
-            goto_if_error_reset_state(r, "FAPI GetRandom", error_cleanup);
-
-            return TSS2_FAPI_RC_TRY_AGAIN;
-        }
         break;
 
     statecasedefault(context->get_random_state);
@@ -2585,8 +2753,6 @@ ifapi_get_random(FAPI_CONTEXT *context, size_t numBytes, uint8_t **data)
     return TSS2_RC_SUCCESS;
 
 error_cleanup:
-    if (aux_data)
-        Esys_Free(aux_data);
     context->get_random_state = GET_RANDOM_INIT;
     if (context->get_random.data != NULL)
         SAFE_FREE(context->get_random.data);
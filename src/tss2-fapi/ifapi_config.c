@@ -27,6 +27,16 @@
  */
 #define DEFAULT_CONFIG_FILE (SYSCONFDIR "/tpm2-tss/fapi-config.json")
 
+/**
+ * The default number of keystore objects cached in memory
+ */
+#define DEFAULT_OBJECT_CACHE_SIZE 64
+
+/**
+ * The default number of idle sessions kept for reuse
+ */
+#define DEFAULT_SESSION_POOL_SIZE 0
+
 /** Deserializes a configuration JSON object.
  *
  * @param[in]  jso The JSON object to be deserialized
@@ -119,6 +129,27 @@ ifapi_json_IFAPI_CONFIG_deserialize(json_object *jso, IFAPI_CONFIG *out)
         return_if_error(r, "Bad value for field \"intel_cert_service\".");
     }
 
+    if (ifapi_get_sub_object(jso, "eventlog_sync", &jso2)) {
+        r = ifapi_json_TPMI_YES_NO_deserialize(jso2, &out->eventlog_sync);
+        return_if_error(r, "Bad value for field \"eventlog_sync\".");
+    } else {
+        out->eventlog_sync = TPM2_NO;
+    }
+
+    if (ifapi_get_sub_object(jso, "object_cache_size", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->object_cache_size);
+        return_if_error(r, "Bad value for field \"object_cache_size\".");
+    } else {
+        out->object_cache_size = DEFAULT_OBJECT_CACHE_SIZE;
+    }
+
+    if (ifapi_get_sub_object(jso, "session_pool_size", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->session_pool_size);
+        return_if_error(r, "Bad value for field \"session_pool_size\".");
+    } else {
+        out->session_pool_size = DEFAULT_SESSION_POOL_SIZE;
+    }
+
     LOG_TRACE("true");
     return TSS2_RC_SUCCESS;
 }
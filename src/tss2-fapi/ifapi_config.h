@@ -40,6 +40,12 @@ typedef struct {
     TPMI_YES_NO         ek_cert_less;
     /** Certificate service for Intel TPMs */
     char                *intel_cert_service;
+    /** Switch whether event log files are synced to disk after each event */
+    TPMI_YES_NO         eventlog_sync;
+    /** Maximal number of keystore objects cached in memory, 0 disables the cache */
+    UINT32              object_cache_size;
+    /** Maximal number of idle sessions kept for reuse, 0 disables the pool */
+    UINT32              session_pool_size;
 
 } IFAPI_CONFIG;
 
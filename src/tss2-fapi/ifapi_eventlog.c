@@ -8,7 +8,12 @@
 #include <config.h>
 #endif
 
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "ifapi_helpers.h"
 #include "ifapi_eventlog.h"
@@ -24,6 +29,8 @@
  *
  * @param[in,out] eventlog The context area for the eventlog.
  * @param[in] log_dir The directory where to put the eventlog data.
+ * @param[in] sync Whether the event log files shall be synced to disk after
+ *            each appended event.
  * @retval TSS2_RC_SUCCESS on success.
  * @retval TSS2_FAPI_RC_IO_ERROR if creation of log_dir failed or log_dir is not writable.
  * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
@@ -34,7 +41,8 @@
 TSS2_RC
 ifapi_eventlog_initialize(
     IFAPI_EVENTLOG *eventlog,
-    const char *log_dir)
+    const char *log_dir,
+    bool sync)
 {
     check_not_null(eventlog);
     check_not_null(log_dir);
@@ -46,10 +54,203 @@ ifapi_eventlog_initialize(
 
     eventlog->log_dir = strdup(log_dir);
     return_if_null(eventlog->log_dir, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+    eventlog->sync = sync;
 
     return TSS2_RC_SUCCESS;
 }
 
+/** Add the events of a stored event log to a JSON array.
+ *
+ * Event logs are stored with one compact JSON event per line, so that events
+ * can be appended without rewriting the file. Logs written by former versions
+ * store all events in one JSON array; these are accepted as well.
+ * An invalid last line without line end, left by an interrupted append, is
+ * skipped.
+ *
+ * @param[in,out] logstr The content of the event log file. The buffer will be
+ *                modified during parsing.
+ * @param[in,out] log The JSON array the events will be added to.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the log does not contain valid JSON.
+ */
+static TSS2_RC
+eventlog_parse(
+    char *logstr,
+    json_object *log)
+{
+    char *line, *next;
+    bool terminated;
+    json_object *logpart, *event;
+
+    for (line = logstr; isspace((unsigned char)*line); line++);
+
+    if (*line == '[') {
+        logpart = ifapi_parse_json(line);
+        return_if_null(logpart, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
+
+        /* Iterate through the array of logpart and add each item to the eventlog */
+        /* The return type of json_object_array_length() was changed, thus the case */
+        for (int i = 0; i < (int)json_object_array_length(logpart); i++) {
+            event = json_object_array_get_idx(logpart, i);
+            /* Increment the refcount of event so it does not get freed on put(logpart) below */
+            json_object_get(event);
+            json_object_array_add(log, event);
+        }
+        json_object_put(logpart);
+        return TSS2_RC_SUCCESS;
+    }
+
+    for (; *line; line = next) {
+        next = strchr(line, '\n');
+        terminated = next != NULL;
+        if (next) {
+            *next++ = '\0';
+        } else {
+            next = &line[strlen(line)];
+        }
+        if (*line == '\0')
+            continue;
+
+        event = ifapi_parse_json(line);
+        if (!event && !terminated) {
+            /* The last line was torn by an interrupted append. */
+            LOG_WARNING("Incomplete last event of event log skipped.");
+            break;
+        }
+        return_if_null(event, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
+        json_object_array_add(log, event);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Determine the format and the last record number of an event log file.
+ *
+ * For logs with one event per line only the last line is read, so the cost
+ * does not depend on the number of events stored in the log.
+ * A last line without line end which is not a valid event was torn by an
+ * interrupted append; the log is truncated to the last complete line.
+ *
+ * @param[in] filename The name of the event log file.
+ * @param[out] legacy true if the file stores all events in one JSON array
+ *             and needs to be converted before events can be appended.
+ * @param[out] recnum The number of the last event in the log.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the file could not be read.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the last event is not valid.
+ */
+static TSS2_RC
+eventlog_last_recnum(
+    const char *filename,
+    bool *legacy,
+    UINT32 *recnum)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    FILE *stream;
+    char chunk[256], *line = NULL;
+    long pos, size, start, end, length;
+    size_t i, n;
+    json_object *jso = NULL, *jso2;
+    int c;
+
+    *legacy = false;
+    *recnum = 0;
+
+    stream = fopen(filename, "rt");
+    if (stream == NULL) {
+        LOG_ERROR("Open file \"%s\": %s", filename, strerror(errno));
+        return TSS2_FAPI_RC_IO_ERROR;
+    }
+
+    do {
+        c = fgetc(stream);
+    } while (c != EOF && isspace(c));
+
+    if (c == '[') {
+        *legacy = true;
+        goto cleanup;
+    }
+    if (c == EOF) {
+        /* Empty log file */
+        goto cleanup;
+    }
+
+    if (fseek(stream, 0L, SEEK_END) == -1 || (size = ftell(stream)) == -1) {
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Seek in \"%s\" failed.", cleanup,
+                   filename);
+    }
+
+last_line:
+    pos = size;
+    start = 0;
+    end = -1;
+
+    /* Search backwards for the beginning of the last non empty line. */
+    while (pos > 0) {
+        n = pos < (long)sizeof(chunk) ? (size_t)pos : sizeof(chunk);
+        pos -= n;
+        if (fseek(stream, pos, SEEK_SET) == -1 ||
+                fread(chunk, 1, n, stream) != n) {
+            goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Read of \"%s\" failed.", cleanup,
+                       filename);
+        }
+        for (i = n; i > 0; i--) {
+            if (end < 0) {
+                if (!isspace((unsigned char)chunk[i - 1]))
+                    end = pos + i;
+            } else if (chunk[i - 1] == '\n') {
+                start = pos + i;
+                pos = 0;
+                break;
+            }
+        }
+    }
+
+    if (end < 0) {
+        /* Only white space is left in the log */
+        goto cleanup;
+    }
+
+    length = end - start;
+    line = malloc(length + 1);
+    goto_if_null2(line, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, cleanup);
+
+    if (fseek(stream, start, SEEK_SET) == -1 ||
+            fread(line, 1, length, stream) != (size_t)length) {
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Read of \"%s\" failed.", cleanup,
+                   filename);
+    }
+    line[length] = '\0';
+
+    jso = ifapi_parse_json(line);
+    if (!jso && end == size) {
+        /* Drop the torn event so that the log can be extended again. */
+        LOG_WARNING("Incomplete last event in \"%s\" is discarded.", filename);
+        if (truncate(filename, start) == -1) {
+            goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Truncate \"%s\": %s", cleanup,
+                       filename, strerror(errno));
+        }
+        SAFE_FREE(line);
+        size = start;
+        goto last_line;
+    }
+    goto_if_null2(jso, "Invalid last event in \"%s\".", r, TSS2_FAPI_RC_BAD_VALUE,
+                  cleanup, filename);
+
+    if (!ifapi_get_sub_object(jso, "recnum", &jso2)) {
+        goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Field \"recnum\" not found.", cleanup);
+    }
+    r = ifapi_json_UINT32_deserialize(jso2, recnum);
+    goto_if_error(r, "Bad value for field \"recnum\".", cleanup);
+
+cleanup:
+    if (jso)
+        json_object_put(jso);
+    SAFE_FREE(line);
+    fclose(stream);
+    return r;
+}
+
 /** Retrieve the eventlog for a given list of pcrs using asynchronous io.
  *
  * Call ifapi_eventlog_get_finish to retrieve the results.
@@ -124,7 +325,6 @@ ifapi_eventlog_get_finish(
 
     TSS2_RC r;
     char *event_log_file, *logstr;
-    json_object *logpart, *event;
 
     LOG_TRACE("called");
 
@@ -172,26 +372,10 @@ loop:
         return_try_again(r);
         return_if_error(r, "read_finish failed");
 
-        logpart = ifapi_parse_json(logstr);
+        /* Append the events of the pcr log to the eventlog */
+        r = eventlog_parse(logstr, eventlog->log);
         SAFE_FREE(logstr);
-        return_if_null(log, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
-
-        /* Append the log-entry from logpart to the eventlog */
-        json_type jso_type = json_object_get_type(logpart);
-        if (jso_type != json_type_array) {
-            /* libjson-c does not deliver an array if array has only one element */
-            json_object_array_add(eventlog->log, logpart);
-        } else {
-            /* Iterate through the array of logpart and add each item to the eventlog */
-            /* The return type of json_object_array_length() was changed, thus the case */
-            for (int i = 0; i < (int)json_object_array_length(logpart); i++) {
-                event = json_object_array_get_idx(logpart, i);
-                /* Increment the refcount of event so it does not get freed on put(logpart) below */
-                json_object_get(event);
-                json_object_array_add(eventlog->log, event);
-            }
-            json_object_put(logpart);
-        }
+        return_if_error(r, "Parse event log");
 
         eventlog->pcrListIdx += 1;
         eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
@@ -202,9 +386,64 @@ loop:
     return TSS2_RC_SUCCESS;
 }
 
+/** Prepare appending an event to the event log of a PCR.
+ *
+ * Only the last event of the log is read to determine the next record number.
+ * A log stored in the former format with one JSON array is read completely;
+ * it will be converted to the append-only format by
+ * ifapi_eventlog_append_finish.
+ * Call ifapi_eventlog_append_check afterwards.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ * @param[in,out] io The context area for the asynchronous io module.
+ * @param[in] pcr The PCR whose event log will be extended.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the event log could not be read.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the event log contains invalid data.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_eventlog_append_async(
+    IFAPI_EVENTLOG *eventlog,
+    IFAPI_IO *io,
+    TPM2_HANDLE pcr)
+{
+    check_not_null(eventlog);
+    check_not_null(io);
+
+    TSS2_RC r;
+    char *event_log_file;
+    bool legacy = false;
+
+    eventlog->recnum = 0;
+    eventlog->state = IFAPI_EVENTLOG_STATE_APPENDING;
+
+    /* Construct the filename for the eventlog file */
+    r = ifapi_asprintf(&event_log_file, "%s/%s%i",
+                       eventlog->log_dir, IFAPI_PCR_LOG_FILE, pcr);
+    return_if_error(r, "Out of memory.");
+
+    /* Check whether the event log has to be read. */
+    if (ifapi_io_path_exists(event_log_file)) {
+        r = eventlog_last_recnum(event_log_file, &legacy, &eventlog->recnum);
+        goto_if_error2(r, "Read last event of %s", cleanup, event_log_file);
+    }
+
+    if (legacy) {
+        r = ifapi_io_read_async(io, event_log_file);
+        goto_if_error2(r, "Read event log %s", cleanup, event_log_file);
+        eventlog->state = IFAPI_EVENTLOG_STATE_READING;
+    }
+
+cleanup:
+    SAFE_FREE(event_log_file);
+    return r;
+}
+
 /** Check event log format before appending an event to the existing event log.
  *
- * Call after ifapi_eventlog_get_async.
+ * Call after ifapi_eventlog_append_async.
  *
  * @param[in,out] eventlog The context area for the eventlog.
  * @param[in,out] io The context area for the asynchronous io module.
@@ -233,35 +472,35 @@ ifapi_eventlog_append_check(
 
     switch (eventlog->state) {
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_APPENDING)
-        /* No old log data can be read. */
-        eventlog->log = json_object_new_array();
-        return_if_null(eventlog->log, "Out of memory", TSS2_FAPI_RC_MEMORY);
+        /* The event can be appended to the log without reading it. */
+        eventlog->log = NULL;
 
         return TSS2_RC_SUCCESS;
 
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_READING)
-        /* Finish the reading of the eventlog file and return it directly to the output parameter */
+        /* Finish the reading of the eventlog file in the former format */
         r = ifapi_io_read_finish(io, (uint8_t **)&logstr, NULL);
         return_try_again(r);
         return_if_error(r, "read_finish failed");
 
-        /* If a log was read, we deserialize it to JSON. Otherwise we start a new log. */
+        eventlog->log = json_object_new_array();
+        if (!eventlog->log) {
+            SAFE_FREE(logstr);
+            LOG_ERROR("Out of memory");
+            return TSS2_FAPI_RC_MEMORY;
+        }
+
+        /* The events read will be rewritten in the append-only format. */
         if (logstr) {
-            eventlog->log = ifapi_parse_json(logstr);
+            r = eventlog_parse(logstr, eventlog->log);
             SAFE_FREE(logstr);
-            return_if_null(eventlog->log, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
-
-             /* libjson-c does not deliver an array if array has only one element */
-            json_type jso_type = json_object_get_type(eventlog->log);
-            if (jso_type != json_type_array) {
-                json_object *json_array = json_object_new_array();
-                json_object_array_add(json_array, eventlog->log);
-                eventlog->log = json_array;
+            if (r) {
+                json_object_put(eventlog->log);
+                eventlog->log = NULL;
+                return_if_error(r, "Parse event log");
             }
-        } else {
-            eventlog->log = json_object_new_array();
-            return_if_null(eventlog->log, "Out of memory", TSS2_FAPI_RC_MEMORY);
         }
+        eventlog->recnum = json_object_array_length(eventlog->log);
         break;
 
     statecasedefault(eventlog->state);
@@ -273,7 +512,11 @@ ifapi_eventlog_append_check(
 
 /** Append an event to the existing event log.
  *
- * Call after ifapi_eventlog_get_async.
+ * The event is serialized to one line which is appended to the log file.
+ * If the log was stored in the former format, the complete log is rewritten
+ * in the append-only format instead.
+ *
+ * Call after ifapi_eventlog_append_check.
  *
  * @param[in,out] eventlog The context area for the eventlog.
  * @param[in,out] io The context area for the asynchronous io module.
@@ -301,8 +544,9 @@ ifapi_eventlog_append_finish(
     check_not_null(pcr_event);
 
     TSS2_RC r;
-    char *event_log_file = NULL;
-    const char *logstr2 = NULL;
+    char *event_log_file = NULL, *logstr = NULL;
+    const char *eventstr;
+    size_t i, n, length;
     json_object *event = NULL;
 
     switch (eventlog->state) {
@@ -310,26 +554,57 @@ ifapi_eventlog_append_finish(
         eventlog->event = *pcr_event;
 
         /* Extend the eventlog with the data */
-        eventlog->event.recnum = json_object_array_length(eventlog->log) + 1;
+        eventlog->event.recnum = eventlog->recnum + 1;
 
         r = ifapi_json_IFAPI_EVENT_serialize(&eventlog->event, &event);
         if (r) {
             goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Error serializing event data", error_cleanup);
         }
 
-        json_object_array_add(eventlog->log, event);
-        logstr2 = json_object_to_json_string_ext(eventlog->log, JSON_C_TO_STRING_PRETTY);
-
         /* Construct the filename for the eventlog file */
         r = ifapi_asprintf(&event_log_file, "%s/%s%i",
                            eventlog->log_dir, IFAPI_PCR_LOG_FILE, eventlog->event.pcr);
         goto_if_error(r, "Create file name", error_cleanup);
 
-        /* Start writing the eventlog back to disk */
-        r = ifapi_io_write_async(io, event_log_file, (uint8_t *) logstr2, strlen(logstr2));
+        if (!eventlog->log) {
+            /* Append the event as one line to the log file */
+            r = ifapi_asprintf(&logstr, "%s\n",
+                               json_object_to_json_string_ext(event, JSON_C_TO_STRING_PLAIN));
+            goto_if_error(r, "Out of memory.", error_cleanup);
+            json_object_put(event);
+            event = NULL;
+
+            r = ifapi_io_append_async(io, event_log_file, (uint8_t *) logstr,
+                                      strlen(logstr), eventlog->sync);
+        } else {
+            /* Convert a log in the former format to one event per line */
+            json_object_array_add(eventlog->log, event);
+            event = NULL;
+
+            n = json_object_array_length(eventlog->log);
+            for (i = 0, length = 0; i < n; i++) {
+                eventstr = json_object_to_json_string_ext(
+                    json_object_array_get_idx(eventlog->log, i), JSON_C_TO_STRING_PLAIN);
+                length += strlen(eventstr) + 1;
+            }
+            logstr = malloc(length + 1);
+            goto_if_null2(logstr, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, error_cleanup);
+            for (i = 0, length = 0; i < n; i++) {
+                eventstr = json_object_to_json_string_ext(
+                    json_object_array_get_idx(eventlog->log, i), JSON_C_TO_STRING_PLAIN);
+                memcpy(&logstr[length], eventstr, strlen(eventstr));
+                length += strlen(eventstr);
+                logstr[length++] = '\n';
+            }
+            logstr[length] = '\0';
+            json_object_put(eventlog->log);
+            eventlog->log = NULL;
+
+            r = ifapi_io_write_async(io, event_log_file, (uint8_t *) logstr,
+                                     strlen(logstr));
+        }
         SAFE_FREE(event_log_file);
-        json_object_put(eventlog->log); /* this also frees logstr2 */
-        eventlog->log = NULL;
+        SAFE_FREE(logstr);
         goto_if_error(r, "write_async failed", error_cleanup);
         fallthrough;
 
@@ -337,8 +612,9 @@ ifapi_eventlog_append_finish(
         /* Finish writing the eventlog */
         r = ifapi_io_write_finish(io);
         return_try_again(r);
-        goto_if_error(r, "read_finish failed", error_cleanup);
+        goto_if_error(r, "write_finish failed", error_cleanup);
 
+        eventlog->recnum = eventlog->event.recnum;
         eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
         break;
 
@@ -349,8 +625,13 @@ ifapi_eventlog_append_finish(
 
  error_cleanup:
     SAFE_FREE(event_log_file);
-    if (eventlog->log)
+    SAFE_FREE(logstr);
+    if (event)
+        json_object_put(event);
+    if (eventlog->log) {
         json_object_put(eventlog->log);
+        eventlog->log = NULL;
+    }
     return r;
 }
 
@@ -6,6 +6,7 @@
 #ifndef IFAPI_EVENTLOG_H
 #define IFAPI_EVENTLOG_H
 
+#include <stdbool.h>
 #include <json-c/json.h>
 
 #include "tss2_tpm2_types.h"
@@ -58,7 +59,9 @@ enum IFAPI_EVENTLOG_STATE {
 typedef struct IFAPI_EVENTLOG {
     enum IFAPI_EVENTLOG_STATE state;
     char *log_dir;
+    bool sync;                  /**< Sync the log file to disk after each append */
     struct IFAPI_EVENT event;
+    UINT32 recnum;              /**< Number of the last event in the log to be appended */
     TPM2_HANDLE pcrList[TPM2_MAX_PCRS];
     size_t pcrListSize;
     size_t pcrListIdx;
@@ -68,7 +71,8 @@ typedef struct IFAPI_EVENTLOG {
 TSS2_RC
 ifapi_eventlog_initialize(
     IFAPI_EVENTLOG *eventlog,
-    const char *log_dir);
+    const char *log_dir,
+    bool sync);
 
 TSS2_RC
 ifapi_eventlog_get_async(
@@ -83,6 +87,12 @@ ifapi_eventlog_get_finish(
     IFAPI_IO *io,
     char **log);
 
+TSS2_RC
+ifapi_eventlog_append_async(
+    IFAPI_EVENTLOG *eventlog,
+    IFAPI_IO *io,
+    TPM2_HANDLE pcr);
+
 TSS2_RC
 ifapi_eventlog_append_check(
     IFAPI_EVENTLOG *eventlog,
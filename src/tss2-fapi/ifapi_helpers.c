@@ -1960,20 +1960,165 @@ error_cleanup:
     return r;
 }
 
-/** Check whether a event list corresponds to a certain quote information.
+/** Add the PCRs of a selection to the state of an event log replay.
  *
- * The event list is used to compute the PCR values corresponding
- * to this event list. The PCR digest for these PCRs is computed and compared
- * with the attest passed with quote_info.
+ * PCRs which are already part of the replay state are kept, new PCRs are
+ * initialized with zero and have not replayed any event yet.
  *
- * @param[in]  jso_event_list The event list in JSON representation.
+ * @param[in,out] replay The replay state.
+ * @param[in] pcr_selection The PCRs to be added.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if a bank of the selection is not supported.
+ */
+TSS2_RC
+ifapi_pcr_replay_select(
+    IFAPI_PCR_REPLAY *replay,
+    const TPML_PCR_SELECTION *pcr_selection)
+{
+    size_t i, j, pcr, hash_size;
+    IFAPI_PCR_REPLAY_VALUE *value;
+
+    for (i = 0; i < pcr_selection->count; i++) {
+        hash_size = ifapi_hash_get_digest_size(pcr_selection->pcrSelections[i].hash);
+        if (!hash_size) {
+            return_error2(TSS2_FAPI_RC_BAD_VALUE, "Unsupported PCR bank %"PRIx16,
+                          pcr_selection->pcrSelections[i].hash);
+        }
+        for (pcr = 0; pcr < TPM2_MAX_PCRS; pcr++) {
+            uint8_t byte_idx = pcr / 8;
+            uint8_t flag = 1 << (pcr % 8);
+            if (!(flag & pcr_selection->pcrSelections[i].pcrSelect[byte_idx]))
+                continue;
+
+            for (j = 0; j < replay->count; j++) {
+                if (replay->values[j].pcr == pcr &&
+                        replay->values[j].bank == pcr_selection->pcrSelections[i].hash)
+                    break;
+            }
+            if (j < replay->count)
+                continue;
+            if (replay->count == SIZE_OF_ARY(replay->values)) {
+                return_error(TSS2_FAPI_RC_BAD_VALUE, "Too many PCRs selected.");
+            }
+
+            value = &replay->values[replay->count++];
+            value->bank = pcr_selection->pcrSelections[i].hash;
+            value->pcr = pcr;
+            value->events = 0;
+            value->value.size = hash_size;
+            memset(&value->value.buffer[0], 0, hash_size);
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Replay the events of an event log.
+ *
+ * The event list may start at an arbitrary event of the complete log. Every
+ * PCR value of the replay state is extended with the events following the
+ * last event already replayed for this value. Afterwards all values contain
+ * the state after the last event of the list.
+ *
+ * @param[in,out] replay The replay state.
+ * @param[in] jso_event_list The event list in JSON representation. May be NULL
+ *            if no events were recorded.
+ * @param[in] log_offset The index of the first event of the list in the
+ *            complete event log.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the event list does not contain the
+ *         events following the replay state or an event is invalid.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an error occurs in the crypto library
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+TSS2_RC
+ifapi_pcr_replay_events(
+    IFAPI_PCR_REPLAY *replay,
+    json_object *jso_event_list,
+    size_t log_offset)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    size_t i, i_evt, n_events = 0, first_event = SIZE_MAX;
+    IFAPI_PCR_REPLAY_VALUE *value;
+    json_object *jso, *jso2;
+    TPM2_HANDLE pcr;
+    IFAPI_EVENT event;
+
+    /* Values to be extended for each PCR register */
+    size_t n_index[TPM2_MAX_PCRS] = { 0 };
+    IFAPI_PCR_REPLAY_VALUE *index[TPM2_MAX_PCRS][TPM2_NUM_PCR_BANKS];
+
+    memset(&event, 0, sizeof(IFAPI_EVENT));
+
+    if (jso_event_list)
+        n_events = json_object_array_length(jso_event_list);
+
+    for (i = 0; i < replay->count; i++) {
+        value = &replay->values[i];
+        if (value->events < log_offset || value->events > log_offset + n_events) {
+            return_error2(TSS2_FAPI_RC_BAD_VALUE, "Event log from event %zu to %zu"
+                          " does not continue replay of PCR %"PRIu32" at event %"PRIu64,
+                          log_offset, log_offset + n_events, value->pcr, value->events);
+        }
+        if (value->pcr >= TPM2_MAX_PCRS || n_index[value->pcr] == TPM2_NUM_PCR_BANKS ||
+                value->value.size != ifapi_hash_get_digest_size(value->bank)) {
+            return_error2(TSS2_FAPI_RC_BAD_VALUE, "Invalid value of PCR %"PRIu32,
+                          value->pcr);
+        }
+        index[value->pcr][n_index[value->pcr]++] = value;
+        if (value->events - log_offset < first_event)
+            first_event = value->events - log_offset;
+    }
+
+    for (i_evt = first_event; i_evt < n_events; i_evt++) {
+        jso = json_object_array_get_idx(jso_event_list, i_evt);
+
+        /* Only events of replayed PCRs have to be deserialized completely */
+        if (!ifapi_get_sub_object(jso, "pcr", &jso2)) {
+            return_error(TSS2_FAPI_RC_BAD_VALUE, "Field \"pcr\" not found.");
+        }
+        r = ifapi_json_TPM2_HANDLE_deserialize(jso2, &pcr);
+        return_if_error(r, "Bad value for field \"pcr\".");
+        if (pcr >= TPM2_MAX_PCRS || n_index[pcr] == 0)
+            continue;
+
+        r = ifapi_json_IFAPI_EVENT_deserialize(jso, &event);
+        goto_if_error(r, "Error serialize policy", error_cleanup);
+
+        for (i = 0; i < n_index[pcr]; i++) {
+            value = index[pcr][i];
+            if (value->events > log_offset + i_evt)
+                continue;
+            r = ifapi_extend_vpcr(&value->value, value->bank, &event);
+            goto_if_error2(r, "Extending vpcr %"PRIu32, error_cleanup, pcr);
+        }
+        ifapi_cleanup_event(&event);
+    }
+
+    for (i = 0; i < replay->count; i++)
+        replay->values[i].events = log_offset + n_events;
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    ifapi_cleanup_event(&event);
+    return r;
+}
+
+/** Check whether a replay state corresponds to a certain quote information.
+ *
+ * The PCR digest for the PCRs of the quote is computed from the replayed PCR
+ * values and compared with the attest passed with quote_info. All PCRs of
+ * the quote must be part of the replay state.
+ *
+ * @param[in]  replay The replay state.
  * @param[in]  quote_info The information structure with the attest.
  * @param[out] pcr_digest The computed pcr_digest for the PCRs uses by FAPI.
  *
- * @retval TSS2_RC_SUCCESS: If the PCR digest from the event list matches
+ * @retval TSS2_RC_SUCCESS: If the PCR digest from the replay state matches
  *         the PCR digest passed with the quote_info.
  * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED: If the digest computed
- *         from event list does not match the attest
+ *         from the replay state does not match the attest
  * @retval TSS2_FAPI_RC_BAD_VALUE: If inappropriate values are detected in the
  *         input data.
  * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
@@ -1981,24 +2126,14 @@ error_cleanup:
  * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
  */
 TSS2_RC
-ifapi_calculate_pcr_digest(
-    json_object *jso_event_list,
+ifapi_pcr_replay_digest(
+    const IFAPI_PCR_REPLAY *replay,
     const FAPI_QUOTE_INFO *quote_info,
     TPM2B_DIGEST *pcr_digest)
 {
     TSS2_RC r;
     IFAPI_CRYPTO_CONTEXT_BLOB *cryptoContext = NULL;
-
-    struct {
-        TPMI_ALG_HASH bank;
-        TPM2_HANDLE pcr;
-        TPM2B_DIGEST value;
-    } pcrs[TPM2_MAX_PCRS];
-    size_t i, pcr, i_evt, hash_size, n_pcrs = 0, n_events = 0;
-
-    json_object *jso;
-    IFAPI_EVENT event;
-
+    size_t i, j, pcr, hash_size;
     const TPML_PCR_SELECTION *pcr_selection;
     TPMI_ALG_HASH pcr_digest_hash_alg;
 
@@ -2021,48 +2156,30 @@ ifapi_calculate_pcr_digest(
         return TSS2_FAPI_RC_BAD_VALUE;
     }
 
-    /* Initialize used pcrs */
+    /* Compute digest for the used pcrs */
+    r = ifapi_crypto_hash_start(&cryptoContext, pcr_digest_hash_alg);
+    return_if_error(r, "crypto hash start");
+
     for (i = 0; i < pcr_selection->count; i++) {
         for (pcr = 0; pcr < TPM2_MAX_PCRS; pcr++) {
             uint8_t byte_idx = pcr / 8;
             uint8_t flag = 1 << (pcr % 8);
-            if (flag & pcr_selection->pcrSelections[i].pcrSelect[byte_idx]) {
-                hash_size = ifapi_hash_get_digest_size(pcr_selection->pcrSelections[i].hash);
-                pcrs[n_pcrs].pcr = pcr;
-                pcrs[n_pcrs].bank = pcr_selection->pcrSelections[i].hash;
-                pcrs[n_pcrs].value.size = hash_size;
-                memset(&pcrs[n_pcrs].value.buffer[0], 0, hash_size);
-                n_pcrs += 1;
-            }
-        }
-    }
+            if (!(flag & pcr_selection->pcrSelections[i].pcrSelect[byte_idx]))
+                continue;
 
-    /* Compute pcr values based on event list */
-    if (jso_event_list) {
-        n_events = json_object_array_length(jso_event_list);
-        for (i_evt = 0; i_evt < n_events; i_evt++) {
-            jso = json_object_array_get_idx(jso_event_list, i_evt);
-            r = ifapi_json_IFAPI_EVENT_deserialize(jso, &event);
-            goto_if_error(r, "Error serialize policy", error_cleanup);
-
-            for (i = 0; i < n_pcrs; i++) {
-                if (pcrs[i].pcr == event.pcr) {
-                    r = ifapi_extend_vpcr(&pcrs[i].value, pcrs[i].bank, &event);
-                    goto_if_error2(r, "Extending vpcr %"PRIu32, error_cleanup, pcrs[i].pcr);
-                }
+            for (j = 0; j < replay->count; j++) {
+                if (replay->values[j].pcr == pcr &&
+                        replay->values[j].bank == pcr_selection->pcrSelections[i].hash)
+                    break;
+            }
+            if (j == replay->count) {
+                goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "PCR %zu was not replayed.",
+                           error_cleanup, pcr);
             }
-            ifapi_cleanup_event(&event);
+            HASH_UPDATE_BUFFER(cryptoContext, &replay->values[j].value.buffer[0],
+                               replay->values[j].value.size, r, error_cleanup);
         }
     }
-
-    /* Compute digest for the used pcrs */
-    r = ifapi_crypto_hash_start(&cryptoContext, pcr_digest_hash_alg);
-    return_if_error(r, "crypto hash start");
-
-    for (i = 0; i < n_pcrs; i++) {
-        HASH_UPDATE_BUFFER(cryptoContext, &pcrs[i].value.buffer, pcrs[i].value.size,
-                           r, error_cleanup);
-    }
     r = ifapi_crypto_hash_finish(&cryptoContext,
                                  (uint8_t *) &pcr_digest->buffer[0],
                                  &hash_size);
@@ -2070,8 +2187,10 @@ ifapi_calculate_pcr_digest(
     pcr_digest->size = hash_size;
 
     /* Compare the digest from the event list with the digest from the attest */
-    if (memcmp(&pcr_digest->buffer[0], &quote_info->attest.attested.quote.pcrDigest.buffer[0],
-               pcr_digest->size) != 0) {
+    if (pcr_digest->size != quote_info->attest.attested.quote.pcrDigest.size ||
+            memcmp(&pcr_digest->buffer[0],
+                   &quote_info->attest.attested.quote.pcrDigest.buffer[0],
+                   pcr_digest->size) != 0) {
         goto_error(r, TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED,
                    "The digest computed from event list does not match the attest.",
                    error_cleanup);
@@ -2080,7 +2199,52 @@ ifapi_calculate_pcr_digest(
 error_cleanup:
     if (cryptoContext)
         ifapi_crypto_hash_abort(&cryptoContext);
-    ifapi_cleanup_event(&event);
+    return r;
+}
+
+/** Check whether a event list corresponds to a certain quote information.
+ *
+ * The event list is used to compute the PCR values corresponding
+ * to this event list. The PCR digest for these PCRs is computed and compared
+ * with the attest passed with quote_info.
+ *
+ * @param[in]  jso_event_list The event list in JSON representation.
+ * @param[in]  quote_info The information structure with the attest.
+ * @param[out] pcr_digest The computed pcr_digest for the PCRs uses by FAPI.
+ *
+ * @retval TSS2_RC_SUCCESS: If the PCR digest from the event list matches
+ *         the PCR digest passed with the quote_info.
+ * @retval TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED: If the digest computed
+ *         from event list does not match the attest
+ * @retval TSS2_FAPI_RC_BAD_VALUE: If inappropriate values are detected in the
+ *         input data.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+TSS2_RC
+ifapi_calculate_pcr_digest(
+    json_object *jso_event_list,
+    const FAPI_QUOTE_INFO *quote_info,
+    TPM2B_DIGEST *pcr_digest)
+{
+    TSS2_RC r;
+    IFAPI_PCR_REPLAY *replay;
+
+    replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    return_if_null(replay, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+
+    r = ifapi_pcr_replay_select(replay, &quote_info->attest.attested.quote.pcrSelect);
+    goto_if_error(r, "Select PCRs", cleanup);
+
+    r = ifapi_pcr_replay_events(replay, jso_event_list, 0);
+    goto_if_error(r, "Replay event list", cleanup);
+
+    r = ifapi_pcr_replay_digest(replay, quote_info, pcr_digest);
+    goto_if_error(r, "Verify PCR digest", cleanup);
+
+cleanup:
+    free(replay);
     return r;
 }
 
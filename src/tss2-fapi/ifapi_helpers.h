@@ -165,6 +165,23 @@ TSS2_RC ifapi_calculate_pcr_digest(
     const FAPI_QUOTE_INFO *quote_info,
     TPM2B_DIGEST *pcr_digest);
 
+TSS2_RC
+ifapi_pcr_replay_select(
+    IFAPI_PCR_REPLAY *replay,
+    const TPML_PCR_SELECTION *pcr_selection);
+
+TSS2_RC
+ifapi_pcr_replay_events(
+    IFAPI_PCR_REPLAY *replay,
+    json_object *jso_event_list,
+    size_t log_offset);
+
+TSS2_RC
+ifapi_pcr_replay_digest(
+    const IFAPI_PCR_REPLAY *replay,
+    const FAPI_QUOTE_INFO *quote_info,
+    TPM2B_DIGEST *pcr_digest);
+
 TSS2_RC
 ifapi_compute_policy_digest(
     TPML_PCRVALUES *pcrs,
@@ -189,19 +189,23 @@ ifapi_io_read_finish(
 /** Start writing a buffer into a file in an asynchronous way.
  *
  * @param[in,out] io The input/output context being used for file I/O.
- * @param[in] filename The name of the file to be read into memory.
+ * @param[in] filename The name of the file to be written.
  * @param[in] buffer The buffer to be written.
  * @param[in] length The number of bytes to be written.
+ * @param[in] mode The fopen mode; "wt" to replace the file, "at" to append to it.
+ * @param[in] sync Whether the data shall be flushed to disk before the write is finished.
  * @retval TSS2_RC_SUCCESS: if the function call was a success.
  * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered; such as the file was not found.
  * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
  */
-TSS2_RC
-ifapi_io_write_async(
+static TSS2_RC
+io_write_mode_async(
     struct IFAPI_IO *io,
     const char *filename,
     const uint8_t *buffer,
-    size_t length)
+    size_t length,
+    const char *mode,
+    bool sync)
 {
     TSS2_RC r;
     struct flock flock = { 0 };
@@ -219,8 +223,9 @@ ifapi_io_write_async(
         return TSS2_FAPI_RC_MEMORY;
     }
     memcpy(io->char_rbuffer, buffer, length);
+    io->sync = sync;
 
-    io->stream = fopen(filename, "wt");
+    io->stream = fopen(filename, mode);
     if (io->stream == NULL) {
         goto_error(r, TSS2_FAPI_RC_IO_ERROR,
                    "Open file \"%s\" for writing: %s", error, filename,
@@ -257,6 +262,54 @@ ifapi_io_write_async(
     return r;
 }
 
+/** Start writing a buffer into a file in an asynchronous way.
+ *
+ * An existing file will be replaced.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] filename The name of the file to be written.
+ * @param[in] buffer The buffer to be written.
+ * @param[in] length The number of bytes to be written.
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered; such as the file was not found.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
+ */
+TSS2_RC
+ifapi_io_write_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length)
+{
+    return io_write_mode_async(io, filename, buffer, length, "wt", false);
+}
+
+/** Start appending a buffer to a file in an asynchronous way.
+ *
+ * The file will be created if it does not exist. Call ifapi_io_write_finish
+ * to complete the operation.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] filename The name of the file to be appended to.
+ * @param[in] buffer The buffer to be written.
+ * @param[in] length The number of bytes to be written.
+ * @param[in] sync If true the file is synced to disk before ifapi_io_write_finish
+ *            returns success.
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the data.
+ */
+TSS2_RC
+ifapi_io_append_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length,
+    bool sync)
+{
+    return io_write_mode_async(io, filename, buffer, length, "at", sync);
+}
+
 /** Finish writing a buffer into a file in an asynchronous way.
  *
  * This function needs to be called repeatedly until it does not return TSS2_FAPI_RC_TRY_AGAIN.
@@ -296,6 +349,16 @@ ifapi_io_write_finish(
     if (io->buffer_idx < io->buffer_length)
         return TSS2_FAPI_RC_TRY_AGAIN;
 
+    if (io->sync) {
+        io->sync = false;
+        if (fsync(fileno(io->stream)) == -1) {
+            LOG_ERROR("Error syncing file: %i.", errno);
+            fclose(io->stream);
+            SAFE_FREE(io->char_rbuffer);
+            return TSS2_FAPI_RC_IO_ERROR;
+        }
+    }
+
     SAFE_FREE(io->char_rbuffer);
     fclose(io->stream);
 
@@ -580,6 +643,9 @@ dirfiles_all(const char *dir_name, NODE_OBJECT_T **list, size_t *n)
                 closedir(dir);
             return_if_error(r, "get_entities");
 
+        } else if (entry->d_name[0] == '.') {
+            /* Hidden files like the keystore index are no objects. */
+            continue;
         } else {
             r = ifapi_asprintf(&path, "%s/%s", dir_name, entry->d_name);
             if (r)
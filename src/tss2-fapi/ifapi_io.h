@@ -19,6 +19,7 @@ typedef struct IFAPI_IO {
     char *char_rbuffer;
     size_t buffer_length;
     size_t buffer_idx;
+    bool sync;
 } IFAPI_IO;
 
 #ifdef TEST_FAPI_ASYNC
@@ -53,6 +54,14 @@ ifapi_io_write_async(
     const uint8_t *buffer,
     size_t length);
 
+TSS2_RC
+ifapi_io_append_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length,
+    bool sync);
+
 TSS2_RC
 ifapi_io_write_finish(
     struct IFAPI_IO *io);
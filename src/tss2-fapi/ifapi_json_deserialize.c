@@ -976,3 +976,95 @@ ifapi_json_IFAPI_EVENT_deserialize(json_object *jso,  IFAPI_EVENT *out)
     LOG_TRACE("true");
     return TSS2_RC_SUCCESS;
 }
+
+static char *field_IFAPI_PCR_REPLAY_VALUE_tab[] = {
+    "bank",
+    "pcr",
+    "events",
+    "value"
+};
+
+/** Deserialize a IFAPI_PCR_REPLAY_VALUE json object.
+ *
+ * @param[in]  jso the json object to be deserialized.
+ * @param[out] out the deserialzed binary object.
+ * @retval TSS2_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the json object can't be deserialized.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_VALUE_deserialize(json_object *jso,
+        IFAPI_PCR_REPLAY_VALUE *out)
+{
+    json_object *jso2;
+    TSS2_RC r;
+    LOG_TRACE("call");
+    return_if_null(out, "Bad reference.", TSS2_FAPI_RC_BAD_REFERENCE);
+
+    ifapi_check_json_object_fields(jso, &field_IFAPI_PCR_REPLAY_VALUE_tab[0],
+                                   SIZE_OF_ARY(field_IFAPI_PCR_REPLAY_VALUE_tab));
+    if (!ifapi_get_sub_object(jso, "bank", &jso2)) {
+        LOG_ERROR("Field \"bank\" not found.");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    r = ifapi_json_TPMI_ALG_HASH_deserialize(jso2, &out->bank);
+    return_if_error(r, "Bad value for field \"bank\".");
+
+    if (!ifapi_get_sub_object(jso, "pcr", &jso2)) {
+        LOG_ERROR("Field \"pcr\" not found.");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    r = ifapi_json_TPM2_HANDLE_deserialize(jso2, &out->pcr);
+    return_if_error(r, "Bad value for field \"pcr\".");
+
+    if (!ifapi_get_sub_object(jso, "events", &jso2)) {
+        LOG_ERROR("Field \"events\" not found.");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    r = ifapi_json_UINT64_deserialize(jso2, &out->events);
+    return_if_error(r, "Bad value for field \"events\".");
+
+    if (!ifapi_get_sub_object(jso, "value", &jso2)) {
+        LOG_ERROR("Field \"value\" not found.");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    r = ifapi_json_TPM2B_DIGEST_deserialize(jso2, &out->value);
+    return_if_error(r, "Bad value for field \"value\".");
+    LOG_TRACE("true");
+    return TSS2_RC_SUCCESS;
+}
+
+/** Deserialize a IFAPI_PCR_REPLAY json object.
+ *
+ * @param[in]  jso the json object to be deserialized.
+ * @param[out] out the deserialzed binary object.
+ * @retval TSS2_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the json object can't be deserialized.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_deserialize(json_object *jso, IFAPI_PCR_REPLAY *out)
+{
+    TSS2_RC r;
+    LOG_TRACE("call");
+    return_if_null(out, "Bad reference.", TSS2_FAPI_RC_BAD_REFERENCE);
+
+    if (json_object_get_type(jso) != json_type_array) {
+        LOG_ERROR("BAD VALUE");
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    /* Cast (size_t) is necessary to support older version of libjson-c */
+    if ((size_t)json_object_array_length(jso) > SIZE_OF_ARY(out->values)) {
+        LOG_ERROR("Too many PCR values (%zu > %zu)",
+                  (size_t)json_object_array_length(jso), SIZE_OF_ARY(out->values));
+        return TSS2_FAPI_RC_BAD_VALUE;
+    }
+    out->count = json_object_array_length(jso);
+    for (size_t i = 0; i < out->count; i++) {
+        json_object *jso2 = json_object_array_get_idx(jso, i);
+        r = ifapi_json_IFAPI_PCR_REPLAY_VALUE_deserialize(jso2, &out->values[i]);
+        return_if_error(r, "Bad value for PCR replay value.");
+    }
+    LOG_TRACE("true");
+    return TSS2_RC_SUCCESS;
+}
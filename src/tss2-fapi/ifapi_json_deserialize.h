@@ -74,4 +74,11 @@ ifapi_json_IFAPI_EVENT_UNION_deserialize(UINT32 selector, json_object *jso,
 TSS2_RC
 ifapi_json_IFAPI_EVENT_deserialize(json_object *jso, IFAPI_EVENT *out);
 
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_VALUE_deserialize(json_object *jso,
+        IFAPI_PCR_REPLAY_VALUE *out);
+
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_deserialize(json_object *jso, IFAPI_PCR_REPLAY *out);
+
 #endif /* IFAPI_JSON_DESERIALIZE_H */
@@ -589,6 +589,53 @@ ifapi_json_IFAPI_CAP_INFO_serialize(const IFAPI_CAP_INFO *in, json_object **jso)
     return TSS2_RC_SUCCESS;
 }
 
+/** Serialize value of type IFAPI_CACHE_STATS to json.
+ *
+ * @param[in] in value to be serialized.
+ * @param[out] jso pointer to the json object.
+ * @retval TSS2_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_json_IFAPI_CACHE_STATS_serialize(const IFAPI_CACHE_STATS *in, json_object **jso)
+{
+    return_if_null(in, "Bad reference.", TSS2_FAPI_RC_BAD_REFERENCE);
+
+    TSS2_RC r;
+    json_object *jso2;
+
+    if (*jso == NULL)
+        *jso = json_object_new_object();
+    jso2 = NULL;
+    r = ifapi_json_UINT32_serialize(in->size, &jso2);
+    return_if_error(r, "Serialize UINT32");
+
+    json_object_object_add(*jso, "size", jso2);
+    jso2 = NULL;
+    r = ifapi_json_UINT32_serialize(in->entries, &jso2);
+    return_if_error(r, "Serialize UINT32");
+
+    json_object_object_add(*jso, "entries", jso2);
+    jso2 = NULL;
+    r = ifapi_json_UINT64_serialize(in->hits, &jso2);
+    return_if_error(r, "Serialize UINT64");
+
+    json_object_object_add(*jso, "hits", jso2);
+    jso2 = NULL;
+    r = ifapi_json_UINT64_serialize(in->misses, &jso2);
+    return_if_error(r, "Serialize UINT64");
+
+    json_object_object_add(*jso, "misses", jso2);
+    jso2 = NULL;
+    r = ifapi_json_UINT64_serialize(in->evictions, &jso2);
+    return_if_error(r, "Serialize UINT64");
+
+    json_object_object_add(*jso, "evictions", jso2);
+
+    return TSS2_RC_SUCCESS;
+}
+
 /** Serialize value of type IFAPI_INFO to json.
  *
  * @param[in] in value to be serialized.
@@ -632,6 +679,12 @@ ifapi_json_IFAPI_INFO_serialize(const IFAPI_INFO *in, json_object **jso)
     }
     json_object_object_add(*jso, "capabilities", jso_cap_list);
 
+    jso2 = NULL;
+    r = ifapi_json_IFAPI_CACHE_STATS_serialize(&in->object_cache, &jso2);
+    return_if_error(r, "Serialize IFAPI_CACHE_STATS");
+
+    json_object_object_add(*jso, "object_cache", jso2);
+
     return TSS2_RC_SUCCESS;
 }
 
@@ -943,5 +996,116 @@ ifapi_json_IFAPI_CONFIG_serialize(const IFAPI_CONFIG *in, json_object **jso)
 
      json_object_object_add(*jso, "intel_cert_service", jso2);
 
+     jso2 = NULL;
+     r = ifapi_json_TPMI_YES_NO_serialize(in->eventlog_sync, &jso2);
+     return_if_error(r, "Serialize yes no");
+
+     json_object_object_add(*jso, "eventlog_sync", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->object_cache_size, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "object_cache_size", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->session_pool_size, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "session_pool_size", jso2);
+
      return TSS2_RC_SUCCESS;
  }
+
+/** Serialize value of type IFAPI_PCR_REPLAY_VALUE to json.
+ *
+ * @param[in] in value to be serialized.
+ * @param[out] jso pointer to the json object.
+ * @retval TSS2_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the value is not of type IFAPI_PCR_REPLAY_VALUE.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_VALUE_serialize(const IFAPI_PCR_REPLAY_VALUE *in,
+        json_object **jso)
+{
+    return_if_null(in, "Bad reference.", TSS2_FAPI_RC_BAD_REFERENCE);
+
+    TSS2_RC r;
+    json_object *bank = NULL;
+    json_object *pcr = NULL;
+    json_object *events = NULL;
+    json_object *value = NULL;
+
+    r = ifapi_json_TPMI_ALG_HASH_serialize(in->bank, &bank);
+    goto_if_error(r, "Serialize TPMI_ALG_HASH", error_cleanup);
+
+    r = ifapi_json_TPM2_HANDLE_serialize(in->pcr, &pcr);
+    goto_if_error(r, "Serialize TPM2_HANDLE", error_cleanup);
+
+    r = ifapi_json_UINT64_serialize(in->events, &events);
+    goto_if_error(r, "Serialize UINT64", error_cleanup);
+
+    r = ifapi_json_TPM2B_DIGEST_serialize(&in->value, &value);
+    goto_if_error(r, "Serialize TPM2B_DIGEST", error_cleanup);
+
+    if (*jso == NULL) {
+        *jso = json_object_new_object();
+        if (!*jso) {
+            goto_error(r, TSS2_FAPI_RC_MEMORY, "OOM", error_cleanup);
+        }
+    }
+
+    json_object_object_add(*jso, "bank", bank);
+    json_object_object_add(*jso, "pcr", pcr);
+    json_object_object_add(*jso, "events", events);
+    json_object_object_add(*jso, "value", value);
+
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    if (bank)
+        json_object_put(bank);
+    if (pcr)
+        json_object_put(pcr);
+    if (events)
+        json_object_put(events);
+    if (value)
+        json_object_put(value);
+    return r;
+}
+
+/** Serialize value of type IFAPI_PCR_REPLAY to json.
+ *
+ * @param[in] in value to be serialized.
+ * @param[out] jso pointer to the json object.
+ * @retval TSS2_RC_SUCCESS if the function call was a success.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the value is not of type IFAPI_PCR_REPLAY.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_serialize(const IFAPI_PCR_REPLAY *in,
+        json_object **jso)
+{
+    return_if_null(in, "Bad reference.", TSS2_FAPI_RC_BAD_REFERENCE);
+
+    TSS2_RC r;
+
+    *jso = json_object_new_array();
+    return_if_null(*jso, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+
+    for (size_t i = 0; i < in->count; i++) {
+        json_object *jso2 = NULL;
+        r = ifapi_json_IFAPI_PCR_REPLAY_VALUE_serialize(&in->values[i], &jso2);
+        if (r) {
+            json_object_put(*jso);
+            *jso = NULL;
+        }
+        return_if_error(r, "Serialize IFAPI_PCR_REPLAY_VALUE");
+
+        json_object_array_add(*jso, jso2);
+    }
+    return TSS2_RC_SUCCESS;
+}
@@ -51,6 +51,9 @@ ifapi_json_IFAPI_DUPLICATE_serialize(const IFAPI_DUPLICATE *in,
 TSS2_RC
 ifapi_json_IFAPI_CAP_INFO_serialize(const IFAPI_CAP_INFO *in, json_object **jso);
 
+TSS2_RC
+ifapi_json_IFAPI_CACHE_STATS_serialize(const IFAPI_CACHE_STATS *in, json_object **jso);
+
 TSS2_RC
 ifapi_json_IFAPI_INFO_serialize(const IFAPI_INFO *in, json_object **jso);
 
@@ -81,4 +84,12 @@ ifapi_json_IFAPI_EVENT_serialize(const IFAPI_EVENT *in, json_object **jso);
 TSS2_RC
 ifapi_json_IFAPI_CONFIG_serialize(const IFAPI_CONFIG *in, json_object **jso);
 
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_VALUE_serialize(const IFAPI_PCR_REPLAY_VALUE *in,
+        json_object **jso);
+
+TSS2_RC
+ifapi_json_IFAPI_PCR_REPLAY_serialize(const IFAPI_PCR_REPLAY *in,
+        json_object **jso);
+
 #endif /* IFAPI_JSON_SERIALIZE_H */
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_key_cache.h"
+
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** Find the cache entry of a key path.
+ *
+ * @param[in] cache The key cache.
+ * @param[in] path The keystore path of the key.
+ * @retval The index of the entry or cache->count if the path is not cached.
+ */
+static size_t
+key_cache_find(IFAPI_KEY_CACHE *cache, const char *path)
+{
+    size_t i;
+
+    for (i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].path, path) == 0)
+            break;
+    }
+    return i;
+}
+
+/** Remove an entry from the key cache.
+ *
+ * @param[in,out] cache The key cache.
+ * @param[in] idx The index of the entry.
+ */
+static void
+key_cache_delete(IFAPI_KEY_CACHE *cache, size_t idx)
+{
+    SAFE_FREE(cache->entries[idx].path);
+    SAFE_FREE(cache->entries[idx].private.buffer);
+    SAFE_FREE(cache->entries[idx].context);
+    cache->count -= 1;
+    cache->entries[idx] = cache->entries[cache->count];
+}
+
+/** Get the saved context of a parent key.
+ *
+ * The context is only returned if the cached key still has the passed name
+ * and private blob, i.e. the key at the path was neither replaced by another
+ * key nor got a new authValue by a ChangeAuth, possibly in another process.
+ *
+ * @param[in,out] cache The key cache.
+ * @param[in] path The keystore path of the key.
+ * @param[in] name The name of the key stored in the keystore.
+ * @param[in] private The private blob of the key stored in the keystore.
+ * @retval The saved context owned by the cache or NULL if the key is not cached.
+ */
+TPMS_CONTEXT *
+ifapi_key_cache_lookup(
+    IFAPI_KEY_CACHE *cache,
+    const char *path,
+    const TPM2B_NAME *name,
+    const UINT8_ARY *private)
+{
+    size_t idx = key_cache_find(cache, path);
+    IFAPI_KEY_CACHE_ENTRY *entry;
+
+    if (idx == cache->count)
+        return NULL;
+
+    entry = &cache->entries[idx];
+    if (entry->name.size != name->size ||
+        memcmp(&entry->name.name[0], &name->name[0], name->size) != 0 ||
+        entry->private.size != private->size ||
+        (private->size > 0 &&
+         memcmp(entry->private.buffer, private->buffer, private->size) != 0)) {
+        LOG_DEBUG("Key %s was changed.", path);
+        key_cache_delete(cache, idx);
+        return NULL;
+    }
+    cache->entries[idx].last_use = ++cache->clock;
+    return cache->entries[idx].context;
+}
+
+/** Store the saved context of a parent key.
+ *
+ * An existing context of the path is replaced. If the cache is full, the
+ * least recently used context is dropped.
+ *
+ * @param[in,out] cache The key cache.
+ * @param[in] path The keystore path of the key.
+ * @param[in] name The name of the key.
+ * @param[in] private The private blob of the key, empty for primary keys.
+ * @param[in] context The context returned by Esys_ContextSave. The cache takes
+ *            the ownership of the context.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if the path or the private blob can't be copied.
+ */
+TSS2_RC
+ifapi_key_cache_insert(
+    IFAPI_KEY_CACHE *cache,
+    const char *path,
+    const TPM2B_NAME *name,
+    const UINT8_ARY *private,
+    TPMS_CONTEXT *context)
+{
+    IFAPI_KEY_CACHE_ENTRY *entry;
+    size_t idx = key_cache_find(cache, path);
+    char *path_copy = strdup(path);
+    uint8_t *private_copy = NULL;
+
+    if (private->size > 0)
+        private_copy = malloc(private->size);
+    if (!path_copy || (private->size > 0 && !private_copy)) {
+        SAFE_FREE(path_copy);
+        SAFE_FREE(context);
+        return_error(TSS2_FAPI_RC_MEMORY, "Out of memory.");
+    }
+    if (private_copy)
+        memcpy(private_copy, private->buffer, private->size);
+
+    if (idx < cache->count) {
+        key_cache_delete(cache, idx);
+    } else if (cache->count == IFAPI_KEY_CACHE_SIZE) {
+        idx = 0;
+        for (size_t i = 1; i < cache->count; i++) {
+            if (cache->entries[i].last_use < cache->entries[idx].last_use)
+                idx = i;
+        }
+        key_cache_delete(cache, idx);
+    }
+
+    entry = &cache->entries[cache->count++];
+    entry->path = path_copy;
+    entry->name = *name;
+    entry->private.size = private->size;
+    entry->private.buffer = private_copy;
+    entry->context = context;
+    entry->last_use = ++cache->clock;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Drop the saved context of a key.
+ *
+ * Used if the context can't be loaded anymore.
+ *
+ * @param[in,out] cache The key cache.
+ * @param[in] path The keystore path of the key.
+ */
+void
+ifapi_key_cache_remove(
+    IFAPI_KEY_CACHE *cache,
+    const char *path)
+{
+    size_t idx = key_cache_find(cache, path);
+
+    if (idx < cache->count)
+        key_cache_delete(cache, idx);
+}
+
+/** Drop all saved contexts of the key cache.
+ *
+ * @param[in,out] cache The key cache.
+ */
+void
+ifapi_key_cache_clear(IFAPI_KEY_CACHE *cache)
+{
+    while (cache->count > 0)
+        key_cache_delete(cache, cache->count - 1);
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+#ifndef IFAPI_KEY_CACHE_H
+#define IFAPI_KEY_CACHE_H
+
+#include "tss2_tpm2_types.h"
+#include "fapi_types.h"
+
+/** The maximal number of parent keys whose context is kept by FAPI.
+ */
+#define IFAPI_KEY_CACHE_SIZE 8
+
+/** The saved context of a loaded parent key.
+ */
+typedef struct {
+    char                                          *path;    /**< The keystore path of the key */
+    TPM2B_NAME                                     name;    /**< The name of the key */
+    UINT8_ARY                                   private;    /**< The private blob the key was loaded from */
+    TPMS_CONTEXT                               *context;    /**< The context saved by Esys_ContextSave */
+    UINT64                                     last_use;    /**< Counter for the last use of the key */
+} IFAPI_KEY_CACHE_ENTRY;
+
+/** The cache of saved parent key contexts.
+ *
+ * Loading a key requires loading all its parents. Their contexts are saved
+ * once they are loaded, such that a key can be loaded later with one
+ * TPM2_ContextLoad of its parent instead of reloading the parent chain.
+ */
+typedef struct {
+    IFAPI_KEY_CACHE_ENTRY  entries[IFAPI_KEY_CACHE_SIZE];   /**< The cached contexts */
+    size_t                                        count;    /**< The number of cached contexts */
+    UINT64                                        clock;    /**< Counter for the last use of keys */
+} IFAPI_KEY_CACHE;
+
+TPMS_CONTEXT *
+ifapi_key_cache_lookup(
+    IFAPI_KEY_CACHE *cache,
+    const char *path,
+    const TPM2B_NAME *name,
+    const UINT8_ARY *private);
+
+TSS2_RC
+ifapi_key_cache_insert(
+    IFAPI_KEY_CACHE *cache,
+    const char *path,
+    const TPM2B_NAME *name,
+    const UINT8_ARY *private,
+    TPMS_CONTEXT *context);
+
+void
+ifapi_key_cache_remove(
+    IFAPI_KEY_CACHE *cache,
+    const char *path);
+
+void
+ifapi_key_cache_clear(
+    IFAPI_KEY_CACHE *cache);
+
+#endif /* IFAPI_KEY_CACHE_H */
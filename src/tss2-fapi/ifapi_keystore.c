@@ -10,6 +10,12 @@
 #include <ctype.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
 #include "ifapi_io.h"
 #include "ifapi_helpers.h"
 #include "ifapi_keystore.h"
@@ -401,6 +407,529 @@ expand_path_to_object(
     return r;
 }
 
+/** Create the key of the name index for a TPM name.
+ *
+ * @param[in] name The TPM name of the object.
+ * @param[out] key The caller allocated key of size IFAPI_INDEX_KEY_SIZE.
+ */
+static void
+keystore_index_key_name(const TPM2B_NAME *name, char *key)
+{
+    size_t i, pos = sprintf(key, "name=");
+
+    for (i = 0; i < name->size && i < sizeof(TPMU_NAME); i++)
+        pos += sprintf(&key[pos], "%02x", name->name[i]);
+}
+
+/** Create the key of the name index for a NV index.
+ *
+ * @param[in] nv_index The NV index of the object.
+ * @param[out] key The caller allocated key of size IFAPI_INDEX_KEY_SIZE.
+ */
+static void
+keystore_index_key_nv(TPMI_RH_NV_INDEX nv_index, char *key)
+{
+    sprintf(key, "nv=%08"PRIx32, nv_index);
+}
+
+/** Create an entry of the name index for a keystore object.
+ *
+ * An entry consists of the relative path of the object followed by the keys
+ * the object can be searched for. An entry without keys marks the path as
+ * removed.
+ *
+ * @param[in] path The relative path of the object.
+ * @param[in] object The object or NULL if the object was removed.
+ * @param[out] entry The line to be added to the index (callee-allocated).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+keystore_index_entry(const char *path, IFAPI_OBJECT *object, char **entry)
+{
+    TSS2_RC r;
+    TPM2B_NAME nv_name;
+    char name_key[IFAPI_INDEX_KEY_SIZE] = "";
+    char nv_key[IFAPI_INDEX_KEY_SIZE] = "";
+
+    if (object && object->objectType == IFAPI_KEY_OBJ && object->misc.key.name.size) {
+        keystore_index_key_name(&object->misc.key.name, name_key);
+    } else if (object && object->objectType == IFAPI_NV_OBJ) {
+        if (ifapi_nv_get_name(&object->misc.nv.public, &nv_name) == TSS2_RC_SUCCESS)
+            keystore_index_key_name(&nv_name, name_key);
+        keystore_index_key_nv(object->misc.nv.public.nvPublic.nvIndex, nv_key);
+    }
+
+    r = ifapi_asprintf(entry, "%s%s%s%s%s%s\n", path[0] == '/' ? "" : "/", path,
+                       name_key[0] ? " " : "", name_key,
+                       nv_key[0] ? " " : "", nv_key);
+    return_if_error(r, "Out of memory.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Append an entry to the name index of the keystore.
+ *
+ * The index only serves as hint for object searching, failures are
+ * therefore not reported to the caller.
+ *
+ * @param[in] keystore The keystore.
+ * @param[in] entry The line to be appended.
+ */
+static void
+keystore_index_append(IFAPI_KEYSTORE *keystore, const char *entry)
+{
+    int fd;
+
+    /* A single write of the complete line with O_APPEND keeps concurrent
+       updates from different processes from being interleaved. */
+    fd = open(keystore->index_file, O_WRONLY | O_APPEND | O_CREAT, 0600);
+    if (fd < 0) {
+        LOG_WARNING("Keystore index %s can't be opened: %s", keystore->index_file,
+                    strerror(errno));
+    } else {
+        if (write(fd, entry, strlen(entry)) != (ssize_t)strlen(entry))
+            LOG_WARNING("Keystore index %s can't be written.", keystore->index_file);
+        close(fd);
+    }
+}
+
+/** Add a stored or removed object to the name index of the keystore.
+ *
+ * @param[in] keystore The keystore.
+ * @param[in] path The relative path of the object.
+ * @param[in] object The stored object or NULL if the object was removed.
+ */
+static void
+keystore_index_add(IFAPI_KEYSTORE *keystore, const char *path, IFAPI_OBJECT *object)
+{
+    char *entry = NULL;
+
+    if (keystore_index_entry(path, object, &entry))
+        return;
+
+    keystore_index_append(keystore, entry);
+    free(entry);
+}
+
+/** Replace the name index of the keystore.
+ *
+ * @param[in] keystore The keystore.
+ * @param[in] data The complete content of the new index.
+ */
+static void
+keystore_index_write(IFAPI_KEYSTORE *keystore, const char *data)
+{
+    char *tmp_file = NULL;
+    FILE *stream;
+
+    if (ifapi_asprintf(&tmp_file, "%s.tmp", keystore->index_file))
+        return;
+
+    stream = fopen(tmp_file, "w");
+    if (!stream) {
+        LOG_WARNING("Keystore index %s can't be created.", tmp_file);
+        free(tmp_file);
+        return;
+    }
+    if (data && fputs(data, stream) == EOF) {
+        LOG_WARNING("Keystore index %s can't be written.", tmp_file);
+        fclose(stream);
+        remove(tmp_file);
+        free(tmp_file);
+        return;
+    }
+    fclose(stream);
+
+    /* The rename replaces an existing index atomically. */
+    if (rename(tmp_file, keystore->index_file) != 0) {
+        LOG_WARNING("Keystore index %s can't be replaced.", keystore->index_file);
+        remove(tmp_file);
+    }
+    free(tmp_file);
+}
+
+/** Check whether an object file for a relative path exists in the keystore.
+ *
+ * @param[in] keystore The keystore.
+ * @param[in] path The relative path of the object.
+ * @retval true if the object file exists in the user or system directory.
+ */
+static bool
+keystore_object_exists(IFAPI_KEYSTORE *keystore, const char *path)
+{
+    char *file = NULL;
+    bool exists = false;
+
+    if (expand_path_to_object(keystore, path, keystore->userdir, &file) == TSS2_RC_SUCCESS)
+        exists = ifapi_io_path_exists(file);
+    SAFE_FREE(file);
+    if (!exists &&
+            expand_path_to_object(keystore, path, keystore->systemdir, &file) == TSS2_RC_SUCCESS)
+        exists = ifapi_io_path_exists(file);
+    SAFE_FREE(file);
+    return exists;
+}
+
+/** Entry of the name index used to count the superseded entries. */
+typedef struct {
+    const char *path;   /**< The path of the entry. */
+    size_t line;        /**< The line number of the entry. */
+    bool removed;       /**< The entry marks the object as removed. */
+} IFAPI_INDEX_ENTRY;
+
+/** Order entries of the name index by path and line number. */
+static int
+keystore_index_entry_cmp(const void *a, const void *b)
+{
+    const IFAPI_INDEX_ENTRY *entry_a = a, *entry_b = b;
+    int cmp = strcmp(entry_a->path, entry_b->path);
+
+    if (cmp)
+        return cmp;
+    return (entry_a->line > entry_b->line) - (entry_a->line < entry_b->line);
+}
+
+/** Count the objects of the name index which are not replaced or removed.
+ *
+ * @param[in,out] entries The entries of the index; they are sorted by path.
+ * @param[in] count The number of entries.
+ * @retval The number of current objects.
+ */
+static size_t
+keystore_index_count_current(IFAPI_INDEX_ENTRY *entries, size_t count)
+{
+    size_t current = 0;
+
+    qsort(entries, count, sizeof(entries[0]), keystore_index_entry_cmp);
+    for (size_t i = 0; i < count; i++) {
+        /* The last entry of a path decides whether the object exists. */
+        if ((i + 1 == count || strcmp(entries[i].path, entries[i + 1].path) != 0)
+                && !entries[i].removed)
+            current += 1;
+    }
+    return current;
+}
+
+/** Look up an object in the name index of the keystore.
+ *
+ * The index stores one entry per line. Later entries for a path replace
+ * earlier ones, so the result is the path of the last entry with the key
+ * which was not replaced afterwards. The result is only a hint; the caller
+ * has to verify that the object stored under the path matches.
+ *
+ * An index of more than IFAPI_INDEX_COMPACT_LINES lines is compacted by
+ * rebuilding it if more than half of its lines are replaced or removed
+ * entries.
+ *
+ * @param[in] keystore The keystore.
+ * @param[in] key The key of the searched object.
+ * @param[out] path The relative path of the object or NULL if the key was not
+ *             found (callee-allocated).
+ * @param[out] valid false if the index is missing or corrupted and has to be
+ *             rebuilt.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+keystore_index_lookup(
+    IFAPI_KEYSTORE *keystore,
+    const char *key,
+    char **path,
+    bool *valid)
+{
+    FILE *stream;
+    char *data = NULL, *line, *next, *token, *match = NULL;
+    long length;
+    size_t lines = 0, i;
+    IFAPI_INDEX_ENTRY *entries = NULL;
+    bool found;
+
+    *path = NULL;
+    *valid = false;
+
+    stream = fopen(keystore->index_file, "r");
+    if (!stream) {
+        LOG_DEBUG("No keystore index %s.", keystore->index_file);
+        return TSS2_RC_SUCCESS;
+    }
+    if (fseek(stream, 0L, SEEK_END) == -1 || (length = ftell(stream)) == -1 ||
+            fseek(stream, 0L, SEEK_SET) == -1) {
+        fclose(stream);
+        LOG_WARNING("Keystore index %s can't be read.", keystore->index_file);
+        return TSS2_RC_SUCCESS;
+    }
+    data = malloc(length + 1);
+    if (!data) {
+        fclose(stream);
+        LOG_ERROR("Out of memory.");
+        return TSS2_FAPI_RC_MEMORY;
+    }
+    if (fread(data, 1, length, stream) != (size_t)length) {
+        fclose(stream);
+        free(data);
+        LOG_WARNING("Keystore index %s can't be read.", keystore->index_file);
+        return TSS2_RC_SUCCESS;
+    }
+    fclose(stream);
+    data[length] = '\0';
+
+    /* The entries of a large index are collected to check for compaction. */
+    for (line = data; (line = strchr(line, '\n')); line++)
+        lines += 1;
+    if (lines > IFAPI_INDEX_COMPACT_LINES) {
+        entries = malloc(lines * sizeof(entries[0]));
+        if (!entries) {
+            free(data);
+            LOG_ERROR("Out of memory.");
+            return TSS2_FAPI_RC_MEMORY;
+        }
+    }
+    lines = 0;
+
+    for (line = data; *line; line = next) {
+        next = strchr(line, '\n');
+        if (!next)
+            /* Incomplete last line */
+            goto corrupted;
+        *next++ = '\0';
+        lines += 1;
+
+        /* The path is followed by the keys of the object. */
+        token = strchr(line, ' ');
+        if (token)
+            *token++ = '\0';
+        if (line[0] != '/')
+            goto corrupted;
+        for (i = 1; line[i]; i++) {
+            if (!(isalnum((unsigned char)line[i]) || line[i] == '_' ||
+                  line[i] == '-' || line[i] == '/'))
+                goto corrupted;
+        }
+
+        if (entries) {
+            entries[lines - 1].path = line;
+            entries[lines - 1].line = lines;
+            entries[lines - 1].removed = !token;
+        }
+
+        found = false;
+        while (token) {
+            char *end = strchr(token, ' ');
+            if (end)
+                *end++ = '\0';
+            if (strncmp(token, "name=", 5) != 0 && strncmp(token, "nv=", 3) != 0)
+                goto corrupted;
+            if (strcmp(token, key) == 0)
+                found = true;
+            token = end;
+        }
+
+        if (found)
+            match = line;
+        else if (match && strcmp(match, line) == 0)
+            /* The object was replaced or removed */
+            match = NULL;
+    }
+
+    /* Compact an index containing mainly replaced or removed objects by
+       rebuilding it. */
+    if (entries && lines > 2 * keystore_index_count_current(entries, lines)) {
+        LOG_DEBUG("Keystore index %s will be compacted.", keystore->index_file);
+        free(entries);
+        free(data);
+        return TSS2_RC_SUCCESS;
+    }
+    free(entries);
+
+    *valid = true;
+    if (match) {
+        *path = strdup(match);
+        if (!*path) {
+            free(data);
+            LOG_ERROR("Out of memory.");
+            return TSS2_FAPI_RC_MEMORY;
+        }
+    }
+    free(data);
+    return TSS2_RC_SUCCESS;
+
+corrupted:
+    LOG_WARNING("Keystore index %s is corrupted and will be rebuilt.",
+                keystore->index_file);
+    free(entries);
+    free(data);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Add an entry to the index data collected during an index rebuild.
+ *
+ * @param[in,out] data The collected index data.
+ * @param[in] entry The entry to be added.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+keystore_index_data_add(char **data, const char *entry)
+{
+    size_t length = *data ? strlen(*data) : 0;
+    char *new_data = realloc(*data, length + strlen(entry) + 1);
+
+    return_if_null(new_data, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+    memcpy(&new_data[length], entry, strlen(entry) + 1);
+    *data = new_data;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Release the objects of a cache entry.
+ *
+ * @param[in,out] cache The object cache.
+ * @param[in,out] entry The entry to be cleared.
+ */
+static void
+keystore_cache_entry_clear(IFAPI_OBJECT_CACHE *cache, IFAPI_CACHE_ENTRY *entry)
+{
+    if (!entry->path)
+        return;
+    SAFE_FREE(entry->path);
+    json_object_put(entry->jso);
+    entry->jso = NULL;
+    cache->stats.entries -= 1;
+}
+
+/** Find the cache entry of an object file.
+ *
+ * @param[in] cache The object cache.
+ * @param[in] path The absolute path of the object file.
+ * @retval The entry or NULL if the file is not cached.
+ */
+static IFAPI_CACHE_ENTRY *
+keystore_cache_find(IFAPI_OBJECT_CACHE *cache, const char *path)
+{
+    size_t i;
+
+    for (i = 0; i < cache->stats.size; i++) {
+        if (cache->entries[i].path && strcmp(cache->entries[i].path, path) == 0)
+            return &cache->entries[i];
+    }
+    return NULL;
+}
+
+/** Look up the parsed content of an object file in the cache.
+ *
+ * The cached content is only used if device, inode, size, modification and
+ * status change time of the file did not change since it was read.
+ *
+ * @param[in,out] cache The object cache.
+ * @param[in] path The absolute path of the object file.
+ * @param[in] file_stat The current status of the object file.
+ * @retval A new reference to the cached json object or NULL if the file is not
+ *         cached or was changed.
+ */
+static json_object *
+keystore_cache_lookup(
+    IFAPI_OBJECT_CACHE *cache,
+    const char *path,
+    const struct stat *file_stat)
+{
+    IFAPI_CACHE_ENTRY *entry = keystore_cache_find(cache, path);
+    const struct stat *cached;
+
+    if (!entry)
+        return NULL;
+
+    cached = &entry->file_stat;
+    if (cached->st_dev != file_stat->st_dev ||
+        cached->st_ino != file_stat->st_ino ||
+        cached->st_size != file_stat->st_size ||
+        cached->st_mtim.tv_sec != file_stat->st_mtim.tv_sec ||
+        cached->st_mtim.tv_nsec != file_stat->st_mtim.tv_nsec ||
+        cached->st_ctim.tv_sec != file_stat->st_ctim.tv_sec ||
+        cached->st_ctim.tv_nsec != file_stat->st_ctim.tv_nsec) {
+        LOG_DEBUG("Cached object %s is outdated.", path);
+        keystore_cache_entry_clear(cache, entry);
+        return NULL;
+    }
+
+    entry->last_use = ++cache->use_counter;
+    return json_object_get(entry->jso);
+}
+
+/** Add the parsed content of an object file to the cache.
+ *
+ * If the cache is full the least recently used object is evicted.
+ *
+ * @param[in,out] cache The object cache.
+ * @param[in] path The absolute path of the object file (the cache takes
+ *            ownership).
+ * @param[in] file_stat The status of the object file before it was read.
+ * @param[in] jso The parsed content of the object file.
+ */
+static void
+keystore_cache_insert(
+    IFAPI_OBJECT_CACHE *cache,
+    char *path,
+    const struct stat *file_stat,
+    json_object *jso)
+{
+    IFAPI_CACHE_ENTRY *entry = keystore_cache_find(cache, path);
+    size_t i;
+
+    if (entry) {
+        keystore_cache_entry_clear(cache, entry);
+    } else {
+        for (i = 0; i < cache->stats.size; i++) {
+            if (!cache->entries[i].path) {
+                entry = &cache->entries[i];
+                break;
+            }
+            if (!entry || cache->entries[i].last_use < entry->last_use)
+                entry = &cache->entries[i];
+        }
+        if (entry->path) {
+            LOG_TRACE("Evict cached object %s.", entry->path);
+            keystore_cache_entry_clear(cache, entry);
+            cache->stats.evictions += 1;
+        }
+    }
+
+    entry->path = path;
+    entry->file_stat = *file_stat;
+    entry->jso = json_object_get(jso);
+    entry->last_use = ++cache->use_counter;
+    cache->stats.entries += 1;
+}
+
+/** Remove an object file from the cache.
+ *
+ * @param[in,out] cache The object cache.
+ * @param[in] path The absolute path of the object file.
+ */
+static void
+keystore_cache_invalidate(IFAPI_OBJECT_CACHE *cache, const char *path)
+{
+    IFAPI_CACHE_ENTRY *entry;
+
+    if (!cache->stats.size)
+        return;
+    entry = keystore_cache_find(cache, path);
+    if (entry)
+        keystore_cache_entry_clear(cache, entry);
+}
+
+/** Release the state of a load operation using the cache.
+ *
+ * @param[in,out] cache The object cache.
+ */
+static void
+keystore_cache_load_reset(IFAPI_OBJECT_CACHE *cache)
+{
+    if (cache->hit)
+        json_object_put(cache->hit);
+    cache->hit = NULL;
+    SAFE_FREE(cache->miss_path);
+}
+
 /** Store keystore parameters in the keystore context.
  *
  * Also the user directory will be created if it does not exist.
@@ -446,15 +975,56 @@ ifapi_keystore_initialize(
     goto_if_null2(keystore->defaultprofile, "Out of memory.", r, TSS2_FAPI_RC_MEMORY,
                   error);
 
+    /* The name index covers the objects of the user and system directory. */
+    r = ifapi_asprintf(&keystore->index_file, "%s/%s", config_userdir,
+                       IFAPI_KEYSTORE_INDEX_FILE);
+    goto_if_error(r, "Out of memory.", error);
+
     return TSS2_RC_SUCCESS;
 
 error:
+    SAFE_FREE(keystore->index_file);
     SAFE_FREE(keystore->defaultprofile);
     SAFE_FREE(keystore->userdir);
     SAFE_FREE(keystore->systemdir);
     return r;
 }
 
+/** Initialize the object cache of the keystore.
+ *
+ * Parsed object files are kept in memory and reused as long as the file
+ * was not changed.
+ *
+ * @param[in,out] keystore The keystore.
+ * @param[in] size The maximal number of cached objects. 0 disables the cache.
+ *
+ * @retval TSS2_RC_SUCCESS If the cache can be initialized.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+TSS2_RC
+ifapi_keystore_cache_initialize(
+    IFAPI_KEYSTORE *keystore,
+    UINT32 size)
+{
+    IFAPI_OBJECT_CACHE *cache = &keystore->cache;
+    size_t i;
+
+    for (i = 0; i < cache->stats.size; i++)
+        keystore_cache_entry_clear(cache, &cache->entries[i]);
+    SAFE_FREE(cache->entries);
+    keystore_cache_load_reset(cache);
+    memset(cache, 0, sizeof(IFAPI_OBJECT_CACHE));
+
+    if (size == 0)
+        return TSS2_RC_SUCCESS;
+
+    cache->entries = calloc(size, sizeof(IFAPI_CACHE_ENTRY));
+    return_if_null(cache->entries, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+    cache->stats.size = size;
+
+    return TSS2_RC_SUCCESS;
+}
+
 /** Get absolute object path for FAPI relative path and check whether file exists.
  *
  *  It will be checked whether object exists in user directory, if no
@@ -568,11 +1138,13 @@ ifapi_keystore_load_async(
 {
     TSS2_RC r;
     char *abs_path = NULL;
+    struct stat file_stat;
 
     LOG_TRACE("Load object: %s", path);
 
     /* Free old input buffer if buffer exists */
     SAFE_FREE(io->char_rbuffer);
+    keystore_cache_load_reset(&keystore->cache);
 
     /* Save relative directory path for storing in the object. */
     strdup_check(keystore->rel_path, path, r, error_cleanup);
@@ -581,6 +1153,21 @@ ifapi_keystore_load_async(
     r = rel_path_to_abs_path(keystore, path, &abs_path);
     goto_if_error2(r, "Object %s not found.", error_cleanup, path);
 
+    /* An object whose file did not change is taken from the cache. */
+    if (keystore->cache.stats.size && stat(abs_path, &file_stat) == 0) {
+        keystore->cache.hit = keystore_cache_lookup(&keystore->cache, abs_path,
+                                                    &file_stat);
+        if (keystore->cache.hit) {
+            LOG_TRACE("Object %s taken from cache.", path);
+            keystore->cache.stats.hits += 1;
+            SAFE_FREE(abs_path);
+            return TSS2_RC_SUCCESS;
+        }
+        keystore->cache.stats.misses += 1;
+        keystore->cache.miss_stat = file_stat;
+        strdup_check(keystore->cache.miss_path, abs_path, r, error_cleanup);
+    }
+
     /* Prepare read operation */
     r = ifapi_io_read_async(io, abs_path);
     goto_if_error2(r, "Read object %s", error_cleanup, path);
@@ -590,6 +1177,7 @@ ifapi_keystore_load_async(
  error_cleanup:
     SAFE_FREE(abs_path);
     SAFE_FREE(keystore->rel_path);
+    keystore_cache_load_reset(&keystore->cache);
     return r;
 }
 
@@ -611,7 +1199,7 @@ ifapi_keystore_load_async(
  */
 TSS2_RC
 ifapi_keystore_load_finish(
-    IFAPI_KEYSTORE *keystore MAYBE_UNUSED,
+    IFAPI_KEYSTORE *keystore,
     IFAPI_IO *io,
     IFAPI_OBJECT *object)
 {
@@ -619,19 +1207,30 @@ ifapi_keystore_load_finish(
     json_object *jso = NULL;
     uint8_t *buffer = NULL;
 
-    r = ifapi_io_read_finish(io, &buffer, NULL);
-    return_try_again(r);
-    return_if_error(r, "keystore read_finish failed");
+    if (keystore->cache.hit) {
+        jso = keystore->cache.hit;
+        keystore->cache.hit = NULL;
+    } else {
+        r = ifapi_io_read_finish(io, &buffer, NULL);
+        return_try_again(r);
+        return_if_error(r, "keystore read_finish failed");
 
-    /* If json objects can't be parse the object store is corrupted */
-    jso = ifapi_parse_json((char *)buffer);
-    SAFE_FREE(buffer);
-    goto_if_null2(jso, "Keystore is corrupted (Json error).", r, TSS2_FAPI_RC_GENERAL_FAILURE,
-                  error_cleanup);
+        /* If json objects can't be parse the object store is corrupted */
+        jso = ifapi_parse_json((char *)buffer);
+        SAFE_FREE(buffer);
+        goto_if_null2(jso, "Keystore is corrupted (Json error).", r,
+                      TSS2_FAPI_RC_GENERAL_FAILURE, error_cleanup);
+    }
 
     r = ifapi_json_IFAPI_OBJECT_deserialize(jso, object);
     goto_if_error(r, "Deserialize object.", error_cleanup);
 
+    if (keystore->cache.miss_path) {
+        keystore_cache_insert(&keystore->cache, keystore->cache.miss_path,
+                              &keystore->cache.miss_stat, jso);
+        keystore->cache.miss_path = NULL;
+    }
+
     object->rel_path = keystore->rel_path;
     SAFE_FREE(buffer);
     if (jso)
@@ -645,6 +1244,7 @@ ifapi_keystore_load_finish(
         json_object_put(jso);
     LOG_TRACE("Return %x", r);
     SAFE_FREE(keystore->rel_path);
+    keystore_cache_load_reset(&keystore->cache);
     return r;
 }
 
@@ -712,11 +1312,18 @@ ifapi_keystore_store_async(
     goto_if_null2(jso_string, "Converting json to string", r, TSS2_FAPI_RC_MEMORY,
                   cleanup);
 
+    /* The cached content of a replaced object is outdated. */
+    keystore_cache_invalidate(&keystore->cache, file);
+
     /* Start writing the json string to disk */
     r = ifapi_io_write_async(io, file, (uint8_t *) jso_string, strlen(jso_string));
     free(jso_string);
     goto_if_error(r, "write_async failed", cleanup);
 
+    /* Record the object in the name index. Index entries are verified when
+       they are used, so a write which is not finished does no harm. */
+    keystore_index_add(keystore, directory, (IFAPI_OBJECT *)object);
+
 cleanup:
     if (jso)
         json_object_put(jso);
@@ -961,14 +1568,23 @@ ifapi_keystore_delete(
 {
     TSS2_RC r;
     char *abs_path = NULL;
+    char *directory = NULL;
 
     /* Convert relative path to absolute path in keystore */
     r = rel_path_to_abs_path(keystore, path, &abs_path);
     goto_if_error2(r, "Object %s not found.", cleanup, path);
 
+    keystore_cache_invalidate(&keystore->cache, abs_path);
     r = ifapi_io_remove_file(abs_path);
+    goto_if_error2(r, "Object %s can't be removed.", cleanup, path);
+
+    /* Mark the object as removed in the name index. */
+    r = expand_path(keystore, path, &directory);
+    goto_if_error(r, "Expand path", cleanup);
+    keystore_index_add(keystore, directory, NULL);
 
 cleanup:
+    SAFE_FREE(directory);
     SAFE_FREE(abs_path);
     return r;
 }
@@ -1136,30 +1752,85 @@ keystore_search_obj(
 {
     TSS2_RC r;
     UINT32 path_idx;
-    char *path;
+    char *path, *entry = NULL;
     IFAPI_OBJECT object;
+    IFAPI_KEY_SEARCH *search = &keystore->key_search;
+    bool keys_equal, index_valid;
     size_t i;
 
-    switch (keystore->key_search.state) {
-    statecase(keystore->key_search.state, KSEARCH_INIT)
+    switch (search->state) {
+    statecase(search->state, KSEARCH_INIT)
+        search->pathlist = NULL;
+        search->numPaths = 0;
+
+        /* Probe the name index before all objects of the keystore are searched. */
+        r = keystore_index_lookup(keystore, search->index_key,
+                                  &search->index_path, &index_valid);
+        goto_if_error(r, "Keystore index lookup.", cleanup);
+        search->rebuild_index = !index_valid;
+
+        if (search->index_path && !keystore_object_exists(keystore, search->index_path)) {
+            LOG_DEBUG("Index entry %s does not exist.", search->index_path);
+            SAFE_FREE(search->index_path);
+        }
+        if (search->index_path) {
+            r = ifapi_keystore_load_async(keystore, io, search->index_path);
+            goto_if_error2(r, "Could not open: %s", cleanup, search->index_path);
+        }
+        fallthrough;
+
+    statecase(search->state, KSEARCH_INDEX_READ)
+        if (search->index_path) {
+            r = ifapi_keystore_load_finish(keystore, io, &object);
+            return_try_again(r);
+            goto_if_error(r, "read_finish failed", cleanup);
+
+            r = cmp_function(&object, cmp_object, &keys_equal);
+            if (r == TSS2_RC_SUCCESS && !keys_equal)
+                r = keystore_index_entry(search->index_path, &object, &entry);
+            ifapi_cleanup_ifapi_object(&object);
+            goto_if_error(r, "Invalid object.", cleanup);
+
+            if (keys_equal) {
+                *found_path = search->index_path;
+                search->index_path = NULL;
+                break;
+            }
+            /* The entry is outdated, it is replaced by the current keys of the
+               object and all objects have to be searched. */
+            LOG_DEBUG("Index entry %s does not match.", search->index_path);
+            keystore_index_append(keystore, entry);
+            SAFE_FREE(entry);
+            SAFE_FREE(search->index_path);
+        }
+
         r = ifapi_keystore_list_all(keystore,
                                     "/", /**< search keys and NV objects in store */
-                                    &keystore->key_search.pathlist,
-                                    &keystore->key_search.numPaths);
+                                    &search->pathlist,
+                                    &search->numPaths);
         goto_if_error2(r, "Get entities.", cleanup);
 
-        keystore->key_search.path_idx = keystore->key_search.numPaths;
+        search->path_idx = search->numPaths;
         fallthrough;
 
-    statecase(keystore->key_search.state, KSEARCH_SEARCH_OBJECT)
+    statecase(search->state, KSEARCH_SEARCH_OBJECT)
         /* Use the next object in the path list */
-        if (keystore->key_search.path_idx == 0) {
+        if (search->path_idx == 0) {
+            if (search->rebuild_index) {
+                keystore_index_write(keystore, search->index_data);
+                *found_path = search->rebuild_path;
+                search->rebuild_path = NULL;
+                if (*found_path) {
+                    r = TSS2_RC_SUCCESS;
+                    break;
+                }
+            }
             goto_error(r, TSS2_FAPI_RC_PATH_NOT_FOUND, "Key not found.", cleanup);
         }
-        keystore->key_search.path_idx -= 1;
-        path_idx = keystore->key_search.path_idx;
-        path = keystore->key_search.pathlist[path_idx];
-        LOG_TRACE("Check file: %s %zu", path, keystore->key_search.path_idx);
+        search->path_idx -= 1;
+        path_idx = search->path_idx;
+        path = search->pathlist[path_idx];
+        LOG_TRACE("Check file: %s %zu", path, search->path_idx);
 
         /* Skip policy files. */
         if (ifapi_path_type_p(path, IFAPI_POLICY_PATH)) {
@@ -1171,41 +1842,73 @@ keystore_search_obj(
 
         fallthrough;
 
-    statecase(keystore->key_search.state, KSEARCH_READ)
+    statecase(search->state, KSEARCH_READ)
         r = ifapi_keystore_load_finish(keystore, io, &object);
         return_try_again(r);
         goto_if_error(r, "read_finish failed", cleanup);
 
+        /* The absolute path will be converted to relative path. */
+        path_idx = search->path_idx;
+        path = strdup(search->pathlist[path_idx]);
+        if (!path) {
+            ifapi_cleanup_ifapi_object(&object);
+            goto_error(r, TSS2_FAPI_RC_MEMORY, "Out of memory.", cleanup);
+        }
+        full_path_to_fapi_path(keystore, path);
+
         /* Check whether the key has the passed name */
-        bool keys_equal;
         r = cmp_function(&object, cmp_object, &keys_equal);
+        if (r == TSS2_RC_SUCCESS && (keys_equal || search->rebuild_index))
+            r = keystore_index_entry(path, &object, &entry);
         ifapi_cleanup_ifapi_object(&object);
-        goto_if_error(r, "Invalid object.", cleanup);
+        if (r == TSS2_RC_SUCCESS && search->rebuild_index)
+            r = keystore_index_data_add(&search->index_data, entry);
+        if (r) {
+            SAFE_FREE(entry);
+            SAFE_FREE(path);
+            goto_if_error(r, "Invalid object.", cleanup);
+        }
+
+        if (search->rebuild_index) {
+            /* The rebuild of the index continues with the remaining objects. */
+            SAFE_FREE(entry);
+            if (keys_equal && !search->rebuild_path) {
+                search->rebuild_path = path;
+                path = NULL;
+            }
+            SAFE_FREE(path);
+            search->state = KSEARCH_SEARCH_OBJECT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
 
         if (!keys_equal) {
             /* Try next key */
-            keystore->key_search.state = KSEARCH_SEARCH_OBJECT;
+            SAFE_FREE(path);
+            search->state = KSEARCH_SEARCH_OBJECT;
             return TSS2_FAPI_RC_TRY_AGAIN;
         }
-        /* Key found, the absolute path will be converted to relative path. */
-        path_idx = keystore->key_search.path_idx;
-        *found_path = strdup(keystore->key_search.pathlist[path_idx]);
-        goto_if_null(*found_path, "Out of memory.",
-                     TSS2_FAPI_RC_MEMORY, cleanup);
-        full_path_to_fapi_path(keystore, *found_path);
+
+        /* Add the object missing in the index. */
+        keystore_index_append(keystore, entry);
+        SAFE_FREE(entry);
+        *found_path = path;
         break;
 
-    statecasedefault(keystore->key_search.state);
+    statecasedefault(search->state);
     }
 cleanup:
-    for (i = 0; i < keystore->key_search.numPaths; i++)
-        free(keystore->key_search.pathlist[i]);
-    free(keystore->key_search.pathlist);
+    for (i = 0; i < search->numPaths; i++)
+        free(search->pathlist[i]);
+    SAFE_FREE(search->pathlist);
+    search->numPaths = 0;
+    SAFE_FREE(search->index_path);
+    SAFE_FREE(search->index_data);
+    SAFE_FREE(search->rebuild_path);
     if (!*found_path) {
         LOG_ERROR("Object not found");
         r = TSS2_FAPI_RC_KEY_NOT_FOUND;
     }
-    keystore->key_search.state = KSEARCH_INIT;
+    search->state = KSEARCH_INIT;
     return r;
 }
 
@@ -1242,6 +1945,7 @@ ifapi_keystore_search_obj(
     TPM2B_NAME *name,
     char **found_path)
 {
+    keystore_index_key_name(name, keystore->key_search.index_key);
     return keystore_search_obj(keystore, io, name,
                                ifapi_object_cmp_name, found_path);
 }
@@ -1280,6 +1984,7 @@ ifapi_keystore_search_nv_obj(
     TPM2B_NV_PUBLIC *nv_public,
     char **found_path)
 {
+    keystore_index_key_nv(nv_public->nvPublic.nvIndex, keystore->key_search.index_key);
     return keystore_search_obj(keystore, io, nv_public,
                                ifapi_object_cmp_nv_public, found_path);
 }
@@ -1611,6 +2316,8 @@ ifapi_cleanup_ifapi_keystore(IFAPI_KEYSTORE * keystore) {
         SAFE_FREE(keystore->systemdir);
         SAFE_FREE(keystore->userdir);
         SAFE_FREE(keystore->defaultprofile);
+        SAFE_FREE(keystore->index_file);
+        ifapi_keystore_cache_initialize(keystore, 0);
     }
 }
 
@@ -8,6 +8,8 @@
 #define IFAPI_KEYSTORE_H
 
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <json-c/json.h>
 
 #include "tss2_common.h"
 #include "tss2_tpm2_types.h"
@@ -99,10 +101,17 @@ typedef union {
 /** The states for key searching */
 enum FAPI_SEARCH_STATE {
     KSEARCH_INIT = 0,
+    KSEARCH_INDEX_READ,
     KSEARCH_SEARCH_OBJECT,
     KSEARCH_READ
 };
 
+/** Size of a key of the keystore name index ("name=" and the hex encoded name). */
+#define IFAPI_INDEX_KEY_SIZE (sizeof("name=") + 2 * sizeof(TPMU_NAME))
+
+/** Number of lines of the keystore name index above which it may be compacted. */
+#define IFAPI_INDEX_COMPACT_LINES 1024
+
 /** The data structure holding internal state for key searching.
  */
 typedef struct {
@@ -110,14 +119,52 @@ typedef struct {
     size_t numPaths;                /**< Number of all objects in data store */
     char **pathlist;                /**< The array of all objects  in the search path */
     enum FAPI_SEARCH_STATE state;
+    char index_key[IFAPI_INDEX_KEY_SIZE]; /**< The key of the searched object in the name index */
+    char *index_path;               /**< The path of the object found in the name index */
+    bool rebuild_index;             /**< The name index will be rebuilt during the search */
+    char *index_data;               /**< The index entries collected for the rebuild */
+    char *rebuild_path;             /**< The path found during the index rebuild */
 } IFAPI_KEY_SEARCH;
 
+
+/** Statistics of the object cache of the keystore.
+ */
+typedef struct {
+    UINT32 size;                    /**< The maximal number of cached objects */
+    UINT32 entries;                 /**< The number of currently cached objects */
+    UINT64 hits;                    /**< Loads served from the cache */
+    UINT64 misses;                  /**< Loads which had to read the object file */
+    UINT64 evictions;               /**< Objects removed to make room for others */
+} IFAPI_CACHE_STATS;
+
+/** An object file of the keystore cached in memory.
+ */
+typedef struct {
+    char *path;                     /**< The absolute path of the object file */
+    struct stat file_stat;          /**< The file status used to detect changes */
+    json_object *jso;               /**< The parsed content of the object file */
+    UINT64 last_use;                /**< The counter value of the last use */
+} IFAPI_CACHE_ENTRY;
+
+/** The cache of parsed object files of the keystore.
+ */
+typedef struct {
+    IFAPI_CACHE_ENTRY *entries;     /**< The array of size stats.size */
+    UINT64 use_counter;             /**< Counter used for least recently used eviction */
+    IFAPI_CACHE_STATS stats;
+    json_object *hit;               /**< The cached content for the running load */
+    char *miss_path;                /**< The path of the object file being read */
+    struct stat miss_stat;          /**< The file status before the object file is read */
+} IFAPI_OBJECT_CACHE;
+
 typedef struct IFAPI_KEYSTORE {
     char *systemdir;
     char *userdir;
     char *defaultprofile;
+    char *index_file;               /**< The file storing the name index of the keystore */
     IFAPI_KEY_SEARCH key_search;
     const char* rel_path;
+    IFAPI_OBJECT_CACHE cache;       /**< The cache of parsed object files */
 } IFAPI_KEYSTORE;
 
 
@@ -162,6 +209,11 @@ ifapi_keystore_initialize(
     const char *config_userdir,
     const char *config_defaultprofile);
 
+TSS2_RC
+ifapi_keystore_cache_initialize(
+    IFAPI_KEYSTORE *keystore,
+    UINT32 size);
+
 TSS2_RC
 ifapi_keystore_load_async(
     IFAPI_KEYSTORE *keystore,
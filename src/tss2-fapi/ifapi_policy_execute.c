@@ -545,6 +545,11 @@ cleanup:
  * For an example callback implementation to executie of an authorized policy
  * ifapi_exec_auth_policy()
  *
+ * The verification ticket of the signature is kept in the ticket cache of the
+ * policy context. If the same policy is authorized again by the same key, the
+ * cached ticket is used and loading the key and verifying the signature is
+ * skipped.
+ *
  * @param[in,out] *esys_ctx The ESAPI context which is needed to execute the
  *                policy command.
  * @param[in,out] policy The policy which defines the signing key and several
@@ -588,11 +593,11 @@ execute_policy_authorize(
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
     TPM2B_PUBLIC public2b;
-    TPM2B_DIGEST aHash;
     IFAPI_CRYPTO_CONTEXT_BLOB *cryptoContext;
     size_t hash_size;
     size_t size;
     TPMT_TK_VERIFIED *ticket;
+    const TPMT_TK_VERIFIED *cached_ticket = NULL;
     TPM2B_NAME *tmp_name = NULL;
 
     LOG_TRACE("call");
@@ -605,6 +610,7 @@ execute_policy_authorize(
     switch (current_policy->state) {
     statecase(current_policy->state, POLICY_EXECUTE_INIT);
         current_policy->object_handle = ESYS_TR_NONE;
+        current_policy->ticket_cached = false;
         /* Execute authorized policy. */
         ifapi_policyeval_EXEC_CB *cb = &current_policy->callbacks;
         r = cb->cbauthpol(&policy->keyPublic, hash_alg, &policy->approvedPolicy,
@@ -613,6 +619,51 @@ execute_policy_authorize(
         return_try_again(r);
         goto_if_error(r, "Execute authorized policy.", cleanup);
 
+        /* Use policyRef and policy to compute authorization hash */
+        r = ifapi_crypto_hash_start(&cryptoContext, hash_alg);
+        return_if_error(r, "crypto hash start");
+
+        HASH_UPDATE_BUFFER(cryptoContext, &policy->approvedPolicy.buffer[0],
+                           hash_size, r, cleanup);
+        HASH_UPDATE_BUFFER(cryptoContext, &policy->policyRef.buffer[0],
+                           policy->policyRef.size, r, cleanup);
+        r = ifapi_crypto_hash_finish(&cryptoContext,
+                                     (uint8_t *) &current_policy->aHash.buffer[0],
+                                     &size);
+        return_if_error(r, "crypto hash finish");
+
+        current_policy->aHash.size = size;
+        LOGBLOB_TRACE(&policy->policyRef.buffer[0], policy->policyRef.size, "policyRef");
+        LOGBLOB_TRACE(&current_policy->aHash.buffer[0], current_policy->aHash.size,
+                      "aHash");
+
+        /* A ticket of a former verification of the signature can be used
+           without loading the key. */
+        if (current_policy->ticket_cache) {
+            r = ifapi_get_name(&policy->keyPublic, &policy->keyName);
+            goto_if_error(r, "Compute key name.", cleanup);
+
+            cached_ticket = ifapi_policy_ticket_cache_lookup(current_policy->ticket_cache,
+                                                             &policy->keyName,
+                                                             &current_policy->aHash);
+        }
+        if (cached_ticket) {
+            LOG_DEBUG("Use cached verification ticket.");
+            current_policy->ticket_cached = true;
+            policy->checkTicket = *cached_ticket;
+            r = Esys_PolicyAuthorize_Async(esys_ctx,
+                                           current_policy->session,
+                                           ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                                           &policy->approvedPolicy,
+                                           &policy->policyRef,
+                                           &policy->keyName,
+                                           &policy->checkTicket);
+            goto_if_error(r, "Policy Authorize", cleanup);
+
+            current_policy->state = POLICY_EXECUTE_FINISH;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+
         public2b.size = 0;
         public2b.publicArea = policy->keyPublic;
         r = Esys_LoadExternal_Async(esys_ctx,
@@ -631,28 +682,11 @@ execute_policy_authorize(
         policy->keyName = *tmp_name;
         SAFE_FREE(tmp_name);
 
-        /* Use policyRef and policy to compute authorization hash */
-        r = ifapi_crypto_hash_start(&cryptoContext, hash_alg);
-        return_if_error(r, "crypto hash start");
-
-        HASH_UPDATE_BUFFER(cryptoContext, &policy->approvedPolicy.buffer[0],
-                           hash_size, r, cleanup);
-        HASH_UPDATE_BUFFER(cryptoContext, &policy->policyRef.buffer[0],
-                           policy->policyRef.size, r, cleanup);
-        r = ifapi_crypto_hash_finish(&cryptoContext,
-                                     (uint8_t *) &aHash.buffer[0],
-                                     &size);
-        return_if_error(r, "crypto hash finish");
-
-        aHash.size = size;
-        LOGBLOB_TRACE(&policy->policyRef.buffer[0], policy->policyRef.size, "policyRef");
-        LOGBLOB_TRACE(&aHash.buffer[0], aHash.size, "aHash");
-
         /* Verify the signature retrieved from the authorized policy against
            the computed ahash. */
         r = Esys_VerifySignature_Async(esys_ctx, current_policy->object_handle,
                                        ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
-                                       &aHash,
+                                       &current_policy->aHash,
                                        &policy->signature);
         goto_if_error(r, "Verify signature", cleanup);
         fallthrough;
@@ -664,6 +698,12 @@ execute_policy_authorize(
         /* Execute policy authorize */
         policy->checkTicket = *ticket;
         SAFE_FREE(ticket);
+        if (current_policy->ticket_cache)
+            ifapi_policy_ticket_cache_insert(current_policy->ticket_cache,
+                                             &policy->keyName,
+                                             &current_policy->aHash,
+                                             &policy->checkTicket);
+
         r = Esys_PolicyAuthorize_Async(esys_ctx,
                                        current_policy->session,
                                        ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
@@ -676,7 +716,34 @@ execute_policy_authorize(
 
     statecase(current_policy->state, POLICY_EXECUTE_FINISH);
         r = Esys_PolicyAuthorize_Finish(esys_ctx);
-        try_again_or_error(r, "Execute PolicyAuthorize.");
+        return_try_again(r);
+
+        if (current_policy->ticket_cached && r != TSS2_RC_SUCCESS &&
+            (r & TSS2_RC_LAYER_MASK) == TSS2_TPM_RC_LAYER) {
+            /* The TPM rejected the cached ticket, e.g. with TPM2_RC_VALUE for
+               the checkTicket parameter because the owner hierarchy was
+               cleared. The signature has to be verified again. */
+            ifapi_policy_ticket_cache_remove(current_policy->ticket_cache,
+                                             &policy->keyName,
+                                             &current_policy->aHash);
+            current_policy->ticket_cached = false;
+
+            public2b.size = 0;
+            public2b.publicArea = policy->keyPublic;
+            r = Esys_LoadExternal_Async(esys_ctx,
+                                        ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                                        NULL,  &public2b, ESYS_TR_RH_OWNER);
+            goto_if_error(r, "LoadExternal_Async", cleanup);
+
+            current_policy->state = POLICY_LOAD_KEY;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        goto_if_error(r, "Execute PolicyAuthorize.", cleanup);
+
+        if (current_policy->ticket_cached) {
+            current_policy->state = POLICY_EXECUTE_INIT;
+            break;
+        }
 
         r = Esys_FlushContext_Async(esys_ctx, current_policy->object_handle);
         goto_if_error(r, "FlushContext_Async", cleanup);
@@ -15,6 +15,7 @@
 
 #include "tss2_esys.h"
 #include "tss2_fapi.h"
+#include "ifapi_policy_ticket_cache.h"
 
 TSS2_RC
 ifapi_extend_authorization(
@@ -152,6 +153,10 @@ struct IFAPI_POLICY_EXEC_CTX {
     char *pem_key;                   /**< Pem key recreated during policy execution */
     struct POLICY_LIST *policy_list;
                                     /**< List of policies for authorization selection */
+    IFAPI_POLICY_TICKET_CACHE *ticket_cache;
+                                    /**< Verification tickets of authorized policies */
+    TPM2B_DIGEST aHash;             /**< Digest of the authorized policy and policyRef */
+    bool ticket_cached;             /**< PolicyAuthorize uses a cached ticket */
     ifapi_policyeval_EXEC_CB callbacks;
                                     /**< callbacks used for execution of sub
                                          policies and actions which require access
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "ifapi_policy_ticket_cache.h"
+
+#define LOGMODULE fapi
+#include "util/log.h"
+
+/** Find the cache entry of a key name and an authorization digest.
+ *
+ * @param[in] cache The ticket cache.
+ * @param[in] keyName The name of the authorizing key.
+ * @param[in] aHash The digest of approvedPolicy and policyRef.
+ * @retval The index of the entry or cache->count if no ticket is cached.
+ */
+static size_t
+ticket_cache_find(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash)
+{
+    size_t i;
+    IFAPI_POLICY_TICKET_CACHE_ENTRY *entry;
+
+    for (i = 0; i < cache->count; i++) {
+        entry = &cache->entries[i];
+        if (entry->keyName.size == keyName->size &&
+            entry->aHash.size == aHash->size &&
+            memcmp(&entry->keyName.name[0], &keyName->name[0], keyName->size) == 0 &&
+            memcmp(&entry->aHash.buffer[0], &aHash->buffer[0], aHash->size) == 0)
+            break;
+    }
+    return i;
+}
+
+/** Remove an entry from the ticket cache.
+ *
+ * @param[in,out] cache The ticket cache.
+ * @param[in] idx The index of the entry.
+ */
+static void
+ticket_cache_delete(IFAPI_POLICY_TICKET_CACHE *cache, size_t idx)
+{
+    cache->count -= 1;
+    cache->entries[idx] = cache->entries[cache->count];
+}
+
+/** Get the verification ticket of an authorized policy.
+ *
+ * @param[in,out] cache The ticket cache.
+ * @param[in] keyName The name of the authorizing key.
+ * @param[in] aHash The digest of approvedPolicy and policyRef.
+ * @retval The ticket owned by the cache or NULL if no ticket is cached.
+ */
+const TPMT_TK_VERIFIED *
+ifapi_policy_ticket_cache_lookup(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash)
+{
+    size_t idx = ticket_cache_find(cache, keyName, aHash);
+
+    if (idx == cache->count)
+        return NULL;
+
+    cache->entries[idx].last_use = ++cache->clock;
+    return &cache->entries[idx].ticket;
+}
+
+/** Store the verification ticket of an authorized policy.
+ *
+ * An existing ticket for the key name and digest is replaced. If the cache
+ * is full, the least recently used ticket is dropped.
+ *
+ * @param[in,out] cache The ticket cache.
+ * @param[in] keyName The name of the authorizing key.
+ * @param[in] aHash The digest of approvedPolicy and policyRef.
+ * @param[in] ticket The ticket returned by TPM2_VerifySignature.
+ */
+void
+ifapi_policy_ticket_cache_insert(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash,
+    const TPMT_TK_VERIFIED *ticket)
+{
+    IFAPI_POLICY_TICKET_CACHE_ENTRY *entry;
+    size_t idx = ticket_cache_find(cache, keyName, aHash);
+
+    if (idx < cache->count) {
+        ticket_cache_delete(cache, idx);
+    } else if (cache->count == IFAPI_POLICY_TICKET_CACHE_SIZE) {
+        idx = 0;
+        for (size_t i = 1; i < cache->count; i++) {
+            if (cache->entries[i].last_use < cache->entries[idx].last_use)
+                idx = i;
+        }
+        ticket_cache_delete(cache, idx);
+    }
+
+    entry = &cache->entries[cache->count++];
+    entry->keyName = *keyName;
+    entry->aHash = *aHash;
+    entry->ticket = *ticket;
+    entry->last_use = ++cache->clock;
+}
+
+/** Drop the verification ticket of an authorized policy.
+ *
+ * Used if the TPM does not accept the ticket anymore, e.g. after the owner
+ * hierarchy was cleared.
+ *
+ * @param[in,out] cache The ticket cache.
+ * @param[in] keyName The name of the authorizing key.
+ * @param[in] aHash The digest of approvedPolicy and policyRef.
+ */
+void
+ifapi_policy_ticket_cache_remove(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash)
+{
+    size_t idx = ticket_cache_find(cache, keyName, aHash);
+
+    if (idx < cache->count) {
+        LOG_DEBUG("Drop verification ticket.");
+        ticket_cache_delete(cache, idx);
+    }
+}
+
+/** Drop all tickets of the ticket cache.
+ *
+ * @param[in,out] cache The ticket cache.
+ */
+void
+ifapi_policy_ticket_cache_clear(IFAPI_POLICY_TICKET_CACHE *cache)
+{
+    cache->count = 0;
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018-2019, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+#ifndef IFAPI_POLICY_TICKET_CACHE_H
+#define IFAPI_POLICY_TICKET_CACHE_H
+
+#include "tss2_tpm2_types.h"
+
+/** The maximal number of verification tickets kept by FAPI.
+ */
+#define IFAPI_POLICY_TICKET_CACHE_SIZE 16
+
+/** The verification ticket of an authorized policy.
+ */
+typedef struct {
+    TPM2B_NAME                                  keyName;    /**< The name of the authorizing key */
+    TPM2B_DIGEST                                  aHash;    /**< The digest of approvedPolicy and policyRef */
+    TPMT_TK_VERIFIED                             ticket;    /**< The ticket returned by TPM2_VerifySignature */
+    UINT64                                     last_use;    /**< Counter for the last use of the ticket */
+} IFAPI_POLICY_TICKET_CACHE_ENTRY;
+
+/** The cache of verification tickets used by PolicyAuthorize.
+ *
+ * The ticket produced by TPM2_VerifySignature for an authorized policy only
+ * depends on the authorizing key and the signed digest. It stays valid until
+ * the proof value of the owner hierarchy changes, such that subsequent
+ * executions of the same authorized policy can skip loading the key and
+ * verifying the signature.
+ */
+typedef struct {
+    IFAPI_POLICY_TICKET_CACHE_ENTRY entries[IFAPI_POLICY_TICKET_CACHE_SIZE];
+                                                            /**< The cached tickets */
+    size_t                                        count;    /**< The number of cached tickets */
+    UINT64                                        clock;    /**< Counter for the last use of tickets */
+} IFAPI_POLICY_TICKET_CACHE;
+
+const TPMT_TK_VERIFIED *
+ifapi_policy_ticket_cache_lookup(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash);
+
+void
+ifapi_policy_ticket_cache_insert(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash,
+    const TPMT_TK_VERIFIED *ticket);
+
+void
+ifapi_policy_ticket_cache_remove(
+    IFAPI_POLICY_TICKET_CACHE *cache,
+    const TPM2B_NAME *keyName,
+    const TPM2B_DIGEST *aHash);
+
+void
+ifapi_policy_ticket_cache_clear(
+    IFAPI_POLICY_TICKET_CACHE *cache);
+
+#endif /* IFAPI_POLICY_TICKET_CACHE_H */
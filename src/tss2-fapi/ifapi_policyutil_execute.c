@@ -67,6 +67,7 @@ new_policy(
     pol_exec_ctx->callbacks.cbdup_userdata = context;
     pol_exec_ctx->callbacks.cbaction = ifapi_policy_action;
     pol_exec_ctx->callbacks.cbaction_userdata = context;
+    pol_exec_ctx->ticket_cache = &context->ticket_cache;
 
     pol_exec_cb_ctx = calloc(sizeof(IFAPI_POLICY_EXEC_CB_CTX), 1);
     if (!pol_exec_cb_ctx) {
@@ -17,6 +17,9 @@
 #include "util/tpm2b.h"
 #include "util/tss2_endian.h"
 #define LOGMODULE marshal
+#ifdef MU_MAXLOGLEVEL
+#define LOGMODULE_MAXLOGLEVEL MU_MAXLOGLEVEL
+#endif
 #include "util/log.h"
 
 #define TPM2B_MARSHAL(type) \
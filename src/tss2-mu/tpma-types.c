@@ -16,6 +16,9 @@
 
 #include "util/tss2_endian.h"
 #define LOGMODULE marshal
+#ifdef MU_MAXLOGLEVEL
+#define LOGMODULE_MAXLOGLEVEL MU_MAXLOGLEVEL
+#endif
 #include "util/log.h"
 
 #define TPMA_MARSHAL(type) \
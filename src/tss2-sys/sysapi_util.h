@@ -78,12 +78,6 @@ req_header_from_cxt(_TSS2_SYS_CONTEXT_BLOB *ctx)
     return (TPM20_Header_In *)ctx->cmdBuffer;
 }
 
-typedef struct {
-    TPM2_CC commandCode;
-    int numCommandHandles;
-    int numResponseHandles;
-} COMMAND_HANDLES;
-
 #ifdef __cplusplus
 extern "C" {
 #endif
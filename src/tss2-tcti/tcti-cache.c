@@ -0,0 +1,629 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_mu.h"
+#include "tss2_tpm2_types.h"
+#include "tss2_tcti.h"
+#include "tss2_tcti_cache.h"
+#include "tss2_tctildr.h"
+
+#include "tcti-common.h"
+#include "tcti-cache.h"
+#define LOGMODULE tcti
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Commands cached if no allow-list is given in the environment. All of them
+ * only report state that is changed by the commands in 'invalidating_commands'.
+ * TPM2_GetCapability is only cached for the capabilities that never change,
+ * see tcti_cache_capability_is_fixed.
+ */
+static const TPM2_CC default_commands [] = {
+    TPM2_CC_GetCapability,
+    TPM2_CC_ReadPublic,
+    TPM2_CC_NV_ReadPublic,
+};
+
+/*
+ * Commands that may change the answer to a cached command. The whole cache
+ * is dropped when one of them is sent. State that the TPM updates on its
+ * own (e.g. clock, the lockout counter or sessions closed by continueSession
+ * being clear) is not covered, so commands reporting it are never cached.
+ */
+static const TPM2_CC invalidating_commands [] = {
+    TPM2_CC_Startup,
+    TPM2_CC_Clear,
+    TPM2_CC_ClearControl,
+    TPM2_CC_HierarchyControl,
+    TPM2_CC_HierarchyChangeAuth,
+    TPM2_CC_ChangeEPS,
+    TPM2_CC_ChangePPS,
+    TPM2_CC_EvictControl,
+    TPM2_CC_CreatePrimary,
+    TPM2_CC_CreateLoaded,
+    TPM2_CC_Load,
+    TPM2_CC_LoadExternal,
+    TPM2_CC_ContextLoad,
+    TPM2_CC_ContextSave,
+    TPM2_CC_FlushContext,
+    TPM2_CC_StartAuthSession,
+    TPM2_CC_HashSequenceStart,
+    TPM2_CC_HMAC_Start,
+    TPM2_CC_SequenceComplete,
+    TPM2_CC_EventSequenceComplete,
+    TPM2_CC_NV_DefineSpace,
+    TPM2_CC_NV_UndefineSpace,
+    TPM2_CC_NV_UndefineSpaceSpecial,
+    TPM2_CC_NV_Write,
+    TPM2_CC_NV_Increment,
+    TPM2_CC_NV_Extend,
+    TPM2_CC_NV_SetBits,
+    TPM2_CC_NV_WriteLock,
+    TPM2_CC_NV_GlobalWriteLock,
+    TPM2_CC_NV_ReadLock,
+    TPM2_CC_PCR_Allocate,
+    TPM2_CC_DictionaryAttackLockReset,
+    TPM2_CC_DictionaryAttackParameters,
+    TPM2_CC_SetPrimaryPolicy,
+    TPM2_CC_SetCommandCodeAuditStatus,
+    TPM2_CC_PP_Commands,
+    TPM2_CC_SetAlgorithmSet,
+    TPM2_CC_FieldUpgradeStart,
+    TPM2_CC_FieldUpgradeData,
+    TPM2_CC_ACT_SetTimeout,
+};
+
+/*
+ * This function wraps the "up-cast" of the opaque TCTI context type to the
+ * type for the cache TCTI context. The only safeguard we have to ensure this
+ * operation is possible is the magic number in the cache TCTI context.
+ * If passed a NULL context, or the magic number check fails, this function
+ * will return NULL.
+ */
+TSS2_TCTI_CACHE_CONTEXT*
+tcti_cache_context_cast (TSS2_TCTI_CONTEXT *tcti_ctx)
+{
+    if (tcti_ctx != NULL && TSS2_TCTI_MAGIC (tcti_ctx) == TCTI_CACHE_MAGIC) {
+        return (TSS2_TCTI_CACHE_CONTEXT*)tcti_ctx;
+    }
+    return NULL;
+}
+
+/*
+ * This function down-casts the cache TCTI context to the common context
+ * defined in the tcti-common module.
+ */
+TSS2_TCTI_COMMON_CONTEXT*
+tcti_cache_down_cast (TSS2_TCTI_CACHE_CONTEXT *tcti_cache)
+{
+    if (tcti_cache == NULL) {
+        return NULL;
+    }
+    return &tcti_cache->common;
+}
+
+/*
+ * Parse the allow-list of cached command codes: a list of numbers separated
+ * by commas or white space, e.g. "0x17a,0x173". An empty list disables
+ * caching.
+ */
+TSS2_RC
+tcti_cache_parse_commands (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    const char *commands)
+{
+    const char *pos = commands;
+    char *end;
+    unsigned long cc;
+
+    tcti_cache->num_commands = 0;
+    while (*pos != '\0') {
+        if (*pos == ',' || isspace ((unsigned char)*pos)) {
+            pos++;
+            continue;
+        }
+        cc = strtoul (pos, &end, 0);
+        if (end == pos || cc > UINT32_MAX ||
+            (*end != '\0' && *end != ',' && !isspace ((unsigned char)*end))) {
+            LOG_ERROR ("Invalid command code in %s: %s", ENV_CACHE_COMMANDS,
+                       pos);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        if (tcti_cache->num_commands == TCTI_CACHE_MAX_COMMANDS) {
+            LOG_ERROR ("%s holds more than %d command codes",
+                       ENV_CACHE_COMMANDS, TCTI_CACHE_MAX_COMMANDS);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        tcti_cache->commands [tcti_cache->num_commands++] = (TPM2_CC)cc;
+        pos = end;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static bool
+tcti_cache_cc_in_list (
+    TPM2_CC cc,
+    const TPM2_CC *list,
+    size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (list [i] == cc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * A TPM2_GetCapability response may only be cached if it can not change
+ * without one of the invalidating commands being sent: the algorithm and
+ * command lists and the fixed TPM properties. Handles, PCR allocation,
+ * variable properties (lockout counter, loaded sessions, ...) and all other
+ * capabilities are always read from the TPM.
+ */
+static bool
+tcti_cache_capability_is_fixed (
+    const uint8_t *cmd_buf,
+    size_t size)
+{
+    size_t offset = TPM_HEADER_SIZE;
+    TPM2_CAP capability;
+    UINT32 property, count;
+
+    if (Tss2_MU_UINT32_Unmarshal (cmd_buf, size, &offset,
+                                  &capability) != TSS2_RC_SUCCESS ||
+        Tss2_MU_UINT32_Unmarshal (cmd_buf, size, &offset,
+                                  &property) != TSS2_RC_SUCCESS ||
+        Tss2_MU_UINT32_Unmarshal (cmd_buf, size, &offset,
+                                  &count) != TSS2_RC_SUCCESS) {
+        return false;
+    }
+
+    switch (capability) {
+    case TPM2_CAP_ALGS:
+    case TPM2_CAP_COMMANDS:
+        return true;
+    case TPM2_CAP_TPM_PROPERTIES:
+        return property >= TPM2_PT_FIXED && property < TPM2_PT_VAR &&
+               count <= TPM2_PT_VAR - property;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Only commands without sessions are cached: the response to a command with
+ * sessions depends on the session nonces and never repeats.
+ */
+static bool
+tcti_cache_is_cacheable (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    const tpm_header_t *header,
+    const uint8_t *cmd_buf,
+    size_t size)
+{
+    if (header->tag != TPM2_ST_NO_SESSIONS ||
+        size > TCTI_CACHE_MAX_COMMAND_SIZE ||
+        !tcti_cache_cc_in_list (header->code, tcti_cache->commands,
+                                tcti_cache->num_commands)) {
+        return false;
+    }
+    if (header->code == TPM2_CC_GetCapability) {
+        return tcti_cache_capability_is_fixed (cmd_buf, size);
+    }
+    return true;
+}
+
+static void
+tcti_cache_flush (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache)
+{
+    size_t i;
+
+    for (i = 0; i < TCTI_CACHE_ENTRIES; i++) {
+        free (tcti_cache->entries [i].response);
+    }
+    memset (tcti_cache->entries, 0, sizeof (tcti_cache->entries));
+}
+
+static tcti_cache_entry_t*
+tcti_cache_lookup (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    const uint8_t *cmd_buf,
+    size_t size)
+{
+    tcti_cache_entry_t *entry;
+    size_t i;
+
+    for (i = 0; i < TCTI_CACHE_ENTRIES; i++) {
+        entry = &tcti_cache->entries [i];
+        if (entry->command_size == size &&
+            memcmp (entry->command, cmd_buf, size) == 0) {
+            entry->last_used = ++tcti_cache->clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Store the response to the pending command, replacing the least recently
+ * used entry if the cache is full. Failing to allocate memory only means
+ * the response is not cached.
+ */
+static void
+tcti_cache_insert (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    const uint8_t *response,
+    size_t size)
+{
+    tcti_cache_entry_t *entry = &tcti_cache->entries [0];
+    uint8_t *copy;
+    size_t i;
+
+    for (i = 0; i < TCTI_CACHE_ENTRIES; i++) {
+        if (tcti_cache->entries [i].command_size == 0) {
+            entry = &tcti_cache->entries [i];
+            break;
+        }
+        if (tcti_cache->entries [i].last_used < entry->last_used) {
+            entry = &tcti_cache->entries [i];
+        }
+    }
+
+    copy = malloc (size);
+    if (copy == NULL) {
+        LOG_WARNING ("Failed to allocate memory for cached response");
+        return;
+    }
+    memcpy (copy, response, size);
+
+    free (entry->response);
+    memcpy (entry->command, tcti_cache->command, tcti_cache->command_size);
+    entry->command_size = tcti_cache->command_size;
+    entry->response = copy;
+    entry->response_size = size;
+    entry->last_used = ++tcti_cache->clock;
+}
+
+TSS2_RC
+tcti_cache_transmit (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tcti_ctx);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    tpm_header_t header;
+    TSS2_RC rc;
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_transmit_checks (tcti_common, cmd_buf, TCTI_CACHE_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    rc = header_unmarshal (cmd_buf, &header);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (header.size != size) {
+        LOG_ERROR ("Buffer size parameter: %zu, and TPM2 command header size "
+                   "field: %" PRIu32 " disagree.", size, header.size);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    tcti_cache->hit = NULL;
+    tcti_cache->command_size = 0;
+    if (tcti_cache_cc_in_list (header.code, invalidating_commands,
+                               SIZE_OF_ARY (invalidating_commands))) {
+        LOG_DEBUG ("Command 0x%" PRIx32 " invalidates the response cache",
+                   header.code);
+        tcti_cache_flush (tcti_cache);
+        tcti_cache->stats.invalidations++;
+    } else if (tcti_cache_is_cacheable (tcti_cache, &header, cmd_buf, size)) {
+        tcti_cache->hit = tcti_cache_lookup (tcti_cache, cmd_buf, size);
+        if (tcti_cache->hit != NULL) {
+            LOG_DEBUG ("Serving command 0x%" PRIx32 " from cache", header.code);
+            tcti_cache->stats.hits++;
+            tcti_common->state = TCTI_STATE_RECEIVE;
+            return TSS2_RC_SUCCESS;
+        }
+        tcti_cache->stats.misses++;
+        memcpy (tcti_cache->command, cmd_buf, size);
+        tcti_cache->command_size = size;
+    }
+
+    rc = Tss2_Tcti_Transmit (tcti_cache->tcti_child, size, cmd_buf);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Failed calling TCTI transmit of child TCTI module");
+        tcti_cache->command_size = 0;
+        return rc;
+    }
+
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_cache_receive_hit (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    size_t *response_size,
+    unsigned char *response_buffer)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    tcti_cache_entry_t *entry = tcti_cache->hit;
+
+    if (response_buffer == NULL) {
+        *response_size = entry->response_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*response_size < entry->response_size) {
+        *response_size = entry->response_size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+
+    memcpy (response_buffer, entry->response, entry->response_size);
+    *response_size = entry->response_size;
+    tcti_cache->hit = NULL;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_cache_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    unsigned char *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    tpm_header_t header;
+    TSS2_RC rc;
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_receive_checks (tcti_common, response_size,
+                                     TCTI_CACHE_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    if (tcti_cache->hit != NULL) {
+        return tcti_cache_receive_hit (tcti_cache, response_size,
+                                       response_buffer);
+    }
+
+    rc = Tss2_Tcti_Receive (tcti_cache->tcti_child,
+                            response_size, response_buffer,
+                            timeout);
+    if (rc != TSS2_RC_SUCCESS || response_buffer == NULL) {
+        return rc;
+    }
+
+    /* Only successful responses are cached. */
+    if (tcti_cache->command_size != 0 &&
+        *response_size >= TPM_HEADER_SIZE &&
+        header_unmarshal (response_buffer, &header) == TSS2_RC_SUCCESS &&
+        header.code == TPM2_RC_SUCCESS) {
+        tcti_cache_insert (tcti_cache, response_buffer, *response_size);
+    }
+
+    tcti_cache->command_size = 0;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return rc;
+}
+
+TSS2_RC
+tcti_cache_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    TSS2_RC rc;
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_cancel_checks (tcti_common, TCTI_CACHE_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    if (tcti_cache->hit == NULL) {
+        rc = Tss2_Tcti_Cancel (tcti_cache->tcti_child);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    tcti_cache->hit = NULL;
+    tcti_cache->command_size = 0;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return rc;
+}
+
+TSS2_RC
+tcti_cache_set_locality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    TSS2_RC rc;
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    rc = tcti_common_set_locality_checks (tcti_common, TCTI_CACHE_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    rc = Tss2_Tcti_SetLocality (tcti_cache->tcti_child, locality);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    tcti_common->locality = locality;
+    return rc;
+}
+
+TSS2_RC
+tcti_cache_get_poll_handles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tctiContext);
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    return Tss2_Tcti_GetPollHandles (tcti_cache->tcti_child, handles,
+                                     num_handles);
+}
+
+void
+tcti_cache_finalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = tcti_cache_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+
+    if (tcti_cache == NULL) {
+        return;
+    }
+
+    Tss2_TctiLdr_Finalize (&tcti_cache->tcti_child);
+    tcti_cache_flush (tcti_cache);
+
+    tcti_common->state = TCTI_STATE_FINAL;
+}
+
+/*
+ * Report how many responses were served from the cache and how many
+ * cacheable commands had to be sent to the TPM. The context may be the
+ * tctildr context that loaded the cache TCTI.
+ */
+TSS2_RC
+Tss2_Tcti_Cache_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_CACHE_STATS *stats)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache =
+        tcti_cache_context_cast (tcti_tctildr_child (tctiContext));
+
+    if (tcti_cache == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (stats == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+
+    *stats = tcti_cache->stats;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * This is an implementation of the standard TCTI initialization function for
+ * this module.
+ */
+TSS2_RC
+Tss2_Tcti_Cache_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf)
+{
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache = (TSS2_TCTI_CACHE_CONTEXT*) tctiContext;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cache_down_cast (tcti_cache);
+    const char *commands;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_CACHE_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (conf == NULL) {
+        LOG_TRACE ("tctiContext: 0x%" PRIxPTR ", size: 0x%" PRIxPTR ""
+                   " no configuration will be used.",
+                   (uintptr_t)tctiContext, (uintptr_t)size);
+    } else {
+        LOG_TRACE ("tctiContext: 0x%" PRIxPTR ", size: 0x%" PRIxPTR ", conf: %s",
+                   (uintptr_t)tctiContext, (uintptr_t)size, conf);
+    }
+
+    memset (tcti_cache, 0, sizeof (*tcti_cache));
+    commands = getenv (ENV_CACHE_COMMANDS);
+    if (commands == NULL) {
+        memcpy (tcti_cache->commands, default_commands,
+                sizeof (default_commands));
+        tcti_cache->num_commands = SIZE_OF_ARY (default_commands);
+    } else {
+        rc = tcti_cache_parse_commands (tcti_cache, commands);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+
+    rc = Tss2_TctiLdr_Initialize (conf, &tcti_cache->tcti_child);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Error loading TCTI: %s", conf);
+        return rc;
+    }
+
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_CACHE_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_cache_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_cache_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = tcti_cache_finalize;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_cache_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_cache_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_cache_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = tcti_make_sticky_not_implemented;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    tcti_common->locality = 3;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/* public info structure */
+const TSS2_TCTI_INFO tss2_tcti_info = {
+    .version = TCTI_VERSION,
+    .name = "tcti-cache",
+    .description = "TCTI module for caching responses to read-only TPM "
+                   "commands.",
+    .config_help = "The child tcti module and its config string: <name>:<conf>",
+    .init = Tss2_Tcti_Cache_Init,
+};
+
+const TSS2_TCTI_INFO*
+Tss2_Tcti_Info (void)
+{
+    return &tss2_tcti_info;
+}
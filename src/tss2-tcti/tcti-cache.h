@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+
+#ifndef TCTI_CACHE_H
+#define TCTI_CACHE_H
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_cache.h"
+#include "tcti-common.h"
+
+#define TCTI_CACHE_MAGIC 0xd1e8b0c47a5f3926ULL
+
+#define ENV_CACHE_COMMANDS "TCTI_CACHE_COMMANDS"
+#define TCTI_CACHE_MAX_COMMANDS 32
+#define TCTI_CACHE_ENTRIES 32
+#define TCTI_CACHE_MAX_COMMAND_SIZE 64
+
+typedef struct {
+    uint8_t command [TCTI_CACHE_MAX_COMMAND_SIZE];
+    size_t command_size;
+    uint8_t *response;
+    size_t response_size;
+    uint64_t last_used;
+} tcti_cache_entry_t;
+
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    TSS2_TCTI_CONTEXT *tcti_child;
+    /* command codes whose responses are cached */
+    TPM2_CC commands [TCTI_CACHE_MAX_COMMANDS];
+    size_t num_commands;
+    tcti_cache_entry_t entries [TCTI_CACHE_ENTRIES];
+    uint64_t clock;
+    /* entry holding the response to the current command on a cache hit */
+    tcti_cache_entry_t *hit;
+    /* copy of the current command if its response is to be cached */
+    uint8_t command [TCTI_CACHE_MAX_COMMAND_SIZE];
+    size_t command_size;
+    TSS2_TCTI_CACHE_STATS stats;
+} TSS2_TCTI_CACHE_CONTEXT;
+
+TSS2_RC
+tcti_cache_parse_commands (
+    TSS2_TCTI_CACHE_CONTEXT *tcti_cache,
+    const char *commands);
+
+#endif /* TCTI_CACHE_H */
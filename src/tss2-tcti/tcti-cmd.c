@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
 
@@ -25,16 +26,20 @@
 #include <sys/wait.h>
 #include <sys/time.h>
 
+#include "tss2_mu.h"
 #include "tss2_tcti_cmd.h"
 
 #include "tcti-cmd.h"
 #include "tcti-common.h"
+#include "util/key-value-parse.h"
 #define LOGMODULE tcti
 #include "util/log.h"
 
 #define PIPE_READ_END  0
 #define PIPE_WRITE_END 1
 
+#define TCTI_CMD_CONF_PIPELINE "pipeline="
+
 /* do this as a macro **on one line** so LINENO and everything is preserved */
 #define close_fd(fd) do { if (close (fd)) { LOG_WARNING ("Could not close fd (%d): %s", fd, strerror (errno)); } } while (0)
 
@@ -71,12 +76,6 @@ int tcti_cmd_fork (void)
     return fork ();
 }
 
-TEST_VISIBILITY WEAK
-FILE * tcti_cmd_fdopen (int fd, const char *mode)
-{
-    return fdopen (fd, mode);
-}
-
 TEST_VISIBILITY WEAK
 int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
 {
@@ -84,22 +83,9 @@ int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
 }
 
 TEST_VISIBILITY WEAK
-size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream)
+ssize_t tcti_cmd_write (int fd, const uint8_t *buf, size_t size)
 {
-    return fwrite (ptr, size, nmemb, stream);
-}
-
-TEST_VISIBILITY WEAK
-size_t tcti_cmd_fread (void *ptr, size_t size, size_t nmemb, FILE *stream)
-{
-    return fread (ptr, size, nmemb, stream);
-}
-
-TEST_VISIBILITY WEAK
-int tcti_cmd_ferror (FILE *stream)
-{
-    return ferror (stream);
+    return write_all (fd, buf, size);
 }
 
 static int
@@ -269,8 +255,8 @@ error:
 /*
  * Returns 0 on success or errno on error.
  */
-static int popen_w_pipes (const char *cmd, pid_t *pid, FILE **sink,
-        FILE **source)
+static int popen_w_pipes (const char *cmd, pid_t *pid, int *sink,
+        int *source)
 {
 
     pid_t _pid = 0;
@@ -319,47 +305,22 @@ static int popen_w_pipes (const char *cmd, pid_t *pid, FILE **sink,
     close_fd (stdout_pipefd[PIPE_WRITE_END]);
 
     /*
-     * make them stdio.h file streams so we don't have to worry
-     * about low level IO details.
+     * The raw pipe ends are used so that responses can be polled for and
+     * read without the buffering of stdio.h file streams getting in the way.
      */
-    *sink = tcti_cmd_fdopen (stdin_pipefd[1], "wb");
-    if (!*sink) {
-        rc = errno;
-        LOG_ERROR ("Could not fdopen sink: %s", strerror (errno));
-        goto error_close_all;
-    }
-
-    *source = tcti_cmd_fdopen (stdout_pipefd[0], "rb");
-    if (!*source) {
-        rc = errno;
-        LOG_ERROR ("Could not fdopen source: %s", strerror (errno));
-        fclose (*sink);
-        goto error_close_all;
-    }
-
-    rc = setvbuf (*sink, NULL, _IONBF, 0);
-    if (rc) {
-        LOG_WARNING ("Could not set stdin child pipe to non-buffering: %s",
-                strerror (errno));
-    }
-
-    rc = setvbuf (*source, NULL, _IONBF, 0);
-    if (rc) {
-        LOG_WARNING ("Could not set stdout child pipe to non-buffering: %s",
-                strerror (errno));
-    }
-
+    *sink = stdin_pipefd[PIPE_WRITE_END];
+    *source = stdout_pipefd[PIPE_READ_END];
     *pid = _pid;
 
     /* parent */
-    return rc;
+    return 0;
 
 error_close_all:
     pipe_close (stdout_pipefd);
 error_close_stdin:
     pipe_close (stdin_pipefd);
 
-    *sink = *source = NULL;
+    *sink = *source = -1;
 
     /* The parent had an issue, so reap the child */
     if (_pid > 0) {
@@ -401,20 +362,49 @@ TSS2_RC tcti_cmd_transmit (TSS2_TCTI_CONTEXT *tcti_ctx, size_t size,
 {
     TSS2_TCTI_CMD_CONTEXT *tcti_cmd = tcti_cmd_context_cast (tcti_ctx);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    uint8_t frame[TCTI_CMD_TAG_SIZE + TPM2_MAX_COMMAND_SIZE];
+    const uint8_t *buf = cmd_buf;
+    size_t offset = 0;
+    ssize_t bytes;
 
     TSS2_RC rc = tcti_common_transmit_checks (tcti_common, cmd_buf,
             TCTI_CMD_MAGIC);
+    if (rc == TSS2_TCTI_RC_BAD_SEQUENCE &&
+        tcti_cmd->inflight_count < tcti_cmd->pipeline) {
+        /* tagged commands may be sent while others are still in flight */
+        rc = TSS2_RC_SUCCESS;
+    }
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
 
-    size_t bytes = tcti_cmd_fwrite (cmd_buf, 1, size, tcti_cmd->sink);
-    if (tcti_cmd_ferror (tcti_cmd->sink) || bytes != size) {
+    if (tcti_cmd->pipeline > 0) {
+        if (size > TPM2_MAX_COMMAND_SIZE) {
+            LOG_ERROR ("Command size %zu exceeds maximum of %u", size,
+                    TPM2_MAX_COMMAND_SIZE);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        rc = Tss2_MU_UINT32_Marshal (tcti_cmd->next_tag, frame, sizeof (frame),
+                &offset);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        memcpy (&frame[offset], cmd_buf, size);
+        buf = frame;
+        size += offset;
+    }
+
+    bytes = tcti_cmd_write (tcti_cmd->sink, buf, size);
+    if (bytes < 0 || (size_t)bytes != size) {
         LOG_ERROR ("Transmitting to subprocess failed: %s", strerror (errno));
         return TSS2_TCTI_RC_IO_ERROR;
     }
 
-    fflush (tcti_cmd->sink);
+    if (tcti_cmd->pipeline > 0) {
+        tcti_cmd->inflight[(tcti_cmd->inflight_head + tcti_cmd->inflight_count)
+                % TCTI_CMD_PIPELINE_MAX] = tcti_cmd->next_tag++;
+        tcti_cmd->inflight_count++;
+    }
 
     tcti_common->state = TCTI_STATE_RECEIVE;
 
@@ -437,12 +427,8 @@ TSS2_RC tcti_cmd_get_poll_handles (TSS2_TCTI_CONTEXT *tctiContext,
 
     *num_handles = 1;
     if (handles != NULL) {
-        handles->fd = fileno (cmd_tcti->source);
-        if (handles->fd < 0) {
-            LOG_ERROR ("Could not get fileno: %s", strerror (errno));
-            return TSS2_TCTI_RC_IO_ERROR;
-        }
-        handles->events = POLLIN | POLLOUT;
+        handles->fd = cmd_tcti->source;
+        handles->events = POLLIN;
     }
 
     return TSS2_RC_SUCCESS;
@@ -458,8 +444,168 @@ void tcti_cmd_finalize (TSS2_TCTI_CONTEXT *tctiContext)
 
     reap_child (tcti_cmd->child_pid);
 
-    fclose (tcti_cmd->source);
-    fclose (tcti_cmd->sink);
+    close_fd (tcti_cmd->source);
+    close_fd (tcti_cmd->sink);
+    free (tcti_cmd->parked);
+    tcti_cmd->parked = NULL;
+}
+
+/*
+ * Read from the subprocess until the context buffer holds a complete
+ * response frame and return the size of that frame. Data received before a
+ * timeout is kept in the context for the next call.
+ */
+static TSS2_RC
+tcti_cmd_recv_frame (TSS2_TCTI_CMD_CONTEXT *tcti_cmd, int32_t timeout,
+        size_t *frame_size)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    size_t prefix = tcti_cmd->pipeline > 0 ? TCTI_CMD_TAG_SIZE : 0;
+    TSS2_RC rc;
+
+    rc = socket_recv_buffered (tcti_cmd->source, tcti_cmd->rsp_buf,
+            sizeof (tcti_cmd->rsp_buf), &tcti_cmd->rsp_count,
+            prefix + TPM_HEADER_SIZE, timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    rc = header_unmarshal (&tcti_cmd->rsp_buf[prefix], &tcti_common->header);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    if (tcti_common->header.size < TPM_HEADER_SIZE ||
+        tcti_common->header.size > TPM2_MAX_RESPONSE_SIZE) {
+        LOG_ERROR ("Header response size %" PRIu32 " is not between %zu"
+                " and %u", tcti_common->header.size, TPM_HEADER_SIZE,
+                TPM2_MAX_RESPONSE_SIZE);
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+
+    *frame_size = prefix + tcti_common->header.size;
+
+    return socket_recv_buffered (tcti_cmd->source, tcti_cmd->rsp_buf,
+            sizeof (tcti_cmd->rsp_buf), &tcti_cmd->rsp_count, *frame_size,
+            timeout);
+}
+
+static tcti_cmd_response_t *
+tcti_cmd_find_parked (TSS2_TCTI_CMD_CONTEXT *tcti_cmd, uint32_t tag)
+{
+    size_t i;
+
+    for (i = 0; i < tcti_cmd->parked_count; i++) {
+        if (tcti_cmd->parked[i].tag == tag) {
+            return &tcti_cmd->parked[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Move the tagged frame at the start of the context buffer to a free parked
+ * slot. The tag must belong to a command in flight that has no response yet.
+ */
+static TSS2_RC
+tcti_cmd_park_frame (TSS2_TCTI_CMD_CONTEXT *tcti_cmd, size_t frame_size)
+{
+    tcti_cmd_response_t *slot;
+    uint32_t tag;
+    size_t i;
+
+    TSS2_RC rc = Tss2_MU_UINT32_Unmarshal (tcti_cmd->rsp_buf,
+            TCTI_CMD_TAG_SIZE, NULL, &tag);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    for (i = 0; i < tcti_cmd->inflight_count; i++) {
+        if (tcti_cmd->inflight[(tcti_cmd->inflight_head + i)
+                % TCTI_CMD_PIPELINE_MAX] == tag) {
+            break;
+        }
+    }
+    if (i == tcti_cmd->inflight_count ||
+        tcti_cmd_find_parked (tcti_cmd, tag) != NULL) {
+        LOG_ERROR ("Response with unexpected tag 0x%08" PRIx32, tag);
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+
+    slot = &tcti_cmd->parked[tcti_cmd->parked_count++];
+    slot->tag = tag;
+    slot->size = frame_size - TCTI_CMD_TAG_SIZE;
+    memcpy (slot->buf, &tcti_cmd->rsp_buf[TCTI_CMD_TAG_SIZE], slot->size);
+
+    /* keep data of following frames that was read along with this one */
+    tcti_cmd->rsp_count -= frame_size;
+    memmove (tcti_cmd->rsp_buf, &tcti_cmd->rsp_buf[frame_size],
+            tcti_cmd->rsp_count);
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Return the response to the oldest command in flight. Responses to newer
+ * commands that arrive before it are parked until they are asked for.
+ */
+static TSS2_RC
+tcti_cmd_receive_tagged (TSS2_TCTI_CMD_CONTEXT *tcti_cmd,
+        size_t *response_size, unsigned char *response_buffer,
+        int32_t timeout)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    uint32_t tag = tcti_cmd->inflight[tcti_cmd->inflight_head];
+    tcti_cmd_response_t *slot;
+    size_t frame_size;
+    TSS2_RC rc;
+
+    while ((slot = tcti_cmd_find_parked (tcti_cmd, tag)) == NULL) {
+        rc = tcti_cmd_recv_frame (tcti_cmd, timeout, &frame_size);
+        if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+            return rc;
+        } else if (rc != TSS2_RC_SUCCESS) {
+            goto out;
+        }
+
+        rc = tcti_cmd_park_frame (tcti_cmd, frame_size);
+        if (rc != TSS2_RC_SUCCESS) {
+            goto out;
+        }
+    }
+
+    if (*response_size < slot->size) {
+        LOG_ERROR ("Response size to big: %zu < %zu", *response_size,
+                slot->size);
+        *response_size = slot->size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy (response_buffer, slot->buf, slot->size);
+    *response_size = slot->size;
+
+    if (slot != &tcti_cmd->parked[tcti_cmd->parked_count - 1]) {
+        *slot = tcti_cmd->parked[tcti_cmd->parked_count - 1];
+    }
+    tcti_cmd->parked_count--;
+    tcti_cmd->inflight_head = (tcti_cmd->inflight_head + 1)
+            % TCTI_CMD_PIPELINE_MAX;
+    tcti_cmd->inflight_count--;
+
+    if (tcti_cmd->inflight_count == 0) {
+        tcti_common->state = TCTI_STATE_TRANSMIT;
+    }
+
+    return TSS2_RC_SUCCESS;
+
+out:
+    /* the stream can not be resynchronized, drop everything in flight */
+    tcti_cmd->inflight_count = 0;
+    tcti_cmd->parked_count = 0;
+    tcti_cmd->rsp_count = 0;
+    tcti_common->header.size = 0;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+
+    return rc;
 }
 
 TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
@@ -471,6 +617,7 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
 #endif
     TSS2_TCTI_CMD_CONTEXT *tcti_cmd = tcti_cmd_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    size_t frame_size;
     TSS2_RC rc;
 
     rc = tcti_common_receive_checks (tcti_common, response_size,
@@ -480,7 +627,6 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
     }
 
     if (timeout != TSS2_TCTI_TIMEOUT_BLOCK) {
-        LOG_TRACE ("Asynchronous I/O not actually implemented.");
 #ifdef TEST_FAPI_ASYNC
         if (wait < 1) {
             LOG_TRACE ("Simulating Async by requesting another invocation.");
@@ -494,66 +640,34 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
     }
 
     if (!response_buffer) {
-        *response_size = 4096;
+        *response_size = TPM2_MAX_RESPONSE_SIZE;
         return TSS2_RC_SUCCESS;
     }
 
-    /* block until we have a header or the child closes the pipe */
-    size_t size = tcti_cmd_fread (response_buffer, 1, TPM_HEADER_SIZE, tcti_cmd->source);
-    rc = tcti_cmd_ferror (tcti_cmd->source);
-    if (rc) {
-        LOG_ERROR ("Reading from command TCTI: %s", strerror (errno));
-        rc = TSS2_TCTI_RC_IO_ERROR;
-        goto out;
-    }
-
-    if (size != TPM_HEADER_SIZE) {
-        LOG_ERROR ("Read was not size of header, got %zu expected %zu",
-                size, TPM_HEADER_SIZE);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
-        goto out;
+    if (tcti_cmd->pipeline > 0) {
+        return tcti_cmd_receive_tagged (tcti_cmd, response_size,
+                response_buffer, timeout);
     }
 
     /*
-     * we have a header, get the size field to compute the rest of
-     * the data.
+     * The response is read into the context buffer, data received before a
+     * timeout is kept so the next call continues where this one stopped.
      */
-    rc = header_unmarshal (response_buffer, &tcti_common->header);
-    if (rc) {
-        goto out;
-    }
-
-    if (tcti_common->header.size < TPM_HEADER_SIZE) {
-        LOG_ERROR ("Header response size is less than TPM_HEADER_SIZE,"
-                " got %" PRIu32 " expected greater than or equal to %zu",
-                tcti_common->header.size, TPM_HEADER_SIZE);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
-        goto out;
-    }
-
-    /*
-     * Read the remaining data that is past the header size
-     */
-    size_t data_size = tcti_common->header.size - TPM_HEADER_SIZE;
-
-    size = tcti_cmd_fread (&response_buffer[TPM_HEADER_SIZE], 1, data_size,
-            tcti_cmd->source);
-    rc = tcti_cmd_ferror (tcti_cmd->source);
-    if (rc) {
-        rc = errno == EFAULT ?
-                TSS2_TCTI_RC_INSUFFICIENT_BUFFER : TSS2_TCTI_RC_IO_ERROR;
-        LOG_ERROR ("Reading from command TCTI: %s", strerror (errno));
+    rc = tcti_cmd_recv_frame (tcti_cmd, timeout, &frame_size);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        return rc;
+    } else if (rc != TSS2_RC_SUCCESS) {
         goto out;
     }
 
-    if (size != data_size) {
-        LOG_ERROR ("Command response body read was not for expected size, "
-                "got %zu expected %zu", size, data_size);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
-        goto out;
+    if (*response_size < frame_size) {
+        LOG_ERROR ("Response size to big: %zu < %zu", *response_size,
+                frame_size);
+        *response_size = frame_size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
     }
-
-    *response_size = tcti_common->header.size;
+    memcpy (response_buffer, tcti_cmd->rsp_buf, frame_size);
+    *response_size = frame_size;
 
     /*
      * Executing code beyond this point transitions the state machine to
@@ -562,6 +676,7 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
      */
 out:
     tcti_common->header.size = 0;
+    tcti_cmd->rsp_count = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
 
     return rc;
@@ -581,6 +696,36 @@ void tcti_cmd_init_context_data (TSS2_TCTI_COMMON_CONTEXT *tcti_common)
     memset (&tcti_common->header, 0, sizeof (tcti_common->header));
 }
 
+static TSS2_RC
+cmd_kv_callback (const key_value_t *key_value,
+                 void *user_data)
+{
+    TSS2_TCTI_CMD_CONTEXT *tcti_cmd = (TSS2_TCTI_CMD_CONTEXT*)user_data;
+    unsigned long pipeline;
+    char *end;
+
+    if (key_value == NULL || user_data == NULL) {
+        LOG_WARNING ("%s passed NULL parameter", __func__);
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+    LOG_DEBUG ("key: %s / value: %s\n", key_value->key, key_value->value);
+    if (strcmp (key_value->key, "pipeline") == 0) {
+        errno = 0;
+        pipeline = strtoul (key_value->value, &end, 10);
+        if (errno != 0 || end == key_value->value || *end != '\0' ||
+            pipeline < 1 || pipeline > TCTI_CMD_PIPELINE_MAX) {
+            LOG_ERROR ("Invalid pipeline depth %s, must be between 1 and %d",
+                    key_value->value, TCTI_CMD_PIPELINE_MAX);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        tcti_cmd->pipeline = pipeline;
+        return TSS2_RC_SUCCESS;
+    } else {
+        LOG_ERROR ("Invalid cmd option: %s", key_value->key);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+}
+
 /*
  * This is an implementation of the standard TCTI initialization function for
  * this module.
@@ -591,6 +736,9 @@ TSS2_RC Tss2_Tcti_Cmd_Init (TSS2_TCTI_CONTEXT *tctiContext, size_t *size,
     TSS2_TCTI_CMD_CONTEXT *tcti_command =
             (TSS2_TCTI_CMD_CONTEXT*) tctiContext;
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_command);
+    const char *cmd = conf;
+    char *conf_copy, *separator;
+    TSS2_RC rval;
 
     if (size == NULL || conf == NULL) {
         return TSS2_TCTI_RC_BAD_VALUE;
@@ -601,17 +749,61 @@ TSS2_RC Tss2_Tcti_Cmd_Init (TSS2_TCTI_CONTEXT *tctiContext, size_t *size,
         return TSS2_RC_SUCCESS;
     }
 
-    LOG_DEBUG ("Initializing command TCTI with command: %s", conf);
-
-    tcti_command->sink = NULL;
-    tcti_command->source = NULL;
+    tcti_command->sink = -1;
+    tcti_command->source = -1;
     tcti_command->child_pid = -1;
+    tcti_command->pipeline = 0;
+    tcti_command->next_tag = 0;
+    tcti_command->inflight_head = 0;
+    tcti_command->inflight_count = 0;
+    tcti_command->rsp_count = 0;
+    tcti_command->parked = NULL;
+    tcti_command->parked_count = 0;
+
+    /*
+     * Options are only recognized in front of the command if the conf string
+     * starts with a known key, anything else is passed to the shell as is.
+     */
+    if (strncmp (conf, TCTI_CMD_CONF_PIPELINE,
+                 strlen (TCTI_CMD_CONF_PIPELINE)) == 0) {
+        separator = strchr (conf, ';');
+        if (separator == NULL) {
+            LOG_ERROR ("Options must be separated from the command by ';'");
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        conf_copy = strndup (conf, separator - conf);
+        if (conf_copy == NULL) {
+            LOG_ERROR ("Failed to allocate memory for the conf string");
+            return TSS2_TCTI_RC_MEMORY;
+        }
+        rval = parse_key_value_string (conf_copy, cmd_kv_callback,
+                tcti_command);
+        free (conf_copy);
+        if (rval != TSS2_RC_SUCCESS) {
+            return rval;
+        }
+        cmd = separator + 1;
+    }
+
+    /* no more responses than commands in flight can be parked */
+    if (tcti_command->pipeline > 0) {
+        tcti_command->parked = calloc (tcti_command->pipeline,
+                sizeof (*tcti_command->parked));
+        if (tcti_command->parked == NULL) {
+            LOG_ERROR ("Failed to allocate memory for the pipeline");
+            return TSS2_TCTI_RC_MEMORY;
+        }
+    }
+
+    LOG_DEBUG ("Initializing command TCTI with command: %s", cmd);
 
-    int rc = popen_w_pipes (conf, &tcti_command->child_pid, &tcti_command->sink,
+    int rc = popen_w_pipes (cmd, &tcti_command->child_pid, &tcti_command->sink,
             &tcti_command->source);
     if (rc != 0) {
-        LOG_ERROR ("Open subprocess command \"%s\", failed with: %s", conf,
+        LOG_ERROR ("Open subprocess command \"%s\", failed with: %s", cmd,
                 strerror (rc));
+        free (tcti_command->parked);
+        tcti_command->parked = NULL;
         return TSS2_TCTI_RC_GENERAL_FAILURE;
     }
 
@@ -15,18 +15,50 @@
 #define TCTI_CMD_NAME "tcti-cmd"
 #define TCTI_CMD_DESCRIPTION "TCTI module for using a process to send and receive data."
 #define TCTI_CMD_HELP "string used as command, passed to " \
-                "execl(\"/bin/sh\", \"sh\", \"-c\", command, (char *) 0);."
+                "execl(\"/bin/sh\", \"sh\", \"-c\", command, (char *) 0);. " \
+                "Prefix with \"pipeline=<n>;\" to keep up to n tagged " \
+                "commands in flight."
 
 #define TCTI_CMD_MAGIC 0xf05b04cd9f02728dULL
 
+/*
+ * With the pipeline option every command and response exchanged with the
+ * subprocess is prefixed by a 4 byte big endian tag. The subprocess echoes
+ * the tag of a command in front of its response and may answer in any order.
+ */
+#define TCTI_CMD_TAG_SIZE 4
+#define TCTI_CMD_PIPELINE_MAX 8
+
+typedef struct {
+    uint32_t tag;
+    size_t size;
+    uint8_t buf[TPM2_MAX_RESPONSE_SIZE];
+} tcti_cmd_response_t;
+
 typedef struct TSS2_TCTI_CMD_CONTEXT TSS2_TCTI_CMD_CONTEXT;
 struct TSS2_TCTI_CMD_CONTEXT {
     TSS2_TCTI_COMMON_CONTEXT common;
     /* stdin of the subprocess */
-    FILE *sink;
+    int sink;
     /* stdout of the subprocess */
-    FILE *source;
+    int source;
     pid_t child_pid;
+    /* maximum number of tagged commands in flight, 0 without tagging */
+    size_t pipeline;
+    uint32_t next_tag;
+    /* tags of the commands in flight, oldest first */
+    uint32_t inflight[TCTI_CMD_PIPELINE_MAX];
+    size_t inflight_head;
+    size_t inflight_count;
+    /* data read from the subprocess but not yet returned */
+    uint8_t rsp_buf[TCTI_CMD_TAG_SIZE + TPM2_MAX_RESPONSE_SIZE];
+    size_t rsp_count;
+    /*
+     * responses that arrived before the response to an older command,
+     * pipeline slots allocated by Init only if pipeline is set
+     */
+    tcti_cmd_response_t *parked;
+    size_t parked_count;
 };
 
 /*
@@ -40,12 +72,8 @@ struct TSS2_TCTI_CMD_CONTEXT {
 
 WEAK int tcti_cmd_pipe (int pipefd[2]);
 WEAK int tcti_cmd_fork (void);
-WEAK FILE *tcti_cmd_fdopen (int fd, const char *mode);
 WEAK int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset);
-WEAK size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream);
-WEAK size_t tcti_cmd_fread (void *ptr, size_t size, size_t nmemb, FILE *stream);
-WEAK int tcti_cmd_ferror (FILE *stream);
+WEAK ssize_t tcti_cmd_write (int fd, const uint8_t *buf, size_t size);
 #endif
 
 #endif /* TCTI_CMD_H */
@@ -21,6 +21,7 @@
 #include "tss2_mu.h"
 
 #include "tcti-common.h"
+#include "tctildr.h"
 #define LOGMODULE tcti
 #include "util/log.h"
 
@@ -36,6 +37,15 @@ tcti_common_down_cast (TSS2_TCTI_COMMON_CONTEXT *ctx)
     return (TSS2_TCTI_CONTEXT*)&ctx->v2;
 }
 
+TSS2_TCTI_CONTEXT*
+tcti_tctildr_child (TSS2_TCTI_CONTEXT *ctx)
+{
+    if (ctx != NULL && TSS2_TCTI_MAGIC (ctx) == TCTILDR_MAGIC) {
+        return ((TSS2_TCTILDR_CONTEXT*)ctx)->tcti;
+    }
+    return ctx;
+}
+
 TSS2_RC
 tcti_common_cancel_checks (
     TSS2_TCTI_COMMON_CONTEXT *tcti_common,
@@ -71,6 +71,13 @@ tcti_common_context_cast (TSS2_TCTI_CONTEXT *ctx);
  */
 TSS2_TCTI_CONTEXT*
 tcti_common_down_cast (TSS2_TCTI_COMMON_CONTEXT *ctx);
+/*
+ * Applications usually hold the tctildr context that wraps a TCTI. This
+ * function returns the TCTI context loaded by tctildr if passed such a
+ * context and the context itself otherwise.
+ */
+TSS2_TCTI_CONTEXT*
+tcti_tctildr_child (TSS2_TCTI_CONTEXT *ctx);
 /*
  * This function performs checks on the common context structure passed to a
  * TCTI 'cancel' function.
@@ -94,6 +94,232 @@ tcti_device_down_cast (TSS2_TCTI_DEVICE_CONTEXT *tcti_dev)
     return &tcti_dev->common;
 }
 
+#ifdef HAVE_LIBURING
+/*
+ * Set up the io_uring used to exchange commands with the TPM. The device file
+ * is switched to blocking mode: io_uring fails a read from a non-blocking file
+ * that has no data yet instead of waiting for the response. Callers wait on
+ * the ring instead, which is returned by the getPollHandles function.
+ * Kernels before 5.6 set up a ring but reject IORING_OP_READ and
+ * IORING_OP_WRITE, the caller keeps using read() and write() then.
+ */
+TSS2_RC
+tcti_device_ring_init (
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev)
+{
+    struct io_uring_probe *probe;
+    int ret, flags;
+
+    ret = io_uring_queue_init (TCTI_DEVICE_RING_ENTRIES, &tcti_dev->ring, 0);
+    if (ret < 0) {
+        LOG_DEBUG ("Failed to set up io_uring, got errno %d: %s",
+                   -ret, strerror (-ret));
+        return TSS2_TCTI_RC_NOT_SUPPORTED;
+    }
+    /* The probe itself is only supported since 5.6 as well. */
+    probe = io_uring_get_probe_ring (&tcti_dev->ring);
+    if (probe == NULL ||
+        !io_uring_opcode_supported (probe, IORING_OP_READ) ||
+        !io_uring_opcode_supported (probe, IORING_OP_WRITE)) {
+        LOG_DEBUG ("io_uring does not support read and write requests");
+        if (probe != NULL) {
+            io_uring_free_probe (probe);
+        }
+        io_uring_queue_exit (&tcti_dev->ring);
+        return TSS2_TCTI_RC_NOT_SUPPORTED;
+    }
+    io_uring_free_probe (probe);
+    flags = fcntl (tcti_dev->fd, F_GETFL);
+    if (flags < 0 || fcntl (tcti_dev->fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+        LOG_DEBUG ("Failed to set fd %d to blocking mode, got errno %d: %s",
+                   tcti_dev->fd, errno, strerror (errno));
+        io_uring_queue_exit (&tcti_dev->ring);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    tcti_dev->ring_enabled = true;
+    tcti_dev->ring_inflight = 0;
+    tcti_dev->ring_error = 0;
+    tcti_dev->rsp_count = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Submit the write of the command and the read of the response as linked
+ * requests, so that the read is started by the kernel as soon as the write
+ * is done. The command is copied since the caller's buffer may be gone
+ * before the write is executed.
+ */
+static TSS2_RC
+tcti_device_ring_transmit (
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev,
+    size_t command_size,
+    const uint8_t *command_buffer)
+{
+    struct io_uring_sqe *sqe_write, *sqe_read;
+    int ret;
+
+    if (command_size > sizeof (tcti_dev->cmd_buf)) {
+        LOG_ERROR ("Command of %zu bytes exceeds the maximum of %zu bytes.",
+                   command_size, sizeof (tcti_dev->cmd_buf));
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    memcpy (tcti_dev->cmd_buf, command_buffer, command_size);
+    tcti_dev->cmd_size = command_size;
+    tcti_dev->rsp_count = 0;
+    tcti_dev->ring_error = 0;
+
+    /*
+     * Both entries are taken only if both are free, so that no prepared
+     * entry is left behind in the submission queue. The queue is full if
+     * earlier entries could not be submitted.
+     */
+    if (io_uring_sq_space_left (&tcti_dev->ring) < 2 ||
+        (sqe_write = io_uring_get_sqe (&tcti_dev->ring)) == NULL ||
+        (sqe_read = io_uring_get_sqe (&tcti_dev->ring)) == NULL) {
+        LOG_ERROR ("No free submission queue entry for fd %d.", tcti_dev->fd);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    io_uring_prep_write (sqe_write, tcti_dev->fd, tcti_dev->cmd_buf,
+                         command_size, 0);
+    io_uring_sqe_set_flags (sqe_write, IOSQE_IO_LINK);
+    io_uring_sqe_set_data (sqe_write, tcti_dev->cmd_buf);
+
+    io_uring_prep_read (sqe_read, tcti_dev->fd, tcti_dev->rsp_buf,
+                        sizeof (tcti_dev->rsp_buf), 0);
+    io_uring_sqe_set_data (sqe_read, tcti_dev->rsp_buf);
+
+    ret = io_uring_submit (&tcti_dev->ring);
+    if (ret < 0) {
+        LOG_ERROR ("Failed to submit command for fd %d, got errno %d: %s",
+                   tcti_dev->fd, -ret, strerror (-ret));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    tcti_dev->ring_inflight = ret;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Reap the completions of the requests submitted by the transmit function.
+ * The first error of either request is kept in 'ring_error'.
+ */
+static TSS2_RC
+tcti_device_ring_wait (
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev,
+    int32_t timeout)
+{
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts;
+    int ret;
+
+    while (tcti_dev->ring_inflight > 0) {
+        if (timeout == TSS2_TCTI_TIMEOUT_BLOCK) {
+            ret = io_uring_wait_cqe (&tcti_dev->ring, &cqe);
+        } else if (timeout == 0) {
+            ret = io_uring_peek_cqe (&tcti_dev->ring, &cqe);
+        } else {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+            ret = io_uring_wait_cqe_timeout (&tcti_dev->ring, &cqe, &ts);
+        }
+        if (ret == -ETIME || ret == -EAGAIN || ret == -EINTR) {
+            LOG_INFO ("Timed out waiting for response from fd %d.",
+                      tcti_dev->fd);
+            return TSS2_TCTI_RC_TRY_AGAIN;
+        } else if (ret < 0) {
+            LOG_ERROR ("Failed to wait for response from fd %d, got errno "
+                       "%d: %s", tcti_dev->fd, -ret, strerror (-ret));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+
+        if (cqe->res < 0) {
+            if (tcti_dev->ring_error == 0) {
+                tcti_dev->ring_error = -cqe->res;
+            }
+        } else if (io_uring_cqe_get_data (cqe) == tcti_dev->rsp_buf) {
+            tcti_dev->rsp_count = cqe->res;
+        } else if ((size_t)cqe->res != tcti_dev->cmd_size) {
+            LOG_ERROR ("wrong number of bytes written. Expected %zu, wrote %d.",
+                       tcti_dev->cmd_size, cqe->res);
+            tcti_dev->ring_error = EIO;
+        }
+        io_uring_cqe_seen (&tcti_dev->ring, cqe);
+        tcti_dev->ring_inflight--;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * The whole response is read into 'rsp_buf' by the request submitted with
+ * the command. The response size is thus known without reading the header
+ * separately, and the response can be copied out as often as the caller
+ * needs to find the right buffer size.
+ */
+static TSS2_RC
+tcti_device_ring_receive (
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev,
+    size_t *response_size,
+    uint8_t *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_device_down_cast (tcti_dev);
+    TSS2_RC rc;
+
+    rc = tcti_device_ring_wait (tcti_dev, timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    if (tcti_dev->ring_error != 0) {
+        LOG_ERROR ("Failed to exchange command with fd %d, got errno %d: %s",
+                   tcti_dev->fd, tcti_dev->ring_error,
+                   strerror (tcti_dev->ring_error));
+        rc = TSS2_TCTI_RC_IO_ERROR;
+        goto out;
+    }
+    if (tcti_dev->rsp_count == 0) {
+        LOG_WARNING ("Got EOF instead of response.");
+        rc = TSS2_TCTI_RC_NO_CONNECTION;
+        goto out;
+    }
+    if (tcti_dev->rsp_count < TPM_HEADER_SIZE) {
+        LOG_ERROR ("Received %zu bytes, not enough to hold a TPM2 response "
+                   "header.", tcti_dev->rsp_count);
+        rc = TSS2_TCTI_RC_GENERAL_FAILURE;
+        goto out;
+    }
+    rc = header_unmarshal (tcti_dev->rsp_buf, &tcti_common->header);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto out;
+    }
+    if (tcti_dev->rsp_count != tcti_common->header.size) {
+        LOG_WARNING ("TPM2 response size disagrees with number of bytes read "
+                     "from fd %d. Header says %u but we read %zu bytes.",
+                     tcti_dev->fd, tcti_common->header.size,
+                     tcti_dev->rsp_count);
+    }
+
+    if (response_buffer == NULL) {
+        *response_size = tcti_dev->rsp_count;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*response_size < tcti_dev->rsp_count) {
+        *response_size = tcti_dev->rsp_count;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy (response_buffer, tcti_dev->rsp_buf, tcti_dev->rsp_count);
+    *response_size = tcti_dev->rsp_count;
+    LOGBLOB_DEBUG (response_buffer, *response_size, "Response Received");
+
+out:
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return rc;
+}
+#endif /* HAVE_LIBURING */
+
 TSS2_RC
 tcti_device_transmit (
     TSS2_TCTI_CONTEXT *tctiContext,
@@ -115,6 +341,16 @@ tcti_device_transmit (
                    command_size,
                    "sending %zu byte command buffer:",
                    command_size);
+#ifdef HAVE_LIBURING
+    if (tcti_dev->ring_enabled) {
+        rc = tcti_device_ring_transmit (tcti_dev, command_size, command_buffer);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        tcti_common->state = TCTI_STATE_RECEIVE;
+        return TSS2_RC_SUCCESS;
+    }
+#endif
     size = write_all (tcti_dev->fd,
                       command_buffer,
                       command_size);
@@ -172,6 +408,12 @@ tcti_device_receive (
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
+#ifdef HAVE_LIBURING
+    if (tcti_dev->ring_enabled) {
+        return tcti_device_ring_receive (tcti_dev, response_size,
+                                         response_buffer, timeout);
+    }
+#endif
 
     if (!response_buffer) {
         if (!tcti_common->partial_read_supported) {
@@ -319,6 +561,11 @@ tcti_device_finalize (
     if (tcti_dev == NULL) {
         return;
     }
+#ifdef HAVE_LIBURING
+    if (tcti_dev->ring_enabled) {
+        io_uring_queue_exit (&tcti_dev->ring);
+    }
+#endif
     close (tcti_dev->fd);
     tcti_common->state = TCTI_STATE_FINAL;
 }
@@ -349,6 +596,13 @@ tcti_device_get_poll_handles (
     }
 
     *num_handles = 1;
+#ifdef HAVE_LIBURING
+    if (handles != NULL && tcti_dev->ring_enabled) {
+        handles->fd = tcti_dev->ring.ring_fd;
+        handles->events = POLLIN;
+        return TSS2_RC_SUCCESS;
+    }
+#endif
     if (handles != NULL) {
         handles->fd = tcti_dev->fd;
         handles->events = POLLIN | POLLOUT;
@@ -389,6 +643,9 @@ Tss2_Tcti_Device_Init (
     TSS2_TCTI_DEVICE_CONTEXT *tcti_dev;
     TSS2_TCTI_COMMON_CONTEXT *tcti_common;
     char *used_conf = NULL;
+#ifdef HAVE_LIBURING
+    const char *use_ring;
+#endif
 
     if (tctiContext == NULL && size == NULL) {
         return TSS2_TCTI_RC_BAD_VALUE;
@@ -413,6 +670,9 @@ Tss2_Tcti_Device_Init (
     memset (&tcti_common->header, 0, sizeof (tcti_common->header));
     tcti_common->locality = 3;
     tcti_common->partial = false;
+#ifdef HAVE_LIBURING
+    tcti_dev->ring_enabled = false;
+#endif
 
     if (conf == NULL) {
         LOG_TRACE ("No TCTI device file specified");
@@ -510,6 +770,15 @@ Tss2_Tcti_Device_Init (
         tcti_common->partial_read_supported = 1;
     }
 
+#ifdef HAVE_LIBURING
+    use_ring = getenv (ENV_DEVICE_IO_URING);
+    if (use_ring != NULL && strcmp (use_ring, "0") != 0 &&
+        tcti_device_ring_init (tcti_dev) != TSS2_RC_SUCCESS) {
+        LOG_WARNING ("io_uring not available, using blocking I/O on %s",
+                     used_conf);
+    }
+#endif
+
     return TSS2_RC_SUCCESS;
 }
 
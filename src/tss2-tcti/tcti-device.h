@@ -6,13 +6,42 @@
 #ifndef TCTI_DEVICE_H
 #define TCTI_DEVICE_H
 
+#include <stdbool.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
 #include "tcti-common.h"
 
 #define TCTI_DEVICE_MAGIC 0x89205e72e319e5bbULL
 
+#define ENV_DEVICE_IO_URING "TCTI_DEVICE_IO_URING"
+#define TCTI_DEVICE_RING_ENTRIES 4
+
 typedef struct {
     TSS2_TCTI_COMMON_CONTEXT common;
     int fd;
+#ifdef HAVE_LIBURING
+    /*
+     * With io_uring enabled a command is submitted as a write linked to the
+     * read of the whole response into 'rsp_buf'. 'ring_inflight' counts the
+     * submitted requests whose completion has not been reaped yet.
+     */
+    bool ring_enabled;
+    struct io_uring ring;
+    unsigned int ring_inflight;
+    int ring_error;
+    size_t cmd_size;
+    size_t rsp_count;
+    uint8_t cmd_buf [TPM2_MAX_COMMAND_SIZE];
+    uint8_t rsp_buf [TPM2_MAX_RESPONSE_SIZE];
+#endif
 } TSS2_TCTI_DEVICE_CONTEXT;
 
+#ifdef HAVE_LIBURING
+TSS2_RC
+tcti_device_ring_init (
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev);
+#endif
+
 #endif /* TCTI_DEVICE_H */
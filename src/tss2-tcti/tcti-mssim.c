@@ -141,27 +141,164 @@ send_sim_session_end (
 }
 
 /*
- * This function is used to send the simulator a sort of command message
- * that tells it we're about to send it a TPM command. This requires that
- * we first send it a 4 byte code that's defined by the simulator. Then
+ * Close both sockets. The next transmit reconnects to the simulator.
+ */
+static void
+tcti_mssim_disconnect (
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim)
+{
+    socket_close (&tcti_mssim->tpm_sock);
+    socket_close (&tcti_mssim->platform_sock);
+    tcti_mssim->rsp_count = 0;
+}
+
+static TSS2_RC simulator_setup (TSS2_TCTI_CONTEXT *tctiContext);
+
+/*
+ * Connect the TPM and platform sockets and power on the simulator.
+ */
+static TSS2_RC
+tcti_mssim_connect (
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim)
+{
+    mssim_conf_t *mssim_conf = &tcti_mssim->mssim_conf;
+    TSS2_RC rc;
+
+    rc = socket_connect_timeout (mssim_conf->host,
+                                 mssim_conf->port,
+                                 mssim_conf->socket.connect_timeout,
+                                 &tcti_mssim->tpm_sock);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto fail_out;
+    }
+
+    rc = socket_set_nonblock (tcti_mssim->tpm_sock);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto fail_out;
+    }
+
+    rc = socket_connect_timeout (mssim_conf->host,
+                                 mssim_conf->port + 1,
+                                 mssim_conf->socket.connect_timeout,
+                                 &tcti_mssim->platform_sock);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto fail_out;
+    }
+
+    rc = socket_set_io_timeout (tcti_mssim->platform_sock,
+                                mssim_conf->socket.io_timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto fail_out;
+    }
+
+    rc = simulator_setup ((TSS2_TCTI_CONTEXT*)tcti_mssim);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto fail_out;
+    }
+
+    return TSS2_RC_SUCCESS;
+
+fail_out:
+    tcti_mssim_disconnect (tcti_mssim);
+    return rc;
+}
+
+/*
+ * Reconnect after the connection to the simulator was lost. Failed attempts
+ * are retried up to 'reconnect' times with exponential backoff. A simulator
+ * that was restarted still needs a TPM2_Startup from the application.
+ */
+static TSS2_RC
+tcti_mssim_reconnect (
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim)
+{
+    socket_conf_t *conf = &tcti_mssim->mssim_conf.socket;
+    uint32_t delay = conf->reconnect_delay;
+    uint32_t attempt;
+    TSS2_RC rc;
+
+    tcti_mssim_disconnect (tcti_mssim);
+    for (attempt = 0; ; attempt++) {
+        rc = tcti_mssim_connect (tcti_mssim);
+        if (rc == TSS2_RC_SUCCESS) {
+            tcti_mssim->reconnects++;
+            tcti_mssim->cancel = 0;
+            LOG_WARNING ("Reconnected to simulator at %s:%" PRIu16 ", %"
+                         PRIu32 " reconnects, %" PRIu32 " failed attempts",
+                         tcti_mssim->mssim_conf.host,
+                         tcti_mssim->mssim_conf.port,
+                         tcti_mssim->reconnects,
+                         tcti_mssim->connect_failures);
+            return rc;
+        }
+        tcti_mssim->connect_failures++;
+        if (attempt >= conf->reconnect) {
+            LOG_ERROR ("Failed to reconnect to simulator after %" PRIu32
+                       " attempts", attempt + 1);
+            return rc;
+        }
+        socket_backoff (&delay);
+    }
+}
+
+/*
+ * Receive into the context buffer until it holds 'min' bytes. A blocking
+ * receive gives up after the configured IO timeout.
+ */
+static TSS2_RC
+tcti_mssim_recv (
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim,
+    size_t min,
+    int32_t timeout)
+{
+    uint32_t io_timeout = tcti_mssim->mssim_conf.socket.io_timeout;
+    TSS2_RC rc;
+
+    if (timeout != TSS2_TCTI_TIMEOUT_BLOCK || io_timeout == 0) {
+        return socket_recv_buffered (tcti_mssim->tpm_sock,
+                                     tcti_mssim->rsp_buf,
+                                     sizeof (tcti_mssim->rsp_buf),
+                                     &tcti_mssim->rsp_count,
+                                     min,
+                                     timeout);
+    }
+
+    rc = socket_recv_buffered (tcti_mssim->tpm_sock,
+                               tcti_mssim->rsp_buf,
+                               sizeof (tcti_mssim->rsp_buf),
+                               &tcti_mssim->rsp_count,
+                               min,
+                               io_timeout);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        LOG_ERROR ("No response from simulator within %" PRIu32 " ms",
+                   io_timeout);
+        rc = TSS2_TCTI_RC_IO_ERROR;
+    }
+    return rc;
+}
+
+/*
+ * This function builds the simulator command header that announces a TPM
+ * command to the simulator. The header starts with the 4 byte
+ * MS_SIM_TPM_SEND_COMMAND code that's defined by the simulator. Then
  * another byte identifying the locality and finally the size of the TPM
  * command buffer that we're about to send. After these 9 bytes are sent
  * the simulator will accept a TPM command buffer.
  */
 #define SIM_CMD_SIZE (sizeof (UINT32) + sizeof (UINT8) + sizeof (UINT32))
 TSS2_RC
-send_sim_cmd_setup (
+sim_cmd_setup_marshal (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim,
-    UINT32 size)
+    UINT32 size,
+    uint8_t buf [SIM_CMD_SIZE])
 {
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
-    uint8_t buf [SIM_CMD_SIZE] = { 0 };
     size_t offset = 0;
     TSS2_RC rc;
 
     rc = Tss2_MU_UINT32_Marshal (MS_SIM_TPM_SEND_COMMAND,
                                  buf,
-                                 sizeof (buf),
+                                 SIM_CMD_SIZE,
                                  &offset);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
@@ -169,18 +306,13 @@ send_sim_cmd_setup (
 
     rc = Tss2_MU_UINT8_Marshal (tcti_common->locality,
                                 buf,
-                                sizeof (buf),
+                                SIM_CMD_SIZE,
                                 &offset);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
 
-    rc = Tss2_MU_UINT32_Marshal (size, buf, sizeof (buf), &offset);
-    if (rc != TSS2_RC_SUCCESS) {
-        return rc;
-    }
-
-    return socket_xmit_buf (tcti_mssim->tpm_sock, buf, sizeof (buf));
+    return Tss2_MU_UINT32_Marshal (size, buf, SIM_CMD_SIZE, &offset);
 }
 
 TSS2_RC
@@ -192,6 +324,8 @@ tcti_mssim_transmit (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = tcti_mssim_context_cast (tcti_ctx);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
     tpm_header_t header;
+    uint8_t sim_cmd [SIM_CMD_SIZE] = { 0 };
+    struct iovec iov [2];
     TSS2_RC rc;
 
     rc = tcti_common_transmit_checks (tcti_common, cmd_buf, TCTI_MSSIM_MAGIC);
@@ -210,12 +344,30 @@ tcti_mssim_transmit (
 
     LOG_DEBUG ("Sending command with TPM_CC 0x%" PRIx32 " and size %" PRIu32,
                header.code, header.size);
-    rc = send_sim_cmd_setup (tcti_mssim, header.size);
+    rc = sim_cmd_setup_marshal (tcti_mssim, header.size, sim_cmd);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
-    rc = socket_xmit_buf (tcti_mssim->tpm_sock, cmd_buf, size);
+    /*
+     * Reconnect before sending if the connection was lost or the simulator
+     * went away while idle, so the command is not lost.
+     */
+    if (tcti_mssim->tpm_sock == INVALID_SOCKET ||
+        socket_peer_closed (tcti_mssim->tpm_sock)) {
+        rc = tcti_mssim_reconnect (tcti_mssim);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+    }
+    /* Send the simulator command setup and the TPM command in one go. */
+    iov [0].iov_base = sim_cmd;
+    iov [0].iov_len = sizeof (sim_cmd);
+    iov [1].iov_base = (void*)cmd_buf;
+    iov [1].iov_len = size;
+    LOGBLOB_DEBUG (cmd_buf, size, "Sending command buffer:");
+    rc = socket_xmit_bufv (tcti_mssim->tpm_sock, iov, 2);
     if (rc != TSS2_RC_SUCCESS) {
+        tcti_mssim_disconnect (tcti_mssim);
         return rc;
     }
 
@@ -243,6 +395,7 @@ tcti_mssim_cancel (
 
     tcti_common->state = TCTI_STATE_TRANSMIT;
     tcti_mssim->cancel = 1;
+    tcti_mssim->rsp_count = 0;
 
     return rc;
 }
@@ -307,6 +460,7 @@ tcti_mssim_finalize(
     send_sim_session_end (tcti_mssim->tpm_sock);
     socket_close (&tcti_mssim->platform_sock);
     socket_close (&tcti_mssim->tpm_sock);
+    free (tcti_mssim->conf_copy);
 }
 
 TSS2_RC
@@ -323,8 +477,6 @@ tcti_mssim_receive (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = tcti_mssim_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
     TSS2_RC rc;
-    UINT32 trash;
-    int ret;
 
     rc = tcti_common_receive_checks (tcti_common,
                                      response_size,
@@ -346,32 +498,32 @@ tcti_mssim_receive (
 #endif /* TEST_FAPI_ASYNC */
     }
 
-    if (tcti_common->header.size == 0) {
-        /* Receive the size of the response. */
-        uint8_t size_buf [sizeof (UINT32)];
-
-        ret = socket_poll(tcti_mssim->tpm_sock, timeout);
-        if (ret != TSS2_RC_SUCCESS) {
-            if (ret == TSS2_TCTI_RC_TRY_AGAIN) {
-                return ret;
-            }
-            rc = ret;
-            goto out;
-        }
-        ret = socket_recv_buf (tcti_mssim->tpm_sock, size_buf, sizeof(UINT32));
-        if (ret != sizeof (UINT32)) {
-            rc = TSS2_TCTI_RC_IO_ERROR;
+    /*
+     * The whole framed response is read into the context buffer, usually with
+     * a single read. Data received before a timeout is kept for the next call.
+     */
+    if (tcti_mssim->rsp_count < sizeof (UINT32)) {
+        rc = tcti_mssim_recv (tcti_mssim, sizeof (UINT32), timeout);
+        if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+            return rc;
+        } else if (rc != TSS2_RC_SUCCESS) {
             goto out;
         }
 
-        rc = Tss2_MU_UINT32_Unmarshal (size_buf,
-                                       sizeof (size_buf), 0,
+        rc = Tss2_MU_UINT32_Unmarshal (tcti_mssim->rsp_buf,
+                                       sizeof (UINT32), 0,
                                        &tcti_common->header.size);
         if (rc != TSS2_RC_SUCCESS) {
             LOG_WARNING ("Failed to unmarshal size from tpm2 simulator "
                          "protocol: 0x%" PRIu32, rc);
             goto out;
         }
+        if (tcti_common->header.size > TPM2_MAX_RESPONSE_SIZE) {
+            LOG_ERROR ("Response size %" PRIu32 " exceeds maximum of %u",
+                       tcti_common->header.size, TPM2_MAX_RESPONSE_SIZE);
+            rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
+            goto out;
+        }
 
         LOG_DEBUG ("response size: %" PRIu32, tcti_common->header.size);
     }
@@ -388,44 +540,21 @@ tcti_mssim_receive (
     }
     *response_size = tcti_common->header.size;
 
-    /* Receive the TPM response. */
+    /* Receive the rest of the TPM response and the appended four bytes of 0's */
     LOG_DEBUG ("Reading response of size %" PRIu32, tcti_common->header.size);
-    ret = socket_poll(tcti_mssim->tpm_sock, timeout);
-    if (ret != TSS2_RC_SUCCESS) {
-        if (ret == TSS2_TCTI_RC_TRY_AGAIN) {
-            return ret;
-        }
-        rc = ret;
-        goto out;
-    }
-    ret = socket_recv_buf (tcti_mssim->tpm_sock,
-                           (unsigned char *)response_buffer,
-                           tcti_common->header.size);
-    if (ret < (ssize_t)tcti_common->header.size) {
-        rc = TSS2_TCTI_RC_IO_ERROR;
+    rc = tcti_mssim_recv (tcti_mssim,
+                          tcti_common->header.size + MSSIM_RSP_FRAME_SIZE,
+                          timeout);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        return rc;
+    } else if (rc != TSS2_RC_SUCCESS) {
         goto out;
     }
+    memcpy (response_buffer, &tcti_mssim->rsp_buf [sizeof (UINT32)],
+            tcti_common->header.size);
     LOGBLOB_DEBUG(response_buffer, tcti_common->header.size,
                   "Response buffer received:");
 
-    ret = socket_poll (tcti_mssim->tpm_sock, timeout);
-    if (ret != TSS2_RC_SUCCESS) {
-        if (ret == TSS2_TCTI_RC_TRY_AGAIN) {
-            return ret;
-        }
-        rc = ret;
-        goto out;
-    }
-
-    /* Receive the appended four bytes of 0's */
-    ret = socket_recv_buf (tcti_mssim->tpm_sock,
-                           (unsigned char *)&trash, 4);
-    if (ret != 4) {
-        LOG_DEBUG ("Error reading last 4 bytes %" PRIu32, ret);
-        rc = TSS2_TCTI_RC_IO_ERROR;
-        goto out;
-    }
-
     if (tcti_mssim->cancel) {
         rc = tcti_platform_command (tctiContext, MS_SIM_CANCEL_OFF);
         tcti_mssim->cancel = 0;
@@ -436,7 +565,12 @@ tcti_mssim_receive (
      * another command is sent to the TPM.
      */
 out:
+    if (rc != TSS2_RC_SUCCESS) {
+        /* the stream can not be resynchronized, start over on a new one */
+        tcti_mssim_disconnect (tcti_mssim);
+    }
     tcti_common->header.size = 0;
+    tcti_mssim->rsp_count = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
 
     return rc;
@@ -521,7 +655,7 @@ mssim_kv_callback (const key_value_t *key_value,
         }
         return TSS2_RC_SUCCESS;
     } else {
-        return TSS2_TCTI_RC_BAD_VALUE;
+        return socket_conf_kv (key_value, &mssim_conf->socket);
     }
 }
 void
@@ -541,6 +675,31 @@ tcti_mssim_init_context_data (
     tcti_common->locality = 0;
     memset (&tcti_common->header, 0, sizeof (tcti_common->header));
 }
+/*
+ * Report how often the connection to the simulator was reestablished and how
+ * many connection attempts failed. The context may be the tctildr context
+ * that loaded the mssim TCTI.
+ */
+TSS2_RC
+Tss2_Tcti_Mssim_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_MSSIM_STATS *stats)
+{
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim =
+        tcti_mssim_context_cast (tcti_tctildr_child (tctiContext));
+
+    if (tcti_mssim == NULL ||
+        TSS2_TCTI_MAGIC (tcti_mssim) != TCTI_MSSIM_MAGIC) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (stats == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+
+    stats->reconnects = tcti_mssim->reconnects;
+    stats->connect_failures = tcti_mssim->connect_failures;
+    return TSS2_RC_SUCCESS;
+}
 /*
  * This is an implementation of the standard TCTI initialization function for
  * this module.
@@ -554,7 +713,6 @@ Tss2_Tcti_Mssim_Init (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = (TSS2_TCTI_MSSIM_CONTEXT*)tctiContext;
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
     TSS2_RC rc;
-    char *conf_copy = NULL;
     mssim_conf_t mssim_conf = MSSIM_CONF_DEFAULT_INIT;
 
     if (conf == NULL) {
@@ -573,6 +731,14 @@ Tss2_Tcti_Mssim_Init (
         return TSS2_RC_SUCCESS;
     }
 
+    tcti_mssim->tpm_sock = -1;
+    tcti_mssim->platform_sock = -1;
+    tcti_mssim->conf_copy = NULL;
+    tcti_mssim->mssim_conf = mssim_conf;
+    tcti_mssim->reconnects = 0;
+    tcti_mssim->connect_failures = 0;
+    tcti_mssim->rsp_count = 0;
+
     if (conf != NULL) {
         LOG_TRACE ("conf is not NULL");
         if (strlen (conf) > TCTI_MSSIM_CONF_MAX) {
@@ -580,61 +746,35 @@ Tss2_Tcti_Mssim_Init (
                          TCTI_MSSIM_CONF_MAX);
             return TSS2_TCTI_RC_BAD_VALUE;
         }
-        conf_copy = strdup (conf);
-        if (conf_copy == NULL) {
+        tcti_mssim->conf_copy = strdup (conf);
+        if (tcti_mssim->conf_copy == NULL) {
             LOG_ERROR ("Failed to allocate buffer: %s", strerror (errno));
             rc = TSS2_TCTI_RC_GENERAL_FAILURE;
             goto fail_out;
         }
         LOG_DEBUG ("Dup'd conf string to: 0x%" PRIxPTR,
-                   (uintptr_t)conf_copy);
-        rc = parse_key_value_string (conf_copy,
+                   (uintptr_t)tcti_mssim->conf_copy);
+        rc = parse_key_value_string (tcti_mssim->conf_copy,
                                      mssim_kv_callback,
-                                     &mssim_conf);
+                                     &tcti_mssim->mssim_conf);
         if (rc != TSS2_RC_SUCCESS) {
             goto fail_out;
         }
     }
     LOG_DEBUG ("Initializing mssim TCTI with host: %s, port: %" PRIu16,
-               mssim_conf.host, mssim_conf.port);
-
-    tcti_mssim->tpm_sock = -1;
-    tcti_mssim->platform_sock = -1;
-
-    rc = socket_connect (mssim_conf.host,
-                         mssim_conf.port,
-                         &tcti_mssim->tpm_sock);
-    if (rc != TSS2_RC_SUCCESS) {
-        goto fail_out;
-    }
-
-    rc = socket_set_nonblock (tcti_mssim->tpm_sock);
-    if (rc != TSS2_RC_SUCCESS) {
-        goto fail_out;
-    }
-
-    rc = socket_connect (mssim_conf.host,
-                         mssim_conf.port + 1,
-                         &tcti_mssim->platform_sock);
-    if (rc != TSS2_RC_SUCCESS) {
-        goto fail_out;
-    }
+               tcti_mssim->mssim_conf.host, tcti_mssim->mssim_conf.port);
 
     tcti_mssim_init_context_data (tcti_common);
-    rc = simulator_setup (tctiContext);
+    rc = tcti_mssim_connect (tcti_mssim);
     if (rc != TSS2_RC_SUCCESS) {
         goto fail_out;
     }
 
-    if (conf_copy != NULL) {
-        free (conf_copy);
-    }
     return TSS2_RC_SUCCESS;
 
 fail_out:
-    if (conf_copy != NULL) {
-        free (conf_copy);
-    }
+    free (tcti_mssim->conf_copy);
+    tcti_mssim->conf_copy = NULL;
     socket_close (&tcti_mssim->tpm_sock);
     socket_close (&tcti_mssim->platform_sock);
 
@@ -646,7 +786,9 @@ const TSS2_TCTI_INFO tss2_tcti_info = {
     .version = TCTI_VERSION,
     .name = "tcti-socket",
     .description = "TCTI module for communication with the Microsoft TPM2 Simulator.",
-    .config_help = "Key / value string in the form \"host=localhost,port=2321\".",
+    .config_help = "Key / value string in the form \"host=localhost,port=2321\"."
+        " Optional keys: connect_timeout, io_timeout (ms), reconnect (retries),"
+        " reconnect_delay (ms).",
     .init = Tss2_Tcti_Mssim_Init,
 };
 
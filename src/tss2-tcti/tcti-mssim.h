@@ -15,30 +15,48 @@
 /*
  * longest possible conf string:
  * HOST_NAME_MAX + max char uint16 (5) + strlen ("host=,port=") (11)
+ * + socket options
  */
-#define TCTI_MSSIM_CONF_MAX (_HOST_NAME_MAX + 16)
+#define TCTI_MSSIM_CONF_MAX (_HOST_NAME_MAX + 16 + SOCKET_CONF_MAX)
 #define TCTI_MSSIM_DEFAULT_HOST "localhost"
 #define TCTI_MSSIM_DEFAULT_PORT 2321
 #define MSSIM_CONF_DEFAULT_INIT { \
     .host = TCTI_MSSIM_DEFAULT_HOST, \
     .port = TCTI_MSSIM_DEFAULT_PORT, \
+    .socket = SOCKET_CONF_DEFAULT_INIT, \
 }
 
 #define TCTI_MSSIM_MAGIC 0xf05b04cd9f02728dULL
 
+/*
+ * The simulator frames each response with a 4 byte size and 4 trailing bytes
+ * of 0's. The receive buffer holds one complete framed response.
+ */
+#define MSSIM_RSP_FRAME_SIZE (sizeof (UINT32) + sizeof (UINT32))
+#define MSSIM_RSP_BUF_SIZE (TPM2_MAX_RESPONSE_SIZE + MSSIM_RSP_FRAME_SIZE)
+
 typedef struct {
     char *host;
     uint16_t port;
+    socket_conf_t socket;
 } mssim_conf_t;
 
 typedef struct {
     TSS2_TCTI_COMMON_CONTEXT common;
     SOCKET platform_sock;
     SOCKET tpm_sock;
+    char *conf_copy;
+    mssim_conf_t mssim_conf;
+    /* successful reconnects and failed connection attempts */
+    uint32_t reconnects;
+    uint32_t connect_failures;
 /* Flag indicating if a command has been cancelled.
  * This is a temporary flag, which will be changed into
  * a tcti state when support for asynch operation will be added */
     bool cancel;
+    /* Framed response and the number of bytes of it received so far. */
+    uint8_t rsp_buf [MSSIM_RSP_BUF_SIZE];
+    size_t rsp_count;
 } TSS2_TCTI_MSSIM_CONTEXT;
 
 #endif /* TCTI_MSSIM_H */
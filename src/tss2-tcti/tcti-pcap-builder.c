@@ -9,13 +9,18 @@
 #endif
 
 #include <time.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 
 #include "tss2_common.h"
@@ -55,6 +60,8 @@
 #define TCP_CHECKSUM_UNUSED         0x0000
 #define TCP_URGENT_PTR_UNUSED       0x0000
 
+#define PCAP_FILE_HEADER_LEN        (sizeof (shb) + sizeof (idb))
+
 #define SIZEOF_IN_OCTETS(x)         (sizeof (x)/sizeof (uint32_t))
 #define TO_MULTIPLE_OF_4_BYTE(x)    (((x)-1)/4*4+4) * !!(x)
 
@@ -164,7 +171,12 @@ pcap_write_enhanced_packet_block (
     size_t buf_len,
     const void* payload,
     size_t payload_len,
-    int direction);
+    int direction,
+    const struct timespec *timestamp);
+
+static size_t
+pcap_enhanced_packet_block_len (
+    size_t payload_len);
 
 static int
 pcap_write_ip_packet (
@@ -184,24 +196,190 @@ pcap_write_tcp_segment (
     size_t payload_len,
     int direction);
 
+static int
+pcap_ring_init (
+    pcap_buider_ctx *ctx,
+    size_t size);
+
+static int
+pcap_ring_print (
+    pcap_buider_ctx *ctx,
+    const void* payload,
+    size_t payload_len,
+    int direction,
+    const struct timespec *timestamp);
+
+static void
+pcap_ring_deinit (pcap_buider_ctx *ctx);
+
+/*
+ * Write the file header: SHB and IDB (can be written multiple times to the
+ * same file).
+ */
+static int
+pcap_write_file_header (pcap_buider_ctx *ctx)
+{
+    uint8_t buf[PCAP_FILE_HEADER_LEN];
+    size_t buf_len = sizeof (buf);
+    size_t offset = 0;
+    size_t uret;
+    int ret;
+
+    ret = pcap_write_section_header_block (ctx, buf, buf_len);
+    if (ret < 0) {
+        return ret;
+    }
+    offset += ret;
+
+    ret = pcap_write_interface_description_block (ctx,
+                                                  buf + offset,
+                                                  buf_len - offset);
+    if (ret < 0) {
+        return ret;
+    }
+    offset += ret;
+
+    uret = write_all (ctx->fd, buf, offset);
+    if (uret != offset) {
+        return -1;
+    }
+    ctx->file_size += offset;
+
+    return 0;
+}
+
+/* Get the name of the n-th retained file, i.e. <file>.<n>. */
+static char *
+pcap_rotated_filename (
+    pcap_buider_ctx *ctx,
+    unsigned int n)
+{
+    size_t len = strlen (ctx->filename) + sizeof (".4294967295");
+    char *name = malloc (len);
+
+    if (name) {
+        if (n == 0) {
+            snprintf (name, len, "%s", ctx->filename);
+        } else {
+            snprintf (name, len, "%s.%u", ctx->filename, n);
+        }
+    }
+    return name;
+}
+
+/*
+ * Check whether the capture file has to be rotated before len bytes are
+ * written. A file is never rotated before it contains a packet, such that
+ * packets larger than the size limit are still captured.
+ */
+static int
+pcap_rotation_due (
+    pcap_buider_ctx *ctx,
+    size_t len)
+{
+    if (ctx->filename == NULL) {
+        return 0;
+    }
+    if (ctx->rotation.size > 0 && ctx->file_size > PCAP_FILE_HEADER_LEN &&
+        ctx->file_size + len > ctx->rotation.size) {
+        return 1;
+    }
+    if (ctx->rotation.time > 0 &&
+        time (NULL) - ctx->file_start >= ctx->rotation.time) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Rename the retained file <file>.<from> to <file>.<to>. */
+static void
+pcap_rename (
+    pcap_buider_ctx *ctx,
+    unsigned int from,
+    unsigned int to)
+{
+    char *from_name = pcap_rotated_filename (ctx, from);
+    char *to_name = pcap_rotated_filename (ctx, to);
+
+    if (from_name && to_name && rename (from_name, to_name) != 0 &&
+        errno != ENOENT) {
+        LOG_WARNING ("Failed to rename %s to %s: %s", from_name, to_name,
+                     strerror (errno));
+    }
+    free (from_name);
+    free (to_name);
+}
+
+/*
+ * Shift the retained files by one, dropping the oldest one, and continue the
+ * capture in a new file. If the new file can't be opened, the files are
+ * shifted back and the capture continues in the current file.
+ */
+static void
+pcap_rotate (pcap_buider_ctx *ctx)
+{
+    unsigned int i;
+    int fd;
+
+    for (i = ctx->rotation.files - 1; i > 0; i--) {
+        pcap_rename (ctx, i - 1, i);
+    }
+
+    ctx->file_start = time (NULL);
+
+    fd = open (ctx->filename, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+    if (fd < 0) {
+        LOG_WARNING ("Failed to open file %s: %s", ctx->filename, strerror (errno));
+        for (i = 1; i < ctx->rotation.files; i++) {
+            pcap_rename (ctx, i, i - 1);
+        }
+        return;
+    }
+    ctx->file_size = 0;
+    if (close (ctx->fd) != 0) {
+        LOG_WARNING ("Failed to close file: %s", strerror (errno));
+    }
+    ctx->fd = fd;
+
+    if (pcap_write_file_header (ctx) != 0) {
+        LOG_WARNING ("Failed to write to file %s: %s", ctx->filename, strerror (errno));
+    }
+    LOG_DEBUG ("Rotated PCAP file %s", ctx->filename);
+}
+
 int
 pcap_init (pcap_buider_ctx *ctx)
 {
     char *filename = getenv (ENV_PCAP_FILE);
-    struct timespec time;
-    size_t buf_len;
-    size_t offset;
-    size_t uret;
+    char *buffer_size = getenv (ENV_PCAP_BUFFER_SIZE);
+    unsigned long long ring_size = 0;
+    char *end;
+    struct timespec now;
+    struct stat st;
     int ret;
 
+    memset (&ctx->ring, 0, sizeof (ctx->ring));
+    ctx->filename = NULL;
+    ctx->file_size = 0;
+
     if (filename == NULL) {
         LOG_TRACE (ENV_PCAP_FILE " not set. Using default PCAP file: "
                    DEFAULT_PCAP_FILE);
         filename = DEFAULT_PCAP_FILE;
     }
 
-    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
-    srand (time.tv_nsec);
+    if (buffer_size != NULL) {
+        errno = 0;
+        ring_size = strtoull (buffer_size, &end, 0);
+        if (errno != 0 || end == buffer_size || *end != '\0' ||
+            ring_size > SIZE_MAX - 4) {
+            LOG_ERROR ("Invalid value of " ENV_PCAP_BUFFER_SIZE ": %s", buffer_size);
+            return -1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    srand (now.tv_nsec);
 
     /* random ips to associate unique connection with this tcti instance */
     ctx->ip_host = (rand() << 16) | rand();
@@ -221,33 +399,39 @@ pcap_init (pcap_buider_ctx *ctx)
             LOG_ERROR ("Failed to open file %s: %s", filename, strerror (errno));
             goto error;
         }
-    }
-
-    uint8_t buf[sizeof (shb) + sizeof (idb)];
-    buf_len = sizeof (buf);
-    offset = 0;
-
-    ret = pcap_write_section_header_block (ctx, buf, buf_len);
-    if (ret < 0) {
-        return ret;
-    }
-    offset += ret;
 
-    ret = pcap_write_interface_description_block (ctx,
-                                                  buf + offset,
-                                                  buf_len - offset);
-    if (ret < 0) {
-        return ret;
+        /* only regular files are rotated */
+        if ((ctx->rotation.size > 0 || ctx->rotation.time > 0) &&
+            (fstat (ctx->fd, &st) != 0 || !S_ISREG (st.st_mode))) {
+            LOG_WARNING ("%s is not a regular file, it is not rotated", filename);
+        } else if (ctx->rotation.size > 0 || ctx->rotation.time > 0) {
+            ctx->filename = strdup (filename);
+            if (!ctx->filename) {
+                LOG_ERROR ("Out of memory");
+                goto error;
+            }
+            if (ctx->rotation.files == 0) {
+                ctx->rotation.files = 1;
+            }
+            ctx->file_size = (size_t) st.st_size;
+            ctx->file_start = time (NULL);
+        }
     }
-    offset += ret;
 
-    /* write file header: SHB and IDB (can be written multiple times to same file) */
-    uret = write_all (ctx->fd, buf, offset);
-    if (uret != offset) {
+    ret = pcap_write_file_header (ctx);
+    if (ret != 0) {
         LOG_ERROR ("Failed to write to file %s: %s", filename, strerror (errno));
         goto error;
     }
 
+    /* packets are written by a separate thread if a ring buffer is configured */
+    if (ring_size > 0) {
+        ret = pcap_ring_init (ctx, ring_size);
+        if (ret < 0) {
+            goto error;
+        }
+    }
+
     return 0;
 
 error:
@@ -261,6 +445,21 @@ pcap_print (
     const void* payload,
     size_t payload_len,
     int direction)
+{
+    return pcap_print_at (ctx, payload, payload_len, direction, NULL);
+}
+
+/*
+ * Like pcap_print() but with the timestamp of the packet, e.g. for packets
+ * whose capture was deferred. A NULL timestamp means the current time.
+ */
+int
+pcap_print_at (
+    pcap_buider_ctx *ctx,
+    const void* payload,
+    size_t payload_len,
+    int direction,
+    const struct timespec *timestamp)
 {
     size_t pdu_len;
     size_t uret;
@@ -270,13 +469,12 @@ pcap_print (
         return -1;
     }
 
-    /* get required buffer size */
-    ret = pcap_write_enhanced_packet_block (ctx, NULL, 0,
-                                            payload, payload_len, direction);
-    if (ret < 0) {
-        return ret;
+    if (ctx->ring.buf) {
+        return pcap_ring_print (ctx, payload, payload_len, direction, timestamp);
     }
-    pdu_len = ret;
+
+    /* get required buffer size */
+    pdu_len = pcap_enhanced_packet_block_len (payload_len);
 
     uint8_t *buf = malloc (pdu_len);
     if (!buf) {
@@ -285,18 +483,24 @@ pcap_print (
     }
 
     ret = pcap_write_enhanced_packet_block (ctx, buf, pdu_len,
-                                            payload, payload_len, direction);
+                                            payload, payload_len, direction,
+                                            timestamp);
     if (ret < 0) {
         goto cleanup;
     }
     pdu_len = ret;
 
+    if (pcap_rotation_due (ctx, pdu_len)) {
+        pcap_rotate (ctx);
+    }
+
     uret = write_all (ctx->fd, buf, pdu_len);
     if (uret != pdu_len) {
         LOG_ERROR ("Failed to write to file: %s", strerror (errno));
         ret = -1;
         goto cleanup;
     }
+    ctx->file_size += pdu_len;
 
     ret = 0;
 
@@ -310,12 +514,266 @@ pcap_deinit (pcap_buider_ctx *ctx)
 {
     int ret;
 
+    if (ctx->ring.buf) {
+        pcap_ring_deinit (ctx);
+    }
+
     if (ctx->fd != STDOUT_FILENO && ctx->fd != STDERR_FILENO) {
         ret = close (ctx->fd);
         if (ret != 0) {
             LOG_WARNING ("Failed to close file: %s", strerror (errno));
         }
     }
+
+    free (ctx->filename);
+    ctx->filename = NULL;
+}
+
+/*
+ * Drain the blocks between tail and head to the capture file. At most two
+ * runs of blocks (before and after the wrap around of the ring) are written
+ * with a single writev.
+ */
+static size_t
+pcap_ring_drain (
+    pcap_buider_ctx *ctx,
+    size_t tail,
+    size_t head)
+{
+    pcap_ring *ring = &ctx->ring;
+    struct iovec iov[2] = { { 0 } };
+    int iovcnt = 0;
+    uint64_t blocks = 0;
+    size_t batch_len = 0;
+    uint32_t block_type, block_len;
+    size_t pos;
+    ssize_t written;
+
+    while (tail != head) {
+        pos = tail % ring->size;
+        memcpy (&block_type, &ring->buf[pos], sizeof (block_type));
+        if (block_type == 0) {
+            /* rest of the ring is unused */
+            tail += ring->size - pos;
+            continue;
+        }
+        memcpy (&block_len, &ring->buf[pos + sizeof (block_type)], sizeof (block_len));
+
+        /* a batch must not exceed the size limit of the capture file */
+        if (blocks > 0 && ctx->rotation.size > 0 &&
+            ctx->file_size + batch_len + block_len > ctx->rotation.size) {
+            break;
+        }
+
+        if (iovcnt > 0 &&
+            (uint8_t *) iov[iovcnt - 1].iov_base + iov[iovcnt - 1].iov_len == &ring->buf[pos]) {
+            iov[iovcnt - 1].iov_len += block_len;
+        } else if (iovcnt < 2) {
+            iov[iovcnt].iov_base = &ring->buf[pos];
+            iov[iovcnt].iov_len = block_len;
+            iovcnt++;
+        } else {
+            break;
+        }
+        tail += block_len;
+        batch_len += block_len;
+        blocks++;
+    }
+
+    if (pcap_rotation_due (ctx, batch_len)) {
+        pcap_rotate (ctx);
+    }
+
+    while (iovcnt > 0) {
+        TEMP_RETRY (written, writev (ctx->fd, iov, iovcnt));
+        if (written < 0) {
+            LOG_WARNING ("Failed to write to file: %s", strerror (errno));
+            __atomic_add_fetch (&ring->dropped, blocks, __ATOMIC_RELAXED);
+            break;
+        }
+        ctx->file_size += written;
+        /* skip what was written on partial writes */
+        while (iovcnt > 0 && (size_t) written >= iov[0].iov_len) {
+            written -= iov[0].iov_len;
+            iov[0] = iov[1];
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov[0].iov_base = (uint8_t *) iov[0].iov_base + written;
+            iov[0].iov_len -= written;
+        }
+    }
+
+    return tail;
+}
+
+/*
+ * Park the writer until the producer publishes a block or stop is set. The
+ * store of sleeping and the load of head are sequentially consistent, as
+ * are the store of head and the load of sleeping in pcap_ring_wake, so either
+ * the writer sees the new head or the producer sees the writer sleeping. The
+ * lock is held from setting sleeping until the wait, no signal is lost.
+ */
+static void
+pcap_ring_sleep (
+    pcap_ring *ring,
+    size_t tail)
+{
+    pthread_mutex_lock (&ring->lock);
+    __atomic_store_n (&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&ring->head, __ATOMIC_SEQ_CST) == tail &&
+        !__atomic_load_n (&ring->stop, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait (&ring->wake, &ring->lock);
+    }
+    __atomic_store_n (&ring->sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock (&ring->lock);
+}
+
+/* Wake the writer if it is parked, the common path takes no lock. */
+static void
+pcap_ring_wake (pcap_ring *ring)
+{
+    if (__atomic_load_n (&ring->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock (&ring->lock);
+        pthread_cond_signal (&ring->wake);
+        pthread_mutex_unlock (&ring->lock);
+    }
+}
+
+static void *
+pcap_ring_writer (void *arg)
+{
+    pcap_buider_ctx *ctx = arg;
+    pcap_ring *ring = &ctx->ring;
+    size_t tail = ring->tail;
+    size_t head;
+    int stop;
+
+    for (;;) {
+        /* load stop before head, all blocks are published once stop is set */
+        stop = __atomic_load_n (&ring->stop, __ATOMIC_ACQUIRE);
+        head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (stop) {
+                break;
+            }
+            pcap_ring_sleep (ring, tail);
+            continue;
+        }
+
+        tail = pcap_ring_drain (ctx, tail, head);
+        __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+static int
+pcap_ring_init (
+    pcap_buider_ctx *ctx,
+    size_t size)
+{
+    pcap_ring *ring = &ctx->ring;
+    int ret;
+
+    /* blocks are 4 byte aligned, a wrap marker therefore always fits */
+    ring->size = TO_MULTIPLE_OF_4_BYTE (size);
+    ring->buf = malloc (ring->size);
+    if (!ring->buf) {
+        LOG_ERROR ("Out of memory");
+        return -1;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->stop = 0;
+    ring->sleeping = 0;
+    pthread_mutex_init (&ring->lock, NULL);
+    pthread_cond_init (&ring->wake, NULL);
+
+    ret = pthread_create (&ring->writer, NULL, pcap_ring_writer, ctx);
+    if (ret != 0) {
+        LOG_ERROR ("Failed to start PCAP writer thread: %s", strerror (ret));
+        pthread_cond_destroy (&ring->wake);
+        pthread_mutex_destroy (&ring->lock);
+        free (ring->buf);
+        ring->buf = NULL;
+        return -1;
+    }
+
+    LOG_DEBUG ("PCAP ring buffer of %zu bytes", ring->size);
+    return 0;
+}
+
+static int
+pcap_ring_print (
+    pcap_buider_ctx *ctx,
+    const void* payload,
+    size_t payload_len,
+    int direction,
+    const struct timespec *timestamp)
+{
+    pcap_ring *ring = &ctx->ring;
+    size_t pdu_len = pcap_enhanced_packet_block_len (payload_len);
+    size_t head = ring->head;
+    size_t tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+    size_t pos = head % ring->size;
+    size_t skip = 0;
+    int ret;
+
+    /* a block must not wrap around the end of the ring */
+    if (ring->size - pos < pdu_len) {
+        skip = ring->size - pos;
+    }
+
+    if (skip + pdu_len > ring->size - (head - tail)) {
+        __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELAXED);
+        /* leave a gap in the tcp sequence numbers to mark the lost segment */
+        if (direction == PCAP_DIR_HOST_TO_TPM) {
+            ctx->tcp_sequence_no_host += payload_len;
+        } else if (direction == PCAP_DIR_TPM_TO_HOST) {
+            ctx->tcp_sequence_no_tpm += payload_len;
+        }
+        return 0;
+    }
+
+    if (skip) {
+        memset (&ring->buf[pos], 0, sizeof (uint32_t));
+        head += skip;
+        pos = 0;
+    }
+
+    ret = pcap_write_enhanced_packet_block (ctx, &ring->buf[pos], pdu_len,
+                                            payload, payload_len, direction,
+                                            timestamp);
+    if (ret < 0) {
+        return ret;
+    }
+
+    __atomic_store_n (&ring->head, head + pdu_len, __ATOMIC_SEQ_CST);
+    pcap_ring_wake (ring);
+    return 0;
+}
+
+static void
+pcap_ring_deinit (pcap_buider_ctx *ctx)
+{
+    pcap_ring *ring = &ctx->ring;
+
+    /* the writer drains the ring before it terminates */
+    __atomic_store_n (&ring->stop, 1, __ATOMIC_SEQ_CST);
+    pcap_ring_wake (ring);
+    pthread_join (ring->writer, NULL);
+    pthread_cond_destroy (&ring->wake);
+    pthread_mutex_destroy (&ring->lock);
+
+    if (ring->dropped > 0) {
+        LOG_WARNING ("%" PRIu64 " packets were not written to the PCAP file",
+                     ring->dropped);
+    }
+
+    free (ring->buf);
+    ring->buf = NULL;
 }
 
 static int
@@ -382,7 +840,8 @@ pcap_write_enhanced_packet_block (
     size_t buf_len,
     const void* payload,
     size_t payload_len,
-    int direction)
+    int direction,
+    const struct timespec *ts_packet)
 {
     UNUSED (ctx);
 
@@ -391,11 +850,15 @@ pcap_write_enhanced_packet_block (
     uint64_t timestamp;
     int ret;
 
-    ret = clock_gettime (CLOCK_REALTIME, &ts);
-    if (ret != 0) {
-        LOG_WARNING ("Failed to get time: %s", strerror (errno));
-        ts.tv_sec = 0;
-        ts.tv_nsec = 0;
+    if (ts_packet) {
+        ts = *ts_packet;
+    } else {
+        ret = clock_gettime (CLOCK_REALTIME, &ts);
+        if (ret != 0) {
+            LOG_WARNING ("Failed to get time: %s", strerror (errno));
+            ts.tv_sec = 0;
+            ts.tv_nsec = 0;
+        }
     }
     timestamp = (uint64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
 
@@ -442,6 +905,15 @@ pcap_write_enhanced_packet_block (
     return pdu_len;
 }
 
+static size_t
+pcap_enhanced_packet_block_len (
+    size_t payload_len)
+{
+    size_t sdu_len = sizeof (ip_header) + sizeof (tcp_header) + payload_len;
+
+    return sizeof (epb_header) + TO_MULTIPLE_OF_4_BYTE (sdu_len) + sizeof (epb_footer);
+}
+
 static int
 pcap_write_ip_packet (
     pcap_buider_ctx *ctx,
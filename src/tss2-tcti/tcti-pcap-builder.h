@@ -7,15 +7,58 @@
 #define TCTI_PCAP_BUILDER_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
 
 #define PCAP_DIR_HOST_TO_TPM 0
 #define PCAP_DIR_TPM_TO_HOST 1
 
 #define ENV_PCAP_FILE     "TCTI_PCAP_FILE"
 #define DEFAULT_PCAP_FILE "tpm2_log.pcap"
+#define ENV_PCAP_BUFFER_SIZE "TCTI_PCAP_BUFFER_SIZE"
+
+/*
+ * Ring buffer of formatted pcapng blocks. The capturing thread is the only
+ * producer and advances head, the writer thread is the only consumer and
+ * advances tail. Both are free running byte counters, the position in buf is
+ * the counter modulo size. A block never wraps around the end of buf, a
+ * block type of 0 marks the remainder of buf as unused.
+ *
+ * An idle writer sets sleeping and waits on wake. The producer only takes
+ * lock to signal wake if it finds sleeping set after advancing head.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t head;
+    size_t tail;
+    uint64_t dropped;
+    int stop;
+    int sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t writer;
+} pcap_ring;
+
+/*
+ * Rotation of the capture file. The current file is renamed to <file>.1 once
+ * it would exceed size bytes or is older than time seconds, older files are
+ * shifted up to <file>.<files - 1>. A value of 0 disables the criterion.
+ */
+typedef struct {
+    size_t size;
+    time_t time;
+    unsigned int files;
+} pcap_rotation;
 
 typedef struct {
     int fd;
+    char *filename;
+    pcap_rotation rotation;
+    size_t file_size;
+    time_t file_start;
+    pcap_ring ring;
     uint32_t ip_host;
     uint32_t ip_tpm;
     uint32_t tcp_sequence_no_host;
@@ -30,6 +73,13 @@ pcap_print (
     const void* payload,
     size_t payload_len,
     int direction);
+int
+pcap_print_at (
+    pcap_buider_ctx *ctx,
+    const void* payload,
+    size_t payload_len,
+    int direction,
+    const struct timespec *timestamp);
 void
 pcap_deinit (pcap_buider_ctx *ctx);
 
@@ -8,14 +8,19 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include "tss2_tpm2_types.h"
 #include "tss2_common.h"
 #include "tss2_tcti.h"
+#include "tss2_mu.h"
 #include "tcti-common.h"
+#include "util/key-value-parse.h"
 #define LOGMODULE tcti
 #include "util/log.h"
 
@@ -52,6 +57,37 @@ tcti_pcap_down_cast (TSS2_TCTI_PCAP_CONTEXT *tcti_pcap)
     return &tcti_pcap->common;
 }
 
+/*
+ * Decide whether a command and its response are captured, based on the
+ * command code filter and the sampling rate of the conf string.
+ */
+static int
+tcti_pcap_sample (
+    TSS2_TCTI_PCAP_CONTEXT *tcti_pcap,
+    const uint8_t *cmd_buf,
+    size_t size)
+{
+    tcti_pcap_conf_t *conf = &tcti_pcap->pcap_conf;
+    size_t offset = sizeof (TPM2_ST) + sizeof (UINT32);
+    TPM2_CC cc;
+    size_t i;
+
+    if (conf->cc_count > 0) {
+        if (Tss2_MU_TPM2_CC_Unmarshal (cmd_buf, size, &offset, &cc) != TSS2_RC_SUCCESS) {
+            return 0;
+        }
+        for (i = 0; i < conf->cc_count && conf->cc[i] != cc; i++);
+        if (i == conf->cc_count) {
+            return 0;
+        }
+    }
+
+    if (conf->sample > 1) {
+        return tcti_pcap->sample_count++ % conf->sample == 0;
+    }
+    return 1;
+}
+
 TSS2_RC
 tcti_pcap_transmit (
     TSS2_TCTI_CONTEXT *tcti_ctx,
@@ -73,12 +109,25 @@ tcti_pcap_transmit (
 
     LOGBLOB_DEBUG (cmd_buf, size, "sending %zu byte command buffer:", size);
 
-    /* handle errors of underlying TCTI later (always writes to PCAP file) */
-    ret = pcap_print (&tcti_pcap->pcap_builder,
-                      cmd_buf, size,
-                      PCAP_DIR_HOST_TO_TPM);
-    if (ret != 0) {
-        LOG_WARNING ("Failed to save transmission to PCAP file.");
+    tcti_pcap->capture = tcti_pcap_sample (tcti_pcap, cmd_buf, size);
+    tcti_pcap->pending_size = 0;
+    if (tcti_pcap->capture && tcti_pcap->pcap_conf.errors_only) {
+        /* the command is captured once its response code is known */
+        if (size <= sizeof (tcti_pcap->pending_cmd)) {
+            memcpy (tcti_pcap->pending_cmd, cmd_buf, size);
+            tcti_pcap->pending_size = size;
+            clock_gettime (CLOCK_REALTIME, &tcti_pcap->pending_time);
+        } else {
+            tcti_pcap->capture = 0;
+        }
+    } else if (tcti_pcap->capture) {
+        /* handle errors of underlying TCTI later (always writes to PCAP file) */
+        ret = pcap_print (&tcti_pcap->pcap_builder,
+                          cmd_buf, size,
+                          PCAP_DIR_HOST_TO_TPM);
+        if (ret != 0) {
+            LOG_WARNING ("Failed to save transmission to PCAP file.");
+        }
     }
 
     rc = Tss2_Tcti_Transmit (tcti_pcap->tcti_child, size, cmd_buf);
@@ -100,6 +149,8 @@ tcti_pcap_receive (
 {
     TSS2_TCTI_PCAP_CONTEXT *tcti_pcap = tcti_pcap_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pcap_down_cast (tcti_pcap);
+    UINT32 response_code;
+    size_t offset;
     TSS2_RC rc;
     int ret;
 
@@ -126,11 +177,29 @@ tcti_pcap_receive (
 
     LOGBLOB_DEBUG (response_buffer, *response_size, "Response Received");
 
-    ret = pcap_print (&tcti_pcap->pcap_builder,
-                      response_buffer, *response_size,
-                      PCAP_DIR_TPM_TO_HOST);
-    if (ret != 0) {
-        LOG_WARNING ("Failed to save transmission to PCAP file.");
+    if (tcti_pcap->capture && tcti_pcap->pcap_conf.errors_only) {
+        offset = sizeof (TPM2_ST) + sizeof (UINT32);
+        if (Tss2_MU_UINT32_Unmarshal (response_buffer, *response_size,
+                                      &offset, &response_code) == TSS2_RC_SUCCESS &&
+            response_code == TPM2_RC_SUCCESS) {
+            tcti_pcap->capture = 0;
+        } else if (tcti_pcap->pending_size > 0) {
+            ret = pcap_print_at (&tcti_pcap->pcap_builder,
+                                 tcti_pcap->pending_cmd, tcti_pcap->pending_size,
+                                 PCAP_DIR_HOST_TO_TPM, &tcti_pcap->pending_time);
+            if (ret != 0) {
+                LOG_WARNING ("Failed to save transmission to PCAP file.");
+            }
+        }
+    }
+
+    if (tcti_pcap->capture) {
+        ret = pcap_print (&tcti_pcap->pcap_builder,
+                          response_buffer, *response_size,
+                          PCAP_DIR_TPM_TO_HOST);
+        if (ret != 0) {
+            LOG_WARNING ("Failed to save transmission to PCAP file.");
+        }
     }
 
     tcti_common->state = TCTI_STATE_TRANSMIT;
@@ -226,6 +295,91 @@ tcti_pcap_finalize (
     tcti_common->state = TCTI_STATE_FINAL;
 }
 
+static int
+tcti_pcap_parse_number (
+    const char *value,
+    unsigned long long max,
+    unsigned long long *number)
+{
+    char *end;
+
+    errno = 0;
+    *number = strtoull (value, &end, 0);
+    if (errno != 0 || end == value || *end != '\0' || *number > max) {
+        LOG_ERROR ("Invalid number: %s", value);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Parse a list of command codes separated by '+', e.g. "0x17f+0x176".
+ */
+static TSS2_RC
+tcti_pcap_parse_cc (
+    char *value,
+    tcti_pcap_conf_t *pcap_conf)
+{
+    unsigned long long cc;
+    char *tok, *state;
+
+    for (tok = strtok_r (value, "+", &state);
+         tok;
+         tok = strtok_r (NULL, "+", &state)) {
+        if (pcap_conf->cc_count == TCTI_PCAP_CC_MAX) {
+            LOG_ERROR ("More than %d command codes", TCTI_PCAP_CC_MAX);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        if (tcti_pcap_parse_number (tok, UINT32_MAX, &cc) != 0) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        pcap_conf->cc[pcap_conf->cc_count++] = cc;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+pcap_kv_callback (const key_value_t *key_value,
+                  void *user_data)
+{
+    tcti_pcap_conf_t *pcap_conf = (tcti_pcap_conf_t*)user_data;
+    unsigned long long number;
+
+    LOG_TRACE ("key_value: 0x%" PRIxPTR " and user_data: 0x%" PRIxPTR,
+               (uintptr_t)key_value, (uintptr_t)user_data);
+    if (key_value == NULL || user_data == NULL) {
+        LOG_WARNING ("%s passed NULL parameter", __func__);
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+    LOG_DEBUG ("key: %s / value: %s\n", key_value->key, key_value->value);
+    if (strcmp (key_value->key, "cc") == 0) {
+        return tcti_pcap_parse_cc (key_value->value, pcap_conf);
+    }
+    if (tcti_pcap_parse_number (key_value->value, UINT32_MAX, &number) != 0) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    if (number == 0 && (strcmp (key_value->key, "rotate_files") == 0 ||
+                        strcmp (key_value->key, "sample") == 0)) {
+        LOG_ERROR ("Invalid value of %s: %s", key_value->key, key_value->value);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    if (strcmp (key_value->key, "rotate_size") == 0) {
+        pcap_conf->rotation.size = number;
+    } else if (strcmp (key_value->key, "rotate_time") == 0) {
+        pcap_conf->rotation.time = number;
+    } else if (strcmp (key_value->key, "rotate_files") == 0) {
+        pcap_conf->rotation.files = number;
+    } else if (strcmp (key_value->key, "sample") == 0) {
+        pcap_conf->sample = number;
+    } else if (strcmp (key_value->key, "errors_only") == 0) {
+        pcap_conf->errors_only = number != 0;
+    } else {
+        LOG_ERROR ("Invalid pcap option: %s=%s", key_value->key, key_value->value);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 /*
  * This is an implementation of the standard TCTI initialization function for
  * this module.
@@ -239,6 +393,8 @@ Tss2_Tcti_Pcap_Init (
     TSS2_TCTI_PCAP_CONTEXT *tcti_pcap = (TSS2_TCTI_PCAP_CONTEXT*) tctiContext;
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pcap_down_cast (tcti_pcap);
     TSS2_RC rc = TSS2_RC_SUCCESS;
+    char *conf_copy = NULL, *separator;
+    const char *child_conf;
     int ret;
 
     if (tctiContext == NULL && size == NULL) {
@@ -257,11 +413,48 @@ Tss2_Tcti_Pcap_Init (
                    (uintptr_t)tctiContext, (uintptr_t)size, conf);
     }
 
-    rc = Tss2_TctiLdr_Initialize (conf, &tcti_pcap->tcti_child);
+    memset (&tcti_pcap->pcap_conf, 0, sizeof (tcti_pcap->pcap_conf));
+    tcti_pcap->pcap_conf.sample = 1;
+    tcti_pcap->sample_count = 0;
+    tcti_pcap->capture = 1;
+    tcti_pcap->pending_size = 0;
+
+    /*
+     * pcap options are separated from the child conf by ';'. They are only
+     * recognized if the text in front of the first ';' is a key=value list;
+     * a child conf like "cmd:foo; bar" contains a ':' and is passed as is.
+     */
+    child_conf = conf;
+    separator = conf != NULL ? strchr (conf, ';') : NULL;
+    if (separator != NULL &&
+        memchr (conf, '=', separator - conf) != NULL &&
+        memchr (conf, ':', separator - conf) == NULL) {
+        conf_copy = strdup (conf);
+        if (conf_copy == NULL) {
+            LOG_ERROR ("Failed to allocate memory for the conf string");
+            return TSS2_TCTI_RC_MEMORY;
+        }
+        separator = strchr (conf_copy, ';');
+        *separator = '\0';
+        child_conf = separator + 1;
+        rc = parse_key_value_string (conf_copy, pcap_kv_callback,
+                                     &tcti_pcap->pcap_conf);
+        if (rc != TSS2_RC_SUCCESS) {
+            free (conf_copy);
+            return rc;
+        }
+        if (*child_conf == '\0') {
+            child_conf = NULL;
+        }
+    }
+
+    rc = Tss2_TctiLdr_Initialize (child_conf, &tcti_pcap->tcti_child);
     if (rc != TSS2_RC_SUCCESS) {
-        LOG_ERROR ("Error loading TCTI: %s", conf);
+        LOG_ERROR ("Error loading TCTI: %s", child_conf);
+        free (conf_copy);
         return rc;
     }
+    free (conf_copy);
 
     TSS2_TCTI_MAGIC (tcti_common) = TCTI_PCAP_MAGIC;
     TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
@@ -276,6 +469,7 @@ Tss2_Tcti_Pcap_Init (
     tcti_common->locality = 3;
     memset (&tcti_common->header, 0, sizeof (tcti_common->header));
 
+    tcti_pcap->pcap_builder.rotation = tcti_pcap->pcap_conf.rotation;
     ret = pcap_init (&tcti_pcap->pcap_builder);
     if (ret != 0) {
         LOG_ERROR ("Failed to initialize PCAP TCTI");
@@ -291,7 +485,10 @@ const TSS2_TCTI_INFO tss2_tcti_info = {
     .version = TCTI_VERSION,
     .name = "tcti-pcap",
     .description = "TCTI module for logging TPM commands in pcapng format.",
-    .config_help = "The child tcti module and its config string: <name>:<conf>",
+    .config_help = "The child tcti module and its config string: <name>:<conf>, "
+        "optionally preceded by pcap options and ';', e.g. "
+        "rotate_size=<bytes>,rotate_time=<s>,rotate_files=<n>,sample=<n>,"
+        "cc=<cc>[+<cc>...],errors_only=1;<name>:<conf>",
     .init = Tss2_Tcti_Pcap_Init,
 };
 
@@ -13,15 +13,32 @@
 #include "tcti-common.h"
 
 #define TCTI_PCAP_MAGIC 0x9cf45c5d7d9d0d3fULL
+#define TCTI_PCAP_CC_MAX 16
 
+/*
+ * Options preceding the child conf, e.g.
+ * "rotate_size=1048576,rotate_files=4,sample=10;device:/dev/tpm0"
+ */
 typedef struct {
     const char *child_tcti;
+    pcap_rotation rotation;
+    uint32_t sample;                   /* capture 1 in sample commands */
+    TPM2_CC cc[TCTI_PCAP_CC_MAX];      /* capture only these commands */
+    size_t cc_count;
+    int errors_only;                   /* capture only failed commands */
 } tcti_pcap_conf_t;
 
 typedef struct {
     TSS2_TCTI_COMMON_CONTEXT common;
     pcap_buider_ctx pcap_builder;
     TSS2_TCTI_CONTEXT *tcti_child;
+    tcti_pcap_conf_t pcap_conf;
+    uint32_t sample_count;
+    int capture;                       /* the current command is captured */
+    /* command whose capture is deferred until its response code is known */
+    uint8_t pending_cmd[TPM2_MAX_COMMAND_SIZE];
+    size_t pending_size;
+    struct timespec pending_time;
 } TSS2_TCTI_PCAP_CONTEXT;
 
 #endif /* TCTI_PCAP_H */
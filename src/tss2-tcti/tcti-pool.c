@@ -0,0 +1,617 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_pool.h"
+#include "tss2_tctildr.h"
+
+#include "tcti-common.h"
+#include "tcti-pool.h"
+#define LOGMODULE tcti
+#include "util/log.h"
+
+/*
+ * This function wraps the "up-cast" of the opaque TCTI context type to the
+ * type for the pool TCTI context. The only safeguard we have to ensure this
+ * operation is possible is the magic number in the pool TCTI context.
+ * If passed a NULL context, or the magic number check fails, this function
+ * will return NULL.
+ */
+TSS2_TCTI_POOL_CONTEXT*
+tcti_pool_context_cast (TSS2_TCTI_CONTEXT *tcti_ctx)
+{
+    if (tcti_ctx != NULL && TSS2_TCTI_MAGIC (tcti_ctx) == TCTI_POOL_MAGIC) {
+        return (TSS2_TCTI_POOL_CONTEXT*)tcti_ctx;
+    }
+    return NULL;
+}
+
+/*
+ * This function down-casts the pool TCTI context to the common context
+ * defined in the tcti-common module.
+ */
+TSS2_TCTI_COMMON_CONTEXT*
+tcti_pool_down_cast (TSS2_TCTI_POOL_CONTEXT *tcti_pool)
+{
+    if (tcti_pool == NULL) {
+        return NULL;
+    }
+    return &tcti_pool->common;
+}
+
+/*
+ * A token of the pool conf string starts the conf of a new child if it
+ * begins with a TCTI name, i.e. it contains a ':' before any '=' or no '='
+ * at all. Other tokens (e.g. "port=2321") continue the conf of the previous
+ * child.
+ */
+static bool
+tcti_pool_starts_child (const char *token)
+{
+    size_t len = strcspn (token, ",");
+    const char *colon = memchr (token, ':', len);
+    const char *equal = memchr (token, '=', len);
+
+    if (equal == NULL) {
+        return true;
+    }
+    return colon != NULL && colon < equal;
+}
+
+/*
+ * Split the next child conf off the comma separated pool conf string, e.g.
+ * "mssim:host=localhost,port=2321,mssim:port=2331" yields
+ * "mssim:host=localhost,port=2321" and then "mssim:port=2331". The string
+ * is modified in place and '*conf' advanced. NULL is returned once all
+ * child confs have been consumed.
+ */
+char*
+tcti_pool_next_conf (char **conf)
+{
+    char *start = *conf;
+    char *pos;
+
+    if (start == NULL) {
+        return NULL;
+    }
+    while (*start == ',') {
+        start++;
+    }
+    if (*start == '\0') {
+        *conf = NULL;
+        return NULL;
+    }
+
+    for (pos = strchr (start, ','); pos != NULL; pos = strchr (pos + 1, ',')) {
+        if (tcti_pool_starts_child (pos + 1)) {
+            *pos = '\0';
+            *conf = pos + 1;
+            return start;
+        }
+    }
+    *conf = NULL;
+    return start;
+}
+
+/*
+ * Resolve the pool of a pool or client context. The context itself is the
+ * key of the caller that owns a child. NULL is returned if the context is
+ * neither a pool nor a client context.
+ */
+static TSS2_TCTI_POOL_CONTEXT*
+tcti_pool_resolve (TSS2_TCTI_CONTEXT *tcti_ctx)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = tcti_pool_context_cast (tcti_ctx);
+
+    if (tcti_pool == NULL && tcti_ctx != NULL &&
+        TSS2_TCTI_MAGIC (tcti_ctx) == TCTI_POOL_CLIENT_MAGIC) {
+        tcti_pool = ((TSS2_TCTI_POOL_CLIENT_CONTEXT*)tcti_ctx)->pool;
+    }
+    return tcti_pool;
+}
+
+/*
+ * Return the child owned by the caller, NULL if the caller has no command
+ * in flight. The pool mutex must be held.
+ */
+static tcti_pool_child_t*
+tcti_pool_owned_child (
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool,
+    const void *owner)
+{
+    size_t i;
+
+    for (i = 0; i < tcti_pool->num_children; i++) {
+        if (tcti_pool->children [i].busy &&
+            tcti_pool->children [i].owner == owner) {
+            return &tcti_pool->children [i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Return the next idle child in round robin order, NULL if all children
+ * are busy. The pool mutex must be held.
+ */
+static tcti_pool_child_t*
+tcti_pool_idle_child (TSS2_TCTI_POOL_CONTEXT *tcti_pool)
+{
+    size_t i, index;
+
+    for (i = 0; i < tcti_pool->num_children; i++) {
+        index = (tcti_pool->next_child + i) % tcti_pool->num_children;
+        if (!tcti_pool->children [index].busy) {
+            tcti_pool->next_child = index + 1;
+            return &tcti_pool->children [index];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Resolve the pool of the context and look up the child owned by it.
+ */
+static TSS2_TCTI_POOL_CONTEXT*
+tcti_pool_find_owned_child (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    tcti_pool_child_t **child)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = tcti_pool_resolve (tctiContext);
+
+    if (tcti_pool == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock (&tcti_pool->mutex);
+    *child = tcti_pool_owned_child (tcti_pool, tctiContext);
+    pthread_mutex_unlock (&tcti_pool->mutex);
+
+    return tcti_pool;
+}
+
+static void
+tcti_pool_release_child (
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool,
+    tcti_pool_child_t *child,
+    bool locality_stale,
+    bool response_stale)
+{
+    pthread_mutex_lock (&tcti_pool->mutex);
+    child->busy = false;
+    child->owner = NULL;
+    child->locality_stale |= locality_stale;
+    child->response_stale |= response_stale;
+    pthread_cond_signal (&tcti_pool->idle);
+    pthread_mutex_unlock (&tcti_pool->mutex);
+}
+
+/*
+ * Read and drop the response to a command that was cancelled
+ * unsuccessfully, so that the child can take the next command.
+ */
+static TSS2_RC
+tcti_pool_drop_response (tcti_pool_child_t *child)
+{
+    uint8_t buffer [TPM2_MAX_RESPONSE_SIZE];
+    size_t size = sizeof (buffer);
+    TSS2_RC rc;
+
+    LOG_DEBUG ("Dropping response of cancelled command");
+    rc = Tss2_Tcti_Receive (child->tcti, &size, buffer,
+                            TSS2_TCTI_TIMEOUT_BLOCK);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Failed to receive response of cancelled command");
+        return rc;
+    }
+    child->response_stale = false;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * The state machine of the pool is kept per caller: the pool context and
+ * each of its client contexts own the child they sent a command to until
+ * the response has been received, whichever thread receives it. Different
+ * callers may have commands in flight on different children at the same
+ * time. If all children are busy, transmit blocks until one becomes idle.
+ */
+TSS2_RC
+tcti_pool_transmit (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = tcti_pool_resolve (tcti_ctx);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pool_down_cast (tcti_pool);
+    tcti_pool_child_t *child;
+    bool locality_stale, response_stale;
+    uint8_t locality;
+    TSS2_RC rc;
+
+    if (tcti_pool == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (cmd_buf == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+
+    pthread_mutex_lock (&tcti_pool->mutex);
+    if (tcti_pool_owned_child (tcti_pool, tcti_ctx) != NULL) {
+        pthread_mutex_unlock (&tcti_pool->mutex);
+        LOG_ERROR ("Response to the previous command not received yet");
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    while ((child = tcti_pool_idle_child (tcti_pool)) == NULL) {
+        LOG_DEBUG ("All %zu child TCTIs busy, waiting",
+                   tcti_pool->num_children);
+        pthread_cond_wait (&tcti_pool->idle, &tcti_pool->mutex);
+    }
+    child->busy = true;
+    child->owner = tcti_ctx;
+    locality_stale = child->locality_stale;
+    response_stale = child->response_stale;
+    locality = tcti_common->locality;
+    child->locality_stale = false;
+    pthread_mutex_unlock (&tcti_pool->mutex);
+
+    LOG_DEBUG ("Dispatching command to child TCTI %zu",
+               (size_t)(child - tcti_pool->children));
+    if (response_stale) {
+        rc = tcti_pool_drop_response (child);
+        if (rc != TSS2_RC_SUCCESS) {
+            tcti_pool_release_child (tcti_pool, child, locality_stale, true);
+            return rc;
+        }
+    }
+    if (locality_stale) {
+        rc = Tss2_Tcti_SetLocality (child->tcti, locality);
+        if (rc != TSS2_RC_SUCCESS) {
+            LOG_ERROR ("Failed to set locality %" PRIu8 " on child TCTI",
+                       locality);
+            tcti_pool_release_child (tcti_pool, child, true, false);
+            return rc;
+        }
+    }
+
+    rc = Tss2_Tcti_Transmit (child->tcti, size, cmd_buf);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Failed calling TCTI transmit of child TCTI module");
+        tcti_pool_release_child (tcti_pool, child, false, false);
+        return rc;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_pool_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    unsigned char *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool;
+    tcti_pool_child_t *child;
+    TSS2_RC rc;
+
+    tcti_pool = tcti_pool_find_owned_child (tctiContext, &child);
+    if (tcti_pool == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (response_size == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (child == NULL) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+
+    rc = Tss2_Tcti_Receive (child->tcti, response_size, response_buffer,
+                            timeout);
+    /* The child stays busy until the whole response has been received. */
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN ||
+        rc == TSS2_TCTI_RC_INSUFFICIENT_BUFFER ||
+        (rc == TSS2_RC_SUCCESS && response_buffer == NULL)) {
+        return rc;
+    }
+
+    tcti_pool_release_child (tcti_pool, child, false, false);
+    return rc;
+}
+
+/*
+ * The child is released whether or not the cancel succeeds. If it fails,
+ * the response is dropped before the child takes its next command.
+ */
+TSS2_RC
+tcti_pool_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool;
+    tcti_pool_child_t *child;
+    TSS2_RC rc;
+
+    tcti_pool = tcti_pool_find_owned_child (tctiContext, &child);
+    if (tcti_pool == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (child == NULL) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+
+    rc = Tss2_Tcti_Cancel (child->tcti);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_WARNING ("Failed to cancel command on child TCTI: 0x%" PRIx32, rc);
+    }
+    tcti_pool_release_child (tcti_pool, child, false, rc != TSS2_RC_SUCCESS);
+    return rc;
+}
+
+TSS2_RC
+tcti_pool_set_locality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = tcti_pool_resolve (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pool_down_cast (tcti_pool);
+    size_t i;
+
+    if (tcti_pool == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    pthread_mutex_lock (&tcti_pool->mutex);
+    if (tcti_pool_owned_child (tcti_pool, tctiContext) != NULL) {
+        pthread_mutex_unlock (&tcti_pool->mutex);
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+    tcti_common->locality = locality;
+    for (i = 0; i < tcti_pool->num_children; i++) {
+        tcti_pool->children [i].locality_stale = true;
+    }
+    pthread_mutex_unlock (&tcti_pool->mutex);
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Returns the poll handles of the child TCTI that the caller has a command
+ * in flight on.
+ */
+TSS2_RC
+tcti_pool_get_poll_handles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool;
+    tcti_pool_child_t *child;
+
+    tcti_pool = tcti_pool_find_owned_child (tctiContext, &child);
+    if (tcti_pool == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (child == NULL) {
+        return TSS2_TCTI_RC_BAD_SEQUENCE;
+    }
+
+    return Tss2_Tcti_GetPollHandles (child->tcti, handles, num_handles);
+}
+
+static void
+tcti_pool_finalize_children (
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool)
+{
+    size_t i;
+
+    for (i = 0; i < tcti_pool->num_children; i++) {
+        Tss2_TctiLdr_Finalize (&tcti_pool->children [i].tcti);
+    }
+    tcti_pool->num_children = 0;
+}
+
+void
+tcti_pool_finalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = tcti_pool_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pool_down_cast (tcti_pool);
+
+    if (tcti_pool == NULL) {
+        return;
+    }
+
+    tcti_pool_finalize_children (tcti_pool);
+    pthread_cond_destroy (&tcti_pool->idle);
+    pthread_mutex_destroy (&tcti_pool->mutex);
+
+    tcti_common->state = TCTI_STATE_FINAL;
+}
+
+/*
+ * This is an implementation of the standard TCTI initialization function for
+ * this module.
+ */
+TSS2_RC
+Tss2_Tcti_Pool_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = (TSS2_TCTI_POOL_CONTEXT*) tctiContext;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_pool_down_cast (tcti_pool);
+    char *conf_copy, *conf_iter, *child_conf;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_POOL_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (conf == NULL) {
+        LOG_ERROR ("tcti-pool requires the conf strings of its child TCTIs");
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    LOG_TRACE ("tctiContext: 0x%" PRIxPTR ", size: 0x%" PRIxPTR ", conf: %s",
+               (uintptr_t)tctiContext, (uintptr_t)size, conf);
+
+    memset (tcti_pool, 0, sizeof (*tcti_pool));
+    conf_copy = strdup (conf);
+    if (conf_copy == NULL) {
+        LOG_ERROR ("Failed to allocate memory for the conf string");
+        return TSS2_TCTI_RC_MEMORY;
+    }
+
+    conf_iter = conf_copy;
+    while ((child_conf = tcti_pool_next_conf (&conf_iter)) != NULL) {
+        if (tcti_pool->num_children == TCTI_POOL_MAX_CHILDREN) {
+            LOG_ERROR ("tcti-pool supports at most %d child TCTIs",
+                       TCTI_POOL_MAX_CHILDREN);
+            rc = TSS2_TCTI_RC_BAD_VALUE;
+            goto cleanup;
+        }
+        LOG_DEBUG ("Loading child TCTI %zu: %s", tcti_pool->num_children,
+                   child_conf);
+        rc = Tss2_TctiLdr_Initialize (child_conf,
+            &tcti_pool->children [tcti_pool->num_children].tcti);
+        if (rc != TSS2_RC_SUCCESS) {
+            LOG_ERROR ("Error loading TCTI: %s", child_conf);
+            goto cleanup;
+        }
+        tcti_pool->num_children++;
+    }
+    if (tcti_pool->num_children == 0) {
+        LOG_ERROR ("No child TCTI configured in conf string: %s", conf);
+        rc = TSS2_TCTI_RC_BAD_VALUE;
+        goto cleanup;
+    }
+
+    if (pthread_mutex_init (&tcti_pool->mutex, NULL) != 0) {
+        rc = TSS2_TCTI_RC_GENERAL_FAILURE;
+        goto cleanup;
+    }
+    if (pthread_cond_init (&tcti_pool->idle, NULL) != 0) {
+        pthread_mutex_destroy (&tcti_pool->mutex);
+        rc = TSS2_TCTI_RC_GENERAL_FAILURE;
+        goto cleanup;
+    }
+    free (conf_copy);
+
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_POOL_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_pool_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_pool_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = tcti_pool_finalize;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_pool_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_pool_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_pool_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = tcti_make_sticky_not_implemented;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    tcti_common->locality = 3;
+
+    return TSS2_RC_SUCCESS;
+
+cleanup:
+    tcti_pool_finalize_children (tcti_pool);
+    free (conf_copy);
+    return rc;
+}
+
+/*
+ * A child still owned by the client is released; the response of its
+ * command is dropped before the child takes the next command.
+ */
+void
+tcti_pool_client_finalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool;
+    tcti_pool_child_t *child;
+
+    if (tctiContext == NULL ||
+        TSS2_TCTI_MAGIC (tctiContext) != TCTI_POOL_CLIENT_MAGIC) {
+        return;
+    }
+    tcti_pool = tcti_pool_find_owned_child (tctiContext, &child);
+    if (child != NULL) {
+        tcti_pool_release_child (tcti_pool, child, false, true);
+    }
+    ((TSS2_TCTI_POOL_CLIENT_CONTEXT*)tctiContext)->common.state =
+        TCTI_STATE_FINAL;
+}
+
+/*
+ * Initialize a client context of a pool. The pool may be passed as the
+ * tctildr context that loaded it. The client context must be finalized
+ * before the pool.
+ */
+TSS2_RC
+Tss2_Tcti_Pool_InitClient (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    TSS2_TCTI_CONTEXT *pool)
+{
+    TSS2_TCTI_POOL_CLIENT_CONTEXT *client =
+        (TSS2_TCTI_POOL_CLIENT_CONTEXT*) tctiContext;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common;
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool;
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_POOL_CLIENT_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    tcti_pool = tcti_pool_context_cast (tcti_tctildr_child (pool));
+    if (tcti_pool == NULL) {
+        LOG_ERROR ("Not a tcti-pool context: 0x%" PRIxPTR, (uintptr_t)pool);
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    memset (client, 0, sizeof (*client));
+    client->pool = tcti_pool;
+    tcti_common = &client->common;
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_POOL_CLIENT_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_pool_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_pool_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = tcti_pool_client_finalize;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_pool_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_pool_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_pool_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = tcti_make_sticky_not_implemented;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+
+    return TSS2_RC_SUCCESS;
+}
+
+/* public info structure */
+const TSS2_TCTI_INFO tss2_tcti_info = {
+    .version = TCTI_VERSION,
+    .name = "tcti-pool",
+    .description = "TCTI module for dispatching TPM commands across a pool "
+                   "of child TCTIs.",
+    .config_help = "Comma separated list of child TCTI modules and their "
+                   "config strings: <name>:<conf>,<name>:<conf>,...",
+    .init = Tss2_Tcti_Pool_Init,
+};
+
+const TSS2_TCTI_INFO*
+Tss2_Tcti_Info (void)
+{
+    return &tss2_tcti_info;
+}
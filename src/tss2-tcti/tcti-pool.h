@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2021 Intel Corporation
+ * All rights reserved.
+ */
+
+#ifndef TCTI_POOL_H
+#define TCTI_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "tss2_tcti.h"
+#include "tcti-common.h"
+
+#define TCTI_POOL_MAGIC 0x5c0e3a9b7f1d2e64ULL
+#define TCTI_POOL_CLIENT_MAGIC 0x5c0e3a9b7f1d2e65ULL
+#define TCTI_POOL_MAX_CHILDREN 16
+
+/*
+ * A child TCTI is busy from the transmit of a command until the matching
+ * receive completes. While busy it is owned by the TCTI context the command
+ * was sent through, i.e. the pool context or one of its client contexts, so
+ * the response may be received by any thread. A locality set on the pool is
+ * applied to each child before its next command. If a command was cancelled
+ * unsuccessfully, its response is read and dropped before the next command.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT *tcti;
+    bool busy;
+    bool locality_stale;
+    bool response_stale;
+    const void *owner;
+} tcti_pool_child_t;
+
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    pthread_mutex_t mutex;
+    pthread_cond_t idle;
+    size_t num_children;
+    size_t next_child;
+    tcti_pool_child_t children [TCTI_POOL_MAX_CHILDREN];
+} TSS2_TCTI_POOL_CONTEXT;
+
+/*
+ * A client context is a separate caller of a pool: it may have a command in
+ * flight while the pool context or other clients have theirs.
+ */
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    TSS2_TCTI_POOL_CONTEXT *pool;
+} TSS2_TCTI_POOL_CLIENT_CONTEXT;
+
+char*
+tcti_pool_next_conf (
+    char **conf);
+
+#endif /* TCTI_POOL_H */
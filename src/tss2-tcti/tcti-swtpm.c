@@ -81,6 +81,56 @@ tcti_swtpm_down_cast (TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm)
     return &tcti_swtpm->common;
 }
 
+/*
+ * swtpm serves one client at a time, so a new connection is opened for every
+ * command. The Unix domain socket at 'path' is used if set, host:port
+ * otherwise. A failed connect is retried up to 'reconnect' times with
+ * exponential backoff, e.g. while swtpm is being restarted.
+ */
+static TSS2_RC
+tcti_swtpm_connect (
+    TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm,
+    const char *path,
+    uint16_t port,
+    SOCKET *sock)
+{
+    socket_conf_t *conf = &tcti_swtpm->swtpm_conf.socket;
+    uint32_t delay = conf->reconnect_delay;
+    uint32_t attempt;
+    TSS2_RC rc;
+
+    for (attempt = 0; ; attempt++) {
+        if (path != NULL) {
+            rc = socket_connect_unix (path, conf->connect_timeout, sock);
+        } else {
+            rc = socket_connect_timeout (tcti_swtpm->swtpm_conf.host, port,
+                                         conf->connect_timeout, sock);
+        }
+        if (rc == TSS2_RC_SUCCESS) {
+            break;
+        }
+        tcti_swtpm->connect_failures++;
+        if (attempt >= conf->reconnect || rc == TSS2_TCTI_RC_BAD_VALUE ||
+            rc == TSS2_TCTI_RC_NOT_IMPLEMENTED) {
+            return rc;
+        }
+        socket_backoff (&delay);
+    }
+
+    if (attempt > 0) {
+        tcti_swtpm->reconnects++;
+        LOG_WARNING ("Reconnected to swtpm, %" PRIu32 " reconnects, %" PRIu32
+                     " failed attempts", tcti_swtpm->reconnects,
+                     tcti_swtpm->connect_failures);
+    }
+
+    rc = socket_set_io_timeout (*sock, conf->io_timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        socket_close (sock);
+    }
+    return rc;
+}
+
 /*
  * This function is for sending one of the SWTPM_* control commands to the swtpm
  * simulator. These are sent over the out-of-band control socket.
@@ -135,9 +185,10 @@ TSS2_RC tcti_control_command (
     uint8_t resp_buf[SWTPM_CTRL_RESP_MAX_LEN] = { 0 };
     size_t resp_buf_len = sizeof(uint32_t);
 
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port + 1,
-                         &tcti_swtpm->ctrl_sock);
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.ctrl_path,
+                             tcti_swtpm->swtpm_conf.port + 1,
+                             &tcti_swtpm->ctrl_sock);
     if (rc != TSS2_RC_SUCCESS) {
         LOG_ERROR ("Failed to connect to control socket.");
         rc = TSS2_TCTI_RC_IO_ERROR;
@@ -274,15 +325,17 @@ tcti_swtpm_transmit (
     LOG_DEBUG ("Sending command with TPM_CC 0x%" PRIx32 " and size %" PRIu32,
                header.code, header.size);
 
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port,
-                         &tcti_swtpm->tpm_sock);
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.path,
+                             tcti_swtpm->swtpm_conf.port,
+                             &tcti_swtpm->tpm_sock);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
 
     rc = socket_xmit_buf (tcti_swtpm->tpm_sock, cmd_buf, size);
     if (rc != TSS2_RC_SUCCESS) {
+        socket_close (&tcti_swtpm->tpm_sock);
         return rc;
     }
 
@@ -361,6 +414,41 @@ tcti_swtpm_finalize(
     free (tcti_swtpm->conf_copy);
 }
 
+/*
+ * Receive into the context buffer until it holds 'min' bytes. A blocking
+ * receive gives up after the configured IO timeout.
+ */
+static TSS2_RC
+tcti_swtpm_recv (
+    TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm,
+    size_t min,
+    int32_t timeout)
+{
+    uint32_t io_timeout = tcti_swtpm->swtpm_conf.socket.io_timeout;
+    TSS2_RC rc;
+
+    if (timeout != TSS2_TCTI_TIMEOUT_BLOCK || io_timeout == 0) {
+        return socket_recv_buffered (tcti_swtpm->tpm_sock,
+                                     tcti_swtpm->rsp_buf,
+                                     sizeof (tcti_swtpm->rsp_buf),
+                                     &tcti_swtpm->rsp_count,
+                                     min,
+                                     timeout);
+    }
+
+    rc = socket_recv_buffered (tcti_swtpm->tpm_sock,
+                               tcti_swtpm->rsp_buf,
+                               sizeof (tcti_swtpm->rsp_buf),
+                               &tcti_swtpm->rsp_count,
+                               min,
+                               io_timeout);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        LOG_ERROR ("No response from swtpm within %" PRIu32 " ms", io_timeout);
+        rc = TSS2_TCTI_RC_IO_ERROR;
+    }
+    return rc;
+}
+
 TSS2_RC
 tcti_swtpm_receive (
     TSS2_TCTI_CONTEXT *tctiContext,
@@ -376,7 +464,6 @@ tcti_swtpm_receive (
     TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm = tcti_swtpm_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_swtpm_down_cast (tcti_swtpm);
     TSS2_RC rc;
-    int ret;
 
     rc = tcti_common_receive_checks (tcti_common, response_size, TCTI_SWTPM_MAGIC);
     if (rc != TSS2_RC_SUCCESS) {
@@ -384,7 +471,6 @@ tcti_swtpm_receive (
     }
 
     if (timeout != TSS2_TCTI_TIMEOUT_BLOCK) {
-        LOG_TRACE("Asynchronous I/O not actually implemented.");
 #ifdef TEST_FAPI_ASYNC
         if (wait < 1) {
             LOG_TRACE("Simulating Async by requesting another invocation.");
@@ -397,20 +483,30 @@ tcti_swtpm_receive (
 #endif /* TEST_FAPI_ASYNC */
     }
 
-    if (tcti_common->header.size == 0) {
+    /*
+     * The whole response is read into the context buffer, usually with a
+     * single read. Data received before a timeout is kept for the next call.
+     */
+    if (tcti_swtpm->rsp_count < TPM_HEADER_SIZE) {
         LOG_DEBUG("Receiving header to determine the size of the response.");
-        uint8_t res_header[10];
-        ret = socket_recv_buf (tcti_swtpm->tpm_sock, &res_header[0], 10);
-        if (ret != 10) {
-            rc = TSS2_TCTI_RC_IO_ERROR;
+        rc = tcti_swtpm_recv (tcti_swtpm, TPM_HEADER_SIZE, timeout);
+        if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+            return rc;
+        } else if (rc != TSS2_RC_SUCCESS) {
             goto out;
         }
 
-        rc = header_unmarshal (&res_header[0], &tcti_common->header);
+        rc = header_unmarshal (tcti_swtpm->rsp_buf, &tcti_common->header);
         if (rc != TSS2_RC_SUCCESS) {
             LOG_ERROR ("Failed to unmarshal tpm2 header: 0x%" PRIx32, rc);
             goto out;
         }
+        if (tcti_common->header.size > sizeof (tcti_swtpm->rsp_buf)) {
+            LOG_ERROR ("Response size %" PRIu32 " exceeds maximum of %zu",
+                       tcti_common->header.size, sizeof (tcti_swtpm->rsp_buf));
+            rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
+            goto out;
+        }
 
         LOG_DEBUG ("response size: %" PRIu32, tcti_common->header.size);
     }
@@ -426,22 +522,14 @@ tcti_swtpm_receive (
     }
     *response_size = tcti_common->header.size;
 
-    if (tcti_common->header.size > 10) {
-        LOG_DEBUG ("Reading response of size %" PRIu32, tcti_common->header.size);
-        ret = socket_recv_buf (tcti_swtpm->tpm_sock,
-                               (unsigned char *)&response_buffer[10],
-                               tcti_common->header.size - 10);
-        if (ret < (ssize_t)tcti_common->header.size - 10) {
-            rc = TSS2_TCTI_RC_IO_ERROR;
-            goto out;
-        }
-    }
-
-    rc = header_marshal (&tcti_common->header, &response_buffer[0]);
-    if (rc != TSS2_RC_SUCCESS) {
-        LOG_WARNING ("Failed to remarshal tpm2 header: 0x%"PRIu32, rc);
+    LOG_DEBUG ("Reading response of size %" PRIu32, tcti_common->header.size);
+    rc = tcti_swtpm_recv (tcti_swtpm, tcti_common->header.size, timeout);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        return rc;
+    } else if (rc != TSS2_RC_SUCCESS) {
         goto out;
     }
+    memcpy (response_buffer, tcti_swtpm->rsp_buf, tcti_common->header.size);
 
     LOGBLOB_DEBUG(response_buffer, tcti_common->header.size,
                   "Response received:");
@@ -454,6 +542,7 @@ out:
     socket_close (&tcti_swtpm->tpm_sock);
 
     tcti_common->header.size = 0;
+    tcti_swtpm->rsp_count = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
 
     return rc;
@@ -503,8 +592,14 @@ swtpm_kv_callback (const key_value_t *key_value,
             return TSS2_TCTI_RC_BAD_VALUE;
         }
         return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "path") == 0) {
+        swtpm_conf->path = key_value->value;
+        return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "ctrl_path") == 0) {
+        swtpm_conf->ctrl_path = key_value->value;
+        return TSS2_RC_SUCCESS;
     } else {
-        return TSS2_TCTI_RC_BAD_VALUE;
+        return socket_conf_kv (key_value, &swtpm_conf->socket);
     }
 }
 void
@@ -523,6 +618,31 @@ tcti_swtpm_init_context_data (
     tcti_common->state = TCTI_STATE_TRANSMIT;
     memset (&tcti_common->header, 0, sizeof (tcti_common->header));
 }
+/*
+ * Report how often the connection to the swtpm was reestablished and how
+ * many connection attempts failed. The context may be the tctildr context
+ * that loaded the swtpm TCTI.
+ */
+TSS2_RC
+Tss2_Tcti_Swtpm_GetStats (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_SWTPM_STATS *stats)
+{
+    TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm =
+        tcti_swtpm_context_cast (tcti_tctildr_child (tctiContext));
+
+    if (tcti_swtpm == NULL ||
+        TSS2_TCTI_MAGIC (tcti_swtpm) != TCTI_SWTPM_MAGIC) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    if (stats == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+
+    stats->reconnects = tcti_swtpm->reconnects;
+    stats->connect_failures = tcti_swtpm->connect_failures;
+    return TSS2_RC_SUCCESS;
+}
 /*
  * This is an implementation of the standard TCTI initialization function for
  * this module.
@@ -554,6 +674,13 @@ Tss2_Tcti_Swtpm_Init (
 
     tcti_swtpm->swtpm_conf.host = TCTI_SWTPM_DEFAULT_HOST;
     tcti_swtpm->swtpm_conf.port = TCTI_SWTPM_DEFAULT_PORT;
+    tcti_swtpm->swtpm_conf.path = NULL;
+    tcti_swtpm->swtpm_conf.ctrl_path = NULL;
+    tcti_swtpm->swtpm_conf.socket = (socket_conf_t)SOCKET_CONF_DEFAULT_INIT;
+    tcti_swtpm->conf_copy = NULL;
+    tcti_swtpm->reconnects = 0;
+    tcti_swtpm->connect_failures = 0;
+    tcti_swtpm->rsp_count = 0;
 
     if (conf != NULL) {
         LOG_TRACE ("conf is not NULL");
@@ -576,16 +703,22 @@ Tss2_Tcti_Swtpm_Init (
             goto fail_out;
         }
     }
-    LOG_DEBUG ("Initializing swtpm TCTI with host: %s, port: %" PRIu16,
-               tcti_swtpm->swtpm_conf.host, tcti_swtpm->swtpm_conf.port);
+    if (tcti_swtpm->swtpm_conf.path != NULL) {
+        LOG_DEBUG ("Initializing swtpm TCTI with path: %s",
+                   tcti_swtpm->swtpm_conf.path);
+    } else {
+        LOG_DEBUG ("Initializing swtpm TCTI with host: %s, port: %" PRIu16,
+                   tcti_swtpm->swtpm_conf.host, tcti_swtpm->swtpm_conf.port);
+    }
 
     tcti_swtpm->tpm_sock = -1;
     tcti_swtpm->ctrl_sock = -1;
 
     /* sanity check */
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port,
-                         &tcti_swtpm->tpm_sock);
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.path,
+                             tcti_swtpm->swtpm_conf.port,
+                             &tcti_swtpm->tpm_sock);
     socket_close (&tcti_swtpm->tpm_sock);
     if (rc != TSS2_RC_SUCCESS) {
         LOG_ERROR ("Cannot connect to swtpm TPM socket");
@@ -615,7 +748,10 @@ const TSS2_TCTI_INFO tss2_tcti_info = {
     .version = TCTI_VERSION,
     .name = "tcti-swtpm",
     .description = "TCTI module for communication with the swtpm.",
-    .config_help = "Key / value string in the form \"host=localhost,port=2321\".",
+    .config_help = "Key / value string in the form \"host=localhost,port=2321\""
+        " or \"path=/run/swtpm.sock,ctrl_path=/run/swtpm.ctrl\"."
+        " Optional keys: connect_timeout, io_timeout (ms), reconnect (retries),"
+        " reconnect_delay (ms).",
     .init = Tss2_Tcti_Swtpm_Init,
 };
 
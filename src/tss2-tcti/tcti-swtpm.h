@@ -12,16 +12,24 @@
 #include "tcti-common.h"
 #include "util/io.h"
 
+#ifndef PATH_MAX
+#define PATH_MAX MAX_PATH
+#endif
+
 /*
  * longest possible conf string:
  * HOST_NAME_MAX + max char uint16 (5) + strlen ("host=,port=") (11)
+ * + 2 * PATH_MAX + strlen (",path=,ctrl_path=") (17)
+ * + socket options
  */
-#define TCTI_SWTPM_CONF_MAX (_HOST_NAME_MAX + 16)
+#define TCTI_SWTPM_CONF_MAX (_HOST_NAME_MAX + 16 + 2 * PATH_MAX + 17 + \
+                             SOCKET_CONF_MAX)
 #define TCTI_SWTPM_DEFAULT_HOST "localhost"
 #define TCTI_SWTPM_DEFAULT_PORT 2321
 #define SWTPM_CONF_DEFAULT_INIT { \
     .host = TCTI_SWTPM_DEFAULT_HOST, \
     .port = TCTI_SWTPM_DEFAULT_PORT, \
+    .socket = SOCKET_CONF_DEFAULT_INIT, \
 }
 
 #define TCTI_SWTPM_MAGIC 0x496E66696E656F6EULL
@@ -36,6 +44,10 @@
 typedef struct {
     char *host;
     uint16_t port;
+    /* Unix domain sockets used instead of host:port and host:port+1 */
+    char *path;
+    char *ctrl_path;
+    socket_conf_t socket;
 } swtpm_conf_t;
 
 typedef struct {
@@ -44,6 +56,12 @@ typedef struct {
     SOCKET tpm_sock;
     char *conf_copy;
     swtpm_conf_t swtpm_conf;
+    /* connections made after retrying and failed connection attempts */
+    uint32_t reconnects;
+    uint32_t connect_failures;
+    /* Response and the number of bytes of it received so far. */
+    uint8_t rsp_buf [TPM2_MAX_RESPONSE_SIZE];
+    size_t rsp_count;
 } TSS2_TCTI_SWTPM_CONTEXT;
 
 #endif /* TCTI_SWTPM_H */
@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2015 - 2018, Intel Corporation
+ * All rights reserved.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include "tss2_tpm2_types.h"
+
+#include "util/command-info.h"
+
+#define CMD_INFO(cc, cmd_handles, rsp_handles) \
+    [TPM2_CC_##cc - TPM2_CC_FIRST] = { \
+        .commandCode = TPM2_CC_##cc, \
+        .numCommandHandles = cmd_handles, \
+        .numResponseHandles = rsp_handles, \
+    }
+
+/*
+ * Command metadata indexed by the command code relative to TPM2_CC_FIRST.
+ * Command codes without an entry (gaps in the specification) are zeroed and
+ * thus have a commandCode that does not match their index.
+ * Columns: command handles, response handles. test/unit/command-info checks
+ * that every TPM2_CC_* of tss2_tpm2_types.h has an entry.
+ */
+static const COMMAND_INFO command_info[TPM2_CC_LAST - TPM2_CC_FIRST + 1] =
+{
+    CMD_INFO(NV_UndefineSpaceSpecial, 2, 0),
+    CMD_INFO(EvictControl, 2, 0),
+    CMD_INFO(HierarchyControl, 1, 0),
+    CMD_INFO(NV_UndefineSpace, 2, 0),
+    CMD_INFO(ChangeEPS, 1, 0),
+    CMD_INFO(ChangePPS, 1, 0),
+    CMD_INFO(Clear, 1, 0),
+    CMD_INFO(ClearControl, 1, 0),
+    CMD_INFO(ClockSet, 1, 0),
+    CMD_INFO(HierarchyChangeAuth, 1, 0),
+    CMD_INFO(NV_DefineSpace, 1, 0),
+    CMD_INFO(PCR_Allocate, 1, 0),
+    CMD_INFO(PCR_SetAuthPolicy, 1, 0),
+    CMD_INFO(PP_Commands, 1, 0),
+    CMD_INFO(SetPrimaryPolicy, 1, 0),
+    CMD_INFO(FieldUpgradeStart, 2, 0),
+    CMD_INFO(ClockRateAdjust, 1, 0),
+    CMD_INFO(CreatePrimary, 1, 1),
+    CMD_INFO(NV_GlobalWriteLock, 1, 0),
+    CMD_INFO(GetCommandAuditDigest, 2, 0),
+    CMD_INFO(NV_Increment, 2, 0),
+    CMD_INFO(NV_SetBits, 2, 0),
+    CMD_INFO(NV_Extend, 2, 0),
+    CMD_INFO(NV_Write, 2, 0),
+    CMD_INFO(NV_WriteLock, 2, 0),
+    CMD_INFO(DictionaryAttackLockReset, 1, 0),
+    CMD_INFO(DictionaryAttackParameters, 1, 0),
+    CMD_INFO(NV_ChangeAuth, 1, 0),
+    CMD_INFO(PCR_Event, 1, 0),
+    CMD_INFO(PCR_Reset, 1, 0),
+    CMD_INFO(SequenceComplete, 1, 0),
+    CMD_INFO(SetAlgorithmSet, 1, 0),
+    CMD_INFO(SetCommandCodeAuditStatus, 1, 0),
+    CMD_INFO(FieldUpgradeData, 0, 0),
+    CMD_INFO(IncrementalSelfTest, 0, 0),
+    CMD_INFO(SelfTest, 0, 0),
+    CMD_INFO(Startup, 0, 0),
+    CMD_INFO(Shutdown, 0, 0),
+    CMD_INFO(StirRandom, 0, 0),
+    CMD_INFO(ActivateCredential, 2, 0),
+    CMD_INFO(Certify, 2, 0),
+    CMD_INFO(PolicyNV, 3, 0),
+    CMD_INFO(CertifyCreation, 2, 0),
+    CMD_INFO(Duplicate, 2, 0),
+    CMD_INFO(GetTime, 2, 0),
+    CMD_INFO(GetSessionAuditDigest, 3, 0),
+    CMD_INFO(NV_Read, 2, 0),
+    CMD_INFO(NV_ReadLock, 2, 0),
+    CMD_INFO(ObjectChangeAuth, 2, 0),
+    CMD_INFO(PolicySecret, 2, 0),
+    CMD_INFO(Rewrap, 2, 0),
+    CMD_INFO(Create, 1, 0),
+    CMD_INFO(ECDH_ZGen, 1, 0),
+    CMD_INFO(HMAC, 1, 0),
+    CMD_INFO(Import, 1, 0),
+    CMD_INFO(Load, 1, 1),
+    CMD_INFO(Quote, 1, 0),
+    CMD_INFO(RSA_Decrypt, 1, 0),
+    CMD_INFO(HMAC_Start, 1, 1),
+    CMD_INFO(SequenceUpdate, 1, 0),
+    CMD_INFO(Sign, 1, 0),
+    CMD_INFO(Unseal, 1, 0),
+    CMD_INFO(PolicySigned, 2, 0),
+    CMD_INFO(ContextLoad, 0, 1),
+    CMD_INFO(ContextSave, 1, 0),
+    CMD_INFO(ECDH_KeyGen, 1, 0),
+    CMD_INFO(EncryptDecrypt, 1, 0),
+    CMD_INFO(FlushContext, 1, 0),
+    CMD_INFO(LoadExternal, 0, 1),
+    CMD_INFO(MakeCredential, 1, 0),
+    CMD_INFO(NV_ReadPublic, 1, 0),
+    CMD_INFO(PolicyAuthorize, 1, 0),
+    CMD_INFO(PolicyAuthValue, 1, 0),
+    CMD_INFO(PolicyCommandCode, 1, 0),
+    CMD_INFO(PolicyCounterTimer, 1, 0),
+    CMD_INFO(PolicyCpHash, 1, 0),
+    CMD_INFO(PolicyLocality, 1, 0),
+    CMD_INFO(PolicyNameHash, 1, 0),
+    CMD_INFO(PolicyOR, 1, 0),
+    CMD_INFO(PolicyTicket, 1, 0),
+    CMD_INFO(ReadPublic, 1, 0),
+    CMD_INFO(RSA_Encrypt, 1, 0),
+    CMD_INFO(StartAuthSession, 2, 1),
+    CMD_INFO(VerifySignature, 1, 0),
+    CMD_INFO(ECC_Parameters, 0, 0),
+    CMD_INFO(FirmwareRead, 0, 0),
+    CMD_INFO(GetCapability, 0, 0),
+    CMD_INFO(GetRandom, 0, 0),
+    CMD_INFO(GetTestResult, 0, 0),
+    CMD_INFO(Hash, 0, 0),
+    CMD_INFO(PCR_Read, 0, 0),
+    CMD_INFO(PolicyPCR, 1, 0),
+    CMD_INFO(PolicyRestart, 1, 0),
+    CMD_INFO(ReadClock, 0, 0),
+    CMD_INFO(PCR_Extend, 1, 0),
+    CMD_INFO(PCR_SetAuthValue, 1, 0),
+    CMD_INFO(NV_Certify, 3, 0),
+    CMD_INFO(EventSequenceComplete, 2, 0),
+    CMD_INFO(HashSequenceStart, 0, 1),
+    CMD_INFO(PolicyPhysicalPresence, 1, 0),
+    CMD_INFO(PolicyDuplicationSelect, 1, 0),
+    CMD_INFO(PolicyGetDigest, 1, 0),
+    CMD_INFO(TestParms, 0, 0),
+    CMD_INFO(Commit, 1, 0),
+    CMD_INFO(PolicyPassword, 1, 0),
+    CMD_INFO(ZGen_2Phase, 1, 0),
+    CMD_INFO(EC_Ephemeral, 0, 0),
+    CMD_INFO(PolicyNvWritten, 1, 0),
+    CMD_INFO(PolicyTemplate, 1, 0),
+    CMD_INFO(CreateLoaded, 1, 1),
+    CMD_INFO(PolicyAuthorizeNV, 3, 0),
+    CMD_INFO(EncryptDecrypt2, 1, 0),
+    CMD_INFO(AC_GetCapability, 1, 0),
+    CMD_INFO(AC_Send, 3, 0),
+    CMD_INFO(Policy_AC_SendSelect, 1, 0),
+    CMD_INFO(CertifyX509, 2, 0),
+    CMD_INFO(ACT_SetTimeout, 1, 0)
+};
+
+/*
+ * Vendor specific commands have the vendor bit (0x20000000) set and are not
+ * part of the direct-indexed table above.
+ */
+static const COMMAND_INFO vendor_command_info[] =
+{
+    {
+        .commandCode = TPM2_CC_Vendor_TCG_Test,
+        .numCommandHandles = 0,
+        .numResponseHandles = 0,
+    },
+};
+
+/*
+ * Look up the metadata of a command in constant time. Returns NULL for
+ * unknown command codes.
+ */
+const COMMAND_INFO *
+get_command_info (TPM2_CC commandCode)
+{
+    size_t i;
+
+    if (commandCode >= TPM2_CC_FIRST && commandCode <= TPM2_CC_LAST) {
+        const COMMAND_INFO *info = &command_info[commandCode - TPM2_CC_FIRST];
+        return info->commandCode == commandCode ? info : NULL;
+    }
+
+    for (i = 0; i < sizeof (vendor_command_info) /
+                    sizeof (vendor_command_info[0]); i++) {
+        if (vendor_command_info[i].commandCode == commandCode) {
+            return &vendor_command_info[i];
+        }
+    }
+
+    return NULL;
+}
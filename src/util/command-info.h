@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2015 - 2018, Intel Corporation
+ * All rights reserved.
+ */
+
+#ifndef COMMAND_INFO_H
+#define COMMAND_INFO_H
+
+#include "tss2_tpm2_types.h"
+
+/*
+ * Static metadata of a TPM2 command as defined in part 3 of the TPM2
+ * specification: the number of handles in the handle area of the command
+ * and of the response.
+ */
+typedef struct {
+    TPM2_CC commandCode;
+    UINT8 numCommandHandles;
+    UINT8 numResponseHandles;
+} COMMAND_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const COMMAND_INFO *
+get_command_info (TPM2_CC commandCode);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* COMMAND_INFO_H */
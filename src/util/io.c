@@ -13,11 +13,14 @@
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #ifndef _WIN32
 #include <poll.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #endif
 
@@ -144,6 +147,143 @@ socket_xmit_buf (
     return TSS2_RC_SUCCESS;
 }
 
+TSS2_RC
+socket_xmit_bufv (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt)
+{
+#ifdef _WIN32
+    TSS2_RC rc;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        rc = socket_xmit_buf (sock, iov [i].iov_base, iov [i].iov_len);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        iov [i].iov_len = 0;
+    }
+    return TSS2_RC_SUCCESS;
+#else
+    ssize_t written;
+    size_t len;
+
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+        TEMP_RETRY (written, writev (sock, iov, iovcnt));
+        if (written < 0) {
+            LOG_ERROR ("writev to fd %d failed, errno %d: %s",
+                       sock, errno, strerror (errno));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+        LOG_DEBUG ("wrote %zd bytes to fd %d", written, sock);
+        while (written > 0 && iovcnt > 0) {
+            len = (size_t)written < iov->iov_len ?
+                (size_t)written : iov->iov_len;
+            iov->iov_base = (uint8_t*)iov->iov_base + len;
+            iov->iov_len -= len;
+            written -= len;
+            if (iov->iov_len == 0) {
+                iov++;
+                iovcnt--;
+            }
+        }
+    }
+    return TSS2_RC_SUCCESS;
+#endif
+}
+
+TSS2_RC
+socket_recv_buffered (
+    SOCKET sock,
+    uint8_t *buf,
+    size_t size,
+    size_t *count,
+    size_t min,
+    int timeout)
+{
+    ssize_t recvd;
+    TSS2_RC rc;
+#ifndef _WIN32
+    struct timespec deadline = { 0 }, now;
+    int64_t remaining;
+#endif
+
+    if (buf == NULL || count == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (min > size || *count > size) {
+        LOG_ERROR ("Cannot buffer %zu bytes in a buffer of size %zu",
+                   min, size);
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+
+#ifndef _WIN32
+    /* The timeout bounds the whole receive, not each poll. */
+    if (timeout > 0 && clock_gettime (CLOCK_MONOTONIC, &deadline) == 0) {
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+#endif
+    while (*count < min) {
+#ifndef _WIN32
+        if (deadline.tv_sec != 0 &&
+            clock_gettime (CLOCK_MONOTONIC, &now) == 0) {
+            remaining = (int64_t)(deadline.tv_sec - now.tv_sec) * 1000 +
+                (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+            if (remaining <= 0) {
+                LOG_DEBUG ("Timeout after %zu of %zu bytes from fd %d",
+                           *count, min, sock);
+                return TSS2_TCTI_RC_TRY_AGAIN;
+            }
+            timeout = (int)remaining;
+        }
+#endif
+        rc = socket_poll (sock, timeout);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+#ifdef _WIN32
+        TEMP_RETRY (recvd, recv (sock, (char *) &buf [*count],
+                                 (int)(size - *count), 0));
+        if (recvd < 0) {
+            LOG_ERROR ("read on fd %d failed with errno %d: %s",
+                       sock, WSAGetLastError(), strerror (WSAGetLastError()));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+#else
+        TEMP_RETRY (recvd, read (sock, &buf [*count], size - *count));
+        if (recvd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            LOG_ERROR ("read on fd %d failed with errno %d: %s",
+                       sock, errno, strerror (errno));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+#endif
+        if (recvd == 0) {
+            LOG_ERROR ("Read %zu of %zu bytes from fd %d before EOF",
+                       *count, min, sock);
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+        LOGBLOB_DEBUG (&buf [*count], recvd, "read %zd bytes from fd %d:",
+                       recvd, sock);
+        *count += recvd;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
 TSS2_RC
 socket_close (
     SOCKET *socket)
@@ -177,11 +317,93 @@ socket_close (
     return TSS2_RC_SUCCESS;
 }
 
+/*
+ * Request / response protocols gain nothing from Nagle's algorithm, and
+ * keepalive probes let a dead peer be noticed on an idle connection. Failing
+ * to set either is not fatal.
+ */
+static void
+socket_set_opts (
+    SOCKET sock)
+{
+    const int one = 1;
+
+    if (setsockopt (sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&one,
+                    sizeof (one)) != 0) {
+        LOG_DEBUG ("Failed to set TCP_NODELAY on socket %d", sock);
+    }
+    if (setsockopt (sock, SOL_SOCKET, SO_KEEPALIVE, (const char*)&one,
+                    sizeof (one)) != 0) {
+        LOG_DEBUG ("Failed to set SO_KEEPALIVE on socket %d", sock);
+    }
+}
+
+/*
+ * Connect 'sock' to the address 'addr'. With a non-zero 'timeout' the
+ * connection is made in non-blocking mode and given up after 'timeout'
+ * milliseconds. Windows always uses a blocking connect.
+ */
+static int
+socket_connect_addr (
+    SOCKET sock,
+    const struct sockaddr *addr,
+    socklen_t addrlen,
+    uint32_t timeout)
+{
+#ifndef _WIN32
+    struct pollfd fds;
+    socklen_t len = sizeof (int);
+    int flags, ret, err = 0;
+
+    if (timeout == 0) {
+        return connect (sock, addr, addrlen);
+    }
+
+    flags = fcntl (sock, F_GETFL);
+    if (flags == -1 || fcntl (sock, F_SETFL, flags | O_NONBLOCK) != 0) {
+        return SOCKET_ERROR;
+    }
+    ret = connect (sock, addr, addrlen);
+    if (ret == SOCKET_ERROR && errno == EINPROGRESS) {
+        fds.fd = sock;
+        fds.events = POLLOUT;
+        TEMP_RETRY (ret, poll (&fds, 1, timeout));
+        if (ret == 0) {
+            errno = ETIMEDOUT;
+            ret = SOCKET_ERROR;
+        } else if (ret > 0) {
+            ret = getsockopt (sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (ret == 0 && err != 0) {
+                errno = err;
+                ret = SOCKET_ERROR;
+            }
+        }
+    }
+    if (ret != SOCKET_ERROR && fcntl (sock, F_SETFL, flags) != 0) {
+        ret = SOCKET_ERROR;
+    }
+    return ret;
+#else
+    (void)timeout;
+    return connect (sock, addr, addrlen);
+#endif
+}
+
 TSS2_RC
 socket_connect (
     const char *hostname,
     uint16_t port,
     SOCKET *sock)
+{
+    return socket_connect_timeout (hostname, port, 0, sock);
+}
+
+TSS2_RC
+socket_connect_timeout (
+    const char *hostname,
+    uint16_t port,
+    uint32_t timeout,
+    SOCKET *sock)
 {
     static const struct addrinfo hints = { .ai_socktype = SOCK_STREAM,
         .ai_family = AF_UNSPEC, .ai_protocol = IPPROTO_TCP};
@@ -239,8 +461,11 @@ socket_connect (
             h = hostname;
 
         LOG_DEBUG ("Attempting TCP connection to host %s, port %s", h, port_str);
-        if (connect (*sock, p->ai_addr, p->ai_addrlen) != SOCKET_ERROR)
+        if (socket_connect_addr (*sock, p->ai_addr, (socklen_t)p->ai_addrlen,
+                                 timeout) != SOCKET_ERROR) {
+            socket_set_opts (*sock);
             break; /* socket connected OK */
+        }
         socket_close (sock);
     }
     freeaddrinfo (retp);
@@ -259,6 +484,159 @@ socket_connect (
     return TSS2_RC_SUCCESS;
 }
 
+TSS2_RC
+socket_connect_unix (
+    const char *path,
+    uint32_t timeout,
+    SOCKET *sock)
+{
+#ifndef _WIN32
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t len;
+
+    if (path == NULL || sock == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    len = strlen (path);
+    if (len == 0 || len >= sizeof (addr.sun_path)) {
+        LOG_ERROR ("Invalid socket path: %s", path);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    memcpy (addr.sun_path, path, len + 1);
+
+    *sock = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (*sock == INVALID_SOCKET) {
+        LOG_WARNING ("Failed to create socket, errno %d: %s", errno,
+                     strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    LOG_DEBUG ("Attempting connection to socket %s", path);
+    if (socket_connect_addr (*sock, (struct sockaddr*)&addr, sizeof (addr),
+                             timeout) == SOCKET_ERROR) {
+        LOG_WARNING ("Failed to connect to socket %s: errno %d: %s",
+                     path, errno, strerror (errno));
+        socket_close (sock);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    return TSS2_RC_SUCCESS;
+#else
+    (void)path;
+    (void)timeout;
+    (void)sock;
+    LOG_ERROR ("Unix domain sockets are not supported on this platform");
+    return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+#endif
+}
+
+TSS2_RC
+socket_set_io_timeout (
+    SOCKET sock,
+    uint32_t timeout)
+{
+#ifdef _WIN32
+    DWORD tv = timeout;
+#else
+    struct timeval tv = {
+        .tv_sec = timeout / 1000,
+        .tv_usec = (timeout % 1000) * 1000,
+    };
+#endif
+
+    if (timeout == 0) {
+        return TSS2_RC_SUCCESS;
+    }
+    if (setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv,
+                    sizeof (tv)) != 0 ||
+        setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv,
+                    sizeof (tv)) != 0) {
+        LOG_ERROR ("Failed to set timeout on socket %d", sock);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+bool
+socket_peer_closed (
+    SOCKET sock)
+{
+#ifndef _WIN32
+    uint8_t byte;
+    int ret;
+
+    TEMP_RETRY (ret, recv (sock, &byte, sizeof (byte),
+                           MSG_PEEK | MSG_DONTWAIT));
+    if (ret == 0 || (ret < 0 && (errno == ECONNRESET || errno == EPIPE))) {
+        LOG_DEBUG ("Peer closed the connection on socket %d", sock);
+        return true;
+    }
+#else
+    (void)sock;
+#endif
+    return false;
+}
+
+void
+socket_backoff (
+    uint32_t *delay)
+{
+    if (*delay == 0) {
+        *delay = 1;
+    }
+#ifdef _WIN32
+    Sleep (*delay);
+#else
+    struct timespec ts = {
+        .tv_sec = *delay / 1000,
+        .tv_nsec = (*delay % 1000) * 1000000L,
+    };
+
+    while (nanosleep (&ts, &ts) != 0 && errno == EINTR);
+#endif
+    if (*delay > SOCKET_RECONNECT_DELAY_MAX / 2) {
+        *delay = SOCKET_RECONNECT_DELAY_MAX;
+    } else {
+        *delay *= 2;
+    }
+}
+
+TSS2_RC
+socket_conf_kv (
+    const key_value_t *key_value,
+    socket_conf_t *conf)
+{
+    unsigned long value;
+    char *end;
+
+    errno = 0;
+    value = strtoul (key_value->value, &end, 10);
+    if (errno != 0 || end == key_value->value || *end != '\0' ||
+        value > INT32_MAX) {
+        LOG_ERROR ("Invalid value for %s: %s", key_value->key,
+                   key_value->value);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    if (strcmp (key_value->key, "connect_timeout") == 0) {
+        conf->connect_timeout = value;
+    } else if (strcmp (key_value->key, "io_timeout") == 0) {
+        conf->io_timeout = value;
+    } else if (strcmp (key_value->key, "reconnect") == 0) {
+        conf->reconnect = value;
+    } else if (strcmp (key_value->key, "reconnect_delay") == 0) {
+        if (value == 0) {
+            LOG_ERROR ("reconnect_delay must be at least 1 ms");
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        conf->reconnect_delay = value;
+    } else {
+        LOG_ERROR ("Unknown option: %s", key_value->key);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 TSS2_RC
 socket_set_nonblock (SOCKET sock)
 {
@@ -12,11 +12,16 @@
 #include <ws2tcpip.h>
 typedef SSIZE_T ssize_t;
 #define _HOST_NAME_MAX MAX_COMPUTERNAME_LENGTH
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
 
 #else
 #include <arpa/inet.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #define _HOST_NAME_MAX _POSIX_HOST_NAME_MAX
 #define SOCKET int
@@ -24,7 +29,10 @@ typedef SSIZE_T ssize_t;
 #define SOCKET_ERROR -1
 #endif
 
+#include <stdbool.h>
+
 #include "tss2_tpm2_types.h"
+#include "util/key-value-parse.h"
 
 #ifdef _WIN32
 #define TEMP_RETRY(dest, exp) \
@@ -49,6 +57,31 @@ typedef SSIZE_T ssize_t;
     dest =__ret; }
 #endif
 
+/* initial and maximum delay in ms between reconnect attempts */
+#define SOCKET_RECONNECT_DELAY 100
+#define SOCKET_RECONNECT_DELAY_MAX 5000
+/*
+ * longest possible socket options in a conf string:
+ * strlen (",connect_timeout=,io_timeout=,reconnect=,reconnect_delay=") (57)
+ * + 4 * max char uint32 (10)
+ */
+#define SOCKET_CONF_MAX 97
+#define SOCKET_CONF_DEFAULT_INIT { \
+    .reconnect_delay = SOCKET_RECONNECT_DELAY, \
+}
+
+/*
+ * Connection options shared by the socket based TCTIs. All times are in
+ * milliseconds, a timeout of 0 waits as long as the system does.
+ */
+typedef struct {
+    uint32_t connect_timeout;
+    uint32_t io_timeout;
+    /* number of times a failed connection attempt is retried */
+    uint32_t reconnect;
+    uint32_t reconnect_delay;
+} socket_conf_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -80,6 +113,55 @@ socket_connect (
     const char *hostname,
     uint16_t port,
     SOCKET *socket);
+/*
+ * Like 'socket_connect' but each connection attempt gives up after 'timeout'
+ * milliseconds. Connected sockets have TCP_NODELAY and SO_KEEPALIVE set.
+ */
+TSS2_RC
+socket_connect_timeout (
+    const char *hostname,
+    uint16_t port,
+    uint32_t timeout,
+    SOCKET *socket);
+/*
+ * Connect to the Unix domain stream socket at 'path'. A non-zero 'timeout'
+ * limits the time spent connecting. Not implemented on Windows.
+ */
+TSS2_RC
+socket_connect_unix (
+    const char *path,
+    uint32_t timeout,
+    SOCKET *socket);
+/*
+ * Make blocking reads and writes on 'sock' fail after 'timeout' milliseconds.
+ * A timeout of 0 leaves the socket unchanged.
+ */
+TSS2_RC
+socket_set_io_timeout (
+    SOCKET sock,
+    uint32_t timeout);
+/*
+ * Check without blocking whether the peer closed or reset the connection.
+ */
+bool
+socket_peer_closed (
+    SOCKET sock);
+/*
+ * Sleep for '*delay' milliseconds and double '*delay' for the next attempt,
+ * up to SOCKET_RECONNECT_DELAY_MAX. A delay of 0 is treated as 1 ms.
+ */
+void
+socket_backoff (
+    uint32_t *delay);
+/*
+ * Store the value of a socket option from a conf string in 'conf'. Unknown
+ * keys and invalid values, including a reconnect_delay of 0, are rejected
+ * with TSS2_TCTI_RC_BAD_VALUE.
+ */
+TSS2_RC
+socket_conf_kv (
+    const key_value_t *key_value,
+    socket_conf_t *conf);
 TSS2_RC
 socket_close (
     SOCKET *socket);
@@ -96,10 +178,37 @@ socket_xmit_buf (
     SOCKET sock,
     const void *buf,
     size_t size);
+/*
+ * Send the 'iovcnt' buffers described by 'iov' to 'sock'. Where supported the
+ * buffers are handed to the kernel in a single 'writev' call. Short writes
+ * are retried; the 'iov' array is updated to reflect the data sent.
+ */
+TSS2_RC
+socket_xmit_bufv (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt);
 TSS2_RC
 socket_poll (
     SOCKET sock,
     int timeout);
+/*
+ * Append data from 'sock' to the 'size' byte buffer 'buf', which already
+ * holds '*count' bytes, until at least 'min' bytes are buffered. Every read
+ * asks for all of the free space in the buffer so a complete response is
+ * usually received with a single poll / read pair. A positive 'timeout' in
+ * milliseconds bounds the whole call, not each poll. If it expires
+ * TSS2_TCTI_RC_TRY_AGAIN is returned and '*count' reflects the data received
+ * so far so the caller can resume later.
+ */
+TSS2_RC
+socket_recv_buffered (
+    SOCKET sock,
+    uint8_t *buf,
+    size_t size,
+    size_t *count,
+    size_t min,
+    int timeout);
 
 #ifdef __cplusplus
 }
@@ -50,25 +50,51 @@ static log_level LOGMODULE_status COMPILER_ATTR(unused) = LOGLEVEL_UNDEFINED;
 #error "MAXLOGLEVEL undefined"
 #endif
 
+/*
+ * A module may compile out the log statements above a lower level than the
+ * rest of the library by defining LOGMODULE_MAXLOGLEVEL, e.g. for hot paths.
+ */
+#if defined(LOGMODULE_MAXLOGLEVEL) && LOGMODULE_MAXLOGLEVEL < MAXLOGLEVEL
+#undef MAXLOGLEVEL
+#define MAXLOGLEVEL LOGMODULE_MAXLOGLEVEL
+#endif
+
 #if MAXLOGLEVEL > LOGL_TRACE || MAXLOGLEVEL < LOGL_ERROR
     #if MAXLOGLEVEL != LOGL_NONE
         #error "Unknown MAXLOGLEVEL"
     #endif
 #endif
 
+/*
+ * Once the level of the module is known it is checked inline, so that
+ * disabled log statements cost a compare instead of a call to doLog. The
+ * first log statement of a module calls doLog to determine the level.
+ */
+#define LOG_ENABLED(LEVEL) (LOGMODULE_status == LOGLEVEL_UNDEFINED || \
+                            (LEVEL) <= LOGMODULE_status)
+
+#define LOG_LEVEL(LEVEL, FORMAT, ...) \
+    do { \
+        if (LOG_ENABLED(LEVEL)) \
+            doLog(LEVEL, xstr(LOGMODULE), LOGDEFAULT, &LOGMODULE_status, \
+                  __FILE__, __func__, __LINE__, \
+                  FORMAT, ## __VA_ARGS__); \
+    } while (0)
+#define LOGBLOB_LEVEL(LEVEL, BUFFER, SIZE, FORMAT, ...) \
+    do { \
+        if (LOG_ENABLED(LEVEL)) \
+            doLogBlob(LEVEL, xstr(LOGMODULE), LOGDEFAULT, &LOGMODULE_status, \
+                      __FILE__, __func__, __LINE__, \
+                      BUFFER, SIZE, \
+                      FORMAT, ## __VA_ARGS__); \
+    } while (0)
+
 /* MAXLOGLEVEL is Error or "higher" */
 #if MAXLOGLEVEL >= LOGL_ERROR
-#define LOG_ERROR(FORMAT, ...) doLog(LOGLEVEL_ERROR, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     FORMAT, ## __VA_ARGS__)
-#define LOGBLOB_ERROR(BUFFER, SIZE, FORMAT, ...) doLogBlob(LOGLEVEL_ERROR, \
-                                             xstr(LOGMODULE), LOGDEFAULT, \
-                                             &LOGMODULE_status, \
-                                             __FILE__, __func__, __LINE__, \
-                                             BUFFER, SIZE, \
-                                             FORMAT, ## __VA_ARGS__)
+#define LOG_ERROR(FORMAT, ...) LOG_LEVEL(LOGLEVEL_ERROR, FORMAT, ## __VA_ARGS__)
+#define LOGBLOB_ERROR(BUFFER, SIZE, FORMAT, ...) LOGBLOB_LEVEL(LOGLEVEL_ERROR, \
+                                                 BUFFER, SIZE, \
+                                                 FORMAT, ## __VA_ARGS__)
 #else /* MAXLOGLEVEL is not Error or "higher" */
 #define LOG_ERROR(FORMAT, ...) {}
 #define LOGBLOB_ERROR(FORMAT, ...) {}
@@ -76,15 +102,8 @@ static log_level LOGMODULE_status COMPILER_ATTR(unused) = LOGLEVEL_UNDEFINED;
 
 /* MAXLOGLEVEL is Warning or "higher" */
 #if MAXLOGLEVEL >= LOGL_WARNING
-#define LOG_WARNING(FORMAT, ...) doLog(LOGLEVEL_WARNING, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     FORMAT, ## __VA_ARGS__)
-#define LOGBLOB_WARNING(BUFFER, SIZE, FORMAT, ...) doLogBlob(LOGLEVEL_WARNING, \
-                                                 xstr(LOGMODULE), LOGDEFAULT, \
-                                                 &LOGMODULE_status, \
-                                                 __FILE__, __func__, __LINE__, \
+#define LOG_WARNING(FORMAT, ...) LOG_LEVEL(LOGLEVEL_WARNING, FORMAT, ## __VA_ARGS__)
+#define LOGBLOB_WARNING(BUFFER, SIZE, FORMAT, ...) LOGBLOB_LEVEL(LOGLEVEL_WARNING, \
                                                  BUFFER, SIZE, \
                                                  FORMAT, ## __VA_ARGS__)
 #else /* MAXLOGLEVEL is not Warning or "higher" */
@@ -94,17 +113,10 @@ static log_level LOGMODULE_status COMPILER_ATTR(unused) = LOGLEVEL_UNDEFINED;
 
 /* MAXLOGLEVEL is Info or "higher" */
 #if MAXLOGLEVEL >= LOGL_INFO
-#define LOG_INFO(FORMAT, ...) doLog(LOGLEVEL_INFO, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     FORMAT, ## __VA_ARGS__)
-#define LOGBLOB_INFO(BUFFER, SIZE, FORMAT, ...) doLogBlob(LOGLEVEL_INFO, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     BUFFER, SIZE, \
-                                     FORMAT, ## __VA_ARGS__)
+#define LOG_INFO(FORMAT, ...) LOG_LEVEL(LOGLEVEL_INFO, FORMAT, ## __VA_ARGS__)
+#define LOGBLOB_INFO(BUFFER, SIZE, FORMAT, ...) LOGBLOB_LEVEL(LOGLEVEL_INFO, \
+                                                 BUFFER, SIZE, \
+                                                 FORMAT, ## __VA_ARGS__)
 #else /* MAXLOGLEVEL is not Info or "higher" */
 #define LOG_INFO(FORMAT, ...) {}
 #define LOGBLOB_INFO(FORMAT, ...) {}
@@ -112,17 +124,10 @@ static log_level LOGMODULE_status COMPILER_ATTR(unused) = LOGLEVEL_UNDEFINED;
 
 /* MAXLOGLEVEL is Debug or "higher" */
 #if MAXLOGLEVEL >= LOGL_DEBUG
-#define LOG_DEBUG(FORMAT, ...) doLog(LOGLEVEL_DEBUG, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     FORMAT, ## __VA_ARGS__)
-#define LOGBLOB_DEBUG(BUFFER, SIZE, FORMAT, ...) doLogBlob(LOGLEVEL_DEBUG, \
-                                             xstr(LOGMODULE), LOGDEFAULT, \
-                                             &LOGMODULE_status, \
-                                             __FILE__, __func__, __LINE__, \
-                                             BUFFER, SIZE, \
-                                             FORMAT, ## __VA_ARGS__)
+#define LOG_DEBUG(FORMAT, ...) LOG_LEVEL(LOGLEVEL_DEBUG, FORMAT, ## __VA_ARGS__)
+#define LOGBLOB_DEBUG(BUFFER, SIZE, FORMAT, ...) LOGBLOB_LEVEL(LOGLEVEL_DEBUG, \
+                                                 BUFFER, SIZE, \
+                                                 FORMAT, ## __VA_ARGS__)
 #else /* MAXLOGLEVEL is not Debug or "higher" */
 #define LOG_DEBUG(FORMAT, ...) {}
 #define LOGBLOB_DEBUG(FORMAT, ...) {}
@@ -130,17 +135,10 @@ static log_level LOGMODULE_status COMPILER_ATTR(unused) = LOGLEVEL_UNDEFINED;
 
 /* MAXLOGLEVEL is Trace */
 #if MAXLOGLEVEL >= LOGL_TRACE
-#define LOG_TRACE(FORMAT, ...) doLog(LOGLEVEL_TRACE, \
-                                     xstr(LOGMODULE), LOGDEFAULT, \
-                                     &LOGMODULE_status, \
-                                     __FILE__, __func__, __LINE__, \
-                                     FORMAT, ## __VA_ARGS__)
-#define LOGBLOB_TRACE(BUFFER, SIZE, FORMAT, ...) doLogBlob(LOGLEVEL_TRACE, \
-                                             xstr(LOGMODULE), LOGDEFAULT, \
-                                             &LOGMODULE_status, \
-                                             __FILE__, __func__, __LINE__, \
-                                             BUFFER, SIZE, \
-                                             FORMAT, ## __VA_ARGS__)
+#define LOG_TRACE(FORMAT, ...) LOG_LEVEL(LOGLEVEL_TRACE, FORMAT, ## __VA_ARGS__)
+#define LOGBLOB_TRACE(BUFFER, SIZE, FORMAT, ...) LOGBLOB_LEVEL(LOGLEVEL_TRACE, \
+                                                 BUFFER, SIZE, \
+                                                 FORMAT, ## __VA_ARGS__)
 #else /* MAXLOGLEVEL is not Trace */
 #define LOG_TRACE(FORMAT, ...) {}
 #define LOGBLOB_TRACE(FORMAT, ...) {}
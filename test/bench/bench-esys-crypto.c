@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tss2_esys.h"
+#include "esys_crypto.h"
+#include "bench.h"
+
+#define HMAC_SESSION_ITERATIONS 20000
+
+/*
+ * Measure the crypto overhead ESYS adds to a command authorized by an HMAC
+ * session: cpHash and HMAC of the command, rpHash and HMAC of the response.
+ */
+int
+bench_esys_crypto(void)
+{
+    TSS2_RC rc;
+    uint8_t ccBuffer[4] = { 0x00, 0x00, 0x01, 0x5d };
+    uint8_t rcBuffer[4] = { 0 };
+    uint8_t pBuffer[64] = { 0 };
+    uint8_t hmacKey[2 * TPM2_SHA256_DIGEST_SIZE] = { 0 };
+    uint8_t pHash[TPM2_SHA256_DIGEST_SIZE];
+    size_t pHash_size;
+    TPM2B_NAME name = { .size = 34 };
+    TPM2B_NONCE nonceCaller = { .size = TPM2_SHA256_DIGEST_SIZE };
+    TPM2B_NONCE nonceTPM = { .size = TPM2_SHA256_DIGEST_SIZE };
+    TPM2B_AUTH hmac;
+    struct timespec start, end;
+    size_t i;
+
+    bench_now(&start);
+    for (i = 0; i < HMAC_SESSION_ITERATIONS; i++) {
+        pHash_size = sizeof(pHash);
+        rc = iesys_crypto_cpHash(TPM2_ALG_SHA256, ccBuffer, &name, NULL, NULL,
+                                 &pBuffer[0], sizeof(pBuffer), &pHash[0], &pHash_size);
+        BENCH_CHECK(rc == TSS2_RC_SUCCESS);
+        hmac.size = sizeof(hmac.buffer);
+        rc = iesys_crypto_authHmac(TPM2_ALG_SHA256, &hmacKey[0], sizeof(hmacKey),
+                                   &pHash[0], pHash_size, &nonceCaller, &nonceTPM,
+                                   NULL, NULL, TPMA_SESSION_CONTINUESESSION, &hmac);
+        BENCH_CHECK(rc == TSS2_RC_SUCCESS);
+
+        pHash_size = sizeof(pHash);
+        rc = iesys_crypto_rpHash(TPM2_ALG_SHA256, rcBuffer, ccBuffer,
+                                 &pBuffer[0], sizeof(pBuffer), &pHash[0], &pHash_size);
+        BENCH_CHECK(rc == TSS2_RC_SUCCESS);
+        hmac.size = sizeof(hmac.buffer);
+        rc = iesys_crypto_authHmac(TPM2_ALG_SHA256, &hmacKey[0], sizeof(hmacKey),
+                                   &pHash[0], pHash_size, &nonceTPM, &nonceCaller,
+                                   NULL, NULL, TPMA_SESSION_CONTINUESESSION, &hmac);
+        BENCH_CHECK(rc == TSS2_RC_SUCCESS);
+    }
+    bench_now(&end);
+    printf("HMAC session overhead: %7.1f ns per command\n",
+           bench_elapsed_ns(&start, &end) / HMAC_SESSION_ITERATIONS);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,330 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tss2_esys.h"
+#include "tss2_tcti.h"
+#include "tss2_tcti_mssim.h"
+
+#include "util/io.h"
+#include "bench.h"
+
+/*
+ * Compare the throughput in bytes/s of random octets over the mssim TCTI:
+ * Esys_GetRandom in a loop, Esys_GetRandomBulk without the random pool and
+ * Esys_GetRandomBulk with the random pool.
+ *
+ * If TSS2_BENCH_MSSIM holds an mssim configuration string, e.g.
+ * "host=localhost,port=2321", the simulator at this address is used.
+ * Otherwise a forked child plays the simulator: it answers TPM2_GetRandom
+ * with at most STANDIN_DIGEST_MAX octets and every other command with
+ * success, so only the overhead of the TSS and the socket is measured.
+ */
+#define RANDOM_BYTES (256 * 1024)
+#define RESEED_INTERVAL (64 * 1024)
+#define STANDIN_DIGEST_MAX 48
+
+static int
+read_exact (SOCKET sock, uint8_t *buf, size_t size)
+{
+    ssize_t ret;
+
+    while (size > 0) {
+        ret = read (sock, buf, size);
+        if (ret <= 0) {
+            return -1;
+        }
+        buf += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static uint32_t
+get_be32 (const uint8_t *buf)
+{
+    uint32_t value;
+
+    memcpy (&value, buf, sizeof (value));
+    return ntohl (value);
+}
+
+static void
+put_be32 (uint8_t *buf, uint32_t value)
+{
+    value = htonl (value);
+    memcpy (buf, &value, sizeof (value));
+}
+
+/* Listen on two consecutive loopback ports for the TPM and platform. */
+static int
+listen_ports (SOCKET *tpm, SOCKET *platform, uint16_t *port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof (addr);
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        *tpm = socket (AF_INET, SOCK_STREAM, 0);
+        *platform = socket (AF_INET, SOCK_STREAM, 0);
+        addr.sin_port = 0;
+        if (*tpm != INVALID_SOCKET && *platform != INVALID_SOCKET &&
+            bind (*tpm, (struct sockaddr*)&addr, sizeof (addr)) == 0 &&
+            getsockname (*tpm, (struct sockaddr*)&addr, &len) == 0 &&
+            ntohs (addr.sin_port) < UINT16_MAX) {
+            *port = ntohs (addr.sin_port);
+            addr.sin_port = htons (*port + 1);
+            if (bind (*platform, (struct sockaddr*)&addr, sizeof (addr)) == 0 &&
+                listen (*tpm, 4) == 0 && listen (*platform, 4) == 0) {
+                return 0;
+            }
+        }
+        socket_close (tpm);
+        socket_close (platform);
+    }
+    return -1;
+}
+
+/* Answer one command of the TPM socket, return -1 at the end. */
+static int
+serve_tpm (SOCKET sock)
+{
+    uint8_t hdr [9];
+    uint8_t cmd [4096];
+    uint8_t rsp [4 + 12 + STANDIN_DIGEST_MAX + 4] = { 0 };
+    uint32_t size, rsp_size = 10;
+    uint16_t requested;
+
+    if (read_exact (sock, hdr, 4) != 0 ||
+        get_be32 (hdr) != MS_SIM_TPM_SEND_COMMAND ||
+        read_exact (sock, &hdr [4], 5) != 0) {
+        return -1;
+    }
+    size = get_be32 (&hdr [5]);
+    if (size < 10 || size > sizeof (cmd) || read_exact (sock, cmd, size) != 0) {
+        return -1;
+    }
+    if (get_be32 (&cmd [6]) == TPM2_CC_GetRandom && size >= 12) {
+        requested = (cmd [10] << 8) | cmd [11];
+        if (requested > STANDIN_DIGEST_MAX) {
+            requested = STANDIN_DIGEST_MAX;
+        }
+        rsp [4 + 10] = requested >> 8;
+        rsp [4 + 11] = requested & 0xff;
+        memset (&rsp [4 + 12], 0xa5, requested);
+        rsp_size = 12 + requested;
+    }
+    put_be32 (rsp, rsp_size);
+    rsp [4] = TPM2_ST_NO_SESSIONS >> 8;
+    rsp [5] = TPM2_ST_NO_SESSIONS & 0xff;
+    put_be32 (&rsp [6], rsp_size);
+    /* The response code and the trailing acknowledgement stay 0 */
+    return write_all (sock, rsp, 4 + rsp_size + 4) ==
+        (ssize_t)(4 + rsp_size + 4) ? 0 : -1;
+}
+
+/* Answer one platform command with success, return -1 at the end. */
+static int
+serve_platform (SOCKET sock)
+{
+    static const uint8_t ok [4] = { 0 };
+    uint8_t buf [4];
+
+    if (read_exact (sock, buf, sizeof (buf)) != 0 ||
+        get_be32 (buf) == TPM_SESSION_END) {
+        return -1;
+    }
+    return write_all (sock, ok, sizeof (ok)) == sizeof (ok) ? 0 : -1;
+}
+
+static void
+server_loop (SOCKET tpm_listen, SOCKET platform_listen)
+{
+    struct pollfd fds [2];
+    SOCKET tpm, platform;
+    int done;
+
+    for (;;) {
+        tpm = accept (tpm_listen, NULL, NULL);
+        platform = accept (platform_listen, NULL, NULL);
+        fds [0] = (struct pollfd) { .fd = tpm, .events = POLLIN };
+        fds [1] = (struct pollfd) { .fd = platform, .events = POLLIN };
+        for (done = 0; !done; ) {
+            if (poll (fds, 2, -1) < 0) {
+                continue;
+            }
+            if (fds [0].revents && serve_tpm (tpm) != 0) {
+                done = 1;
+            }
+            if (fds [1].revents && serve_platform (platform) != 0) {
+                done = 1;
+            }
+        }
+        socket_close (&tpm);
+        socket_close (&platform);
+    }
+}
+
+/* Fetch the random octets with Esys_GetRandom in a loop. */
+static TSS2_RC
+get_random_loop (ESYS_CONTEXT *esys_context, uint8_t *buffer, size_t size)
+{
+    TPM2B_DIGEST *random;
+    TSS2_RC rc;
+
+    while (size > 0) {
+        rc = Esys_GetRandom (esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                             ESYS_TR_NONE,
+                             size > sizeof (TPMU_HA) ? sizeof (TPMU_HA) : size,
+                             &random);
+        if (rc != TSS2_RC_SUCCESS) {
+            return rc;
+        }
+        if (random->size == 0 || random->size > size) {
+            free (random);
+            return TSS2_ESYS_RC_MALFORMED_RESPONSE;
+        }
+        memcpy (buffer, random->buffer, random->size);
+        buffer += random->size;
+        size -= random->size;
+        free (random);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/* The bytes per second of the three ways of getting random octets. */
+static int
+throughput (const char *conf)
+{
+    ESYS_CONTEXT *esys_context = NULL;
+    TSS2_TCTI_CONTEXT *tcti;
+    struct timespec start, end;
+    uint8_t *buffer;
+    double loop_ns = 0, bulk_ns = 0, pool_ns = 0;
+    size_t size;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Mssim_Init (NULL, &size, NULL);
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+    tcti = calloc (1, size);
+    buffer = malloc (RANDOM_BYTES);
+    if (tcti == NULL || buffer == NULL) {
+        free (tcti);
+        free (buffer);
+    }
+    BENCH_CHECK (tcti != NULL && buffer != NULL);
+    rc = Tss2_Tcti_Mssim_Init (tcti, &size, conf);
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Esys_Initialize (&esys_context, tcti, NULL);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Esys_Startup (esys_context, TPM2_SU_CLEAR);
+        if (rc == TPM2_RC_INITIALIZE) {
+            rc = TSS2_RC_SUCCESS;
+        }
+    }
+
+    if (rc == TSS2_RC_SUCCESS) {
+        bench_now (&start);
+        rc = get_random_loop (esys_context, buffer, RANDOM_BYTES);
+        bench_now (&end);
+        loop_ns = bench_elapsed_ns (&start, &end);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        bench_now (&start);
+        rc = Esys_GetRandomBulk (esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, buffer, RANDOM_BYTES);
+        bench_now (&end);
+        bulk_ns = bench_elapsed_ns (&start, &end);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        rc = Esys_SetRandomPool (esys_context, RESEED_INTERVAL);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        bench_now (&start);
+        rc = Esys_GetRandomBulk (esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                 ESYS_TR_NONE, buffer, RANDOM_BYTES);
+        bench_now (&end);
+        pool_ns = bench_elapsed_ns (&start, &end);
+    }
+
+    Esys_Finalize (&esys_context);
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+    free (buffer);
+    if (rc != TSS2_RC_SUCCESS) {
+        fprintf (stderr, "Getting random octets failed: 0x%08" PRIx32 "\n", rc);
+    }
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+
+    printf ("%d KiB of random octets over mssim:\n", RANDOM_BYTES / 1024);
+    printf ("  Esys_GetRandom loop:        %8.2f MB/s\n",
+            RANDOM_BYTES / loop_ns * 1e3);
+    printf ("  Esys_GetRandomBulk:         %8.2f MB/s\n",
+            RANDOM_BYTES / bulk_ns * 1e3);
+    printf ("  Esys_GetRandomBulk, pool:   %8.2f MB/s (reseed every %d KiB)\n",
+            RANDOM_BYTES / pool_ns * 1e3, RESEED_INTERVAL / 1024);
+    return EXIT_SUCCESS;
+}
+
+int
+bench_esys_random_mssim (void)
+{
+    SOCKET tpm_listen = INVALID_SOCKET, platform_listen = INVALID_SOCKET;
+    const char *conf = getenv ("TSS2_BENCH_MSSIM");
+    char standin_conf [64];
+    uint16_t port;
+    pid_t server = -1;
+    int ret = EXIT_FAILURE;
+
+    if (conf != NULL) {
+        printf ("Simulator: %s\n", conf);
+        return throughput (conf);
+    }
+
+    signal (SIGPIPE, SIG_IGN);
+    if (listen_ports (&tpm_listen, &platform_listen, &port) == 0) {
+        fflush (stdout);
+        server = fork ();
+        if (server == 0) {
+            server_loop (tpm_listen, platform_listen);
+            _exit (0);
+        }
+    }
+    if (server > 0) {
+        printf ("Simulator: stand-in without TPM latency\n");
+        snprintf (standin_conf, sizeof (standin_conf),
+                  "host=127.0.0.1,port=%" PRIu16, port);
+        ret = throughput (standin_conf);
+        kill (server, SIGTERM);
+        waitpid (server, NULL, 0);
+    } else {
+        fprintf (stderr, "Starting the mssim stand-in failed\n");
+    }
+
+    socket_close (&tpm_listen);
+    socket_close (&platform_listen);
+    return ret;
+}
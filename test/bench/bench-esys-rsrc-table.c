@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "tss2_esys.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#include "util/aux_util.h"
+#include "bench.h"
+
+/*
+ * The lookup cost of the resource table of the ESYS_CONTEXT for different
+ * numbers of objects stored in one context.
+ */
+
+#define LOOKUPS 1000000
+
+static TSS2_RC
+tcti_dummy_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                    size_t size, const uint8_t * buffer)
+{
+    UNUSED(tctiContext);
+    UNUSED(size);
+    UNUSED(buffer);
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_dummy_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t * response_size,
+                   uint8_t * response_buffer, int32_t timeout)
+{
+    UNUSED(tctiContext);
+    UNUSED(response_size);
+    UNUSED(response_buffer);
+    UNUSED(timeout);
+
+    return TSS2_TCTI_RC_GENERAL_FAILURE;
+}
+
+static int
+lookup(ESYS_CONTEXT *esys_context)
+{
+    size_t object_counts[] = { 10, 100, 1000, 10000, 100000 };
+    size_t num_counts = sizeof(object_counts) / sizeof(object_counts[0]);
+    size_t created = 0;
+    RSRC_NODE_T *node;
+    ESYS_TR first = esys_context->esys_handle_cnt;
+    struct timespec start, end;
+    unsigned int seed = 1;
+    TSS2_RC r;
+
+    for (size_t c = 0; c < num_counts; c++) {
+        for (; created < object_counts[c]; created++) {
+            r = esys_CreateResourceObject(esys_context,
+                                          esys_context->esys_handle_cnt++,
+                                          &node);
+            BENCH_CHECK(r == TSS2_RC_SUCCESS);
+        }
+
+        bench_now(&start);
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            r = esys_GetResourceObject(esys_context,
+                                       first + rand_r(&seed) % created, &node);
+            BENCH_CHECK(r == TSS2_RC_SUCCESS);
+        }
+        bench_now(&end);
+
+        printf("%7zu objects: %6.1f ns per lookup\n", created,
+               bench_elapsed_ns(&start, &end) / LOOKUPS);
+    }
+    return EXIT_SUCCESS;
+}
+
+int
+bench_esys_rsrc_table(void)
+{
+    ESYS_CONTEXT *esys_context;
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti;
+    int ret;
+
+    /* This is a fake tcti context */
+    tcti = calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    BENCH_CHECK(tcti != NULL);
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_dummy_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_dummy_receive;
+
+    if (Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL)
+        != TSS2_RC_SUCCESS) {
+        free(tcti);
+        return EXIT_FAILURE;
+    }
+
+    ret = lookup(esys_context);
+
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return ret;
+}
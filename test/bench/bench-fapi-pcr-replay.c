@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <json-c/json.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_eventlog.h"
+#include "ifapi_json_serialize.h"
+#include "ifapi_json_deserialize.h"
+#include "ifapi_helpers.h"
+#include "bench.h"
+
+/*
+ * Compare the time of a complete replay of a large event log with the
+ * incremental replay of the new events used by Fapi_VerifyQuoteIncremental().
+ */
+
+#define LOG_EVENTS 100000
+#define NEW_EVENTS 100
+#define NUM_TEMPLATES 10
+
+/* Events for PCR 0 to 9, of which PCR 8 and 9 are not quoted. */
+static json_object *templates[NUM_TEMPLATES];
+
+static int
+init_templates(void)
+{
+    IFAPI_EVENT event;
+
+    for (size_t i = 0; i < NUM_TEMPLATES; i++) {
+        memset(&event, 0, sizeof(IFAPI_EVENT));
+        event.pcr = i;
+        event.type = IFAPI_TSS_EVENT_TAG;
+        event.sub_event.tss_event.data.size = 4;
+        event.digests.count = 2;
+        event.digests.digests[0].hashAlg = TPM2_ALG_SHA1;
+        memset(&event.digests.digests[0].digest.sha1[0], i,
+               TPM2_SHA1_DIGEST_SIZE);
+        event.digests.digests[1].hashAlg = TPM2_ALG_SHA256;
+        memset(&event.digests.digests[1].digest.sha256[0], i + 1,
+               TPM2_SHA256_DIGEST_SIZE);
+        templates[i] = NULL;
+        BENCH_CHECK(ifapi_json_IFAPI_EVENT_serialize(&event, &templates[i])
+                    == TSS2_RC_SUCCESS);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* The events [first, last) of the complete log, sharing the template objects. */
+static json_object *
+get_log(size_t first, size_t last)
+{
+    json_object *log = json_object_new_array();
+
+    for (size_t i = first; log && i < last; i++) {
+        json_object_array_add(log, json_object_get(templates[i % NUM_TEMPLATES]));
+    }
+    return log;
+}
+
+/* Replay the events [first, last) and return the result of the digest check. */
+static TSS2_RC
+replay(IFAPI_PCR_REPLAY *replay, const FAPI_QUOTE_INFO *quote_info,
+       size_t first, size_t last, TPM2B_DIGEST *digest)
+{
+    json_object *log = get_log(first, last);
+    TSS2_RC r;
+
+    if (!log)
+        return TSS2_FAPI_RC_MEMORY;
+    r = ifapi_pcr_replay_select(replay,
+                                &quote_info->attest.attested.quote.pcrSelect);
+    if (r == TSS2_RC_SUCCESS)
+        r = ifapi_pcr_replay_events(replay, log, first);
+    if (r == TSS2_RC_SUCCESS)
+        r = ifapi_pcr_replay_digest(replay, quote_info, digest);
+    json_object_put(log);
+    return r;
+}
+
+static int
+replay_log(IFAPI_PCR_REPLAY *pcr_replay, FAPI_QUOTE_INFO *quote_info)
+{
+    TPM2B_DIGEST *pcr_digest = &quote_info->attest.attested.quote.pcrDigest;
+    struct timespec start, end;
+    json_object *jso = NULL;
+    char *pcr_state;
+    TPM2B_DIGEST digest;
+    TSS2_RC r;
+
+    /* The quote covers the complete log */
+    jso = get_log(0, LOG_EVENTS);
+    BENCH_CHECK(jso != NULL);
+    r = ifapi_calculate_pcr_digest(jso, quote_info, pcr_digest);
+    json_object_put(jso);
+    BENCH_CHECK(r == TSS2_RC_SUCCESS);
+
+    /* The replay state of the log without the new events */
+    jso = get_log(0, LOG_EVENTS - NEW_EVENTS);
+    BENCH_CHECK(jso != NULL);
+    r = ifapi_pcr_replay_select(pcr_replay,
+                                &quote_info->attest.attested.quote.pcrSelect);
+    if (r == TSS2_RC_SUCCESS)
+        r = ifapi_pcr_replay_events(pcr_replay, jso, 0);
+    json_object_put(jso);
+    BENCH_CHECK(r == TSS2_RC_SUCCESS);
+    jso = NULL;
+    BENCH_CHECK(ifapi_json_IFAPI_PCR_REPLAY_serialize(pcr_replay, &jso)
+                == TSS2_RC_SUCCESS);
+    pcr_state = strdup(json_object_to_json_string(jso));
+    json_object_put(jso);
+    BENCH_CHECK(pcr_state != NULL);
+
+    memset(pcr_replay, 0, sizeof(IFAPI_PCR_REPLAY));
+    bench_now(&start);
+    r = replay(pcr_replay, quote_info, 0, LOG_EVENTS, &digest);
+    bench_now(&end);
+    if (r != TSS2_RC_SUCCESS)
+        free(pcr_state);
+    BENCH_CHECK(r == TSS2_RC_SUCCESS);
+    printf("Complete replay of %d events: %8.3f ms\n", LOG_EVENTS,
+           bench_elapsed_ns(&start, &end) / 1e6);
+
+    /* Only the new events are passed */
+    memset(pcr_replay, 0, sizeof(IFAPI_PCR_REPLAY));
+    bench_now(&start);
+    jso = json_tokener_parse(pcr_state);
+    if (jso) {
+        r = ifapi_json_IFAPI_PCR_REPLAY_deserialize(jso, pcr_replay);
+        json_object_put(jso);
+        if (r == TSS2_RC_SUCCESS)
+            r = replay(pcr_replay, quote_info, LOG_EVENTS - NEW_EVENTS,
+                       LOG_EVENTS, &digest);
+    }
+    bench_now(&end);
+    free(pcr_state);
+    BENCH_CHECK(jso != NULL);
+    BENCH_CHECK(r == TSS2_RC_SUCCESS);
+    printf("Incremental replay of %d events: %8.3f ms\n", NEW_EVENTS,
+           bench_elapsed_ns(&start, &end) / 1e6);
+    return EXIT_SUCCESS;
+}
+
+int
+bench_fapi_pcr_replay(void)
+{
+    IFAPI_PCR_REPLAY *pcr_replay;
+    FAPI_QUOTE_INFO quote_info = { 0 };
+    TPML_PCR_SELECTION *pcr_selection;
+    int ret;
+
+    /* Quote of sha256 PCR 0-7 and sha1 PCR 0-3 */
+    quote_info.sig_scheme.scheme = TPM2_ALG_RSASSA;
+    quote_info.sig_scheme.details.rsassa.hashAlg = TPM2_ALG_SHA256;
+    pcr_selection = &quote_info.attest.attested.quote.pcrSelect;
+    pcr_selection->count = 2;
+    pcr_selection->pcrSelections[0].hash = TPM2_ALG_SHA256;
+    pcr_selection->pcrSelections[0].sizeofSelect = 3;
+    pcr_selection->pcrSelections[0].pcrSelect[0] = 0xff;
+    pcr_selection->pcrSelections[1].hash = TPM2_ALG_SHA1;
+    pcr_selection->pcrSelections[1].sizeofSelect = 3;
+    pcr_selection->pcrSelections[1].pcrSelect[0] = 0x0f;
+
+    pcr_replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    BENCH_CHECK(pcr_replay != NULL);
+    ret = init_templates();
+    if (ret == EXIT_SUCCESS)
+        ret = replay_log(pcr_replay, &quote_info);
+
+    for (size_t i = 0; i < NUM_TEMPLATES; i++)
+        json_object_put(templates[i]);
+    free(pcr_replay);
+    return ret;
+}
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tss2_esys.h"
+#include "ifapi_helpers.h"
+#include "ifapi_policy_execute.h"
+#include "ifapi_policy_ticket_cache.h"
+#include "util/aux_util.h"
+#include "bench.h"
+
+/*
+ * Compare the execution of a PolicyAuthorize element with the verification
+ * ticket cache with the execution without it, where every execution loads
+ * the authorization key, verifies the signature and flushes the key.
+ *
+ * The ESAPI functions used by the policy execution are wrapped; they count
+ * the TPM commands and simulate the TPM by sleeping TPM_COMMAND_NS for each
+ * of them. The host time is measured with the same wraps and no sleep.
+ */
+
+#define KEY_HANDLE 0x1000
+#define SESSION_HANDLE 0x1001
+
+#define NUM_EXECUTIONS 200
+#define NUM_EXECUTIONS_HOST 20000
+#define TPM_COMMAND_NS 1000000
+
+static TPMT_PUBLIC loaded_public;
+static long tpm_command_ns;
+static size_t tpm_commands;
+
+/* Account for one TPM command. */
+static void
+tpm_command(void)
+{
+    struct timespec latency = { 0, tpm_command_ns };
+
+    tpm_commands += 1;
+    if (tpm_command_ns)
+        nanosleep(&latency, NULL);
+}
+
+TSS2_RC
+__wrap_Esys_LoadExternal_Async(ESYS_CONTEXT *esysContext,
+                               ESYS_TR shandle1, ESYS_TR shandle2,
+                               ESYS_TR shandle3,
+                               const TPM2B_SENSITIVE *inPrivate,
+                               const TPM2B_PUBLIC *inPublic,
+                               ESYS_TR hierarchy)
+{
+    loaded_public = inPublic->publicArea;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_LoadExternal_Finish(ESYS_CONTEXT *esysContext, ESYS_TR *objectHandle)
+{
+    tpm_command();
+    *objectHandle = KEY_HANDLE;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_TR_GetName(ESYS_CONTEXT *esys_context, ESYS_TR esys_handle,
+                       TPM2B_NAME **name)
+{
+    *name = calloc(1, sizeof(TPM2B_NAME));
+    if (!*name)
+        return TSS2_ESYS_RC_MEMORY;
+    return ifapi_get_name(&loaded_public, *name);
+}
+
+TSS2_RC
+__wrap_Esys_VerifySignature_Async(ESYS_CONTEXT *esysContext, ESYS_TR keyHandle,
+                                  ESYS_TR shandle1, ESYS_TR shandle2,
+                                  ESYS_TR shandle3,
+                                  const TPM2B_DIGEST *digest,
+                                  const TPMT_SIGNATURE *signature)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_VerifySignature_Finish(ESYS_CONTEXT *esysContext,
+                                   TPMT_TK_VERIFIED **validation)
+{
+    tpm_command();
+    *validation = calloc(1, sizeof(TPMT_TK_VERIFIED));
+    if (!*validation)
+        return TSS2_ESYS_RC_MEMORY;
+    (*validation)->tag = TPM2_ST_VERIFIED;
+    (*validation)->hierarchy = TPM2_RH_OWNER;
+    (*validation)->digest.size = TPM2_SHA256_DIGEST_SIZE;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_PolicyAuthorize_Async(ESYS_CONTEXT *esysContext,
+                                  ESYS_TR policySession,
+                                  ESYS_TR shandle1, ESYS_TR shandle2,
+                                  ESYS_TR shandle3,
+                                  const TPM2B_DIGEST *approvedPolicy,
+                                  const TPM2B_NONCE *policyRef,
+                                  const TPM2B_NAME *keySign,
+                                  const TPMT_TK_VERIFIED *checkTicket)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_PolicyAuthorize_Finish(ESYS_CONTEXT *esysContext)
+{
+    tpm_command();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext_Async(ESYS_CONTEXT *esysContext, ESYS_TR flushHandle)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext_Finish(ESYS_CONTEXT *esysContext)
+{
+    tpm_command();
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext(ESYS_CONTEXT *esysContext, ESYS_TR flushHandle)
+{
+    tpm_command();
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+cb_authorize_policy(TPMT_PUBLIC *key_public, TPMI_ALG_HASH hash_alg,
+                    TPM2B_DIGEST *digest, TPM2B_NONCE *policyRef,
+                    TPMT_SIGNATURE *signature, void *userdata)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+/* Execute the policy count times and return the time per execution. */
+static int
+execute_policy(TPMS_POLICY *policy, IFAPI_POLICY_TICKET_CACHE *cache,
+               size_t count, double *ns, double *commands)
+{
+    IFAPI_POLICY_EXEC_CTX pol_ctx;
+    struct timespec start, end;
+    TSS2_RC r;
+
+    tpm_commands = 0;
+    bench_now(&start);
+    for (size_t i = 0; i < count; i++) {
+        memset(&pol_ctx, 0, sizeof(IFAPI_POLICY_EXEC_CTX));
+        pol_ctx.session = SESSION_HANDLE;
+        pol_ctx.ticket_cache = cache;
+        pol_ctx.callbacks.cbauthpol = cb_authorize_policy;
+
+        r = ifapi_policyeval_execute_prepare(&pol_ctx, TPM2_ALG_SHA256, policy);
+        BENCH_CHECK(r == TSS2_RC_SUCCESS);
+        do {
+            r = ifapi_policyeval_execute(NULL, &pol_ctx);
+        } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+        BENCH_CHECK(r == TSS2_RC_SUCCESS);
+    }
+    bench_now(&end);
+    *ns = bench_elapsed_ns(&start, &end) / count;
+    *commands = (double)tpm_commands / count;
+    return EXIT_SUCCESS;
+}
+
+/* Compare the execution without and with the ticket cache. */
+static int
+compare(TPMS_POLICY *policy, size_t count, long command_ns)
+{
+    IFAPI_POLICY_TICKET_CACHE cache = { 0 };
+    double uncached_ns, cached_ns, uncached_cmds, cached_cmds;
+    int ret;
+
+    tpm_command_ns = command_ns;
+    ret = execute_policy(policy, NULL, count, &uncached_ns, &uncached_cmds);
+    if (ret == EXIT_SUCCESS)
+        ret = execute_policy(policy, &cache, count, &cached_ns, &cached_cmds);
+    ifapi_policy_ticket_cache_clear(&cache);
+    if (ret != EXIT_SUCCESS)
+        return ret;
+
+    if (command_ns)
+        printf("PolicyAuthorize, TPM at %.1f ms per command: ",
+               command_ns / 1e6);
+    else
+        printf("PolicyAuthorize, host time only: ");
+    printf("without cache %.1f us (%.0f commands), "
+           "with cache %.1f us (%.0f commands)\n",
+           uncached_ns / 1e3, uncached_cmds, cached_ns / 1e3, cached_cmds);
+    return EXIT_SUCCESS;
+}
+
+int
+bench_fapi_policy_ticket(void)
+{
+    TPML_POLICYELEMENTS *elements;
+    TPMS_POLICYAUTHORIZE *authorize;
+    TPMS_POLICY policy = { 0 };
+    int ret;
+
+    elements = calloc(1, sizeof(TPML_POLICYELEMENTS) + sizeof(TPMT_POLICYELEMENT));
+    BENCH_CHECK(elements != NULL);
+    elements->count = 1;
+    elements->elements[0].type = POLICYAUTHORIZE;
+    authorize = &elements->elements[0].element.PolicyAuthorize;
+    authorize->keyPublic.type = TPM2_ALG_RSA;
+    authorize->keyPublic.nameAlg = TPM2_ALG_SHA256;
+    authorize->keyPublic.objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT;
+    authorize->keyPublic.parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_NULL;
+    authorize->keyPublic.parameters.rsaDetail.scheme.scheme = TPM2_ALG_NULL;
+    authorize->keyPublic.parameters.rsaDetail.keyBits = 2048;
+    authorize->keyPublic.unique.rsa.size = 256;
+    memset(&authorize->keyPublic.unique.rsa.buffer[0], 0x5a, 256);
+    authorize->approvedPolicy.size = TPM2_SHA256_DIGEST_SIZE;
+    policy.policy = elements;
+
+    ret = compare(&policy, NUM_EXECUTIONS_HOST, 0);
+    if (ret == EXIT_SUCCESS)
+        ret = compare(&policy, NUM_EXECUTIONS, TPM_COMMAND_NS);
+
+    SAFE_FREE(elements);
+    return ret;
+}
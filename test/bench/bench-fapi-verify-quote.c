@@ -0,0 +1,270 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <json-c/json.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include "tss2_fapi.h"
+#include "tss2_mu.h"
+#include "fapi_int.h"
+#include "fapi_crypto.h"
+#include "ifapi_json_serialize.h"
+#include "ifapi_helpers.h"
+#include "util/aux_util.h"
+#include "bench.h"
+
+/*
+ * Compare the time of Fapi_VerifyQuoteBatch() with the verification of the
+ * quotes one by one as Fapi_VerifyQuote() does. The quotes are signed by
+ * software keys, which are returned by the wrapped keystore functions.
+ */
+
+#define NUM_KEYS 2
+#define NUM_QUOTES 2000
+
+static char *key_paths[NUM_KEYS] = { "HS/SRK/key0", "HS/SRK/key1" };
+static EVP_PKEY *keys[NUM_KEYS];
+static char *key_pems[NUM_KEYS];
+static const char *key_path;
+
+static uint8_t nonce[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                             11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+
+/* The batch verification does not need the TPM. */
+TSS2_RC
+ifapi_non_tpm_mode_init(FAPI_CONTEXT *context)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_ifapi_keystore_load_async(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_IO *io,
+    const char *path)
+{
+    key_path = path;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_ifapi_keystore_load_finish(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_IO *io,
+    IFAPI_OBJECT *object)
+{
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        if (strcmp(key_path, key_paths[i]) == 0) {
+            memset(object, 0, sizeof(IFAPI_OBJECT));
+            object->objectType = IFAPI_EXT_PUB_KEY_OBJ;
+            object->misc.ext_pub_key.pem_ext_public = strdup(key_pems[i]);
+            if (!object->misc.ext_pub_key.pem_ext_public)
+                return TSS2_FAPI_RC_MEMORY;
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    return TSS2_FAPI_RC_PATH_NOT_FOUND;
+}
+
+static int
+create_keys(void)
+{
+    EVP_PKEY_CTX *ctx;
+    BIO *bio;
+    char *pem;
+    long pem_size;
+    int ok;
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        BENCH_CHECK(ctx != NULL);
+        ok = EVP_PKEY_keygen_init(ctx) == 1 &&
+            EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+                                                   NID_X9_62_prime256v1) == 1 &&
+            EVP_PKEY_keygen(ctx, &keys[i]) == 1;
+        EVP_PKEY_CTX_free(ctx);
+        BENCH_CHECK(ok);
+
+        bio = BIO_new(BIO_s_mem());
+        BENCH_CHECK(bio != NULL);
+        ok = PEM_write_bio_PUBKEY(bio, keys[i]) == 1;
+        if (ok) {
+            pem_size = BIO_get_mem_data(bio, &pem);
+            key_pems[i] = strndup(pem, pem_size);
+        }
+        BIO_free(bio);
+        BENCH_CHECK(ok && key_pems[i] != NULL);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Create a quote info and its signature with the key key_idx. */
+static int
+create_quote(size_t key_idx, uint32_t clock, char **quote_info_string,
+             uint8_t **signature, size_t *signature_size)
+{
+    FAPI_QUOTE_INFO quote_info;
+    json_object *jso = NULL;
+    uint8_t buffer[sizeof(TPMS_ATTEST)];
+    size_t offset = 0;
+    EVP_MD_CTX *mdctx;
+    int ok;
+
+    memset(&quote_info, 0, sizeof(FAPI_QUOTE_INFO));
+    quote_info.sig_scheme.scheme = TPM2_ALG_ECDSA;
+    quote_info.sig_scheme.details.any.hashAlg = TPM2_ALG_SHA256;
+    quote_info.attest.magic = TPM2_GENERATED_VALUE;
+    quote_info.attest.type = TPM2_ST_ATTEST_QUOTE;
+    quote_info.attest.extraData.size = sizeof(nonce);
+    memcpy(&quote_info.attest.extraData.buffer[0], &nonce[0], sizeof(nonce));
+    quote_info.attest.clockInfo.clock = clock;
+    quote_info.attest.attested.quote.pcrDigest.size = TPM2_SHA256_DIGEST_SIZE;
+
+    BENCH_CHECK(ifapi_json_FAPI_QUOTE_INFO_serialize(&quote_info, &jso)
+                == TSS2_RC_SUCCESS);
+    *quote_info_string = strdup(json_object_to_json_string_ext(jso,
+                                    JSON_C_TO_STRING_PRETTY));
+    json_object_put(jso);
+    BENCH_CHECK(*quote_info_string != NULL);
+
+    BENCH_CHECK(Tss2_MU_TPMS_ATTEST_Marshal(&quote_info.attest, &buffer[0],
+                                            sizeof(buffer), &offset)
+                == TSS2_RC_SUCCESS);
+
+    mdctx = EVP_MD_CTX_new();
+    BENCH_CHECK(mdctx != NULL);
+    ok = EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, keys[key_idx]) == 1 &&
+        EVP_DigestSignUpdate(mdctx, &buffer[0], offset) == 1 &&
+        EVP_DigestSignFinal(mdctx, NULL, signature_size) == 1 &&
+        (*signature = malloc(*signature_size)) != NULL &&
+        EVP_DigestSignFinal(mdctx, *signature, signature_size) == 1;
+    EVP_MD_CTX_free(mdctx);
+    BENCH_CHECK(ok);
+    return EXIT_SUCCESS;
+}
+
+/* Verify the quotes one by one as Fapi_VerifyQuote() does. */
+static int
+verify_single(char **quote_infos, uint8_t **signatures, size_t *signature_sizes)
+{
+    IFAPI_OBJECT key_object;
+    IFAPI_PUBLIC_KEY_BLOB *public_key;
+    FAPI_QUOTE_INFO quote_info;
+    TPM2B_ATTEST attest2b;
+    TSS2_RC r;
+
+    for (size_t i = 0; i < NUM_QUOTES; i++) {
+        memset(&key_object, 0, sizeof(IFAPI_OBJECT));
+        key_object.objectType = IFAPI_EXT_PUB_KEY_OBJ;
+        key_object.misc.ext_pub_key.pem_ext_public = key_pems[i % NUM_KEYS];
+        r = ifapi_get_quote_info(quote_infos[i], &attest2b, &quote_info);
+        BENCH_CHECK(r == TSS2_RC_SUCCESS);
+        r = ifapi_public_key_load(&key_object, &public_key);
+        BENCH_CHECK(r == TSS2_RC_SUCCESS);
+        r = ifapi_verify_signature_quote_key(public_key, signatures[i],
+                                             signature_sizes[i],
+                                             &attest2b.attestationData[0],
+                                             attest2b.size,
+                                             &quote_info.sig_scheme);
+        ifapi_public_key_free(&public_key);
+        BENCH_CHECK(r == TSS2_RC_SUCCESS);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int
+verify_quotes(void)
+{
+    FAPI_CONTEXT *context = calloc(1, sizeof(FAPI_CONTEXT));
+    char **quote_infos = calloc(NUM_QUOTES, sizeof(char *));
+    uint8_t **signatures = calloc(NUM_QUOTES, sizeof(uint8_t *));
+    size_t *signature_sizes = calloc(NUM_QUOTES, sizeof(size_t));
+    char const **paths = calloc(NUM_QUOTES, sizeof(char *));
+    uint8_t const **qualifying_data = calloc(NUM_QUOTES, sizeof(uint8_t *));
+    size_t *qualifying_data_sizes = calloc(NUM_QUOTES, sizeof(size_t));
+    TSS2_RC *results = NULL;
+    struct timespec start, end;
+    double single_ns, batch_ns;
+    int ret = EXIT_FAILURE;
+    TSS2_RC r;
+
+    if (!context || !quote_infos || !signatures || !signature_sizes ||
+        !paths || !qualifying_data || !qualifying_data_sizes)
+        goto cleanup;
+
+    for (size_t i = 0; i < NUM_QUOTES; i++) {
+        if (create_quote(i % NUM_KEYS, i, &quote_infos[i], &signatures[i],
+                         &signature_sizes[i]) != EXIT_SUCCESS)
+            goto cleanup;
+        paths[i] = key_paths[i % NUM_KEYS];
+        qualifying_data[i] = nonce;
+        qualifying_data_sizes[i] = sizeof(nonce);
+    }
+
+    bench_now(&start);
+    if (verify_single(quote_infos, signatures, signature_sizes) != EXIT_SUCCESS)
+        goto cleanup;
+    bench_now(&end);
+    single_ns = bench_elapsed_ns(&start, &end);
+
+    bench_now(&start);
+    r = Fapi_VerifyQuoteBatch(context, NUM_QUOTES, paths, qualifying_data,
+                              qualifying_data_sizes,
+                              (char const * const *)quote_infos,
+                              (uint8_t const * const *)signatures,
+                              signature_sizes, NULL, &results);
+    bench_now(&end);
+    batch_ns = bench_elapsed_ns(&start, &end);
+    if (r != TSS2_RC_SUCCESS) {
+        fprintf(stderr, "Fapi_VerifyQuoteBatch failed: 0x%08x\n", r);
+        goto cleanup;
+    }
+
+    printf("Verification of %d quotes: single %.1f ms, batch %.1f ms\n",
+           NUM_QUOTES, single_ns / 1e6, batch_ns / 1e6);
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    SAFE_FREE(results);
+    for (size_t i = 0; quote_infos && signatures && i < NUM_QUOTES; i++) {
+        SAFE_FREE(quote_infos[i]);
+        SAFE_FREE(signatures[i]);
+    }
+    SAFE_FREE(quote_infos);
+    SAFE_FREE(signatures);
+    SAFE_FREE(signature_sizes);
+    SAFE_FREE(paths);
+    SAFE_FREE(qualifying_data);
+    SAFE_FREE(qualifying_data_sizes);
+    SAFE_FREE(context);
+    return ret;
+}
+
+int
+bench_fapi_verify_quote(void)
+{
+    int ret;
+
+    ret = create_keys();
+    if (ret == EXIT_SUCCESS)
+        ret = verify_quotes();
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        EVP_PKEY_free(keys[i]);
+        SAFE_FREE(key_pems[i]);
+    }
+    return ret;
+}
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2017-2018, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tss2_mu.h"
+#include "bench.h"
+
+/*
+ * Marshaling throughput of large TPM2B types and of TPML types with the
+ * maximum number of elements. Each element is marshaled by a separate
+ * function call, so the cost of the log statements in these functions
+ * adds up.
+ */
+
+#define MARSHAL_ITERATIONS 100000
+
+static void
+report(const char *name, const struct timespec *start,
+       const struct timespec *end, size_t size)
+{
+    double ns = bench_elapsed_ns(start, end);
+
+    printf("%s: %7.1f ns per call, %6.1f MB/s\n", name,
+           ns / MARSHAL_ITERATIONS, size * MARSHAL_ITERATIONS * 1e3 / ns);
+}
+
+/* Run stmt MARSHAL_ITERATIONS times from offset 0 and report its timing. */
+#define MEASURE(name, stmt) \
+    do { \
+        bench_now(&start); \
+        for (i = 0; i < MARSHAL_ITERATIONS; i++) { \
+            offset = 0; \
+            rc = stmt; \
+            BENCH_CHECK(rc == TSS2_RC_SUCCESS); \
+        } \
+        bench_now(&end); \
+        report(name, &start, &end, offset); \
+    } while (0)
+
+static int
+tpm2b_marshal(void)
+{
+    TPM2B_MAX_BUFFER max_buf = { .size = TPM2_MAX_DIGEST_BUFFER };
+    TPM2B_PUBLIC pub = {
+        .publicArea = {
+            .type = TPM2_ALG_RSA,
+            .nameAlg = TPM2_ALG_SHA256,
+            .objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT,
+            .parameters.rsaDetail = {
+                .symmetric.algorithm = TPM2_ALG_NULL,
+                .scheme.scheme = TPM2_ALG_RSASSA,
+                .scheme.details.rsassa.hashAlg = TPM2_ALG_SHA256,
+                .keyBits = 2048,
+            },
+            .unique.rsa.size = 256,
+        },
+    };
+    uint8_t buffer[sizeof(max_buf) + sizeof(pub)];
+    struct timespec start, end;
+    size_t offset, i;
+    TSS2_RC rc;
+
+    MEASURE("Tss2_MU_TPM2B_MAX_BUFFER_Marshal",
+            Tss2_MU_TPM2B_MAX_BUFFER_Marshal(&max_buf, buffer, sizeof(buffer),
+                                             &offset));
+    MEASURE("Tss2_MU_TPM2B_PUBLIC_Marshal",
+            Tss2_MU_TPM2B_PUBLIC_Marshal(&pub, buffer, sizeof(buffer), &offset));
+    MEASURE("Tss2_MU_TPM2B_PUBLIC_Unmarshal",
+            (pub.size = 0,
+             Tss2_MU_TPM2B_PUBLIC_Unmarshal(buffer, sizeof(buffer), &offset,
+                                            &pub)));
+    return EXIT_SUCCESS;
+}
+
+static int
+tpml_marshal(void)
+{
+    TPML_DIGEST_VALUES digests = {0};
+    TPML_PCR_SELECTION pcr_sel = {0};
+    uint8_t buffer[sizeof(digests) + sizeof(pcr_sel)];
+    struct timespec start, end;
+    size_t offset, i;
+    TSS2_RC rc;
+
+    digests.count = TPM2_NUM_PCR_BANKS;
+    for (i = 0; i < digests.count; i++) {
+        digests.digests[i].hashAlg = TPM2_ALG_SHA256;
+        memset(digests.digests[i].digest.sha256, (int)i, TPM2_SHA256_DIGEST_SIZE);
+    }
+    pcr_sel.count = TPM2_NUM_PCR_BANKS;
+    for (i = 0; i < pcr_sel.count; i++) {
+        pcr_sel.pcrSelections[i].hash = TPM2_ALG_SHA256;
+        pcr_sel.pcrSelections[i].sizeofSelect = 3;
+        pcr_sel.pcrSelections[i].pcrSelect[0] = 0xff;
+    }
+
+    MEASURE("Tss2_MU_TPML_DIGEST_VALUES_Marshal",
+            Tss2_MU_TPML_DIGEST_VALUES_Marshal(&digests, buffer, sizeof(buffer),
+                                               &offset));
+    MEASURE("Tss2_MU_TPML_DIGEST_VALUES_Unmarshal",
+            Tss2_MU_TPML_DIGEST_VALUES_Unmarshal(buffer, sizeof(buffer), &offset,
+                                                 &digests));
+    MEASURE("Tss2_MU_TPML_PCR_SELECTION_Marshal",
+            Tss2_MU_TPML_PCR_SELECTION_Marshal(&pcr_sel, buffer, sizeof(buffer),
+                                               &offset));
+    MEASURE("Tss2_MU_TPML_PCR_SELECTION_Unmarshal",
+            Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, sizeof(buffer), &offset,
+                                                 &pcr_sel));
+    return EXIT_SUCCESS;
+}
+
+int
+bench_mu_marshal(void)
+{
+    int ret;
+
+    ret = tpm2b_marshal();
+    if (ret != EXIT_SUCCESS)
+        return ret;
+    return tpml_marshal();
+}
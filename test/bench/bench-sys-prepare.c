@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2021, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "tss2_sys.h"
+#include "sysapi_util.h"
+#include "bench.h"
+
+#define MAX_SIZE_CTX 4096
+#define PREPARE_ITERATIONS 1000000
+
+/*
+ * Measure the throughput of Tss2_Sys_*_Prepare for commands at the start
+ * and the end of the command code range.
+ */
+int
+bench_sys_prepare (void)
+{
+    _TSS2_SYS_CONTEXT_BLOB *sys_ctx;
+    UINT32 size_ctx;
+    struct timespec start, end;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    size_t i;
+
+    size_ctx = Tss2_Sys_GetContextSize (MAX_SIZE_CTX);
+    sys_ctx = calloc (1, size_ctx);
+    BENCH_CHECK (sys_ctx != NULL);
+    InitSysContextPtrs (sys_ctx, size_ctx);
+
+    bench_now (&start);
+    for (i = 0; i < PREPARE_ITERATIONS && rc == TSS2_RC_SUCCESS; i++) {
+        rc = Tss2_Sys_GetCapability_Prepare ((TSS2_SYS_CONTEXT *) sys_ctx,
+                                             TPM2_CAP_TPM_PROPERTIES,
+                                             TPM2_PT_FIXED, 1);
+    }
+    bench_now (&end);
+    if (rc == TSS2_RC_SUCCESS) {
+        printf ("Tss2_Sys_GetCapability_Prepare: %6.1f ns per call\n",
+                bench_elapsed_ns (&start, &end) / PREPARE_ITERATIONS);
+
+        bench_now (&start);
+        for (i = 0; i < PREPARE_ITERATIONS && rc == TSS2_RC_SUCCESS; i++) {
+            rc = Tss2_Sys_ACT_SetTimeout_Prepare ((TSS2_SYS_CONTEXT *) sys_ctx,
+                                                  TPM2_RH_ACT_0, 1);
+        }
+        bench_now (&end);
+    }
+    if (rc == TSS2_RC_SUCCESS) {
+        printf ("Tss2_Sys_ACT_SetTimeout_Prepare: %6.1f ns per call\n",
+                bench_elapsed_ns (&start, &end) / PREPARE_ITERATIONS);
+    }
+
+    free (sys_ctx);
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2021, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_swtpm.h"
+
+#include "tss2-tcti/tcti-swtpm.h"
+#include "bench.h"
+
+/*
+ * Compare the round trip time of the swtpm TCTI over TCP loopback and over
+ * Unix domain sockets. A forked child plays swtpm: it answers every command
+ * with a fixed response and every control channel request with success. The
+ * control channel is a Unix domain socket in both cases; it is only used
+ * during initialization.
+ */
+#define ROUND_TRIPS 2000
+
+typedef struct {
+    char dir [64];
+    char path [96];
+    char ctrl_path [96];
+    SOCKET tcp_listen;
+    SOCKET unix_listen;
+    SOCKET ctrl_listen;
+    uint16_t port;
+} latency_state_t;
+
+static const uint8_t command [] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x01, 0x7b, 0x00, 0x08
+};
+static const uint8_t response [] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00
+};
+
+static SOCKET
+listen_unix (const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    SOCKET sock = socket (AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    strncpy (addr.sun_path, path, sizeof (addr.sun_path) - 1);
+    if (bind (sock, (struct sockaddr*)&addr, sizeof (addr)) != 0 ||
+        listen (sock, 16) != 0) {
+        socket_close (&sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+static SOCKET
+listen_tcp (uint16_t *port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof (addr);
+    SOCKET sock = socket (AF_INET, SOCK_STREAM, 0);
+
+    if (sock == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    if (bind (sock, (struct sockaddr*)&addr, sizeof (addr)) != 0 ||
+        listen (sock, 16) != 0 ||
+        getsockname (sock, (struct sockaddr*)&addr, &len) != 0) {
+        socket_close (&sock);
+        return INVALID_SOCKET;
+    }
+    *port = ntohs (addr.sin_port);
+    return sock;
+}
+
+/*
+ * Serve one connection: read one request, send the reply and wait for the
+ * client to close the connection.
+ */
+static void
+serve_one (SOCKET listen_sock, const uint8_t *reply, size_t reply_size)
+{
+    uint8_t buf [64];
+    SOCKET sock = accept (listen_sock, NULL, NULL);
+
+    if (sock == INVALID_SOCKET) {
+        return;
+    }
+    if (read (sock, buf, sizeof (buf)) > 0 &&
+        write_all (sock, reply, reply_size) == (ssize_t)reply_size) {
+        while (read (sock, buf, sizeof (buf)) > 0);
+    }
+    close (sock);
+}
+
+static void
+server_loop (latency_state_t *ls)
+{
+    static const uint8_t ctrl_ok [4] = { 0 };
+    struct pollfd fds [3] = {
+        { .fd = ls->tcp_listen, .events = POLLIN },
+        { .fd = ls->unix_listen, .events = POLLIN },
+        { .fd = ls->ctrl_listen, .events = POLLIN },
+    };
+    size_t i;
+
+    for (;;) {
+        if (poll (fds, 3, -1) < 0) {
+            continue;
+        }
+        for (i = 0; i < 3; i++) {
+            if (!(fds [i].revents & POLLIN)) {
+                continue;
+            }
+            if (i == 2) {
+                serve_one (fds [i].fd, ctrl_ok, sizeof (ctrl_ok));
+            } else {
+                serve_one (fds [i].fd, response, sizeof (response));
+            }
+        }
+    }
+}
+
+/* The nanoseconds per round trip with the TCTI configured by conf. */
+static int
+measure (const char *conf, double *ns)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    uint8_t buf [sizeof (response)];
+    struct timespec start, end;
+    size_t size, i;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Swtpm_Init (NULL, &size, NULL);
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+    ctx = calloc (1, size);
+    BENCH_CHECK (ctx != NULL);
+    rc = Tss2_Tcti_Swtpm_Init (ctx, &size, conf);
+    if (rc != TSS2_RC_SUCCESS) {
+        free (ctx);
+    }
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+
+    bench_now (&start);
+    for (i = 0; i < ROUND_TRIPS && rc == TSS2_RC_SUCCESS; i++) {
+        rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+        if (rc == TSS2_RC_SUCCESS) {
+            size = sizeof (buf);
+            rc = Tss2_Tcti_Receive (ctx, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+        }
+        if (rc == TSS2_RC_SUCCESS &&
+            memcmp (buf, response, sizeof (response)) != 0) {
+            rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
+        }
+    }
+    bench_now (&end);
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+    BENCH_CHECK (rc == TSS2_RC_SUCCESS);
+    *ns = bench_elapsed_ns (&start, &end) / ROUND_TRIPS;
+    return EXIT_SUCCESS;
+}
+
+static int
+latency (latency_state_t *ls)
+{
+    char conf [256];
+    double tcp, uds;
+    int ret;
+
+    snprintf (conf, sizeof (conf), "host=127.0.0.1,port=%" PRIu16
+              ",ctrl_path=%s", ls->port, ls->ctrl_path);
+    ret = measure (conf, &tcp);
+    if (ret != EXIT_SUCCESS) {
+        return ret;
+    }
+    snprintf (conf, sizeof (conf), "path=%s,ctrl_path=%s", ls->path,
+              ls->ctrl_path);
+    ret = measure (conf, &uds);
+    if (ret != EXIT_SUCCESS) {
+        return ret;
+    }
+
+    printf ("swtpm TCP loopback: %8.1f ns per command\n", tcp);
+    printf ("swtpm Unix socket:  %8.1f ns per command\n", uds);
+    return EXIT_SUCCESS;
+}
+
+int
+bench_tcti_swtpm (void)
+{
+    latency_state_t ls = {
+        .tcp_listen = INVALID_SOCKET,
+        .unix_listen = INVALID_SOCKET,
+        .ctrl_listen = INVALID_SOCKET,
+    };
+    int ret = EXIT_FAILURE;
+    pid_t server = -1;
+
+    signal (SIGPIPE, SIG_IGN);
+    strcpy (ls.dir, "/tmp/tss2-swtpm-XXXXXX");
+    BENCH_CHECK (mkdtemp (ls.dir) != NULL);
+    snprintf (ls.path, sizeof (ls.path), "%s/tpm.sock", ls.dir);
+    snprintf (ls.ctrl_path, sizeof (ls.ctrl_path), "%s/ctrl.sock", ls.dir);
+    ls.tcp_listen = listen_tcp (&ls.port);
+    ls.unix_listen = listen_unix (ls.path);
+    ls.ctrl_listen = listen_unix (ls.ctrl_path);
+
+    if (ls.tcp_listen != INVALID_SOCKET && ls.unix_listen != INVALID_SOCKET &&
+        ls.ctrl_listen != INVALID_SOCKET) {
+        fflush (stdout);
+        server = fork ();
+        if (server == 0) {
+            server_loop (&ls);
+            _exit (0);
+        }
+    }
+    if (server > 0) {
+        ret = latency (&ls);
+        kill (server, SIGTERM);
+        waitpid (server, NULL, 0);
+    } else {
+        fprintf (stderr, "Starting the swtpm stand-in failed\n");
+    }
+
+    socket_close (&ls.tcp_listen);
+    socket_close (&ls.unix_listen);
+    socket_close (&ls.ctrl_listen);
+    unlink (ls.path);
+    unlink (ls.ctrl_path);
+    rmdir (ls.dir);
+    return ret;
+}
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const struct {
+    const char *name;
+    int (*run)(void);
+} benchmarks[] = {
+    { "mu-marshal", bench_mu_marshal },
+    { "sys-prepare", bench_sys_prepare },
+#ifdef BENCH_ESYS
+    { "esys-rsrc-table", bench_esys_rsrc_table },
+    { "esys-crypto", bench_esys_crypto },
+#ifdef BENCH_MSSIM
+    { "esys-random-mssim", bench_esys_random_mssim },
+#endif
+#endif
+#ifdef BENCH_FAPI
+    { "fapi-pcr-replay", bench_fapi_pcr_replay },
+    { "fapi-verify-quote", bench_fapi_verify_quote },
+    { "fapi-policy-ticket", bench_fapi_policy_ticket },
+#endif
+#ifdef BENCH_SWTPM
+    { "tcti-swtpm", bench_tcti_swtpm },
+#endif
+};
+
+#define BENCHMARKS_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+void
+bench_now(struct timespec *now)
+{
+    clock_gettime(CLOCK_MONOTONIC, now);
+}
+
+double
+bench_elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+        (end->tv_nsec - start->tv_nsec);
+}
+
+/* Whether the benchmark is selected on the command line, all if none is. */
+static int
+bench_selected(const char *name, int argc, char *argv[])
+{
+    if (argc < 2)
+        return 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int ret = EXIT_SUCCESS;
+
+    for (size_t i = 0; i < BENCHMARKS_COUNT; i++) {
+        if (!bench_selected(benchmarks[i].name, argc, argv))
+            continue;
+        printf("== %s\n", benchmarks[i].name);
+        fflush(stdout);
+        if (benchmarks[i].run() != EXIT_SUCCESS) {
+            fprintf(stderr, "%s failed\n", benchmarks[i].name);
+            ret = EXIT_FAILURE;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+#ifndef TSS2_BENCH_H
+#define TSS2_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Micro benchmarks of the TSS. They are built with "make check" but are not
+ * run as tests; run "make bench" or test/bench/tss2-bench [name...].
+ *
+ * A benchmark returns EXIT_SUCCESS or EXIT_FAILURE if a checked operation
+ * fails, and prints its timings to stdout.
+ */
+
+/** Fail the benchmark if cond does not hold. */
+#define BENCH_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond); \
+            return EXIT_FAILURE; \
+        } \
+    } while (0)
+
+/** Get the current time of the monotonic clock. */
+void bench_now(struct timespec *now);
+
+/** Get the nanoseconds from start to end. */
+double bench_elapsed_ns(const struct timespec *start, const struct timespec *end);
+
+int bench_mu_marshal(void);
+int bench_sys_prepare(void);
+int bench_esys_rsrc_table(void);
+int bench_esys_crypto(void);
+int bench_esys_random_mssim(void);
+int bench_fapi_pcr_replay(void);
+int bench_fapi_verify_quote(void);
+int bench_fapi_policy_ticket(void);
+int bench_tcti_swtpm(void);
+
+#endif /* TSS2_BENCH_H */
@@ -109,6 +109,56 @@ static uint8_t getcap_resp_malformed_short[] = {
 
 #define child_exit(code) do { LOG_ERROR ("PID (%d): Child child_exiting", getpid ()); exit (code); } while (0)
 
+/*
+ * Read a tagged command frame from stdin and check it against the only
+ * command that is expected.
+ */
+static void read_tagged_command (uint8_t tag[4])
+{
+    uint8_t buf[4096];
+
+    if (fread (tag, 1, 4, stdin) != 4 ||
+        fread (buf, 1, sizeof (getcap_command), stdin) !=
+            sizeof (getcap_command)) {
+        LOG_ERROR ("Could not read tagged command: %s", strerror (errno));
+        child_exit (EXIT_FAILURE);
+    }
+
+    if (memcmp (getcap_command, buf, sizeof (getcap_command))) {
+        LOG_ERROR ("Unexpected command buffer");
+        child_exit (EXIT_FAILURE);
+    }
+}
+
+static void write_tagged_response (const uint8_t tag[4], const uint8_t *buf,
+        size_t size)
+{
+    if (fwrite (tag, 1, 4, stdout) != 4 ||
+        fwrite (buf, 1, size, stdout) != size) {
+        LOG_ERROR ("Could not write tagged response: %s", strerror (errno));
+        child_exit (EXIT_FAILURE);
+    }
+}
+
+/*
+ * Pipelined framing: read two tagged commands and answer them in reverse
+ * order, the first with a good getcap response and the second with a
+ * failure response.
+ */
+static void __attribute__((__noreturn__)) tagged_main (void)
+{
+    uint8_t tag[2][4];
+
+    for (;;) {
+        read_tagged_command (tag[0]);
+        read_tagged_command (tag[1]);
+
+        write_tagged_response (tag[1], failure_resp, sizeof (failure_resp));
+        write_tagged_response (tag[0], getcap_good_resp,
+                sizeof (getcap_good_resp));
+    }
+}
+
 int main (int argc, char *argv[])
 {
     /* No buffering on read/write from child stdio/stdin */
@@ -143,6 +193,8 @@ int main (int argc, char *argv[])
     } else if (!strcmp (response_selector, "short")) {
         response_buffer = getcap_resp_malformed_short;
         response_buffer_size = sizeof (getcap_resp_malformed_short);
+    } else if (!strcmp (response_selector, "tagged")) {
+        tagged_main ();
     } else {
         LOG_ERROR ("Unknown buffer response string: %s", argv[1]);
         child_exit (EXIT_FAILURE);
@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ *******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** The number of keys loaded, more than the TPM has transient object slots. */
+#define NUM_KEYS 6
+
+/** This test is intended to test the swapping of transient objects.
+ *
+ * The ESYS_CONTEXT keeps at most three objects loaded (the number of
+ * transient object slots of the simulator). We create a primary key and a
+ * HMAC key, which is loaded several times (Esys_Load). Afterwards a HMAC is
+ * computed with each loaded key, which requires the ESYS_CONTEXT to swap the
+ * keys in and out of the TPM.
+ *
+ * Tested ESYS commands:
+ *  - Esys_Create() (M)
+ *  - Esys_CreatePrimary() (M)
+ *  - Esys_FlushContext() (M)
+ *  - Esys_HMAC() (O)
+ *  - Esys_Load() (M)
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval EXIT_FAILURE
+ * @retval EXIT_SUCCESS
+ */
+
+int
+test_esys_object_swap(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    ESYS_TR primaryHandle = ESYS_TR_NONE;
+    ESYS_TR keyHandle[NUM_KEYS];
+
+    TPM2B_PUBLIC *outPublic = NULL;
+    TPM2B_CREATION_DATA *creationData = NULL;
+    TPM2B_DIGEST *creationHash = NULL;
+    TPMT_TK_CREATION *creationTicket = NULL;
+    TPM2B_PUBLIC *outPublic2 = NULL;
+    TPM2B_PRIVATE *outPrivate2 = NULL;
+    TPM2B_CREATION_DATA *creationData2 = NULL;
+    TPM2B_DIGEST *creationHash2 = NULL;
+    TPMT_TK_CREATION *creationTicket2 = NULL;
+    TPM2B_DIGEST *outHMAC = NULL;
+    TPM2B_DIGEST firstHMAC = { 0 };
+
+    for (size_t i = 0; i < NUM_KEYS; i++)
+        keyHandle[i] = ESYS_TR_NONE;
+
+    TPM2B_SENSITIVE_CREATE inSensitive = { 0 };
+    TPM2B_DATA outsideInfo = { 0 };
+    TPML_PCR_SELECTION creationPCR = { .count = 0 };
+
+    TPM2B_PUBLIC inPublicPrimary = {
+        .size = 0,
+        .publicArea = {
+            .type = TPM2_ALG_RSA,
+            .nameAlg = TPM2_ALG_SHA256,
+            .objectAttributes = (TPMA_OBJECT_USERWITHAUTH |
+                                 TPMA_OBJECT_RESTRICTED |
+                                 TPMA_OBJECT_DECRYPT |
+                                 TPMA_OBJECT_FIXEDTPM |
+                                 TPMA_OBJECT_FIXEDPARENT |
+                                 TPMA_OBJECT_SENSITIVEDATAORIGIN),
+            .parameters.rsaDetail = {
+                 .symmetric = {
+                     .algorithm = TPM2_ALG_AES,
+                     .keyBits.aes = 128,
+                     .mode.aes = TPM2_ALG_CFB},
+                 .scheme = {
+                      .scheme = TPM2_ALG_NULL
+                  },
+                 .keyBits = 2048,
+                 .exponent = 0,
+             },
+        },
+    };
+
+    TPM2B_PUBLIC inPublic = { 0 };
+    inPublic.publicArea.nameAlg = TPM2_ALG_SHA256;
+    inPublic.publicArea.type = TPM2_ALG_KEYEDHASH;
+    inPublic.publicArea.objectAttributes |= TPMA_OBJECT_SIGN_ENCRYPT;
+    inPublic.publicArea.objectAttributes |= TPMA_OBJECT_USERWITHAUTH;
+    inPublic.publicArea.objectAttributes |= TPMA_OBJECT_SENSITIVEDATAORIGIN;
+    inPublic.publicArea.parameters.keyedHashDetail.scheme.scheme = TPM2_ALG_HMAC;
+    inPublic.publicArea.parameters.keyedHashDetail.scheme.details.hmac.hashAlg = TPM2_ALG_SHA256;
+
+    TPM2B_MAX_BUFFER test_buffer = { .size = 20,
+                                     .buffer={0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0,
+                                              1, 2, 3, 4, 5, 6, 7, 8, 9}} ;
+
+    r = Esys_SetResidentObjectLimit(esys_context, 3);
+    goto_if_error(r, "Error: SetResidentObjectLimit", error);
+
+    r = Esys_CreatePrimary(esys_context, ESYS_TR_RH_OWNER, ESYS_TR_PASSWORD,
+                           ESYS_TR_NONE, ESYS_TR_NONE, &inSensitive,
+                           &inPublicPrimary, &outsideInfo, &creationPCR,
+                           &primaryHandle, &outPublic, &creationData,
+                           &creationHash, &creationTicket);
+    goto_if_error(r, "Error: CreatePrimary", error);
+
+    r = Esys_Create(esys_context, primaryHandle, ESYS_TR_PASSWORD,
+                    ESYS_TR_NONE, ESYS_TR_NONE, &inSensitive, &inPublic,
+                    &outsideInfo, &creationPCR, &outPrivate2, &outPublic2,
+                    &creationData2, &creationHash2, &creationTicket2);
+    goto_if_error(r, "Error: Create", error);
+
+    /* Every load needs the primary key, which may have been swapped out */
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        r = Esys_Load(esys_context, primaryHandle, ESYS_TR_PASSWORD,
+                      ESYS_TR_NONE, ESYS_TR_NONE, outPrivate2, outPublic2,
+                      &keyHandle[i]);
+        goto_if_error(r, "Error: Load", error);
+    }
+
+    /* All keys are the same and thus compute the same HMAC */
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        r = Esys_HMAC(esys_context, keyHandle[i], ESYS_TR_PASSWORD,
+                      ESYS_TR_NONE, ESYS_TR_NONE, &test_buffer,
+                      TPM2_ALG_SHA256, &outHMAC);
+        goto_if_error(r, "Error: HMAC", error);
+
+        if (i == 0) {
+            firstHMAC = *outHMAC;
+        } else if (outHMAC->size != firstHMAC.size ||
+                   memcmp(outHMAC->buffer, firstHMAC.buffer, firstHMAC.size)) {
+            LOG_ERROR("HMAC of key %zu differs.", i);
+            goto error;
+        }
+        SAFE_FREE(outHMAC);
+    }
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        r = Esys_FlushContext(esys_context, keyHandle[i]);
+        goto_if_error(r, "Error: FlushContext", error);
+        keyHandle[i] = ESYS_TR_NONE;
+    }
+
+    r = Esys_FlushContext(esys_context, primaryHandle);
+    goto_if_error(r, "Error: FlushContext", error);
+
+    Esys_Free(outPublic);
+    Esys_Free(creationData);
+    Esys_Free(creationHash);
+    Esys_Free(creationTicket);
+    Esys_Free(outPublic2);
+    Esys_Free(outPrivate2);
+    Esys_Free(creationData2);
+    Esys_Free(creationHash2);
+    Esys_Free(creationTicket2);
+    return EXIT_SUCCESS;
+
+ error:
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        if (keyHandle[i] != ESYS_TR_NONE) {
+            if (Esys_FlushContext(esys_context, keyHandle[i]) != TSS2_RC_SUCCESS) {
+                LOG_ERROR("Cleanup keyHandle failed.");
+            }
+        }
+    }
+    if (primaryHandle != ESYS_TR_NONE) {
+        if (Esys_FlushContext(esys_context, primaryHandle) != TSS2_RC_SUCCESS) {
+            LOG_ERROR("Cleanup primaryHandle failed.");
+        }
+    }
+
+    Esys_Free(outPublic);
+    Esys_Free(creationData);
+    Esys_Free(creationHash);
+    Esys_Free(creationTicket);
+    Esys_Free(outPublic2);
+    Esys_Free(outPrivate2);
+    Esys_Free(creationData2);
+    Esys_Free(creationHash2);
+    Esys_Free(creationTicket2);
+    Esys_Free(outHMAC);
+    return EXIT_FAILURE;
+}
+
+int
+test_invoke_esys(ESYS_CONTEXT * esys_context) {
+    return test_esys_object_swap(esys_context);
+}
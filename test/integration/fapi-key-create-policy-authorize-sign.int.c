@@ -317,6 +317,17 @@ test_fapi_key_create_policy_authorize_sign(FAPI_CONTEXT *context)
     ASSERT(strstr(publicKey, "BEGIN PUBLIC KEY"));
     LOG_INFO("Certificate: %s", certificate);
     ASSERT(strstr(certificate, "BEGIN CERTIFICATE"));
+    SAFE_FREE(signature);
+    SAFE_FREE(publicKey);
+    SAFE_FREE(certificate);
+
+    /* The second execution of the authorized policy uses the cached
+       verification ticket. */
+    r = Fapi_Sign(context, OBJECT_PATH, NULL,
+                  &digest.buffer[0], digest.size, &signature, &signatureSize,
+                  &publicKey, &certificate);
+    goto_if_error(r, "Error Fapi_Sign", error);
+    ASSERT(signature != NULL);
 
     r = Fapi_List(context, "/", &pathList);
     goto_if_error(r, "Error Fapi_List", error);
@@ -40,6 +40,8 @@
  *  - Fapi_Import()
  *  - Fapi_PcrRead()
  *  - Fapi_VerifyQuote()
+ *  - Fapi_VerifyQuoteIncremental()
+ *  - Fapi_VerifyQuoteBatch()
  *  - Fapi_List()
  *  - Fapi_Delete()
  *
@@ -62,6 +64,10 @@ test_fapi_quote(FAPI_CONTEXT *context)
     uint8_t *pcr_digest = NULL;
     char *log = NULL;
     char *pathlist = NULL;
+    char *pcrState = NULL;
+    char *pcrState2 = NULL;
+    json_object *jso_log = NULL;
+    TSS2_RC *results = NULL;
 
     uint8_t data[EVENT_SIZE] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
     size_t signatureSize = 0;
@@ -258,6 +264,60 @@ test_fapi_quote(FAPI_CONTEXT *context)
     LOG_INFO("\nVerifyQuote log: %s\n", log);
     CHECK_JSON_LIST(log_check_list, log, error);
 
+    /* Replay the complete log and verify again with the replayed state. */
+    r = Fapi_VerifyQuoteIncremental(context, "HS/SRK/mySignKey",
+                                    qualifyingData, 20,  quoteInfo,
+                                    signature, signatureSize, log, 0,
+                                    NULL, &pcrState);
+    goto_if_error(r, "Error Fapi_VerifyQuoteIncremental", error);
+    ASSERT(pcrState != NULL);
+    LOG_INFO("\nPCR state: %s\n", pcrState);
+
+    jso_log = json_tokener_parse(log);
+    ASSERT(jso_log != NULL);
+    r = Fapi_VerifyQuoteIncremental(context, "HS/SRK/mySignKey",
+                                    qualifyingData, 20,  quoteInfo,
+                                    signature, signatureSize, NULL,
+                                    json_object_array_length(jso_log),
+                                    pcrState, &pcrState2);
+    goto_if_error(r, "Error Fapi_VerifyQuoteIncremental", error);
+    ASSERT(pcrState2 != NULL);
+    json_object_put(jso_log);
+    jso_log = NULL;
+
+    /* Verify the quote several times in one batch, once with a wrong nonce. */
+    uint8_t wrongData[20] = { 0 };
+    char const *batchKeyPaths[] = { "HS/SRK/mySignKey", "HS/SRK/mySignKey",
+                                    "HS/SRK/mySignKey" };
+    uint8_t const *batchQualifyingData[] = { qualifyingData, NULL, wrongData };
+    size_t batchQualifyingDataSizes[] = { 20, 0, 20 };
+    char const *batchQuoteInfos[] = { quoteInfo, quoteInfo, quoteInfo };
+    uint8_t const *batchSignatures[] = { signature, signature, signature };
+    size_t batchSignatureSizes[] = { signatureSize, signatureSize, signatureSize };
+    char const *batchPcrLogs[] = { log, NULL, log };
+
+    r = Fapi_VerifyQuoteBatch(context, 2, batchKeyPaths, batchQualifyingData,
+                              batchQualifyingDataSizes, batchQuoteInfos,
+                              batchSignatures, batchSignatureSizes,
+                              batchPcrLogs, &results);
+    goto_if_error(r, "Error Fapi_VerifyQuoteBatch", error);
+    ASSERT(results != NULL);
+    ASSERT(results[0] == TSS2_RC_SUCCESS && results[1] == TSS2_RC_SUCCESS);
+    SAFE_FREE(results);
+
+    r = Fapi_VerifyQuoteBatch(context, 3, batchKeyPaths, batchQualifyingData,
+                              batchQualifyingDataSizes, batchQuoteInfos,
+                              batchSignatures, batchSignatureSizes,
+                              batchPcrLogs, &results);
+    if (r != TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED) {
+        LOG_ERROR("Fapi_VerifyQuoteBatch accepted a wrong nonce.");
+        goto error;
+    }
+    ASSERT(results != NULL);
+    ASSERT(results[0] == TSS2_RC_SUCCESS && results[1] == TSS2_RC_SUCCESS);
+    ASSERT(results[2] == TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED);
+    SAFE_FREE(results);
+
     r = Fapi_List(context, "/", &pathlist);
     goto_if_error(r, "Pathlist", error);
     ASSERT(pathlist != NULL);
@@ -283,12 +343,17 @@ test_fapi_quote(FAPI_CONTEXT *context)
     SAFE_FREE(pcr_digest);
     SAFE_FREE(log);
     SAFE_FREE(pathlist);
+    SAFE_FREE(pcrState);
+    SAFE_FREE(pcrState2);
+    SAFE_FREE(results);
     return EXIT_SUCCESS;
 
 error:
     Fapi_Delete(context, "/");
     if (jso)
         json_object_put(jso);
+    if (jso_log)
+        json_object_put(jso_log);
     SAFE_FREE(pubkey_pem);
     SAFE_FREE(signature);
     SAFE_FREE(quoteInfo);
@@ -298,6 +363,9 @@ error:
     SAFE_FREE(pcr_digest);
     SAFE_FREE(log);
     SAFE_FREE(pathlist);
+    SAFE_FREE(pcrState);
+    SAFE_FREE(pcrState2);
+    SAFE_FREE(results);
     return EXIT_FAILURE;
 }
 
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2021, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_sys.h"
+#include "util/command-info.h"
+
+/*
+ * Every TPM2_CC_* command code of tss2_tpm2_types.h, generated from the
+ * header at build time.
+ */
+#define COMMAND_CODE(cc) { TPM2_CC_##cc, #cc },
+static const struct {
+    TPM2_CC commandCode;
+    const char *name;
+} command_codes[] = {
+#include "command-codes.h"
+};
+#define NUM_COMMAND_CODES (sizeof (command_codes) / sizeof (command_codes[0]))
+
+/*
+ * Every command code in the direct-indexed range either maps to its own
+ * entry or to NULL for gaps in the specification.
+ */
+static void
+command_info_range (void **state)
+{
+    const COMMAND_INFO *info;
+    TPM2_CC cc;
+    size_t known = 0;
+
+    for (cc = TPM2_CC_FIRST; cc <= TPM2_CC_LAST; cc++) {
+        info = get_command_info (cc);
+        if (info != NULL) {
+            assert_int_equal (info->commandCode, cc);
+            known++;
+        }
+    }
+    /* All but the vendor command are in the direct-indexed range */
+    assert_int_equal (known, NUM_COMMAND_CODES - 1);
+}
+/*
+ * The table has an entry for every command code of the header, so new
+ * command codes cannot be added without their metadata.
+ */
+static void
+command_info_codes (void **state)
+{
+    const COMMAND_INFO *info;
+    size_t i;
+
+    assert_true (NUM_COMMAND_CODES >= 118);
+    for (i = 0; i < NUM_COMMAND_CODES; i++) {
+        info = get_command_info (command_codes[i].commandCode);
+        if (info == NULL) {
+            fail_msg ("No command info for TPM2_CC_%s", command_codes[i].name);
+        }
+        assert_int_equal (info->commandCode, command_codes[i].commandCode);
+    }
+}
+
+static void
+command_info_values (void **state)
+{
+    const COMMAND_INFO *info;
+
+    info = get_command_info (TPM2_CC_StartAuthSession);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 2);
+    assert_int_equal (info->numResponseHandles, 1);
+
+    info = get_command_info (TPM2_CC_NV_Certify);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 3);
+    assert_int_equal (info->numResponseHandles, 0);
+
+    info = get_command_info (TPM2_CC_CreatePrimary);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 1);
+    assert_int_equal (info->numResponseHandles, 1);
+
+    info = get_command_info (TPM2_CC_Startup);
+    assert_non_null (info);
+    assert_int_equal (info->numCommandHandles, 0);
+    assert_int_equal (info->numResponseHandles, 0);
+}
+
+static void
+command_info_unknown (void **state)
+{
+    const COMMAND_INFO *info;
+
+    info = get_command_info (TPM2_CC_Vendor_TCG_Test);
+    assert_non_null (info);
+    assert_int_equal (info->commandCode, TPM2_CC_Vendor_TCG_Test);
+
+    /* Gap between TPM2_CC_NV_UndefineSpace and TPM2_CC_ChangeEPS */
+    assert_null (get_command_info (0x123));
+    assert_null (get_command_info (0));
+    assert_null (get_command_info (TPM2_CC_FIRST - 1));
+    assert_null (get_command_info (TPM2_CC_LAST + 1));
+    assert_null (get_command_info (TPM2_CC_Vendor_TCG_Test + 1));
+}
+
+int
+main (int argc, char* arvg[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (command_info_range),
+        cmocka_unit_test (command_info_codes),
+        cmocka_unit_test (command_info_values),
+        cmocka_unit_test (command_info_unknown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
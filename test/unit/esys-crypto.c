@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -138,6 +139,133 @@ check_hmac_functions(void **state)
     iesys_crypto_hash_abort(&context);
 }
 
+/* HMAC test vectors from RFC 4231 test case 2 and RFC 2202 test case 2 */
+static const uint8_t hmac_sha256_jefe[] = {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26,
+    0x08, 0x95, 0x75, 0xc7, 0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+    0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+};
+static const uint8_t hmac_sha1_jefe[] = {
+    0xef, 0xfc, 0xdf, 0x6a, 0xe5, 0xeb, 0x2f, 0xa2, 0xd2, 0x74, 0x16, 0xd5,
+    0xf1, 0x84, 0xdf, 0x9c, 0x25, 0x9a, 0x7c, 0x79
+};
+/* HMAC-SHA256 with an empty key and empty message */
+static const uint8_t hmac_sha256_empty[] = {
+    0xb6, 0x13, 0x67, 0x9a, 0x08, 0x14, 0xd9, 0xec, 0x77, 0x2f, 0x95, 0xd7,
+    0x78, 0xc3, 0x5f, 0xc5, 0xff, 0x16, 0x97, 0xc4, 0x93, 0x71, 0x56, 0x53,
+    0xc6, 0xc7, 0x12, 0x14, 0x42, 0x92, 0xc5, 0xad
+};
+/* SHA256 and SHA1 of "abc" */
+static const uint8_t sha256_abc[] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde,
+    0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+static const uint8_t sha1_abc[] = {
+    0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e, 0x25, 0x71,
+    0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d
+};
+
+static void
+check_hmac(TPM2_ALG_ID alg, const char *key, const char *data,
+           const uint8_t *expected, size_t expected_size)
+{
+    TSS2_RC rc;
+    IESYS_CRYPTO_CONTEXT_BLOB *context;
+    uint8_t buffer[TPM2_SHA512_DIGEST_SIZE];
+    size_t size = sizeof(buffer);
+
+    rc = iesys_crypto_hmac_start(&context, alg, (const uint8_t *)key, strlen(key));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = iesys_crypto_hmac_update(context, (const uint8_t *)data, strlen(data));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = iesys_crypto_hmac_finish(&context, &buffer[0], &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, expected_size);
+    assert_memory_equal (&buffer[0], expected, expected_size);
+}
+
+static void
+check_hash(TPM2_ALG_ID alg, const char *data,
+           const uint8_t *expected, size_t expected_size)
+{
+    TSS2_RC rc;
+    IESYS_CRYPTO_CONTEXT_BLOB *context;
+    uint8_t buffer[TPM2_SHA512_DIGEST_SIZE];
+    size_t size = sizeof(buffer);
+
+    rc = iesys_crypto_hash_start(&context, alg);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = iesys_crypto_hash_update(context, (const uint8_t *)data, strlen(data));
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = iesys_crypto_hash_finish(&context, &buffer[0], &size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, expected_size);
+    assert_memory_equal (&buffer[0], expected, expected_size);
+}
+
+/*
+ * Contexts of finished or aborted computations are reused by the OpenSSL
+ * backend; results must not depend on the previous use of a context.
+ */
+static void
+check_context_reuse(void **state)
+{
+    TSS2_RC rc;
+    IESYS_CRYPTO_CONTEXT_BLOB *context;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        check_hash(TPM2_ALG_SHA256, "abc", &sha256_abc[0], sizeof(sha256_abc));
+        check_hash(TPM2_ALG_SHA1, "abc", &sha1_abc[0], sizeof(sha1_abc));
+        check_hmac(TPM2_ALG_SHA256, "Jefe", "what do ya want for nothing?",
+                   &hmac_sha256_jefe[0], sizeof(hmac_sha256_jefe));
+        check_hmac(TPM2_ALG_SHA256, "", "",
+                   &hmac_sha256_empty[0], sizeof(hmac_sha256_empty));
+        check_hmac(TPM2_ALG_SHA1, "Jefe", "what do ya want for nothing?",
+                   &hmac_sha1_jefe[0], sizeof(hmac_sha1_jefe));
+
+        /* Aborted computations do not influence later ones. */
+        rc = iesys_crypto_hmac_start(&context, TPM2_ALG_SHA256,
+                                     (const uint8_t *)"key", 3);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        rc = iesys_crypto_hmac_update(context, (const uint8_t *)"data", 4);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        iesys_crypto_hmac_abort(&context);
+        rc = iesys_crypto_hash_start(&context, TPM2_ALG_SHA256);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        rc = iesys_crypto_hash_update(context, (const uint8_t *)"data", 4);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        iesys_crypto_hash_abort(&context);
+    }
+}
+
+static void *
+context_reuse_thread(void *arg)
+{
+    check_context_reuse(arg);
+    return NULL;
+}
+
+/*
+ * Every thread has its own pool of contexts, which is released when the
+ * thread exits.
+ */
+static void
+check_context_reuse_threads(void **state)
+{
+    pthread_t threads[2];
+    size_t i;
+
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        assert_int_equal(pthread_create(&threads[i], NULL,
+                                        context_reuse_thread, state), 0);
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        assert_int_equal(pthread_join(threads[i], NULL), 0);
+
+    check_context_reuse(state);
+}
+
 static void
 check_random(void **state)
 {
@@ -281,6 +409,8 @@ main(int argc, char *argv[])
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(check_hash_functions),
         cmocka_unit_test(check_hmac_functions),
+        cmocka_unit_test(check_context_reuse),
+        cmocka_unit_test(check_context_reuse_threads),
         cmocka_unit_test(check_random),
         cmocka_unit_test(check_pk_encrypt),
         cmocka_unit_test(check_aes_encrypt),
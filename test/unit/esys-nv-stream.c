@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Tests the streaming NV functions. The fake TCTI emulates the NV memory of
+ * one NV index for TPM2_NV_Read and TPM2_NV_Write and reports
+ * TPM2_PT_NV_BUFFER_MAX with TPM2_GetCapability.
+ */
+
+#define NV_SIZE 600
+#define NV_BUFFER_MAX 100
+#define NV_INDEX 0x01000001
+
+static uint8_t nv_memory[NV_SIZE];
+static UINT32 nv_buffer_max;
+static TPM2_CC last_cc;
+static TPM2_RC last_rc;
+static UINT16 last_size;
+static UINT16 last_offset;
+static size_t cap_count;
+static size_t read_count;
+static size_t write_count;
+static size_t fail_at;
+
+static TSS2_RC
+tcti_fake_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t size, const uint8_t * buffer)
+{
+    size_t offset = 6;
+    UINT32 auth_size;
+    TPM2B_MAX_NV_BUFFER data;
+
+    UNUSED(tctiContext);
+    assert_int_equal(Tss2_MU_TPM2_CC_Unmarshal(buffer, size, &offset, &last_cc),
+                     TSS2_RC_SUCCESS);
+    last_rc = TPM2_RC_SUCCESS;
+    if (last_cc == TPM2_CC_GetCapability) {
+        cap_count++;
+        return TSS2_RC_SUCCESS;
+    }
+    assert_true(last_cc == TPM2_CC_NV_Read || last_cc == TPM2_CC_NV_Write);
+
+    /* Skip the handles and the authorization area */
+    offset += 2 * sizeof(TPM2_HANDLE);
+    assert_int_equal(Tss2_MU_UINT32_Unmarshal(buffer, size, &offset, &auth_size),
+                     TSS2_RC_SUCCESS);
+    offset += auth_size;
+
+    if (last_cc == TPM2_CC_NV_Read) {
+        read_count++;
+        assert_int_equal(Tss2_MU_UINT16_Unmarshal(buffer, size, &offset,
+                                                  &last_size),
+                         TSS2_RC_SUCCESS);
+    } else {
+        write_count++;
+        assert_int_equal(Tss2_MU_TPM2B_MAX_NV_BUFFER_Unmarshal(buffer, size,
+                                                               &offset, &data),
+                         TSS2_RC_SUCCESS);
+        last_size = data.size;
+    }
+    assert_int_equal(Tss2_MU_UINT16_Unmarshal(buffer, size, &offset,
+                                              &last_offset),
+                     TSS2_RC_SUCCESS);
+
+    assert_true(last_size <= nv_buffer_max);
+    if (fail_at && read_count + write_count == fail_at)
+        last_rc = TPM2_RC_NV_LOCKED;
+    else if (last_offset + last_size > NV_SIZE)
+        last_rc = TPM2_RC_NV_RANGE;
+    else if (last_cc == TPM2_CC_NV_Write)
+        memcpy(&nv_memory[last_offset], &data.buffer[0], data.size);
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_fake_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    uint8_t buffer[1024];
+    size_t offset = 10;
+    TPM2_ST tag = TPM2_ST_SESSIONS;
+
+    UNUSED(tctiContext);
+    UNUSED(timeout);
+
+    if (last_rc != TPM2_RC_SUCCESS) {
+        /* Error responses have no parameters */
+        tag = TPM2_ST_NO_SESSIONS;
+    } else if (last_cc == TPM2_CC_GetCapability) {
+        tag = TPM2_ST_NO_SESSIONS;
+        Tss2_MU_BYTE_Marshal(TPM2_NO, buffer, sizeof(buffer), &offset);
+        Tss2_MU_UINT32_Marshal(TPM2_CAP_TPM_PROPERTIES, buffer, sizeof(buffer),
+                               &offset);
+        if (nv_buffer_max == NV_BUFFER_MAX) {
+            Tss2_MU_UINT32_Marshal(1, buffer, sizeof(buffer), &offset);
+            Tss2_MU_UINT32_Marshal(TPM2_PT_NV_BUFFER_MAX, buffer,
+                                   sizeof(buffer), &offset);
+            Tss2_MU_UINT32_Marshal(nv_buffer_max, buffer, sizeof(buffer),
+                                   &offset);
+        } else {
+            /* The TPM does not report the property */
+            Tss2_MU_UINT32_Marshal(0, buffer, sizeof(buffer), &offset);
+        }
+    } else {
+        /* Parameter size, parameters and a password session response */
+        UINT32 param_size = (last_cc == TPM2_CC_NV_Read) ? 2 + last_size : 0;
+
+        Tss2_MU_UINT32_Marshal(param_size, buffer, sizeof(buffer), &offset);
+        if (last_cc == TPM2_CC_NV_Read) {
+            Tss2_MU_UINT16_Marshal(last_size, buffer, sizeof(buffer), &offset);
+            memcpy(&buffer[offset], &nv_memory[last_offset], last_size);
+            offset += last_size;
+        }
+        Tss2_MU_UINT16_Marshal(0, buffer, sizeof(buffer), &offset);
+        Tss2_MU_BYTE_Marshal(TPMA_SESSION_CONTINUESESSION, buffer,
+                             sizeof(buffer), &offset);
+        Tss2_MU_UINT16_Marshal(0, buffer, sizeof(buffer), &offset);
+    }
+
+    if (response_buffer == NULL) {
+        *response_size = offset;
+        return TSS2_RC_SUCCESS;
+    }
+    assert_true(*response_size >= offset);
+
+    *response_size = offset;
+    offset = 0;
+    Tss2_MU_TPM2_ST_Marshal(tag, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(*response_size, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(last_rc, buffer, sizeof(buffer), &offset);
+    memcpy(response_buffer, buffer, *response_size);
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+
+    /* This is a fake tcti context */
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti =
+        calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_fake_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_fake_receive;
+
+    r = Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < NV_SIZE; i++)
+        nv_memory[i] = i & 0xff;
+    nv_buffer_max = NV_BUFFER_MAX;
+    cap_count = read_count = write_count = fail_at = 0;
+    *state = (void *)esys_context;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return 0;
+}
+
+/* Create the ESYS_TR object of the NV index, as Esys_TR_FromTPMPublic would do. */
+static ESYS_TR
+create_nv_index(ESYS_CONTEXT *esys_context)
+{
+    RSRC_NODE_T *node;
+    ESYS_TR nv_index = esys_context->esys_handle_cnt++;
+
+    assert_int_equal(esys_CreateResourceObject(esys_context, nv_index, &node),
+                     TSS2_RC_SUCCESS);
+    node->rsrc.handle = NV_INDEX;
+    node->rsrc.rsrcType = IESYSC_NV_RSRC;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.nvIndex = NV_INDEX;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.nameAlg = TPM2_ALG_SHA256;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.attributes =
+        TPMA_NV_OWNERWRITE | TPMA_NV_OWNERREAD;
+    node->rsrc.misc.rsrc_nv_pub.nvPublic.dataSize = NV_SIZE;
+    assert_int_equal(iesys_nv_get_name(&node->rsrc.misc.rsrc_nv_pub,
+                                       &node->rsrc.name),
+                     TSS2_RC_SUCCESS);
+    return nv_index;
+}
+
+static void
+test_read_stream(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR nv_index = create_nv_index(esys_context);
+    uint8_t *data = NULL;
+
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 250, 10, &data),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cap_count, 1);
+    assert_int_equal(read_count, 3);
+    assert_int_equal(last_size, 50);
+    assert_int_equal(last_offset, 210);
+    assert_memory_equal(data, &nv_memory[10], 250);
+    Esys_Free(data);
+
+    /* The NV buffer size is only read once */
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, NV_SIZE, 0, &data),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cap_count, 1);
+    assert_int_equal(read_count, 9);
+    assert_memory_equal(data, &nv_memory[0], NV_SIZE);
+    Esys_Free(data);
+}
+
+static void
+test_write_stream(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR nv_index = create_nv_index(esys_context);
+    uint8_t data[250];
+
+    memset(data, 0x55, sizeof(data));
+    assert_int_equal(Esys_NV_WriteStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                         ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                         ESYS_TR_NONE, data, sizeof(data), 5),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cap_count, 1);
+    assert_int_equal(write_count, 3);
+    assert_int_equal(last_offset, 205);
+    assert_memory_equal(&nv_memory[5], data, sizeof(data));
+    assert_int_equal(nv_memory[4], 4);
+    assert_int_equal(nv_memory[255], 255);
+}
+
+static void
+test_no_buffer_max(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR nv_index = create_nv_index(esys_context);
+    uint8_t *data = NULL;
+
+    /* Without TPM2_PT_NV_BUFFER_MAX the size every TPM supports is used */
+    nv_buffer_max = 64;
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 130, 0, &data),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(read_count, 3);
+    assert_int_equal(last_size, 2);
+    assert_memory_equal(data, &nv_memory[0], 130);
+    Esys_Free(data);
+}
+
+static void
+test_set_buffer_max(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR nv_index = create_nv_index(esys_context);
+    uint8_t *data = NULL;
+
+    /* A known NV buffer size is not read from the TPM */
+    nv_buffer_max = 200;
+    assert_int_equal(Esys_SetNvBufferMax(esys_context, 200), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 250, 0, &data),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cap_count, 0);
+    assert_int_equal(read_count, 2);
+    assert_int_equal(last_size, 50);
+    assert_memory_equal(data, &nv_memory[0], 250);
+    Esys_Free(data);
+
+    /* After a reset the size is read again */
+    nv_buffer_max = NV_BUFFER_MAX;
+    assert_int_equal(Esys_SetNvBufferMax(esys_context, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 250, 0, &data),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cap_count, 1);
+    assert_int_equal(read_count, 5);
+    Esys_Free(data);
+}
+
+static void
+test_errors(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR nv_index = create_nv_index(esys_context);
+    uint8_t *data = NULL;
+    uint8_t buffer[200] = { 0 };
+
+    assert_int_equal(Esys_NV_ReadStream_Finish(esys_context, &data),
+                     TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 0, 0, &data),
+                     TSS2_ESYS_RC_BAD_VALUE);
+    assert_int_equal(Esys_NV_WriteStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                         ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                         ESYS_TR_NONE, buffer, sizeof(buffer),
+                                         UINT16_MAX),
+                     TSS2_ESYS_RC_BAD_VALUE);
+
+    /* A failing chunk ends the stream */
+    fail_at = 2;
+    assert_int_equal(Esys_NV_WriteStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                         ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                         ESYS_TR_NONE, buffer, sizeof(buffer), 0),
+                     TPM2_RC_NV_LOCKED);
+    assert_int_equal(write_count, 2);
+    assert_int_equal(Esys_NV_WriteStream_Finish(esys_context),
+                     TSS2_ESYS_RC_BAD_SEQUENCE);
+
+    /* A new stream can be started afterwards */
+    fail_at = 0;
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 100, 500, &data),
+                     TSS2_RC_SUCCESS);
+    assert_memory_equal(data, &nv_memory[500], 100);
+    Esys_Free(data);
+    assert_int_equal(Esys_NV_ReadStream(esys_context, ESYS_TR_RH_OWNER, nv_index,
+                                        ESYS_TR_PASSWORD, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, 101, 500, &data),
+                     TPM2_RC_NV_RANGE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_read_stream,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_write_stream,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_no_buffer_max,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_set_buffer_max,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_errors,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,376 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Tests the swapping of transient objects by the ESYS_CONTEXT. The fake TCTI
+ * emulates the transient object slots of a TPM for the commands
+ * TPM2_ContextSave, TPM2_ContextLoad and TPM2_FlushContext.
+ */
+
+#define TPM_SLOTS 3
+
+static TPM2_CC last_cc;
+static TPM2_HANDLE last_handle;
+static TPM2_RC last_rc;
+static TPM2_HANDLE loaded_handle;
+static TPM2_HANDLE next_handle;
+static TPM2_HANDLE loaded[TPM_SLOTS];
+static size_t loaded_count;
+static size_t flush_count;
+static size_t save_count;
+static size_t load_count;
+
+static bool
+tpm_is_loaded(TPM2_HANDLE handle)
+{
+    for (size_t i = 0; i < loaded_count; i++) {
+        if (loaded[i] == handle)
+            return true;
+    }
+    return false;
+}
+
+static TPM2_RC
+tpm_load(TPM2_HANDLE *handle)
+{
+    if (loaded_count == TPM_SLOTS)
+        return TPM2_RC_OBJECT_MEMORY;
+    *handle = next_handle++;
+    loaded[loaded_count++] = *handle;
+    return TPM2_RC_SUCCESS;
+}
+
+static TPM2_RC
+tpm_flush(TPM2_HANDLE handle)
+{
+    for (size_t i = 0; i < loaded_count; i++) {
+        if (loaded[i] == handle) {
+            loaded[i] = loaded[--loaded_count];
+            return TPM2_RC_SUCCESS;
+        }
+    }
+    return TPM2_RC_HANDLE;
+}
+
+static TSS2_RC
+tcti_fake_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t size, const uint8_t * buffer)
+{
+    size_t offset = 6;
+
+    UNUSED(tctiContext);
+    assert_int_equal(Tss2_MU_TPM2_CC_Unmarshal(buffer, size, &offset, &last_cc),
+                     TSS2_RC_SUCCESS);
+    if (last_cc != TPM2_CC_ContextLoad)
+        assert_int_equal(Tss2_MU_TPM2_HANDLE_Unmarshal(buffer, size, &offset,
+                                                       &last_handle),
+                         TSS2_RC_SUCCESS);
+    last_rc = TPM2_RC_SUCCESS;
+    if (last_cc == TPM2_CC_FlushContext) {
+        flush_count++;
+        last_rc = tpm_flush(last_handle);
+    } else if (last_cc == TPM2_CC_ContextSave) {
+        save_count++;
+        if (!tpm_is_loaded(last_handle))
+            last_rc = TPM2_RC_HANDLE;
+    } else if (last_cc == TPM2_CC_ContextLoad) {
+        load_count++;
+        last_rc = tpm_load(&loaded_handle);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_fake_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    uint8_t buffer[256];
+    size_t offset = 10;
+    UINT16 blob_size = 16;
+
+    UNUSED(tctiContext);
+    UNUSED(timeout);
+
+    if (last_rc != TPM2_RC_SUCCESS) {
+        /* Error responses have no parameters */
+    } else if (last_cc == TPM2_CC_ContextSave) {
+        Tss2_MU_UINT64_Marshal(1, buffer, sizeof(buffer), &offset);
+        Tss2_MU_TPM2_HANDLE_Marshal(TPM2_TRANSIENT_FIRST, buffer,
+                                    sizeof(buffer), &offset);
+        Tss2_MU_TPM2_HANDLE_Marshal(TPM2_RH_OWNER, buffer, sizeof(buffer),
+                                    &offset);
+        Tss2_MU_UINT16_Marshal(blob_size, buffer, sizeof(buffer), &offset);
+        memset(&buffer[offset], 0xaa, blob_size);
+        offset += blob_size;
+    } else if (last_cc == TPM2_CC_ContextLoad) {
+        Tss2_MU_TPM2_HANDLE_Marshal(loaded_handle, buffer, sizeof(buffer),
+                                    &offset);
+    }
+
+    if (response_buffer == NULL) {
+        *response_size = offset;
+        return TSS2_RC_SUCCESS;
+    }
+    assert_true(*response_size >= offset);
+
+    *response_size = offset;
+    offset = 0;
+    Tss2_MU_TPM2_ST_Marshal(TPM2_ST_NO_SESSIONS, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(*response_size, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(last_rc, buffer, sizeof(buffer), &offset);
+    memcpy(response_buffer, buffer, *response_size);
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+
+    /* This is a fake tcti context */
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti =
+        calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_fake_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_fake_receive;
+
+    r = Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    next_handle = TPM2_TRANSIENT_FIRST;
+    loaded_count = flush_count = save_count = load_count = 0;
+    *state = (void *)esys_context;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return 0;
+}
+
+/* Create the ESYS_TR object of a key, as Esys_Load would do. */
+static ESYS_TR
+create_object(ESYS_CONTEXT *esys_context)
+{
+    RSRC_NODE_T *node;
+    ESYS_TR object = esys_context->esys_handle_cnt++;
+
+    assert_int_equal(iesys_check_sequence_async(esys_context), TSS2_RC_SUCCESS);
+    assert_int_equal(esys_CreateResourceObject(esys_context, object, &node),
+                     TSS2_RC_SUCCESS);
+    node->rsrc.rsrcType = IESYSC_KEY_RSRC;
+    node->rsrc.misc.rsrc_key_pub.publicArea.type = TPM2_ALG_KEYEDHASH;
+    node->rsrc.misc.rsrc_key_pub.publicArea.nameAlg = TPM2_ALG_SHA256;
+    node->rsrc.misc.rsrc_key_pub.publicArea.parameters.keyedHashDetail.scheme.scheme =
+        TPM2_ALG_NULL;
+    assert_int_equal(tpm_load(&node->rsrc.handle), TPM2_RC_SUCCESS);
+    node->last_use = esys_context->resident_clock;
+    return object;
+}
+
+static RSRC_NODE_T *
+get_node(ESYS_CONTEXT *esys_context, ESYS_TR object)
+{
+    RSRC_NODE_T *node;
+
+    assert_int_equal(esys_GetResourceObject(esys_context, object, &node),
+                     TSS2_RC_SUCCESS);
+    return node;
+}
+
+/* Use an object in a command which needs the object to be loaded. */
+static void
+use_object(ESYS_CONTEXT *esys_context, ESYS_TR object)
+{
+    TPMS_CONTEXT *context = NULL;
+
+    assert_int_equal(Esys_ContextSave(esys_context, object, &context),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(last_handle, get_node(esys_context, object)->rsrc.handle);
+    Esys_Free(context);
+}
+
+static void
+test_disabled(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR o[TPM_SLOTS];
+
+    for (size_t i = 0; i < TPM_SLOTS; i++)
+        o[i] = create_object(esys_context);
+    for (size_t i = 0; i < TPM_SLOTS; i++)
+        use_object(esys_context, o[i]);
+
+    assert_int_equal(save_count, TPM_SLOTS);
+    assert_int_equal(flush_count, 0);
+    assert_int_equal(load_count, 0);
+}
+
+static void
+test_swap_lru(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR o[TPM_SLOTS + 2];
+    TPM2_HANDLE handle;
+    TPM2B_NAME *name;
+    RSRC_NODE_T *node;
+
+    assert_int_equal(Esys_SetResidentObjectLimit(esys_context, TPM_SLOTS),
+                     TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < TPM_SLOTS; i++) {
+        o[i] = create_object(esys_context);
+        use_object(esys_context, o[i]);
+    }
+    /* A slot is freed for the next command by swapping out the LRU object */
+    assert_non_null(get_node(esys_context, o[0])->swap_context);
+    assert_int_equal(loaded_count, TPM_SLOTS - 1);
+    assert_int_equal(flush_count, 1);
+
+    /* Objects are loaded (with a new TPM handle) when a command uses them */
+    handle = get_node(esys_context, o[0])->rsrc.handle;
+    use_object(esys_context, o[0]);
+    assert_null(get_node(esys_context, o[0])->swap_context);
+    assert_int_not_equal(get_node(esys_context, o[0])->rsrc.handle, handle);
+    assert_int_equal(load_count, 1);
+
+    /* More objects than TPM slots can be used */
+    o[TPM_SLOTS] = create_object(esys_context);
+    use_object(esys_context, o[TPM_SLOTS]);
+    o[TPM_SLOTS + 1] = create_object(esys_context);
+    for (size_t j = 0; j < 2; j++) {
+        for (size_t i = 0; i < TPM_SLOTS + 2; i++) {
+            use_object(esys_context, o[i]);
+            assert_true(loaded_count <= TPM_SLOTS);
+        }
+    }
+
+    /* Querying the metadata does not load the object */
+    load_count = 0;
+    assert_non_null(get_node(esys_context, o[1])->swap_context);
+    assert_int_equal(Esys_TR_GetName(esys_context, o[1], &name), TSS2_RC_SUCCESS);
+    Esys_Free(name);
+    assert_int_equal(load_count, 0);
+
+    /* Swapped out objects are loaded to be flushed, but not to be closed */
+    assert_int_equal(Esys_FlushContext(esys_context, o[1]), TSS2_RC_SUCCESS);
+    assert_int_equal(load_count, 1);
+    assert_int_equal(esys_GetResourceObject(esys_context, o[1], &node),
+                     TSS2_ESYS_RC_BAD_TR);
+    assert_non_null(get_node(esys_context, o[2])->swap_context);
+    assert_int_equal(Esys_TR_Close(esys_context, &o[2]), TSS2_RC_SUCCESS);
+    assert_int_equal(load_count, 1);
+}
+
+static void
+test_limit_reset(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR o[TPM_SLOTS];
+
+    assert_int_equal(Esys_SetResidentObjectLimit(esys_context, TPM_SLOTS),
+                     TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < TPM_SLOTS; i++)
+        o[i] = create_object(esys_context);
+    use_object(esys_context, o[1]);
+    assert_int_equal(flush_count, 1);
+    assert_non_null(get_node(esys_context, o[0])->swap_context);
+
+    /* Without limit swapped out objects are still loaded, but none swapped out */
+    assert_int_equal(Esys_SetResidentObjectLimit(esys_context, 0),
+                     TSS2_RC_SUCCESS);
+    use_object(esys_context, o[0]);
+    assert_int_equal(load_count, 1);
+    assert_int_equal(flush_count, 1);
+    assert_int_equal(loaded_count, TPM_SLOTS);
+}
+
+static void
+test_get_tpm_handle(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR o[TPM_SLOTS];
+    TPMS_CONTEXT *context = NULL;
+    TPM2_HANDLE handle;
+
+    assert_int_equal(Esys_SetResidentObjectLimit(esys_context, TPM_SLOTS),
+                     TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < TPM_SLOTS; i++)
+        o[i] = create_object(esys_context);
+    use_object(esys_context, o[1]);
+    assert_non_null(get_node(esys_context, o[0])->swap_context);
+
+    /* The handle of a swapped out object cannot be used while a command is
+       in progress */
+    assert_int_equal(Esys_ContextSave_Async(esys_context, o[1]),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_TR_GetTpmHandle(esys_context, o[0], &handle),
+                     TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_int_equal(Esys_ContextSave_Finish(esys_context, &context),
+                     TSS2_RC_SUCCESS);
+    Esys_Free(context);
+    assert_int_equal(load_count, 0);
+
+    /* Otherwise the object is loaded to return a valid handle */
+    assert_int_equal(Esys_TR_GetTpmHandle(esys_context, o[0], &handle),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(load_count, 1);
+    assert_null(get_node(esys_context, o[0])->swap_context);
+    assert_int_equal(handle, get_node(esys_context, o[0])->rsrc.handle);
+    assert_true(loaded_count <= TPM_SLOTS);
+    assert_int_equal(esys_context->resident.count, loaded_count);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_disabled,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_swap_lru,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_limit_reset,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_get_tpm_handle,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,353 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Tests the bulk random functions. The fake TCTI answers TPM2_GetRandom with
+ * the octets of a known stream and returns at most TPM_DIGEST_MAX octets per
+ * command, like a TPM with SHA384 as largest digest.
+ */
+
+#define TPM_DIGEST_MAX 48
+
+/* HMAC_DRBG SHA-256 test vector of NIST CAVP (no reseed, COUNT = 0) */
+static const uint8_t drbg_entropy_nonce[] = {
+    0xca, 0x85, 0x19, 0x11, 0x34, 0x93, 0x84, 0xbf, 0xfe, 0x89, 0xde, 0x1c,
+    0xbd, 0xc4, 0x6e, 0x68, 0x31, 0xe4, 0x4d, 0x34, 0xa4, 0xfb, 0x93, 0x5e,
+    0xe2, 0x85, 0xdd, 0x14, 0xb7, 0x1a, 0x74, 0x88, 0x65, 0x9b, 0xa9, 0x6c,
+    0x60, 0x1d, 0xc6, 0x9f, 0xc9, 0x02, 0x94, 0x08, 0x05, 0xec, 0x0c, 0xa8
+};
+
+static const uint8_t drbg_returned_bits[] = {
+    0xe5, 0x28, 0xe9, 0xab, 0xf2, 0xde, 0xce, 0x54, 0xd4, 0x7c, 0x7e, 0x75,
+    0xe5, 0xfe, 0x30, 0x21, 0x49, 0xf8, 0x17, 0xea, 0x9f, 0xb4, 0xbe, 0xe6,
+    0xf4, 0x19, 0x96, 0x97, 0xd0, 0x4d, 0x5b, 0x89, 0xd5, 0x4f, 0xbb, 0x97,
+    0x8a, 0x15, 0xb5, 0xc4, 0x43, 0xc9, 0xec, 0x21, 0x03, 0x6d, 0x24, 0x60,
+    0xb6, 0xf7, 0x3e, 0xba, 0xd0, 0xdc, 0x2a, 0xba, 0x6e, 0x62, 0x4a, 0xbf,
+    0x07, 0x74, 0x5b, 0xc1, 0x07, 0x69, 0x4b, 0xb7, 0x54, 0x7b, 0xb0, 0x99,
+    0x5f, 0x70, 0xde, 0x25, 0xd6, 0xb2, 0x9e, 0x2d, 0x30, 0x11, 0xbb, 0x19,
+    0xd2, 0x76, 0x76, 0xc0, 0x71, 0x62, 0xc8, 0xb5, 0xcc, 0xde, 0x06, 0x68,
+    0x96, 0x1d, 0xf8, 0x68, 0x03, 0x48, 0x2c, 0xb3, 0x7e, 0xd6, 0xd5, 0xc0,
+    0xbb, 0x8d, 0x50, 0xcf, 0x1f, 0x50, 0xd4, 0x76, 0xaa, 0x04, 0x58, 0xbd,
+    0xab, 0xa8, 0x06, 0xf4, 0x8b, 0xe9, 0xdc, 0xb8
+};
+
+static const uint8_t *tpm_stream;
+static size_t tpm_stream_idx;
+static UINT16 last_requested;
+static UINT16 max_requested;
+static size_t random_count;
+
+/* The random octets of the fake TPM, a counter if no stream is set */
+static uint8_t
+tpm_random_octet(void)
+{
+    size_t idx = tpm_stream_idx++;
+
+    return tpm_stream ? tpm_stream[idx] : idx & 0xff;
+}
+
+static TSS2_RC
+tcti_fake_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t size, const uint8_t * buffer)
+{
+    size_t offset = 6;
+    TPM2_CC cc;
+
+    UNUSED(tctiContext);
+    assert_int_equal(Tss2_MU_TPM2_CC_Unmarshal(buffer, size, &offset, &cc),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cc, TPM2_CC_GetRandom);
+    assert_int_equal(Tss2_MU_UINT16_Unmarshal(buffer, size, &offset,
+                                              &last_requested),
+                     TSS2_RC_SUCCESS);
+    if (last_requested > max_requested)
+        max_requested = last_requested;
+    if (last_requested > TPM_DIGEST_MAX)
+        last_requested = TPM_DIGEST_MAX;
+    random_count++;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_fake_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    uint8_t buffer[128];
+    size_t offset = 10;
+
+    UNUSED(tctiContext);
+    UNUSED(timeout);
+
+    Tss2_MU_UINT16_Marshal(last_requested, buffer, sizeof(buffer), &offset);
+    offset += last_requested;
+
+    if (response_buffer == NULL) {
+        *response_size = offset;
+        return TSS2_RC_SUCCESS;
+    }
+    assert_true(*response_size >= offset);
+
+    for (size_t i = 0; i < last_requested; i++)
+        buffer[12 + i] = tpm_random_octet();
+
+    *response_size = offset;
+    offset = 0;
+    Tss2_MU_TPM2_ST_Marshal(TPM2_ST_NO_SESSIONS, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(*response_size, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(TPM2_RC_SUCCESS, buffer, sizeof(buffer), &offset);
+    memcpy(response_buffer, buffer, *response_size);
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+
+    /* This is a fake tcti context */
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti =
+        calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_fake_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_fake_receive;
+
+    r = Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    tpm_stream = NULL;
+    tpm_stream_idx = 0;
+    max_requested = 0;
+    random_count = 0;
+    *state = (void *)esys_context;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return 0;
+}
+
+static void
+test_bulk(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    uint8_t buffer[1000];
+
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+
+    /* The TPM returns less octets than requested */
+    assert_int_equal(random_count, (sizeof(buffer) + TPM_DIGEST_MAX - 1) /
+                     TPM_DIGEST_MAX);
+    assert_int_equal(max_requested, sizeof(TPMU_HA));
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        assert_int_equal(buffer[i], i & 0xff);
+
+    /* Bulk requests do not interfere with other commands */
+    assert_int_equal(Esys_GetRandomBulk_Finish(esys_context),
+                     TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        NULL, sizeof(buffer)),
+                     TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+static void
+test_pool_known_answer(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    uint8_t buffer[sizeof(drbg_returned_bits)];
+
+    tpm_stream = drbg_entropy_nonce;
+    assert_int_equal(Esys_SetRandomPool(esys_context, 4096), TSS2_RC_SUCCESS);
+
+    /* The first request seeds the pool with entropy input and nonce */
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(tpm_stream_idx, sizeof(drbg_entropy_nonce));
+    assert_int_equal(random_count, 1);
+
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 1);
+    assert_memory_equal(buffer, drbg_returned_bits, sizeof(buffer));
+}
+
+static void
+test_pool_reseed(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    uint8_t buffer[1000];
+    uint8_t buffer2[1000];
+
+    assert_int_equal(Esys_SetRandomPool(esys_context, 2 * sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 1);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer2, sizeof(buffer2)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 1);
+    assert_true(memcmp(buffer, buffer2, sizeof(buffer)) != 0);
+
+    /* The pool is reseeded after the reseed interval */
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 2);
+    assert_int_equal(tpm_stream_idx, 2 * _ESYS_RANDOM_SEED_SIZE);
+
+    /* Without pool the TPM is used directly */
+    assert_int_equal(Esys_SetRandomPool(esys_context, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, TPM_DIGEST_MAX),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 3);
+    assert_int_equal(buffer[0], (2 * _ESYS_RANDOM_SEED_SIZE) & 0xff);
+}
+
+static void
+test_pool_reseed_split(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    uint8_t buffer[2500];
+
+    assert_int_equal(Esys_SetRandomPool(esys_context, 1000), TSS2_RC_SUCCESS);
+
+    /* A request larger than the reseed interval reseeds in between */
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 3);
+    assert_int_equal(tpm_stream_idx, 3 * _ESYS_RANDOM_SEED_SIZE);
+    assert_int_equal(esys_context->random.generated, 500);
+
+    /* A request crossing the boundary is split at the boundary */
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, 600),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 4);
+    assert_int_equal(esys_context->random.generated, 100);
+
+    /* A request of the reseed interval does not reseed at its end */
+    assert_int_equal(Esys_SetRandomPool(esys_context, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SetRandomPool(esys_context, 1000), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, 1000),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 5);
+    assert_int_equal(esys_context->random.generated, 1000);
+}
+
+static void
+test_pool_fork(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    uint8_t buffer[100];
+    int status;
+    pid_t pid;
+
+    assert_int_equal(Esys_SetRandomPool(esys_context, 4096), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 1);
+
+    /* The child reseeds the inherited pool before its first use */
+    pid = fork();
+    assert_true(pid >= 0);
+    if (pid == 0) {
+        if (Esys_GetRandomBulk(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                               ESYS_TR_NONE, buffer, sizeof(buffer))
+            != TSS2_RC_SUCCESS)
+            _exit(1);
+        _exit(random_count == 2 ? 0 : 2);
+    }
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+
+    /* The parent keeps its seed */
+    assert_int_equal(Esys_GetRandomBulk(esys_context, ESYS_TR_NONE,
+                                        ESYS_TR_NONE, ESYS_TR_NONE,
+                                        buffer, sizeof(buffer)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(random_count, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_bulk,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_known_answer,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reseed,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_reseed_split,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_pool_fork,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,165 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Tests the resource table of the ESYS_CONTEXT: creation, lookup and removal
+ * of ESYS_TR objects across table growth.
+ */
+
+static TSS2_RC
+tcti_dummy_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                    size_t size, const uint8_t * buffer)
+{
+    UNUSED(tctiContext);
+    UNUSED(size);
+    UNUSED(buffer);
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_dummy_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t * response_size,
+                   uint8_t * response_buffer, int32_t timeout)
+{
+    UNUSED(tctiContext);
+    UNUSED(response_size);
+    UNUSED(response_buffer);
+    UNUSED(timeout);
+
+    return TSS2_TCTI_RC_GENERAL_FAILURE;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+
+    /* This is a fake tcti context */
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti =
+        calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_dummy_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_dummy_receive;
+
+    r = Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    *state = (void *)esys_context;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return 0;
+}
+
+static void
+test_create_get_close(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    size_t count = 5 * _ESYS_RSRC_TABLE_INIT_SIZE + 3;
+    RSRC_NODE_T **nodes = calloc(count, sizeof(RSRC_NODE_T *));
+    RSRC_NODE_T *node;
+    ESYS_TR first = esys_context->esys_handle_cnt;
+    ESYS_TR handle;
+
+    assert_non_null(nodes);
+    for (size_t i = 0; i < count; i++) {
+        r = esys_CreateResourceObject(esys_context,
+                                      esys_context->esys_handle_cnt++,
+                                      &nodes[i]);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal(esys_context->rsrc_count, count);
+    assert_true(esys_context->rsrc_table_size >= count);
+
+    for (size_t i = 0; i < count; i++) {
+        r = esys_GetResourceObject(esys_context, first + i, &node);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_ptr_equal(node, nodes[i]);
+        assert_int_equal(node->esys_handle, first + i);
+    }
+
+    /* Close every other object */
+    for (size_t i = 0; i < count; i += 2) {
+        handle = first + i;
+        r = Esys_TR_Close(esys_context, &handle);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(handle, ESYS_TR_NONE);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        r = esys_GetResourceObject(esys_context, first + i, &node);
+        if (i % 2 == 0) {
+            assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+        } else {
+            assert_int_equal(r, TSS2_RC_SUCCESS);
+            assert_ptr_equal(node, nodes[i]);
+        }
+    }
+
+    /* Closing an already closed object must fail */
+    handle = first;
+    r = Esys_TR_Close(esys_context, &handle);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+    assert_int_equal(handle, first);
+
+    /* Global objects are created on first use and found afterwards */
+    r = esys_GetResourceObject(esys_context, ESYS_TR_RH_OWNER, &node);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node->rsrc.handle, TPM2_RH_OWNER);
+    r = esys_GetResourceObject(esys_context, ESYS_TR_RH_OWNER, &nodes[0]);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(node, nodes[0]);
+
+    r = esys_GetResourceObject(esys_context, ESYS_TR_NONE, &node);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_null(node);
+
+    free(nodes);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_create_get_close,
+                                        esys_unit_setup, esys_unit_teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,413 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "tss2_mu.h"
+
+#include "tss2-esys/esys_iutil.h"
+#include "tss2-esys/esys_int.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Tests the session pool of the ESYS_CONTEXT. The fake TCTI answers
+ * TPM2_FlushContext, TPM2_ContextSave and TPM2_ContextLoad and counts the
+ * commands received.
+ */
+
+#define SESSION_HANDLE 0x02000000
+
+static TPM2_CC last_cc;
+static size_t flush_count;
+static size_t save_count;
+static size_t load_count;
+
+static TSS2_RC
+tcti_fake_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                   size_t size, const uint8_t * buffer)
+{
+    size_t offset = 6;
+
+    UNUSED(tctiContext);
+    assert_int_equal(Tss2_MU_TPM2_CC_Unmarshal(buffer, size, &offset, &last_cc),
+                     TSS2_RC_SUCCESS);
+    if (last_cc == TPM2_CC_FlushContext)
+        flush_count++;
+    else if (last_cc == TPM2_CC_ContextSave)
+        save_count++;
+    else if (last_cc == TPM2_CC_ContextLoad)
+        load_count++;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_fake_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                  size_t * response_size,
+                  uint8_t * response_buffer, int32_t timeout)
+{
+    uint8_t buffer[256];
+    size_t offset = 10;
+    UINT16 blob_size = 16;
+
+    UNUSED(tctiContext);
+    UNUSED(timeout);
+
+    if (last_cc == TPM2_CC_ContextSave) {
+        Tss2_MU_UINT64_Marshal(1, buffer, sizeof(buffer), &offset);
+        Tss2_MU_TPM2_HANDLE_Marshal(SESSION_HANDLE, buffer, sizeof(buffer), &offset);
+        Tss2_MU_TPM2_HANDLE_Marshal(TPM2_RH_NULL, buffer, sizeof(buffer), &offset);
+        Tss2_MU_UINT16_Marshal(blob_size, buffer, sizeof(buffer), &offset);
+        memset(&buffer[offset], 0xaa, blob_size);
+        offset += blob_size;
+    } else if (last_cc == TPM2_CC_ContextLoad) {
+        Tss2_MU_TPM2_HANDLE_Marshal(SESSION_HANDLE, buffer, sizeof(buffer), &offset);
+    }
+
+    if (response_buffer == NULL) {
+        *response_size = offset;
+        return TSS2_RC_SUCCESS;
+    }
+    assert_true(*response_size >= offset);
+
+    *response_size = offset;
+    offset = 0;
+    Tss2_MU_TPM2_ST_Marshal(TPM2_ST_NO_SESSIONS, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(*response_size, buffer, sizeof(buffer), &offset);
+    Tss2_MU_UINT32_Marshal(TPM2_RC_SUCCESS, buffer, sizeof(buffer), &offset);
+    memcpy(response_buffer, buffer, *response_size);
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+esys_unit_setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context;
+
+    /* This is a fake tcti context */
+    TSS2_TCTI_CONTEXT_COMMON_V1 *tcti =
+        calloc(1, sizeof(TSS2_TCTI_CONTEXT_COMMON_V1));
+    tcti->version = 1;
+    TSS2_TCTI_TRANSMIT (tcti) = tcti_fake_transmit;
+    TSS2_TCTI_RECEIVE (tcti) = tcti_fake_receive;
+
+    r = Esys_Initialize(&esys_context, (TSS2_TCTI_CONTEXT *) tcti, NULL);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    flush_count = save_count = load_count = 0;
+    *state = (void *)esys_context;
+    return 0;
+}
+
+static int
+esys_unit_teardown(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    return 0;
+}
+
+static const TPMT_SYM_DEF aes128 = {
+    .algorithm = TPM2_ALG_AES,
+    .keyBits = { .aes = 128 },
+    .mode = { .aes = TPM2_ALG_CFB }
+};
+
+/* Create the ESYS_TR object of a salt key without talking to the TPM. */
+static ESYS_TR
+create_key(ESYS_CONTEXT *esys_context, BYTE id)
+{
+    RSRC_NODE_T *node;
+    ESYS_TR key = esys_context->esys_handle_cnt++;
+
+    assert_int_equal(esys_CreateResourceObject(esys_context, key, &node),
+                     TSS2_RC_SUCCESS);
+    node->rsrc.rsrcType = IESYSC_KEY_RSRC;
+    node->rsrc.handle = TPM2_TRANSIENT_FIRST + id;
+    node->rsrc.name.size = 34;
+    memset(&node->rsrc.name.name[0], id, node->rsrc.name.size);
+    return key;
+}
+
+/* Create the ESYS_TR object of an HMAC session without talking to the TPM.
+   The session is salted with salt_key unless it is ESYS_TR_NONE. */
+static ESYS_TR
+create_session(ESYS_CONTEXT *esys_context, TPMI_ALG_HASH authHash,
+               ESYS_TR salt_key)
+{
+    RSRC_NODE_T *key_node;
+    RSRC_NODE_T *node;
+    ESYS_TR session = esys_context->esys_handle_cnt++;
+    IESYS_SESSION *rsrc_session;
+
+    assert_int_equal(esys_CreateResourceObject(esys_context, session, &node),
+                     TSS2_RC_SUCCESS);
+    node->rsrc.rsrcType = IESYSC_SESSION_RSRC;
+    node->rsrc.handle = SESSION_HANDLE + session;
+    rsrc_session = &node->rsrc.misc.rsrc_session;
+    rsrc_session->sessionType = TPM2_SE_HMAC;
+    rsrc_session->sessionAttributes = TPMA_SESSION_CONTINUESESSION;
+    rsrc_session->authHash = authHash;
+    rsrc_session->symmetric = aes128;
+    if (salt_key != ESYS_TR_NONE) {
+        rsrc_session->sessionKey.size = 32;
+        assert_int_equal(esys_GetResourceObject(esys_context, salt_key, &key_node),
+                         TSS2_RC_SUCCESS);
+        node->salt_key = key_node->rsrc.name;
+    }
+    return session;
+}
+
+static void
+test_release_acquire(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TPMT_SYM_DEF xor = { .algorithm = TPM2_ALG_XOR,
+                         .keyBits = { .exclusiveOr = TPM2_ALG_SHA256 } };
+    ESYS_TR key, other_key, s1, s2, handle, session;
+    RSRC_NODE_T *node;
+
+    key = create_key(esys_context, 1);
+    other_key = create_key(esys_context, 2);
+    s1 = create_session(esys_context, TPM2_ALG_SHA256, key);
+    s2 = create_session(esys_context, TPM2_ALG_SHA256, key);
+
+    /* The pool is disabled by default */
+    handle = s1;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s1);
+
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 1), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, ESYS_TR_NONE);
+
+    /* The pool is full */
+    handle = s2;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s2);
+
+    /* Sessions with other parameters are not returned */
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, ESYS_TR_NONE, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, other_key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA1, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &xor,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, s1);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+
+    /* Salted sessions with an unknown salt key are not pooled */
+    assert_int_equal(esys_GetResourceObject(esys_context, s2, &node), TSS2_RC_SUCCESS);
+    node->salt_key.size = 0;
+    handle = s2;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s2);
+
+    /* Sessions without continueSession, bound and policy sessions are not pooled */
+    assert_int_equal(esys_GetResourceObject(esys_context, s2, &node), TSS2_RC_SUCCESS);
+    node->rsrc.misc.rsrc_session.sessionAttributes = 0;
+    handle = s2;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s2);
+
+    node->rsrc.misc.rsrc_session.sessionAttributes = TPMA_SESSION_CONTINUESESSION;
+    node->rsrc.misc.rsrc_session.bound_entity.size = 4;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s2);
+
+    node->rsrc.misc.rsrc_session.bound_entity.size = 0;
+    node->rsrc.misc.rsrc_session.sessionType = TPM2_SE_POLICY;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, s2);
+
+    /* A pooled session closed by the application is dropped */
+    handle = s1;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(handle, ESYS_TR_NONE);
+    handle = s1;
+    assert_int_equal(Esys_TR_Close(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, ESYS_TR_NONE);
+    assert_int_equal(esys_context->session_pool_count, 0);
+    assert_int_equal(flush_count, 0);
+}
+
+static void
+test_set_size(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR s[3], handle, session;
+
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 3), TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < 3; i++) {
+        s[i] = create_session(esys_context, TPM2_ALG_SHA256, ESYS_TR_NONE);
+        handle = s[i];
+        assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+        assert_int_equal(handle, ESYS_TR_NONE);
+    }
+
+    /* Shrinking flushes the least recently used session */
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 2), TSS2_RC_SUCCESS);
+    assert_int_equal(flush_count, 1);
+    assert_int_equal(esys_context->session_pool_count, 2);
+
+    /* The most recently used session is returned first */
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, ESYS_TR_NONE, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, s[2]);
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, ESYS_TR_NONE, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, s[1]);
+
+    handle = s[2];
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(flush_count, 2);
+    assert_int_equal(esys_context->session_pool_count, 0);
+    assert_null(esys_context->session_pool);
+}
+
+static void
+test_evict(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    ESYS_TR key, s1, s2, handle, session;
+    RSRC_NODE_T *node;
+
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_NO),
+                     TSS2_ESYS_RC_BAD_VALUE);
+
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 2), TSS2_RC_SUCCESS);
+    key = create_key(esys_context, 1);
+    s1 = create_session(esys_context, TPM2_ALG_SHA256, key);
+    s2 = create_session(esys_context, TPM2_ALG_SHA256, key);
+    handle = s1;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+    handle = s2;
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+
+    /* The least recently used session is saved and its ESYS_TR closed */
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_NO), TSS2_RC_SUCCESS);
+    assert_int_equal(save_count, 1);
+    assert_int_equal(esys_GetResourceObject(esys_context, s1, &node),
+                     TSS2_ESYS_RC_BAD_TR);
+
+    /* Loaded sessions are preferred */
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(session, s2);
+    assert_int_equal(load_count, 0);
+
+    /* The saved session is loaded again with its metadata */
+    assert_int_equal(Esys_SessionPool_Acquire(esys_context, key, &aes128,
+                                              TPM2_ALG_SHA256, &session),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(load_count, 1);
+    assert_int_not_equal(session, ESYS_TR_NONE);
+    assert_int_equal(esys_GetResourceObject(esys_context, session, &node),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(node->rsrc.rsrcType, IESYSC_SESSION_RSRC);
+    assert_int_equal(node->rsrc.misc.rsrc_session.authHash, TPM2_ALG_SHA256);
+    assert_int_equal(node->salt_key.size, 34);
+    assert_int_equal(esys_context->session_pool_count, 0);
+
+    /* Saved sessions are flushed by their TPM handle */
+    assert_int_equal(Esys_SessionPool_Release(esys_context, &session), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_NO), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_NO),
+                     TSS2_ESYS_RC_BAD_VALUE);
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_YES), TSS2_RC_SUCCESS);
+    assert_int_equal(flush_count, 1);
+    assert_int_equal(esys_context->session_pool_count, 0);
+    assert_int_equal(Esys_SessionPool_Evict(esys_context, TPM2_YES),
+                     TSS2_ESYS_RC_BAD_VALUE);
+}
+
+static void
+test_finalize(void **state)
+{
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) *state;
+    TSS2_TCTI_CONTEXT *tcti;
+    ESYS_TR handle;
+
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 2), TSS2_RC_SUCCESS);
+    for (size_t i = 0; i < 2; i++) {
+        handle = create_session(esys_context, TPM2_ALG_SHA256, ESYS_TR_NONE);
+        assert_int_equal(Esys_SessionPool_Release(esys_context, &handle), TSS2_RC_SUCCESS);
+        assert_int_equal(handle, ESYS_TR_NONE);
+    }
+
+    /* A command is still pending */
+    assert_int_equal(Esys_GetRandom_Async(esys_context, ESYS_TR_NONE, ESYS_TR_NONE,
+                                          ESYS_TR_NONE, 16), TSS2_RC_SUCCESS);
+    assert_int_equal(Esys_SessionPool_SetSize(esys_context, 0),
+                     TSS2_ESYS_RC_BAD_SEQUENCE);
+
+    /* Esys_Finalize flushes the pooled sessions anyway */
+    assert_int_equal(Esys_GetTcti(esys_context, &tcti), TSS2_RC_SUCCESS);
+    Esys_Finalize(&esys_context);
+    free(tcti);
+    assert_int_equal(flush_count, 2);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_release_acquire,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_set_size,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup_teardown(test_evict,
+                                        esys_unit_setup,
+                                        esys_unit_teardown),
+        cmocka_unit_test_setup(test_finalize, esys_unit_setup),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
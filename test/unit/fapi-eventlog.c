@@ -0,0 +1,276 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <json-c/json_util.h>
+#include <json-c/json_tokener.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "ifapi_eventlog.h"
+#include "ifapi_helpers.h"
+#include "ifapi_json_serialize.h"
+#include "fapi_int.h"
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+#define TEST_PCR 16
+
+typedef struct {
+    char dir[64];
+    char file[128];
+    IFAPI_EVENTLOG eventlog;
+    IFAPI_IO io;
+} test_ctx;
+
+static void
+fill_event(IFAPI_EVENT *event, UINT8 value)
+{
+    memset(event, 0, sizeof(*event));
+    event->pcr = TEST_PCR;
+    event->type = IFAPI_TSS_EVENT_TAG;
+    event->digests.count = 1;
+    event->digests.digests[0].hashAlg = TPM2_ALG_SHA256;
+    memset(&event->digests.digests[0].digest.sha256[0], value, TPM2_SHA256_DIGEST_SIZE);
+    event->sub_event.tss_event.data.size = 1;
+    event->sub_event.tss_event.data.buffer[0] = value;
+}
+
+static TSS2_RC
+append_event(test_ctx *ctx, UINT8 value)
+{
+    TSS2_RC r;
+    IFAPI_EVENT event;
+
+    fill_event(&event, value);
+
+    r = ifapi_eventlog_append_async(&ctx->eventlog, &ctx->io, TEST_PCR);
+    if (r)
+        return r;
+    do {
+        r = ifapi_eventlog_append_check(&ctx->eventlog, &ctx->io);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    if (r)
+        return r;
+    do {
+        r = ifapi_eventlog_append_finish(&ctx->eventlog, &ctx->io, &event);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    return r;
+}
+
+/* Read the log via the get interface and return it as JSON array. */
+static json_object *
+get_log(test_ctx *ctx)
+{
+    TSS2_RC r;
+    TPM2_HANDLE pcr = TEST_PCR;
+    char *logstr = NULL;
+    json_object *jso;
+
+    r = ifapi_eventlog_get_async(&ctx->eventlog, &ctx->io, &pcr, 1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_eventlog_get_finish(&ctx->eventlog, &ctx->io, &logstr);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    jso = json_tokener_parse(logstr);
+    free(logstr);
+    assert_non_null(jso);
+    assert_int_equal(json_object_get_type(jso), json_type_array);
+    return jso;
+}
+
+static void
+check_recnums(json_object *log, size_t count)
+{
+    json_object *jso;
+    size_t i;
+
+    assert_int_equal(json_object_array_length(log), count);
+    for (i = 0; i < count; i++) {
+        assert_true(json_object_object_get_ex(json_object_array_get_idx(log, i),
+                                              "recnum", &jso));
+        assert_int_equal(json_object_get_int(jso), i + 1);
+    }
+}
+
+static size_t
+count_lines(const char *filename)
+{
+    FILE *stream = fopen(filename, "r");
+    size_t lines = 0;
+    int c;
+
+    assert_non_null(stream);
+    while ((c = fgetc(stream)) != EOF) {
+        if (c == '\n')
+            lines++;
+    }
+    fclose(stream);
+    return lines;
+}
+
+static int
+setup(void **state)
+{
+    test_ctx *ctx = calloc(1, sizeof(*ctx));
+    assert_non_null(ctx);
+
+    strcpy(ctx->dir, "/tmp/tss_unit_eventlog_XXXXXX");
+    assert_non_null(mkdtemp(ctx->dir));
+    snprintf(ctx->file, sizeof(ctx->file), "%s/%s%i", ctx->dir,
+             IFAPI_PCR_LOG_FILE, TEST_PCR);
+
+    assert_int_equal(ifapi_eventlog_initialize(&ctx->eventlog, ctx->dir, false),
+                     TSS2_RC_SUCCESS);
+    *state = ctx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    test_ctx *ctx = *state;
+
+    unlink(ctx->file);
+    rmdir(ctx->dir);
+    SAFE_FREE(ctx->eventlog.log_dir);
+    free(ctx);
+    return 0;
+}
+
+static void
+check_eventlog_append(void **state)
+{
+    test_ctx *ctx = *state;
+    json_object *log;
+
+    assert_int_equal(append_event(ctx, 1), TSS2_RC_SUCCESS);
+    assert_int_equal(append_event(ctx, 2), TSS2_RC_SUCCESS);
+
+    /* Subsequent appends only need the last line of the log */
+    ctx->eventlog.sync = true;
+    assert_int_equal(append_event(ctx, 3), TSS2_RC_SUCCESS);
+    assert_int_equal(count_lines(ctx->file), 3);
+
+    log = get_log(ctx);
+    check_recnums(log, 3);
+    json_object_put(log);
+}
+
+static void
+check_eventlog_migrate(void **state)
+{
+    test_ctx *ctx = *state;
+    IFAPI_EVENT event;
+    json_object *array, *jso;
+    FILE *stream;
+    const char *str;
+
+    /* Write a log in the former format: one pretty printed JSON array */
+    array = json_object_new_array();
+    for (UINT32 i = 1; i <= 2; i++) {
+        fill_event(&event, i);
+        event.recnum = i;
+        jso = NULL;
+        assert_int_equal(ifapi_json_IFAPI_EVENT_serialize(&event, &jso),
+                         TSS2_RC_SUCCESS);
+        json_object_array_add(array, jso);
+    }
+    str = json_object_to_json_string_ext(array, JSON_C_TO_STRING_PRETTY);
+    stream = fopen(ctx->file, "w");
+    assert_non_null(stream);
+    fputs(str, stream);
+    fclose(stream);
+    json_object_put(array);
+
+    /* The former format is still readable */
+    array = get_log(ctx);
+    check_recnums(array, 2);
+    json_object_put(array);
+
+    /* Appending converts the log to one event per line */
+    assert_int_equal(append_event(ctx, 3), TSS2_RC_SUCCESS);
+    assert_int_equal(count_lines(ctx->file), 3);
+    assert_int_equal(append_event(ctx, 4), TSS2_RC_SUCCESS);
+    assert_int_equal(count_lines(ctx->file), 4);
+
+    array = get_log(ctx);
+    check_recnums(array, 4);
+    json_object_put(array);
+}
+
+static void
+check_eventlog_torn(void **state)
+{
+    test_ctx *ctx = *state;
+    json_object *log;
+    FILE *stream;
+
+    assert_int_equal(append_event(ctx, 1), TSS2_RC_SUCCESS);
+
+    /* An append interrupted in the middle of the last event */
+    stream = fopen(ctx->file, "a");
+    assert_non_null(stream);
+    fputs("{\"recnum\":", stream);
+    fclose(stream);
+
+    /* The torn event is skipped when reading the log */
+    log = get_log(ctx);
+    check_recnums(log, 1);
+    json_object_put(log);
+
+    /* and discarded before the next event is appended */
+    assert_int_equal(append_event(ctx, 2), TSS2_RC_SUCCESS);
+    assert_int_equal(count_lines(ctx->file), 2);
+
+    log = get_log(ctx);
+    check_recnums(log, 2);
+    json_object_put(log);
+}
+
+static void
+check_eventlog_corrupt(void **state)
+{
+    test_ctx *ctx = *state;
+    FILE *stream;
+
+    assert_int_equal(append_event(ctx, 1), TSS2_RC_SUCCESS);
+
+    /* An invalid complete last event must not be extended */
+    stream = fopen(ctx->file, "a");
+    assert_non_null(stream);
+    fputs("{\"recnum\":\n", stream);
+    fclose(stream);
+
+    assert_int_equal(ifapi_eventlog_append_async(&ctx->eventlog, &ctx->io, TEST_PCR),
+                     TSS2_FAPI_RC_BAD_VALUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(check_eventlog_append, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_eventlog_migrate, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_eventlog_torn, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_eventlog_corrupt, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
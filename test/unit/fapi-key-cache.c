@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "ifapi_key_cache.h"
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+static TPMS_CONTEXT *
+new_context(UINT64 sequence)
+{
+    TPMS_CONTEXT *context = calloc(1, sizeof(TPMS_CONTEXT));
+
+    assert_non_null(context);
+    context->sequence = sequence;
+    return context;
+}
+
+static TPM2B_NAME
+key_name(BYTE value)
+{
+    TPM2B_NAME name = { .size = 34 };
+
+    memset(&name.name[0], value, name.size);
+    return name;
+}
+
+static void
+check_key_cache_lookup(void **state)
+{
+    IFAPI_KEY_CACHE cache = { 0 };
+    uint8_t blob[] = { 0x00, 0x20, 1, 2, 3, 4 };
+    UINT8_ARY priv = { .size = sizeof(blob), .buffer = blob };
+    TPM2B_NAME name1 = key_name(1);
+    TPM2B_NAME name2 = key_name(2);
+    TPMS_CONTEXT *context;
+
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK", &name1, &priv));
+
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK", &name1, &priv,
+                                            new_context(1)),
+                     TSS2_RC_SUCCESS);
+    context = ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK", &name1, &priv);
+    assert_non_null(context);
+    assert_int_equal(context->sequence, 1);
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/a", &name1, &priv));
+
+    /* A new context of the same path replaces the former one */
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK", &name1, &priv,
+                                            new_context(2)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cache.count, 1);
+    context = ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK", &name1, &priv);
+    assert_int_equal(context->sequence, 2);
+
+    /* A replaced key at the same path is dropped */
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK", &name2, &priv));
+    assert_int_equal(cache.count, 0);
+
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK", &name1, &priv,
+                                            new_context(3)),
+                     TSS2_RC_SUCCESS);
+    ifapi_key_cache_remove(&cache, "/P_RSA/HS/SRK/a");
+    assert_int_equal(cache.count, 1);
+    ifapi_key_cache_remove(&cache, "/P_RSA/HS/SRK");
+    assert_int_equal(cache.count, 0);
+}
+
+/* A new private blob with the same name, e.g. after a ChangeAuth, drops the
+   saved context, which still carries the former authValue. */
+static void
+check_key_cache_private_changed(void **state)
+{
+    IFAPI_KEY_CACHE cache = { 0 };
+    TPM2B_NAME name = key_name(1);
+    uint8_t blob[] = { 0x00, 0x20, 1, 2, 3, 4 };
+    UINT8_ARY priv = { .size = sizeof(blob), .buffer = blob };
+    uint8_t blob_new[] = { 0x00, 0x20, 1, 2, 3, 5 };
+    UINT8_ARY priv_new = { .size = sizeof(blob_new), .buffer = blob_new };
+    UINT8_ARY priv_short = { .size = sizeof(blob) - 1, .buffer = blob };
+
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK/k", &name,
+                                            &priv, new_context(1)),
+                     TSS2_RC_SUCCESS);
+    /* The cache keeps its own copy of the blob */
+    blob[5] = 0xff;
+    blob_new[5] = 4;
+    assert_non_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k", &name,
+                                           &priv_new));
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k", &name,
+                                       &priv));
+    assert_int_equal(cache.count, 0);
+
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK/k", &name,
+                                            &priv_new, new_context(2)),
+                     TSS2_RC_SUCCESS);
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k", &name,
+                                       &priv_short));
+    assert_int_equal(cache.count, 0);
+}
+
+static void
+check_key_cache_lru(void **state)
+{
+    IFAPI_KEY_CACHE cache = { 0 };
+    UINT8_ARY priv = { .size = 0, .buffer = NULL };
+    TPM2B_NAME name = key_name(1);
+    char path[32];
+
+    for (UINT64 i = 0; i < IFAPI_KEY_CACHE_SIZE; i++) {
+        snprintf(path, sizeof(path), "/P_RSA/HS/SRK/k%" PRIu64, i);
+        assert_int_equal(ifapi_key_cache_insert(&cache, path, &name, &priv,
+                                                new_context(i)),
+                         TSS2_RC_SUCCESS);
+    }
+    /* The first key is used again, the second is the least recently used */
+    assert_non_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k0", &name, &priv));
+
+    assert_int_equal(ifapi_key_cache_insert(&cache, "/P_RSA/HS/SRK/new", &name, &priv,
+                                            new_context(99)),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(cache.count, IFAPI_KEY_CACHE_SIZE);
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k1", &name, &priv));
+    assert_non_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k0", &name, &priv));
+    assert_non_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/new", &name, &priv));
+
+    ifapi_key_cache_clear(&cache);
+    assert_int_equal(cache.count, 0);
+    assert_null(ifapi_key_cache_lookup(&cache, "/P_RSA/HS/SRK/k0", &name, &priv));
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(check_key_cache_lookup),
+        cmocka_unit_test(check_key_cache_lru),
+        cmocka_unit_test(check_key_cache_private_changed),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,361 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <json-c/json_util.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "fapi_int.h"
+#include "ifapi_keystore.h"
+#include "ifapi_helpers.h"
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * The unit tests check the name index used by ifapi_keystore_search_obj and
+ * the object cache of the keystore. The number of object files read is
+ * counted by a wrapper.
+ */
+
+static size_t read_count;
+
+TSS2_RC
+__real_ifapi_io_read_async(
+    struct IFAPI_IO *io,
+    const char *filename);
+
+TSS2_RC
+__wrap_ifapi_io_read_async(
+    struct IFAPI_IO *io,
+    const char *filename)
+{
+    read_count += 1;
+    return __real_ifapi_io_read_async(io, filename);
+}
+
+typedef struct {
+    char dir[64];
+    IFAPI_KEYSTORE keystore;
+    IFAPI_IO io;
+} test_ctx;
+
+static void
+set_name(TPM2B_NAME *name, UINT8 value)
+{
+    name->size = 2 + TPM2_SHA256_DIGEST_SIZE;
+    name->name[0] = 0x00;
+    name->name[1] = 0x0b;
+    memset(&name->name[2], value, TPM2_SHA256_DIGEST_SIZE);
+}
+
+static void
+store_key(test_ctx *ctx, const char *path, UINT8 value)
+{
+    TSS2_RC r;
+    IFAPI_OBJECT object;
+    TPMT_PUBLIC *public = &object.misc.key.public.publicArea;
+
+    memset(&object, 0, sizeof(object));
+    object.objectType = IFAPI_KEY_OBJ;
+    object.system = TPM2_NO;
+    public->type = TPM2_ALG_RSA;
+    public->nameAlg = TPM2_ALG_SHA256;
+    public->objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT | TPMA_OBJECT_USERWITHAUTH;
+    public->parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_NULL;
+    public->parameters.rsaDetail.scheme.scheme = TPM2_ALG_NULL;
+    public->parameters.rsaDetail.keyBits = 2048;
+    object.misc.key.signing_scheme.scheme = TPM2_ALG_NULL;
+    object.misc.key.creationTicket.tag = TPM2_ST_CREATION;
+    object.misc.key.creationTicket.hierarchy = TPM2_RH_OWNER;
+    set_name(&object.misc.key.name, value);
+
+    r = ifapi_keystore_store_async(&ctx->keystore, &ctx->io, path, &object);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_keystore_store_finish(&ctx->io);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+static TSS2_RC
+search_key(test_ctx *ctx, UINT8 value, char **path)
+{
+    TSS2_RC r;
+    TPM2B_NAME name;
+
+    set_name(&name, value);
+    *path = NULL;
+    read_count = 0;
+    do {
+        r = ifapi_keystore_search_obj(&ctx->keystore, &ctx->io, &name, path);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    return r;
+}
+
+static void
+check_found(test_ctx *ctx, UINT8 value, const char *expected, size_t reads)
+{
+    char *path;
+
+    assert_int_equal(search_key(ctx, value, &path), TSS2_RC_SUCCESS);
+    assert_string_equal(path, expected);
+    assert_int_equal(read_count, reads);
+    free(path);
+}
+
+static UINT8
+load_key(test_ctx *ctx, const char *path)
+{
+    TSS2_RC r;
+    IFAPI_OBJECT object;
+    UINT8 value;
+
+    read_count = 0;
+    r = ifapi_keystore_load_async(&ctx->keystore, &ctx->io, path);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_keystore_load_finish(&ctx->keystore, &ctx->io, &object);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(object.objectType, IFAPI_KEY_OBJ);
+    value = object.misc.key.name.name[2];
+    ifapi_cleanup_ifapi_object(&object);
+    return value;
+}
+
+static void
+store_keys(test_ctx *ctx)
+{
+    store_key(ctx, "/P_TEST/HS/SRK/key1", 1);
+    store_key(ctx, "/P_TEST/HS/SRK/key2", 2);
+    store_key(ctx, "/P_TEST/HS/SRK/key3", 3);
+}
+
+static int
+setup(void **state)
+{
+    test_ctx *ctx = calloc(1, sizeof(*ctx));
+    char *userdir = NULL, *systemdir = NULL;
+    assert_non_null(ctx);
+
+    strcpy(ctx->dir, "/tmp/tss_unit_keystore_XXXXXX");
+    assert_non_null(mkdtemp(ctx->dir));
+    assert_int_equal(ifapi_asprintf(&userdir, "%s/user", ctx->dir), TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_asprintf(&systemdir, "%s/system", ctx->dir), TSS2_RC_SUCCESS);
+
+    assert_int_equal(ifapi_keystore_initialize(&ctx->keystore, systemdir, userdir,
+                                               "P_TEST"),
+                     TSS2_RC_SUCCESS);
+    free(userdir);
+    free(systemdir);
+    *state = ctx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    test_ctx *ctx = *state;
+
+    /* The keystore path "/" is shorter than any directory, so ctx->dir is
+       removed as well. An empty path would be read out of bounds. */
+    ifapi_io_remove_directories(ctx->dir, "/", NULL);
+    ifapi_cleanup_ifapi_keystore(&ctx->keystore);
+    free(ctx);
+    return 0;
+}
+
+static void
+check_keystore_index_lookup(void **state)
+{
+    test_ctx *ctx = *state;
+    char *path;
+
+    store_keys(ctx);
+
+    /* Only the object referenced by the index is read. */
+    check_found(ctx, 2, "/P_TEST/HS/SRK/key2", 1);
+    check_found(ctx, 3, "/P_TEST/HS/SRK/key3", 1);
+
+    /* The index file is no keystore object. */
+    assert_int_equal(ifapi_keystore_list_all(&ctx->keystore, "/", &ctx->keystore.key_search.pathlist,
+                                             &ctx->keystore.key_search.numPaths),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ctx->keystore.key_search.numPaths, 3);
+    for (size_t i = 0; i < ctx->keystore.key_search.numPaths; i++)
+        free(ctx->keystore.key_search.pathlist[i]);
+    SAFE_FREE(ctx->keystore.key_search.pathlist);
+    ctx->keystore.key_search.numPaths = 0;
+
+    assert_int_equal(search_key(ctx, 4, &path), TSS2_FAPI_RC_KEY_NOT_FOUND);
+    assert_null(path);
+}
+
+static void
+check_keystore_index_rebuild(void **state)
+{
+    test_ctx *ctx = *state;
+    FILE *stream;
+
+    store_keys(ctx);
+
+    /* A missing index is rebuilt from all objects. */
+    assert_int_equal(remove(ctx->keystore.index_file), 0);
+    check_found(ctx, 2, "/P_TEST/HS/SRK/key2", 3);
+    check_found(ctx, 1, "/P_TEST/HS/SRK/key1", 1);
+
+    /* A corrupted index is rebuilt as well. */
+    stream = fopen(ctx->keystore.index_file, "a");
+    assert_non_null(stream);
+    fputs("/P_TEST/HS/SRK/key1 garbage", stream);
+    fclose(stream);
+    check_found(ctx, 3, "/P_TEST/HS/SRK/key3", 3);
+    check_found(ctx, 3, "/P_TEST/HS/SRK/key3", 1);
+}
+
+static void
+check_keystore_index_update(void **state)
+{
+    test_ctx *ctx = *state;
+    FILE *stream;
+    char *path;
+
+    store_keys(ctx);
+
+    /* Removed objects are not found. */
+    assert_int_equal(ifapi_keystore_delete(&ctx->keystore, "/P_TEST/HS/SRK/key1"),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(search_key(ctx, 1, &path), TSS2_FAPI_RC_KEY_NOT_FOUND);
+
+    /* A replaced object is found under its new name only. */
+    store_key(ctx, "/P_TEST/HS/SRK/key2", 5);
+    assert_int_equal(search_key(ctx, 2, &path), TSS2_FAPI_RC_KEY_NOT_FOUND);
+    check_found(ctx, 5, "/P_TEST/HS/SRK/key2", 1);
+
+    /* An outdated entry is detected when the object is verified. */
+    stream = fopen(ctx->keystore.index_file, "a");
+    assert_non_null(stream);
+    fputs("/P_TEST/HS/SRK/key3 name=000b", stream);
+    for (size_t i = 0; i < TPM2_SHA256_DIGEST_SIZE; i++)
+        fputs("07", stream);
+    fputs("\n", stream);
+    fclose(stream);
+    assert_int_equal(search_key(ctx, 7, &path), TSS2_FAPI_RC_KEY_NOT_FOUND);
+    assert_int_equal(read_count, 3);
+    check_found(ctx, 3, "/P_TEST/HS/SRK/key3", 1);
+}
+
+static void
+check_keystore_index_compact(void **state)
+{
+    test_ctx *ctx = *state;
+    FILE *stream;
+    char entry[256];
+    size_t lines = 0;
+
+    store_keys(ctx);
+
+    /* An index of mainly replaced entries is rebuilt. */
+    stream = fopen(ctx->keystore.index_file, "r");
+    assert_non_null(stream);
+    assert_non_null(fgets(entry, sizeof(entry), stream));
+    fclose(stream);
+    stream = fopen(ctx->keystore.index_file, "a");
+    assert_non_null(stream);
+    for (size_t i = 0; i < IFAPI_INDEX_COMPACT_LINES; i++)
+        fputs(entry, stream);
+    fclose(stream);
+    check_found(ctx, 2, "/P_TEST/HS/SRK/key2", 3);
+    check_found(ctx, 2, "/P_TEST/HS/SRK/key2", 1);
+
+    stream = fopen(ctx->keystore.index_file, "r");
+    assert_non_null(stream);
+    while (fgets(entry, sizeof(entry), stream))
+        lines += 1;
+    fclose(stream);
+    assert_int_equal(lines, 3);
+}
+
+static void
+check_keystore_cache(void **state)
+{
+    test_ctx *ctx = *state;
+    IFAPI_CACHE_STATS *stats = &ctx->keystore.cache.stats;
+    char *file = NULL;
+    FILE *stream;
+
+    assert_int_equal(ifapi_keystore_cache_initialize(&ctx->keystore, 2),
+                     TSS2_RC_SUCCESS);
+    store_keys(ctx);
+
+    /* The second load is served from memory. */
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 1);
+    assert_int_equal(read_count, 1);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 1);
+    assert_int_equal(read_count, 0);
+    assert_int_equal(stats->hits, 1);
+    assert_int_equal(stats->misses, 1);
+
+    /* Objects stored via the keystore replace the cached object. */
+    store_key(ctx, "/P_TEST/HS/SRK/key1", 4);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 4);
+    assert_int_equal(read_count, 1);
+
+    /* Files changed by other processes are read again. */
+    assert_int_equal(ifapi_asprintf(&file, "%s/P_TEST/HS/SRK/key1/%s",
+                                    ctx->keystore.userdir, IFAPI_OBJECT_FILE),
+                     TSS2_RC_SUCCESS);
+    stream = fopen(file, "a");
+    assert_non_null(stream);
+    fputs("\n", stream);
+    fclose(stream);
+    free(file);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 4);
+    assert_int_equal(read_count, 1);
+
+    /* The least recently used object is evicted. */
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key2"), 2);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 4);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key3"), 3);
+    assert_int_equal(stats->evictions, 1);
+    assert_int_equal(stats->entries, 2);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key1"), 4);
+    assert_int_equal(read_count, 0);
+    assert_int_equal(load_key(ctx, "/P_TEST/HS/SRK/key2"), 2);
+    assert_int_equal(read_count, 1);
+
+    /* Deleted objects are not served from the cache. */
+    assert_int_equal(ifapi_keystore_delete(&ctx->keystore, "/P_TEST/HS/SRK/key2"),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(stats->entries, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(check_keystore_index_lookup, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_keystore_index_rebuild, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_keystore_index_update, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_keystore_index_compact, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_keystore_cache, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
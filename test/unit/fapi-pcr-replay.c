@@ -0,0 +1,295 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <json-c/json.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/evp.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_eventlog.h"
+#include "ifapi_json_serialize.h"
+#include "ifapi_json_deserialize.h"
+#include "ifapi_helpers.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests the incremental replay of event logs used by
+ * Fapi_VerifyQuoteIncremental().
+ */
+
+#define LOG_EVENTS 1000
+#define NEW_EVENTS 100
+#define NUM_TEMPLATES 10
+
+/* Events for PCR 0 to 9, of which PCR 8 and 9 are not quoted. */
+static json_object *templates[NUM_TEMPLATES];
+
+static void
+init_event(IFAPI_EVENT *event, TPM2_HANDLE pcr)
+{
+    memset(event, 0, sizeof(IFAPI_EVENT));
+    event->pcr = pcr;
+    event->type = IFAPI_TSS_EVENT_TAG;
+    event->sub_event.tss_event.data.size = 4;
+    event->digests.count = 2;
+    event->digests.digests[0].hashAlg = TPM2_ALG_SHA1;
+    memset(&event->digests.digests[0].digest.sha1[0], pcr, TPM2_SHA1_DIGEST_SIZE);
+    event->digests.digests[1].hashAlg = TPM2_ALG_SHA256;
+    memset(&event->digests.digests[1].digest.sha256[0], pcr + 1,
+           TPM2_SHA256_DIGEST_SIZE);
+}
+
+static int
+setup(void **state)
+{
+    IFAPI_EVENT event;
+
+    for (size_t i = 0; i < NUM_TEMPLATES; i++) {
+        init_event(&event, i);
+        templates[i] = NULL;
+        assert_int_equal(ifapi_json_IFAPI_EVENT_serialize(&event, &templates[i]),
+                         TSS2_RC_SUCCESS);
+    }
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    for (size_t i = 0; i < NUM_TEMPLATES; i++)
+        json_object_put(templates[i]);
+    return 0;
+}
+
+/* The events [first, last) of the complete log, sharing the template objects. */
+static json_object *
+get_log(size_t first, size_t last)
+{
+    json_object *log = json_object_new_array();
+
+    assert_non_null(log);
+    for (size_t i = first; i < last; i++) {
+        json_object_array_add(log, json_object_get(templates[i % NUM_TEMPLATES]));
+    }
+    return log;
+}
+
+/* Quote of sha256 PCR 0-7 and sha1 PCR 0-3 */
+static void
+init_quote_info(FAPI_QUOTE_INFO *quote_info)
+{
+    TPML_PCR_SELECTION *pcr_selection;
+
+    memset(quote_info, 0, sizeof(FAPI_QUOTE_INFO));
+    quote_info->sig_scheme.scheme = TPM2_ALG_RSASSA;
+    quote_info->sig_scheme.details.rsassa.hashAlg = TPM2_ALG_SHA256;
+    pcr_selection = &quote_info->attest.attested.quote.pcrSelect;
+    pcr_selection->count = 2;
+    pcr_selection->pcrSelections[0].hash = TPM2_ALG_SHA256;
+    pcr_selection->pcrSelections[0].sizeofSelect = 3;
+    pcr_selection->pcrSelections[0].pcrSelect[0] = 0xff;
+    pcr_selection->pcrSelections[1].hash = TPM2_ALG_SHA1;
+    pcr_selection->pcrSelections[1].sizeofSelect = 3;
+    pcr_selection->pcrSelections[1].pcrSelect[0] = 0x0f;
+}
+
+/* Replay the complete log and store the resulting PCR digest in the quote. */
+static void
+replay_complete(FAPI_QUOTE_INFO *quote_info, size_t n_events)
+{
+    IFAPI_PCR_REPLAY *replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    TPM2B_DIGEST *pcr_digest = &quote_info->attest.attested.quote.pcrDigest;
+    json_object *log = get_log(0, n_events);
+    TPM2B_DIGEST digest;
+
+    assert_non_null(replay);
+    pcr_digest->size = 0;
+    assert_int_equal(ifapi_pcr_replay_select(replay,
+                         &quote_info->attest.attested.quote.pcrSelect),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(replay->count, 12);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_digest(replay, quote_info, &digest),
+                     TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED);
+    *pcr_digest = digest;
+    assert_int_equal(ifapi_pcr_replay_digest(replay, quote_info, &digest),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_calculate_pcr_digest(log, quote_info, &digest),
+                     TSS2_RC_SUCCESS);
+    json_object_put(log);
+    free(replay);
+}
+
+/* Replay the log up to event n_events and return the serialized state. */
+static char *
+replay_state(FAPI_QUOTE_INFO *quote_info, size_t n_events)
+{
+    IFAPI_PCR_REPLAY *replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    json_object *log = get_log(0, n_events);
+    json_object *jso = NULL;
+    char *state;
+
+    assert_non_null(replay);
+    assert_int_equal(ifapi_pcr_replay_select(replay,
+                         &quote_info->attest.attested.quote.pcrSelect),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_json_IFAPI_PCR_REPLAY_serialize(replay, &jso),
+                     TSS2_RC_SUCCESS);
+    state = strdup(json_object_to_json_string(jso));
+    assert_non_null(state);
+    json_object_put(jso);
+    json_object_put(log);
+    free(replay);
+    return state;
+}
+
+static void
+load_state(IFAPI_PCR_REPLAY *replay, const char *state)
+{
+    json_object *jso = json_tokener_parse(state);
+
+    assert_non_null(jso);
+    memset(replay, 0, sizeof(IFAPI_PCR_REPLAY));
+    assert_int_equal(ifapi_json_IFAPI_PCR_REPLAY_deserialize(jso, replay),
+                     TSS2_RC_SUCCESS);
+    json_object_put(jso);
+}
+
+/*
+ * Check the replay against a PCR value computed independently.
+ */
+static void
+check_replay_value(void **state)
+{
+    FAPI_QUOTE_INFO quote_info;
+    IFAPI_PCR_REPLAY *replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    json_object *log = get_log(0, 3 * NUM_TEMPLATES);
+    uint8_t pcr[TPM2_SHA256_DIGEST_SIZE] = { 0 };
+    uint8_t digest[TPM2_SHA256_DIGEST_SIZE];
+    unsigned int size;
+
+    /* PCR 2 was extended three times with the digest 0x03...03 */
+    memset(&digest[0], 3, sizeof(digest));
+    for (size_t i = 0; i < 3; i++) {
+        EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+        assert_non_null(ctx);
+        assert_int_equal(EVP_DigestInit_ex(ctx, EVP_sha256(), NULL), 1);
+        assert_int_equal(EVP_DigestUpdate(ctx, pcr, sizeof(pcr)), 1);
+        assert_int_equal(EVP_DigestUpdate(ctx, digest, sizeof(digest)), 1);
+        assert_int_equal(EVP_DigestFinal_ex(ctx, pcr, &size), 1);
+        EVP_MD_CTX_free(ctx);
+    }
+
+    assert_non_null(replay);
+    init_quote_info(&quote_info);
+    assert_int_equal(ifapi_pcr_replay_select(replay,
+                         &quote_info.attest.attested.quote.pcrSelect),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(replay->values[2].pcr, 2);
+    assert_int_equal(replay->values[2].bank, TPM2_ALG_SHA256);
+    assert_int_equal(replay->values[2].events, 3 * NUM_TEMPLATES);
+    assert_memory_equal(&replay->values[2].value.buffer[0], pcr, sizeof(pcr));
+
+    json_object_put(log);
+    free(replay);
+}
+
+/*
+ * Replay a large log completely and incrementally and compare the results.
+ */
+static void
+check_replay_incremental(void **state)
+{
+    FAPI_QUOTE_INFO quote_info;
+    IFAPI_PCR_REPLAY *replay = calloc(1, sizeof(IFAPI_PCR_REPLAY));
+    json_object *log, *new_log;
+    TPM2B_DIGEST digest;
+    char *pcr_state;
+
+    assert_non_null(replay);
+    init_quote_info(&quote_info);
+    pcr_state = replay_state(&quote_info, LOG_EVENTS - NEW_EVENTS);
+
+    replay_complete(&quote_info, LOG_EVENTS);
+
+    /* Only the new events are passed */
+    new_log = get_log(LOG_EVENTS - NEW_EVENTS, LOG_EVENTS);
+    load_state(replay, pcr_state);
+    assert_int_equal(ifapi_pcr_replay_select(replay,
+                         &quote_info.attest.attested.quote.pcrSelect),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(replay->count, 12);
+    assert_int_equal(ifapi_pcr_replay_events(replay, new_log,
+                                             LOG_EVENTS - NEW_EVENTS),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_digest(replay, &quote_info, &digest),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(replay->values[0].events, LOG_EVENTS);
+
+    /* The complete log is passed, the replayed events are skipped */
+    log = get_log(0, LOG_EVENTS);
+    load_state(replay, pcr_state);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log, 0), TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_digest(replay, &quote_info, &digest),
+                     TSS2_RC_SUCCESS);
+    json_object_put(log);
+
+    /* Events between state and log are missing */
+    log = get_log(LOG_EVENTS - NEW_EVENTS / 2, LOG_EVENTS);
+    load_state(replay, pcr_state);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log,
+                                             LOG_EVENTS - NEW_EVENTS / 2),
+                     TSS2_FAPI_RC_BAD_VALUE);
+    json_object_put(log);
+
+    /* The log is shorter than the replayed state, e.g. after a reboot */
+    log = get_log(0, NEW_EVENTS);
+    load_state(replay, pcr_state);
+    assert_int_equal(ifapi_pcr_replay_events(replay, log, 0),
+                     TSS2_FAPI_RC_BAD_VALUE);
+    json_object_put(log);
+
+    /* A PCR which is not part of the state can not be verified */
+    load_state(replay, pcr_state);
+    quote_info.attest.attested.quote.pcrSelect.pcrSelections[1].pcrSelect[0] = 0x1f;
+    assert_int_equal(ifapi_pcr_replay_select(replay,
+                         &quote_info.attest.attested.quote.pcrSelect),
+                     TSS2_RC_SUCCESS);
+    assert_int_equal(ifapi_pcr_replay_events(replay, new_log,
+                                             LOG_EVENTS - NEW_EVENTS),
+                     TSS2_FAPI_RC_BAD_VALUE);
+
+    json_object_put(new_log);
+    free(pcr_state);
+    free(replay);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(check_replay_value, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_replay_incremental, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,245 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+#include "ifapi_helpers.h"
+#include "ifapi_policy_execute.h"
+#include "ifapi_policy_ticket_cache.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Execute a PolicyAuthorize element with wrapped ESAPI functions and check
+ * that a verification ticket taken from the ticket cache, which is rejected
+ * by the TPM, leads to a new verification of the signature.
+ */
+
+#define KEY_HANDLE 0x1000
+#define SESSION_HANDLE 0x1001
+
+static TPMT_PUBLIC loaded_public;
+static int verify_calls;
+static int flush_calls;
+
+TSS2_RC
+__wrap_Esys_LoadExternal_Async(ESYS_CONTEXT *esysContext,
+                               ESYS_TR shandle1, ESYS_TR shandle2,
+                               ESYS_TR shandle3,
+                               const TPM2B_SENSITIVE *inPrivate,
+                               const TPM2B_PUBLIC *inPublic,
+                               ESYS_TR hierarchy)
+{
+    loaded_public = inPublic->publicArea;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_LoadExternal_Finish(ESYS_CONTEXT *esysContext, ESYS_TR *objectHandle)
+{
+    *objectHandle = KEY_HANDLE;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_TR_GetName(ESYS_CONTEXT *esys_context, ESYS_TR esys_handle,
+                       TPM2B_NAME **name)
+{
+    *name = calloc(1, sizeof(TPM2B_NAME));
+    assert_non_null(*name);
+    return ifapi_get_name(&loaded_public, *name);
+}
+
+TSS2_RC
+__wrap_Esys_VerifySignature_Async(ESYS_CONTEXT *esysContext, ESYS_TR keyHandle,
+                                  ESYS_TR shandle1, ESYS_TR shandle2,
+                                  ESYS_TR shandle3,
+                                  const TPM2B_DIGEST *digest,
+                                  const TPMT_SIGNATURE *signature)
+{
+    verify_calls += 1;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_VerifySignature_Finish(ESYS_CONTEXT *esysContext,
+                                   TPMT_TK_VERIFIED **validation)
+{
+    *validation = calloc(1, sizeof(TPMT_TK_VERIFIED));
+    assert_non_null(*validation);
+    (*validation)->tag = TPM2_ST_VERIFIED;
+    (*validation)->hierarchy = TPM2_RH_OWNER;
+    (*validation)->digest.size = 32;
+    memset(&(*validation)->digest.buffer[0], verify_calls, 32);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_PolicyAuthorize_Async(ESYS_CONTEXT *esysContext,
+                                  ESYS_TR policySession,
+                                  ESYS_TR shandle1, ESYS_TR shandle2,
+                                  ESYS_TR shandle3,
+                                  const TPM2B_DIGEST *approvedPolicy,
+                                  const TPM2B_NONCE *policyRef,
+                                  const TPM2B_NAME *keySign,
+                                  const TPMT_TK_VERIFIED *checkTicket)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_PolicyAuthorize_Finish(ESYS_CONTEXT *esysContext)
+{
+    return mock_type(TSS2_RC);
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext_Async(ESYS_CONTEXT *esysContext, ESYS_TR flushHandle)
+{
+    flush_calls += 1;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext_Finish(ESYS_CONTEXT *esysContext)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_Esys_FlushContext(ESYS_CONTEXT *esysContext, ESYS_TR flushHandle)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+cb_authorize_policy(TPMT_PUBLIC *key_public, TPMI_ALG_HASH hash_alg,
+                    TPM2B_DIGEST *digest, TPM2B_NONCE *policyRef,
+                    TPMT_SIGNATURE *signature, void *userdata)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+static TPMT_PUBLIC
+authorize_key(void)
+{
+    TPMT_PUBLIC public = {
+        .type = TPM2_ALG_RSA,
+        .nameAlg = TPM2_ALG_SHA256,
+        .objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT,
+        .parameters.rsaDetail = {
+            .symmetric.algorithm = TPM2_ALG_NULL,
+            .scheme.scheme = TPM2_ALG_NULL,
+            .keyBits = 2048,
+        },
+        .unique.rsa.size = 256,
+    };
+
+    memset(&public.unique.rsa.buffer[0], 0x5a, public.unique.rsa.size);
+    return public;
+}
+
+/* Execute the policy until it is finished and return the result. */
+static TSS2_RC
+execute_policy(IFAPI_POLICY_EXEC_CTX *pol_ctx, TPMS_POLICY *policy)
+{
+    TSS2_RC r;
+
+    r = ifapi_policyeval_execute_prepare(pol_ctx, TPM2_ALG_SHA256, policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_policyeval_execute(NULL, pol_ctx);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    return r;
+}
+
+static void
+check_policy_authorize_ticket_rejected(void **state)
+{
+    IFAPI_POLICY_TICKET_CACHE cache = { 0 };
+    IFAPI_POLICY_EXEC_CTX pol_ctx = { 0 };
+    TPML_POLICYELEMENTS *elements;
+    TPMS_POLICY policy = { 0 };
+    TPMS_POLICYAUTHORIZE *authorize;
+    const TPMT_TK_VERIFIED *ticket;
+    TSS2_RC r;
+
+    elements = calloc(1, sizeof(TPML_POLICYELEMENTS) + sizeof(TPMT_POLICYELEMENT));
+    assert_non_null(elements);
+    elements->count = 1;
+    elements->elements[0].type = POLICYAUTHORIZE;
+    authorize = &elements->elements[0].element.PolicyAuthorize;
+    authorize->keyPublic = authorize_key();
+    authorize->approvedPolicy.size = 32;
+    policy.policy = elements;
+
+    pol_ctx.session = SESSION_HANDLE;
+    pol_ctx.ticket_cache = &cache;
+    pol_ctx.callbacks.cbauthpol = cb_authorize_policy;
+
+    /* The first execution verifies the signature and caches the ticket */
+    will_return(__wrap_Esys_PolicyAuthorize_Finish, TSS2_RC_SUCCESS);
+    r = execute_policy(&pol_ctx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(verify_calls, 1);
+    assert_int_equal(flush_calls, 1);
+    assert_int_equal(cache.count, 1);
+
+    /* The second execution uses the cached ticket */
+    will_return(__wrap_Esys_PolicyAuthorize_Finish, TSS2_RC_SUCCESS);
+    r = execute_policy(&pol_ctx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(verify_calls, 1);
+    assert_int_equal(flush_calls, 1);
+
+    /* The TPM rejects the cached ticket as it does for a changed proof
+       value: TPM2_RC_VALUE for parameter 4. The signature is verified again
+       and the new ticket replaces the rejected one. */
+    will_return(__wrap_Esys_PolicyAuthorize_Finish,
+                TPM2_RC_VALUE + TPM2_RC_P + TPM2_RC_4);
+    will_return(__wrap_Esys_PolicyAuthorize_Finish, TSS2_RC_SUCCESS);
+    r = execute_policy(&pol_ctx, &policy);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(verify_calls, 2);
+    assert_int_equal(flush_calls, 2);
+    assert_int_equal(cache.count, 1);
+    ticket = ifapi_policy_ticket_cache_lookup(&cache, &authorize->keyName,
+                                              &pol_ctx.aHash);
+    assert_non_null(ticket);
+    assert_int_equal(ticket->digest.buffer[0], 2);
+
+    /* An error for a freshly verified ticket is returned to the caller */
+    ifapi_policy_ticket_cache_clear(&cache);
+    will_return(__wrap_Esys_PolicyAuthorize_Finish,
+                TPM2_RC_VALUE + TPM2_RC_P + TPM2_RC_4);
+    r = execute_policy(&pol_ctx, &policy);
+    assert_int_equal(r, TPM2_RC_VALUE + TPM2_RC_P + TPM2_RC_4);
+    assert_int_equal(verify_calls, 3);
+
+    ifapi_policy_ticket_cache_clear(&cache);
+    free(elements);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(check_policy_authorize_ticket_rejected),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
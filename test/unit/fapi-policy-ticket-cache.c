@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2018, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "ifapi_policy_ticket_cache.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+static TPM2B_NAME
+key_name(BYTE value)
+{
+    TPM2B_NAME name = { .size = 34 };
+
+    memset(&name.name[0], value, name.size);
+    return name;
+}
+
+static TPM2B_DIGEST
+auth_hash(BYTE value, UINT16 size)
+{
+    TPM2B_DIGEST digest = { .size = size };
+
+    memset(&digest.buffer[0], value, digest.size);
+    return digest;
+}
+
+static TPMT_TK_VERIFIED
+verified_ticket(BYTE value)
+{
+    TPMT_TK_VERIFIED ticket = { .tag = TPM2_ST_VERIFIED,
+                                .hierarchy = TPM2_RH_OWNER,
+                                .digest = { .size = 32 } };
+
+    memset(&ticket.digest.buffer[0], value, ticket.digest.size);
+    return ticket;
+}
+
+static void
+check_ticket_cache_lookup(void **state)
+{
+    IFAPI_POLICY_TICKET_CACHE cache = { 0 };
+    TPM2B_NAME name1 = key_name(1);
+    TPM2B_NAME name2 = key_name(2);
+    TPM2B_DIGEST hash1 = auth_hash(1, 32);
+    TPM2B_DIGEST hash2 = auth_hash(2, 32);
+    TPM2B_DIGEST hash_short = auth_hash(1, 20);
+    TPMT_TK_VERIFIED ticket1 = verified_ticket(1);
+    TPMT_TK_VERIFIED ticket2 = verified_ticket(2);
+    const TPMT_TK_VERIFIED *ticket;
+
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash1));
+
+    ifapi_policy_ticket_cache_insert(&cache, &name1, &hash1, &ticket1);
+    ticket = ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash1);
+    assert_non_null(ticket);
+    assert_memory_equal(ticket, &ticket1, sizeof(ticket1));
+
+    /* Key name and digest have to match */
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name2, &hash1));
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash2));
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash_short));
+
+    /* A new ticket for the same key and digest replaces the former one */
+    ifapi_policy_ticket_cache_insert(&cache, &name1, &hash1, &ticket2);
+    assert_int_equal(cache.count, 1);
+    ticket = ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash1);
+    assert_memory_equal(ticket, &ticket2, sizeof(ticket2));
+
+    ifapi_policy_ticket_cache_insert(&cache, &name2, &hash1, &ticket1);
+    assert_int_equal(cache.count, 2);
+    ifapi_policy_ticket_cache_remove(&cache, &name1, &hash2);
+    assert_int_equal(cache.count, 2);
+    ifapi_policy_ticket_cache_remove(&cache, &name1, &hash1);
+    assert_int_equal(cache.count, 1);
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name1, &hash1));
+    assert_non_null(ifapi_policy_ticket_cache_lookup(&cache, &name2, &hash1));
+}
+
+static void
+check_ticket_cache_lru(void **state)
+{
+    IFAPI_POLICY_TICKET_CACHE cache = { 0 };
+    TPM2B_NAME name = key_name(1);
+    TPM2B_DIGEST hash;
+    TPM2B_DIGEST hash_new = auth_hash(0xff, 32);
+    TPMT_TK_VERIFIED ticket = verified_ticket(1);
+
+    for (BYTE i = 0; i < IFAPI_POLICY_TICKET_CACHE_SIZE; i++) {
+        hash = auth_hash(i, 32);
+        ifapi_policy_ticket_cache_insert(&cache, &name, &hash, &ticket);
+    }
+    /* The first ticket is used again, the second is the least recently used */
+    hash = auth_hash(0, 32);
+    assert_non_null(ifapi_policy_ticket_cache_lookup(&cache, &name, &hash));
+
+    ifapi_policy_ticket_cache_insert(&cache, &name, &hash_new, &ticket);
+    assert_int_equal(cache.count, IFAPI_POLICY_TICKET_CACHE_SIZE);
+    hash = auth_hash(1, 32);
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name, &hash));
+    hash = auth_hash(0, 32);
+    assert_non_null(ifapi_policy_ticket_cache_lookup(&cache, &name, &hash));
+    assert_non_null(ifapi_policy_ticket_cache_lookup(&cache, &name, &hash_new));
+
+    ifapi_policy_ticket_cache_clear(&cache);
+    assert_int_equal(cache.count, 0);
+    assert_null(ifapi_policy_ticket_cache_lookup(&cache, &name, &hash));
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(check_ticket_cache_lookup),
+        cmocka_unit_test(check_ticket_cache_lru),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*******************************************************************************
+ * Copyright 2021, Fraunhofer SIT sponsored by Infineon Technologies AG
+ * All rights reserved.
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <json-c/json.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include "tss2_fapi.h"
+#include "tss2_mu.h"
+#include "fapi_int.h"
+#include "fapi_crypto.h"
+#include "ifapi_json_serialize.h"
+#include "ifapi_helpers.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests Fapi_VerifyQuoteBatch() with quotes signed by software keys.
+ */
+
+#define NUM_KEYS 2
+#define NUM_QUOTES 200
+
+static char *key_paths[NUM_KEYS] = { "HS/SRK/key0", "HS/SRK/key1" };
+static EVP_PKEY *keys[NUM_KEYS];
+static char *key_pems[NUM_KEYS];
+static size_t key_loads;
+static const char *key_path;
+
+static uint8_t nonce[20] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                             11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+
+/* The batch verification does not need the TPM. */
+TSS2_RC
+ifapi_non_tpm_mode_init(FAPI_CONTEXT *context)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_ifapi_keystore_load_async(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_IO *io,
+    const char *path)
+{
+    key_path = path;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+__wrap_ifapi_keystore_load_finish(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_IO *io,
+    IFAPI_OBJECT *object)
+{
+    key_loads++;
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        if (strcmp(key_path, key_paths[i]) == 0) {
+            memset(object, 0, sizeof(IFAPI_OBJECT));
+            object->objectType = IFAPI_EXT_PUB_KEY_OBJ;
+            object->misc.ext_pub_key.pem_ext_public = strdup(key_pems[i]);
+            assert_non_null(object->misc.ext_pub_key.pem_ext_public);
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    return TSS2_FAPI_RC_PATH_NOT_FOUND;
+}
+
+static int
+setup(void **state)
+{
+    EVP_PKEY_CTX *ctx;
+    BIO *bio;
+    char *pem;
+    long pem_size;
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        assert_non_null(ctx);
+        assert_int_equal(EVP_PKEY_keygen_init(ctx), 1);
+        assert_int_equal(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx,
+                                 NID_X9_62_prime256v1), 1);
+        keys[i] = NULL;
+        assert_int_equal(EVP_PKEY_keygen(ctx, &keys[i]), 1);
+        EVP_PKEY_CTX_free(ctx);
+
+        bio = BIO_new(BIO_s_mem());
+        assert_non_null(bio);
+        assert_int_equal(PEM_write_bio_PUBKEY(bio, keys[i]), 1);
+        pem_size = BIO_get_mem_data(bio, &pem);
+        key_pems[i] = strndup(pem, pem_size);
+        assert_non_null(key_pems[i]);
+        BIO_free(bio);
+    }
+    key_loads = 0;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        EVP_PKEY_free(keys[i]);
+        SAFE_FREE(key_pems[i]);
+    }
+    return 0;
+}
+
+/* Create a quote info and its signature with the key key_idx. */
+static void
+create_quote(size_t key_idx, uint32_t clock, char **quote_info_string,
+             uint8_t **signature, size_t *signature_size)
+{
+    FAPI_QUOTE_INFO quote_info;
+    json_object *jso = NULL;
+    uint8_t buffer[sizeof(TPMS_ATTEST)];
+    size_t offset = 0;
+    EVP_MD_CTX *mdctx;
+
+    memset(&quote_info, 0, sizeof(FAPI_QUOTE_INFO));
+    quote_info.sig_scheme.scheme = TPM2_ALG_ECDSA;
+    quote_info.sig_scheme.details.any.hashAlg = TPM2_ALG_SHA256;
+    quote_info.attest.magic = TPM2_GENERATED_VALUE;
+    quote_info.attest.type = TPM2_ST_ATTEST_QUOTE;
+    quote_info.attest.extraData.size = sizeof(nonce);
+    memcpy(&quote_info.attest.extraData.buffer[0], &nonce[0], sizeof(nonce));
+    quote_info.attest.clockInfo.clock = clock;
+    quote_info.attest.attested.quote.pcrDigest.size = TPM2_SHA256_DIGEST_SIZE;
+
+    assert_int_equal(ifapi_json_FAPI_QUOTE_INFO_serialize(&quote_info, &jso),
+                     TSS2_RC_SUCCESS);
+    *quote_info_string = strdup(json_object_to_json_string_ext(jso,
+                                    JSON_C_TO_STRING_PRETTY));
+    assert_non_null(*quote_info_string);
+    json_object_put(jso);
+
+    assert_int_equal(Tss2_MU_TPMS_ATTEST_Marshal(&quote_info.attest, &buffer[0],
+                                                 sizeof(buffer), &offset),
+                     TSS2_RC_SUCCESS);
+
+    mdctx = EVP_MD_CTX_new();
+    assert_non_null(mdctx);
+    assert_int_equal(EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL,
+                                        keys[key_idx]), 1);
+    assert_int_equal(EVP_DigestSignUpdate(mdctx, &buffer[0], offset), 1);
+    assert_int_equal(EVP_DigestSignFinal(mdctx, NULL, signature_size), 1);
+    *signature = malloc(*signature_size);
+    assert_non_null(*signature);
+    assert_int_equal(EVP_DigestSignFinal(mdctx, *signature, signature_size), 1);
+    EVP_MD_CTX_free(mdctx);
+}
+
+static void
+check_batch_results(void **state)
+{
+    FAPI_CONTEXT *context = calloc(1, sizeof(FAPI_CONTEXT));
+    char *quote_infos[NUM_KEYS];
+    uint8_t *signatures[NUM_KEYS];
+    size_t signature_sizes[NUM_KEYS];
+    uint8_t wrong_nonce[sizeof(nonce)] = { 0 };
+    TSS2_RC *results = NULL;
+    TSS2_RC r;
+
+    assert_non_null(context);
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        create_quote(i, i, &quote_infos[i], &signatures[i], &signature_sizes[i]);
+    }
+
+    /* Valid, valid, wrong nonce, wrong key, unknown key, no nonce. */
+    char const *paths[] = { key_paths[0], key_paths[1], key_paths[0],
+                            key_paths[1], "HS/SRK/unknown", key_paths[0] };
+    uint8_t const *qualifying_data[] = { nonce, nonce, wrong_nonce, nonce, nonce,
+                                         NULL };
+    size_t qualifying_data_sizes[] = { 20, 20, 20, 20, 20, 0 };
+    char const *infos[] = { quote_infos[0], quote_infos[1], quote_infos[0],
+                            quote_infos[0], quote_infos[0], quote_infos[0] };
+    uint8_t const *sigs[] = { signatures[0], signatures[1], signatures[0],
+                              signatures[0], signatures[0], signatures[0] };
+    size_t sig_sizes[] = { signature_sizes[0], signature_sizes[1],
+                           signature_sizes[0], signature_sizes[0],
+                           signature_sizes[0], signature_sizes[0] };
+
+    r = Fapi_VerifyQuoteBatch(context, 6, paths, qualifying_data,
+                              qualifying_data_sizes, infos, sigs, sig_sizes,
+                              NULL, &results);
+    assert_int_equal(r, TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED);
+    assert_non_null(results);
+    assert_int_equal(results[0], TSS2_RC_SUCCESS);
+    assert_int_equal(results[1], TSS2_RC_SUCCESS);
+    assert_int_equal(results[2], TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED);
+    assert_int_equal(results[3], TSS2_FAPI_RC_SIGNATURE_VERIFICATION_FAILED);
+    assert_int_equal(results[4], TSS2_FAPI_RC_PATH_NOT_FOUND);
+    assert_int_equal(results[5], TSS2_RC_SUCCESS);
+    SAFE_FREE(results);
+
+    /* Every distinct key is loaded once. */
+    assert_int_equal(key_loads, 3);
+
+    /* The valid quotes alone are verified. */
+    r = Fapi_VerifyQuoteBatch(context, 2, paths, qualifying_data,
+                              qualifying_data_sizes, infos, sigs, sig_sizes,
+                              NULL, &results);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_non_null(results);
+    assert_int_equal(results[0], TSS2_RC_SUCCESS);
+    assert_int_equal(results[1], TSS2_RC_SUCCESS);
+    SAFE_FREE(results);
+
+    r = Fapi_VerifyQuoteBatch(context, 0, paths, qualifying_data,
+                              qualifying_data_sizes, infos, sigs, sig_sizes,
+                              NULL, &results);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        SAFE_FREE(quote_infos[i]);
+        SAFE_FREE(signatures[i]);
+    }
+    SAFE_FREE(context);
+}
+
+/*
+ * Verify many quotes in one batch: all of them are valid and every key is
+ * loaded once.
+ */
+static void
+check_batch_many(void **state)
+{
+    FAPI_CONTEXT *context = calloc(1, sizeof(FAPI_CONTEXT));
+    char **quote_infos = calloc(NUM_QUOTES, sizeof(char *));
+    uint8_t **signatures = calloc(NUM_QUOTES, sizeof(uint8_t *));
+    size_t *signature_sizes = calloc(NUM_QUOTES, sizeof(size_t));
+    char const **paths = calloc(NUM_QUOTES, sizeof(char *));
+    uint8_t const **qualifying_data = calloc(NUM_QUOTES, sizeof(uint8_t *));
+    size_t *qualifying_data_sizes = calloc(NUM_QUOTES, sizeof(size_t));
+    TSS2_RC *results = NULL;
+    TSS2_RC r;
+
+    assert_non_null(context);
+    assert_non_null(quote_infos);
+    assert_non_null(signatures);
+    assert_non_null(signature_sizes);
+    assert_non_null(paths);
+    assert_non_null(qualifying_data);
+    assert_non_null(qualifying_data_sizes);
+
+    for (size_t i = 0; i < NUM_QUOTES; i++) {
+        create_quote(i % NUM_KEYS, i, &quote_infos[i], &signatures[i],
+                     &signature_sizes[i]);
+        paths[i] = key_paths[i % NUM_KEYS];
+        qualifying_data[i] = nonce;
+        qualifying_data_sizes[i] = sizeof(nonce);
+    }
+
+    r = Fapi_VerifyQuoteBatch(context, NUM_QUOTES, paths, qualifying_data,
+                              qualifying_data_sizes,
+                              (char const * const *)quote_infos,
+                              (uint8_t const * const *)signatures,
+                              signature_sizes, NULL, &results);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_non_null(results);
+    for (size_t i = 0; i < NUM_QUOTES; i++) {
+        assert_int_equal(results[i], TSS2_RC_SUCCESS);
+    }
+    assert_int_equal(key_loads, NUM_KEYS);
+
+    SAFE_FREE(results);
+    for (size_t i = 0; i < NUM_QUOTES; i++) {
+        SAFE_FREE(quote_infos[i]);
+        SAFE_FREE(signatures[i]);
+    }
+    SAFE_FREE(quote_infos);
+    SAFE_FREE(signatures);
+    SAFE_FREE(signature_sizes);
+    SAFE_FREE(paths);
+    SAFE_FREE(qualifying_data);
+    SAFE_FREE(qualifying_data_sizes);
+    SAFE_FREE(context);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(check_batch_results, setup, teardown),
+        cmocka_unit_test_setup_teardown(check_batch_many, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
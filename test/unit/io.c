@@ -9,9 +9,11 @@
 #endif
 
 #include <inttypes.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -65,6 +67,31 @@ __wrap_write (int fd, const void *buffer, size_t buffer_size)
     return mock_type (ssize_t);
 }
 
+ssize_t
+__wrap_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+    LOG_DEBUG ("writing %d buffers to fd: %d", iovcnt, fd);
+    return mock_type (ssize_t);
+}
+
+/* The timeout of the last poll and the time each poll takes in ms. */
+static int poll_timeout;
+static long poll_sleep_ms;
+
+int
+__wrap_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    struct timespec ts = { 0, poll_sleep_ms * 1000000L };
+    int ret = mock_type (int);
+
+    poll_timeout = timeout;
+    if (poll_sleep_ms > 0) {
+        nanosleep (&ts, NULL);
+    }
+    fds->revents = fds->events;
+    return ret;
+}
+
 /*
  * A test case for a successful call to the receive function. This requires
  * that the context and the command buffer be valid (including the size
@@ -112,6 +139,114 @@ read_all_twice_eof (void **state)
     ret = read_all (10, buf, 10);
     assert_int_equal (ret, 5);
 }
+/*
+ * The buffered receive keeps reading into the free space of the buffer until
+ * the requested minimum is reached.
+ */
+static void
+socket_recv_buffered_short_reads_test (void **state)
+{
+    TSS2_RC rc;
+    uint8_t buf [16] = { 0 };
+    size_t count = 0;
+
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 3);
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 7);
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 10, -1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (count, 10);
+
+    /* Already buffered data satisfies the next request without a read. */
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 8, -1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (count, 10);
+}
+/*
+ * A poll timeout returns TRY_AGAIN and preserves the data received so far.
+ * EOF before the minimum is reached is an IO error.
+ */
+static void
+socket_recv_buffered_try_again_eof_test (void **state)
+{
+    TSS2_RC rc;
+    uint8_t buf [16] = { 0 };
+    size_t count = 0;
+
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 2);
+    will_return (__wrap_poll, 0);
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 10, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (count, 2);
+
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 0);
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 10, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+    assert_int_equal (count, 2);
+
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 17, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+}
+/*
+ * The timeout bounds the whole receive: every poll only waits for the time
+ * left and once it is used up TRY_AGAIN is returned without another poll.
+ */
+static void
+socket_recv_buffered_deadline_test (void **state)
+{
+    TSS2_RC rc;
+    uint8_t buf [16] = { 0 };
+    size_t count = 0;
+
+    poll_sleep_ms = 30;
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 2);
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 2);
+    rc = socket_recv_buffered (10, buf, sizeof (buf), &count, 10, 50);
+    poll_sleep_ms = 0;
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (count, 4);
+    assert_in_range (poll_timeout, 1, 20);
+}
+/*
+ * All buffers are sent with a single 'writev' unless the write is short in
+ * which case the remaining data is sent with further calls.
+ */
+static void
+socket_xmit_bufv_test (void **state)
+{
+    TSS2_RC rc;
+    uint8_t buf0 [4] = { 0 }, buf1 [6] = { 0 };
+    struct iovec iov [2] = {
+        { .iov_base = buf0, .iov_len = sizeof (buf0) },
+        { .iov_base = buf1, .iov_len = sizeof (buf1) },
+    };
+
+    will_return (__wrap_writev, 10);
+    rc = socket_xmit_bufv (10, iov, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    iov [0].iov_base = buf0;
+    iov [0].iov_len = sizeof (buf0);
+    iov [1].iov_base = buf1;
+    iov [1].iov_len = sizeof (buf1);
+    will_return (__wrap_writev, 5);
+    will_return (__wrap_writev, 5);
+    rc = socket_xmit_bufv (10, iov, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (iov [1].iov_len, 0);
+    assert_ptr_equal (iov [1].iov_base, &buf1 [sizeof (buf1)]);
+
+    iov [0].iov_base = buf0;
+    iov [0].iov_len = sizeof (buf0);
+    will_return (__wrap_writev, -1);
+    rc = socket_xmit_bufv (10, iov, 1);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+}
 /* When passed all NULL values ensure that we get back the expected RC. */
 static void
 socket_connect_test (void **state)
@@ -200,6 +335,87 @@ socket_connect_null_test (void **state)
     assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
 }
 
+static void
+socket_connect_unix_test (void **state)
+{
+    TSS2_RC rc;
+    SOCKET sock = INVALID_SOCKET;
+
+    will_return (__wrap_socket, 0);
+    will_return (__wrap_socket, 1);
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_connect, 0);
+    rc = socket_connect_unix ("/run/swtpm/tpm.sock", 0, &sock);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (sock, 1);
+}
+static void
+socket_connect_unix_socket_fail_test (void **state)
+{
+    TSS2_RC rc;
+    SOCKET sock;
+
+    will_return (__wrap_socket, EAFNOSUPPORT);
+    will_return (__wrap_socket, -1);
+    rc = socket_connect_unix ("/run/swtpm/tpm.sock", 0, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+}
+/* Paths that do not fit into sun_path are rejected before socket is called. */
+static void
+socket_connect_unix_bad_path_test (void **state)
+{
+    TSS2_RC rc;
+    SOCKET sock;
+    char path[sizeof (((struct sockaddr_un*)0)->sun_path) + 1];
+
+    memset (path, 'a', sizeof (path) - 1);
+    path[sizeof (path) - 1] = '\0';
+    rc = socket_connect_unix (path, 0, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = socket_connect_unix ("", 0, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = socket_connect_unix (NULL, 0, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
+}
+/*
+ * Socket options from a TCTI conf string are parsed as unsigned integers,
+ * anything else is rejected.
+ */
+static void
+socket_conf_kv_test (void **state)
+{
+    socket_conf_t conf = SOCKET_CONF_DEFAULT_INIT;
+    key_value_t kv_connect = { .key = "connect_timeout", .value = "250" };
+    key_value_t kv_io = { .key = "io_timeout", .value = "5000" };
+    key_value_t kv_reconnect = { .key = "reconnect", .value = "4" };
+    key_value_t kv_delay = { .key = "reconnect_delay", .value = "20" };
+    key_value_t kv_nan = { .key = "reconnect", .value = "4x" };
+    key_value_t kv_empty = { .key = "io_timeout", .value = "" };
+    key_value_t kv_large = { .key = "io_timeout", .value = "4294967296" };
+    key_value_t kv_unknown = { .key = "nodelay", .value = "1" };
+    key_value_t kv_no_delay = { .key = "reconnect_delay", .value = "0" };
+
+    assert_int_equal (conf.connect_timeout, 0);
+    assert_int_equal (conf.io_timeout, 0);
+    assert_int_equal (conf.reconnect, 0);
+    assert_int_equal (conf.reconnect_delay, SOCKET_RECONNECT_DELAY);
+
+    assert_int_equal (socket_conf_kv (&kv_connect, &conf), TSS2_RC_SUCCESS);
+    assert_int_equal (socket_conf_kv (&kv_io, &conf), TSS2_RC_SUCCESS);
+    assert_int_equal (socket_conf_kv (&kv_reconnect, &conf), TSS2_RC_SUCCESS);
+    assert_int_equal (socket_conf_kv (&kv_delay, &conf), TSS2_RC_SUCCESS);
+    assert_int_equal (conf.connect_timeout, 250);
+    assert_int_equal (conf.io_timeout, 5000);
+    assert_int_equal (conf.reconnect, 4);
+    assert_int_equal (conf.reconnect_delay, 20);
+
+    assert_int_equal (socket_conf_kv (&kv_nan, &conf), TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (socket_conf_kv (&kv_empty, &conf), TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (socket_conf_kv (&kv_large, &conf), TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (socket_conf_kv (&kv_unknown, &conf), TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (socket_conf_kv (&kv_no_delay, &conf), TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (conf.reconnect_delay, 20);
+}
 int
 main (int   argc,
       char *argv[])
@@ -208,6 +424,10 @@ main (int   argc,
         cmocka_unit_test (write_all_simple_success_test),
         cmocka_unit_test (read_all_eof_test),
         cmocka_unit_test (read_all_twice_eof),
+        cmocka_unit_test (socket_recv_buffered_short_reads_test),
+        cmocka_unit_test (socket_recv_buffered_try_again_eof_test),
+        cmocka_unit_test (socket_recv_buffered_deadline_test),
+        cmocka_unit_test (socket_xmit_bufv_test),
         cmocka_unit_test (socket_connect_test),
         cmocka_unit_test (socket_connect_null_test),
         cmocka_unit_test (socket_connect_socket_fail_test),
@@ -215,6 +435,10 @@ main (int   argc,
         cmocka_unit_test (socket_ipv6_connect_test),
         cmocka_unit_test (socket_ipv6_connect_socket_fail_test),
         cmocka_unit_test (socket_ipv6_connect_connect_fail_test),
+        cmocka_unit_test (socket_connect_unix_test),
+        cmocka_unit_test (socket_connect_unix_socket_fail_test),
+        cmocka_unit_test (socket_connect_unix_bad_path_test),
+        cmocka_unit_test (socket_conf_kv_test),
     };
     return cmocka_run_group_tests (tests, NULL, NULL);
 }
@@ -0,0 +1,542 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2021, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_cache.h"
+
+#include "tss2-tcti/tcti-common.h"
+#include "tss2-tcti/tcti-cache.h"
+#include "tss2-tcti/tctildr.h"
+
+#define TCTI_STUB_MAGIC 0x4b9e2d716c3a8f05ULL
+#define TCTI_STUB_FAIL_CONF "fail"
+
+/* TPM2_ReadPublic of handle 0x81000001 */
+static const uint8_t read_public [] = { 0x80, 0x01,
+                                        0x00, 0x00, 0x00, 0x0e,
+                                        0x00, 0x00, 0x01, 0x73,
+                                        0x81, 0x00, 0x00, 0x01 };
+/* TPM2_GetRandom of 8 bytes */
+static const uint8_t get_random [] = { 0x80, 0x01,
+                                       0x00, 0x00, 0x00, 0x0c,
+                                       0x00, 0x00, 0x01, 0x7b,
+                                       0x00, 0x08 };
+/* TPM2_GetCapability of 8 TPM properties starting at TPM2_PT_FIXED */
+static const uint8_t get_cap_fixed [] = { 0x80, 0x01,
+                                          0x00, 0x00, 0x00, 0x16,
+                                          0x00, 0x00, 0x01, 0x7a,
+                                          0x00, 0x00, 0x00, 0x06,
+                                          0x00, 0x00, 0x01, 0x00,
+                                          0x00, 0x00, 0x00, 0x08 };
+/* TPM2_GetCapability of the TPM properties from TPM2_PT_LOCKOUT_COUNTER */
+static const uint8_t get_cap_var [] = { 0x80, 0x01,
+                                        0x00, 0x00, 0x00, 0x16,
+                                        0x00, 0x00, 0x01, 0x7a,
+                                        0x00, 0x00, 0x00, 0x06,
+                                        0x00, 0x00, 0x02, 0x0e,
+                                        0x00, 0x00, 0x00, 0x01 };
+/* TPM2_GetCapability of the loaded session handles */
+static const uint8_t get_cap_handles [] = { 0x80, 0x01,
+                                            0x00, 0x00, 0x00, 0x16,
+                                            0x00, 0x00, 0x01, 0x7a,
+                                            0x00, 0x00, 0x00, 0x01,
+                                            0x02, 0x00, 0x00, 0x00,
+                                            0x00, 0x00, 0x00, 0x10 };
+/* TPM2_EvictControl, parameters left out */
+static const uint8_t evict_control [] = { 0x80, 0x02,
+                                          0x00, 0x00, 0x00, 0x0a,
+                                          0x00, 0x00, 0x01, 0x20 };
+
+/*
+ * Child TCTI stub counting the commands it receives. Its responses carry
+ * the number of the command and the configured response code.
+ */
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    size_t transmitted;
+    TSS2_RC rc;
+} TSS2_TCTI_STUB_CONTEXT;
+
+static TSS2_RC
+tcti_stub_transmit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_transmit_checks (&stub->common, cmd_buf, TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    stub->transmitted++;
+    stub->common.state = TCTI_STATE_RECEIVE;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    uint8_t *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    tpm_header_t header = { TPM2_ST_NO_SESSIONS, TPM_HEADER_SIZE + 1,
+                            stub->rc };
+    TSS2_RC rc;
+
+    rc = tcti_common_receive_checks (&stub->common, response_size,
+                                     TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (response_buffer == NULL) {
+        *response_size = header.size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*response_size < header.size) {
+        *response_size = header.size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    header_marshal (&header, response_buffer);
+    response_buffer [TPM_HEADER_SIZE] = (uint8_t)stub->transmitted;
+    *response_size = header.size;
+    stub->common.state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_cancel_checks (&stub->common, TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    stub->common.state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Replacement for the tctildr functions used by the cache. Every conf string
+ * except "fail" creates a new stub child.
+ */
+TSS2_RC
+Tss2_TctiLdr_Initialize (const char *nameConf,
+                         TSS2_TCTI_CONTEXT **tctiContext)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common;
+
+    *tctiContext = NULL;
+    if (nameConf != NULL && strcmp (nameConf, TCTI_STUB_FAIL_CONF) == 0) {
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    stub = calloc (1, sizeof (TSS2_TCTI_STUB_CONTEXT));
+    assert_non_null (stub);
+    tcti_common = &stub->common;
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_STUB_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_stub_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_stub_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = NULL;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_stub_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = NULL;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = NULL;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = NULL;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+
+    *tctiContext = (TSS2_TCTI_CONTEXT*)stub;
+    return TSS2_RC_SUCCESS;
+}
+
+void
+Tss2_TctiLdr_Finalize (TSS2_TCTI_CONTEXT **tctiContext)
+{
+    free (*tctiContext);
+    *tctiContext = NULL;
+}
+
+static TSS2_TCTI_STUB_CONTEXT*
+tcti_cache_stub (TSS2_TCTI_CONTEXT *ctx)
+{
+    return (TSS2_TCTI_STUB_CONTEXT*)((TSS2_TCTI_CACHE_CONTEXT*)ctx)->tcti_child;
+}
+
+/*
+ * Send a command through the cache and return the first response byte after
+ * the header, i.e. the number of the command received by the stub child.
+ */
+static uint8_t
+tcti_cache_roundtrip (
+    TSS2_TCTI_CONTEXT *ctx,
+    const uint8_t *cmd,
+    size_t cmd_size)
+{
+    uint8_t rsp [TPM_HEADER_SIZE + 1] = { 0 };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Transmit (ctx, cmd_size, cmd);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (rsp));
+
+    size = 4;
+    rc = Tss2_Tcti_Receive (ctx, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, sizeof (rsp));
+
+    rc = Tss2_Tcti_Receive (ctx, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (rsp));
+
+    return rsp [TPM_HEADER_SIZE];
+}
+
+static void
+tcti_cache_init_size_test (void **state)
+{
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Cache_Init (NULL, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    rc = Tss2_Tcti_Cache_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (TSS2_TCTI_CACHE_CONTEXT));
+}
+
+static void
+tcti_cache_init_fail_test (void **state)
+{
+    TSS2_TCTI_CACHE_CONTEXT tcti_cache;
+    TSS2_RC rc;
+
+    unsetenv (ENV_CACHE_COMMANDS);
+    rc = Tss2_Tcti_Cache_Init ((TSS2_TCTI_CONTEXT*)&tcti_cache, NULL,
+                               TCTI_STUB_FAIL_CONF);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+
+    setenv (ENV_CACHE_COMMANDS, "0x17a,read_public", 1);
+    rc = Tss2_Tcti_Cache_Init ((TSS2_TCTI_CONTEXT*)&tcti_cache, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    unsetenv (ENV_CACHE_COMMANDS);
+}
+
+static void
+tcti_cache_parse_commands_test (void **state)
+{
+    TSS2_TCTI_CACHE_CONTEXT tcti_cache;
+    TSS2_RC rc;
+
+    rc = tcti_cache_parse_commands (&tcti_cache, " 0x17a, 371 ,0x00000176");
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_cache.num_commands, 3);
+    assert_int_equal (tcti_cache.commands [0], TPM2_CC_GetCapability);
+    assert_int_equal (tcti_cache.commands [1], TPM2_CC_ReadPublic);
+    assert_int_equal (tcti_cache.commands [2], TPM2_CC_StartAuthSession);
+
+    rc = tcti_cache_parse_commands (&tcti_cache, "");
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_cache.num_commands, 0);
+
+    rc = tcti_cache_parse_commands (&tcti_cache, "0x17ag");
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = tcti_cache_parse_commands (&tcti_cache, "0x1ffffffff");
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+
+static int
+tcti_cache_setup (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Cache_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    ctx = calloc (1, size);
+    assert_non_null (ctx);
+
+    unsetenv (ENV_CACHE_COMMANDS);
+    rc = Tss2_Tcti_Cache_Init (ctx, &size, "stub");
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+tcti_cache_teardown (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+    return 0;
+}
+
+/*
+ * The second identical TPM2_ReadPublic is answered from the cache.
+ */
+static void
+tcti_cache_hit_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_STUB_CONTEXT *stub = tcti_cache_stub (ctx);
+    TSS2_TCTI_CACHE_STATS stats;
+    TSS2_TCTILDR_CONTEXT tctildr = { 0 };
+    TSS2_RC rc;
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 1);
+    assert_int_equal (stub->transmitted, 1);
+
+    rc = Tss2_Tcti_Cache_GetStats (ctx, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 1);
+    assert_int_equal (stats.invalidations, 0);
+
+    /* A hit can be cancelled without involving the child. */
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (read_public), read_public);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_Tcti_Cancel (ctx);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stub->common.state, TCTI_STATE_TRANSMIT);
+
+    rc = Tss2_Tcti_Cache_GetStats (ctx, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
+    rc = Tss2_Tcti_Cache_GetStats ((TSS2_TCTI_CONTEXT*)stub, &stats);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
+
+    /* Applications may only hold the tctildr context of the cache. */
+    tctildr.v2.v1.magic = TCTILDR_MAGIC;
+    tctildr.tcti = ctx;
+    memset (&stats, 0, sizeof (stats));
+    rc = Tss2_Tcti_Cache_GetStats ((TSS2_TCTI_CONTEXT*)&tctildr, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 2);
+    tctildr.tcti = (TSS2_TCTI_CONTEXT*)stub;
+    rc = Tss2_Tcti_Cache_GetStats ((TSS2_TCTI_CONTEXT*)&tctildr, &stats);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
+}
+
+/*
+ * Commands not on the allow-list, commands with sessions and error
+ * responses always go to the child.
+ */
+static void
+tcti_cache_miss_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_STUB_CONTEXT *stub = tcti_cache_stub (ctx);
+    TSS2_TCTI_CACHE_STATS stats;
+    uint8_t read_public_sessions [sizeof (read_public)];
+    TSS2_RC rc;
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_random,
+                                            sizeof (get_random)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_random,
+                                            sizeof (get_random)), 2);
+
+    memcpy (read_public_sessions, read_public, sizeof (read_public));
+    read_public_sessions [1] = 0x02;
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public_sessions,
+                                            sizeof (read_public)), 3);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public_sessions,
+                                            sizeof (read_public)), 4);
+
+    stub->rc = TPM2_RC_HANDLE;
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 5);
+    stub->rc = TPM2_RC_SUCCESS;
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 6);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 6);
+
+    rc = Tss2_Tcti_Cache_GetStats (ctx, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 2);
+}
+
+/*
+ * TPM2_EvictControl drops all cached responses.
+ */
+static void
+tcti_cache_invalidate_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_CACHE_STATS stats;
+    TSS2_RC rc;
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, evict_control,
+                                            sizeof (evict_control)), 2);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 3);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 3);
+
+    rc = Tss2_Tcti_Cache_GetStats (ctx, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.hits, 1);
+    assert_int_equal (stats.misses, 2);
+    assert_int_equal (stats.invalidations, 1);
+}
+
+/*
+ * TPM2_GetCapability is only cached for capabilities that can not change on
+ * their own; handles and variable properties are always read from the TPM.
+ */
+static void
+tcti_cache_get_capability_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_STUB_CONTEXT *stub = tcti_cache_stub (ctx);
+    uint8_t get_cap_cross [sizeof (get_cap_fixed)];
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_fixed,
+                                            sizeof (get_cap_fixed)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_fixed,
+                                            sizeof (get_cap_fixed)), 1);
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_var,
+                                            sizeof (get_cap_var)), 2);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_var,
+                                            sizeof (get_cap_var)), 3);
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_handles,
+                                            sizeof (get_cap_handles)), 4);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_handles,
+                                            sizeof (get_cap_handles)), 5);
+
+    /* a request reaching into TPM2_PT_VAR is not cached either */
+    memcpy (get_cap_cross, get_cap_fixed, sizeof (get_cap_fixed));
+    get_cap_cross [sizeof (get_cap_cross) - 2] = 0x01;
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_cross,
+                                            sizeof (get_cap_cross)), 6);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_cap_cross,
+                                            sizeof (get_cap_cross)), 7);
+    assert_int_equal (stub->transmitted, 7);
+}
+
+/*
+ * Once the cache is full, the least recently used response is replaced.
+ */
+static void
+tcti_cache_lru_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_STUB_CONTEXT *stub = tcti_cache_stub (ctx);
+    uint8_t cmd [sizeof (read_public)];
+    size_t i;
+
+    memcpy (cmd, read_public, sizeof (read_public));
+    for (i = 0; i < TCTI_CACHE_ENTRIES; i++) {
+        cmd [sizeof (cmd) - 1] = (uint8_t)i;
+        tcti_cache_roundtrip (ctx, cmd, sizeof (cmd));
+    }
+    assert_int_equal (stub->transmitted, TCTI_CACHE_ENTRIES);
+
+    /* Use entry 0 so that entry 1 becomes the least recently used. */
+    cmd [sizeof (cmd) - 1] = 0;
+    assert_int_equal (tcti_cache_roundtrip (ctx, cmd, sizeof (cmd)), 1);
+
+    cmd [sizeof (cmd) - 1] = 0xff;
+    tcti_cache_roundtrip (ctx, cmd, sizeof (cmd));
+    assert_int_equal (stub->transmitted, TCTI_CACHE_ENTRIES + 1);
+
+    cmd [sizeof (cmd) - 1] = 0;
+    assert_int_equal (tcti_cache_roundtrip (ctx, cmd, sizeof (cmd)), 1);
+    cmd [sizeof (cmd) - 1] = 1;
+    tcti_cache_roundtrip (ctx, cmd, sizeof (cmd));
+    assert_int_equal (stub->transmitted, TCTI_CACHE_ENTRIES + 2);
+}
+
+/*
+ * The allow-list is taken from the environment.
+ */
+static void
+tcti_cache_env_commands_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_RC rc;
+
+    Tss2_Tcti_Finalize (ctx);
+    setenv (ENV_CACHE_COMMANDS, "0x17b", 1);
+    rc = Tss2_Tcti_Cache_Init (ctx, NULL, "stub");
+    unsetenv (ENV_CACHE_COMMANDS);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_random,
+                                            sizeof (get_random)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, get_random,
+                                            sizeof (get_random)), 1);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 2);
+    assert_int_equal (tcti_cache_roundtrip (ctx, read_public,
+                                            sizeof (read_public)), 3);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tcti_cache_init_size_test),
+        cmocka_unit_test (tcti_cache_init_fail_test),
+        cmocka_unit_test (tcti_cache_parse_commands_test),
+        cmocka_unit_test_setup_teardown (tcti_cache_hit_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_miss_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_invalidate_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_get_capability_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_lru_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+        cmocka_unit_test_setup_teardown (tcti_cache_env_commands_test,
+                                         tcti_cache_setup,
+                                         tcti_cache_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
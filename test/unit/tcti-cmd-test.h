@@ -46,4 +46,9 @@ static uint8_t getcap_good_resp[] = {
         0x00, 0x04, 0x00
 };
 
+/* A TPM2_RC_FAILURE response */
+static uint8_t failure_resp[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x01
+};
+
 #endif /* TEST_UNIT_TCTI_CMD_TEST_H_ */
@@ -15,6 +15,7 @@
 #include <string.h>
 
 #include <cmocka.h>
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
 
@@ -69,17 +70,6 @@ int tcti_cmd_fork (void)
     return -1;
 }
 
-FILE *tcti_cmd_fdopen (int fd, const char *mode)
-{
-    int rc = mock_type (int);
-    if (!rc) {
-        return fdopen (fd, mode);
-    }
-
-    errno = rc;
-    return NULL;
-}
-
 int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
 {
     int rc = mock_type (int);
@@ -91,35 +81,21 @@ int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
     return -1;
 }
 
-int tcti_cmd_ferror (FILE *stream)
+ssize_t tcti_cmd_write (int fd, const uint8_t *buf, size_t size)
 {
     int rc = mock_type (int);
     if (!rc) {
-        return ferror (stream);
+        return write_all (fd, buf, size);
     }
 
     errno = rc;
     return -1;
 }
 
-size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream)
-{
-    int rc = mock_type (int);
-    if (!rc) {
-        return fwrite (ptr, size, nmemb, stream);
-    }
-
-    will_return (tcti_cmd_ferror, rc);
-    errno = rc;
-    return 0;
-}
-
 TSS2_TCTI_CONTEXT *
 test_common_setup (const char *cmd)
 {
     will_return_always (tcti_cmd_sigprocmask, 0);
-    will_return_always (tcti_cmd_fdopen, 0);
     will_return_always (tcti_cmd_fork, 0);
     will_return_always (tcti_cmd_pipe, 0);
 
@@ -180,7 +156,7 @@ tcti_cmd_init_size_test (void **state)
 static void
 tcti_cmd_test_pipe_1_fail (void **state)
 {
-    uint8_t buf[4096];
+    uint8_t buf[sizeof (TSS2_TCTI_CMD_CONTEXT)];
     size_t tcti_size = sizeof (buf);
     TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
 
@@ -193,7 +169,7 @@ tcti_cmd_test_pipe_1_fail (void **state)
 static void
 tcti_cmd_test_pipe_2_fail (void **state)
 {
-    uint8_t buf[4096];
+    uint8_t buf[sizeof (TSS2_TCTI_CMD_CONTEXT)];
     size_t tcti_size = sizeof (buf);
     TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
 
@@ -208,7 +184,7 @@ tcti_cmd_test_pipe_2_fail (void **state)
 static void
 tcti_cmd_test_fork_fail (void **state)
 {
-    uint8_t buf[4096];
+    uint8_t buf[sizeof (TSS2_TCTI_CMD_CONTEXT)];
     size_t tcti_size = sizeof (buf);
     TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
 
@@ -221,46 +197,10 @@ tcti_cmd_test_fork_fail (void **state)
     assert_int_equal (rval, TSS2_TCTI_RC_GENERAL_FAILURE);
 }
 
-static void
-tcti_cmd_test_fdopen_1_fail (void **state)
-{
-    uint8_t buf[4096];
-    size_t tcti_size = sizeof (buf);
-    TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
-
-    will_return_always (tcti_cmd_pipe, 0);
-    will_return_always (tcti_cmd_fork, 0);
-    will_return_always (tcti_cmd_sigprocmask, 0);
-
-    will_return (tcti_cmd_fdopen, EINVAL);
-
-    TSS2_RC rval = Tss2_Tcti_Cmd_Init (tcti_context, &tcti_size, __func__);
-    assert_int_equal (rval, TSS2_TCTI_RC_GENERAL_FAILURE);
-}
-
-static void
-tcti_cmd_test_fdopen_2_fail (void **state)
-{
-    uint8_t buf[4096];
-    size_t tcti_size = sizeof (buf);
-    TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
-
-    will_return_always (tcti_cmd_pipe, 0);
-    will_return_always (tcti_cmd_fork, 0);
-    will_return_always (tcti_cmd_sigprocmask, 0);
-
-    /* first fdopen works, second fails */
-    will_return (tcti_cmd_fdopen, 0);
-    will_return (tcti_cmd_fdopen, EINVAL);
-
-    TSS2_RC rval = Tss2_Tcti_Cmd_Init (tcti_context, &tcti_size, __func__);
-    assert_int_equal (rval, TSS2_TCTI_RC_GENERAL_FAILURE);
-}
-
 static void
 tcti_cmd_test_sigprocmask_1_fail (void **state)
 {
-    uint8_t buf[4096];
+    uint8_t buf[sizeof (TSS2_TCTI_CMD_CONTEXT)];
     size_t tcti_size = sizeof (buf);
     TSS2_TCTI_CONTEXT *tcti_context = (TSS2_TCTI_CONTEXT *)buf;
 
@@ -275,12 +215,13 @@ tcti_cmd_test_sigprocmask_1_fail (void **state)
 static void
 tcti_cmd_test_good (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" good");
     assert_non_null (tcti_context);
+    /* no slots for early responses without pipelining */
+    assert_null (((TSS2_TCTI_CMD_CONTEXT *)tcti_context)->parked);
 
     /* send the command buffer */
     TSS2_RC rval = Tss2_Tcti_Transmit (tcti_context,
@@ -303,11 +244,10 @@ tcti_cmd_test_good (void **state)
 static void
 tcti_cmd_test_malformed_size_smaller (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
-            test_common_setup (EXECLP_CMD" smaller");
+            test_common_setup (EXECLP_CMD" small");
     assert_non_null (tcti_context);
 
     /* send the command buffer */
@@ -327,11 +267,10 @@ tcti_cmd_test_malformed_size_smaller (void **state)
 static void
 tcti_cmd_test_malformed_size_bigger (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
-            test_common_setup (EXECLP_CMD" bigger");
+            test_common_setup (EXECLP_CMD" big");
     assert_non_null (tcti_context);
 
     /* send the command buffer */
@@ -354,7 +293,7 @@ tcti_cmd_test_malformed_size_bigger (void **state)
 static void
 tcti_cmd_test_transmit_fail (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, EBADF);
+    will_return_always (tcti_cmd_write, EBADF);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" good");
@@ -414,6 +353,138 @@ tcti_cmd_test_get_poll_handles_ok (void **state)
     TSS2_RC rval = Tss2_Tcti_GetPollHandles (tcti_context, &poll_handle, &num_of_handles);
     assert_int_equal (rval, TSS2_RC_SUCCESS);
     assert_int_equal(num_of_handles, 1);
+    assert_int_equal (poll_handle.fd,
+            ((TSS2_TCTI_CMD_CONTEXT *)tcti_context)->source);
+    assert_int_equal (poll_handle.events, POLLIN);
+}
+
+/*
+ * The subprocess only sends part of a response header, a receive with a
+ * timeout must return TSS2_TCTI_RC_TRY_AGAIN instead of blocking.
+ */
+static void
+tcti_cmd_test_receive_timeout (void **state)
+{
+    will_return_always (tcti_cmd_write, 0);
+
+    TSS2_TCTI_CONTEXT *tcti_context = *state =
+            test_common_setup (EXECLP_CMD" short");
+    assert_non_null (tcti_context);
+
+    TSS2_RC rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    uint8_t rbuf[sizeof (getcap_good_resp)];
+    size_t rsize = sizeof (rbuf);
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 100);
+    assert_int_equal (rval, TSS2_TCTI_RC_TRY_AGAIN);
+
+    /* the partial header is kept and the response can still be waited for */
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 10);
+    assert_int_equal (rval, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (((TSS2_TCTI_CMD_CONTEXT *)tcti_context)->rsp_count, 8);
+}
+
+static void
+tcti_cmd_test_pipeline_conf_fail (void **state)
+{
+    const char *confs[] = {
+        "pipeline=0;"EXECLP_CMD" tagged",
+        "pipeline=9;"EXECLP_CMD" tagged",
+        "pipeline=two;"EXECLP_CMD" tagged",
+        "pipeline=2,depth=2;"EXECLP_CMD" tagged",
+        "pipeline=2",
+    };
+    uint8_t buf[sizeof (TSS2_TCTI_CMD_CONTEXT)];
+    size_t tcti_size = sizeof (buf);
+    size_t i;
+
+    for (i = 0; i < sizeof (confs) / sizeof (confs[0]); i++) {
+        TSS2_RC rval = Tss2_Tcti_Cmd_Init ((TSS2_TCTI_CONTEXT *)buf,
+                &tcti_size, confs[i]);
+        assert_int_equal (rval, TSS2_TCTI_RC_BAD_VALUE);
+    }
+}
+
+/*
+ * Two tagged commands are in flight at once. The subprocess answers them in
+ * reverse order and each response must still be matched to its command.
+ */
+static void
+tcti_cmd_test_pipeline (void **state)
+{
+    will_return_always (tcti_cmd_write, 0);
+
+    TSS2_TCTI_CONTEXT *tcti_context = *state =
+            test_common_setup ("pipeline=2;"EXECLP_CMD" tagged");
+    assert_non_null (tcti_context);
+    assert_non_null (((TSS2_TCTI_CMD_CONTEXT *)tcti_context)->parked);
+
+    TSS2_RC rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    /* the pipeline is full */
+    rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    uint8_t rbuf[sizeof (getcap_good_resp)];
+    size_t rsize = sizeof (failure_resp);
+
+    /* the response to the first command arrives last */
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (rsize, sizeof (getcap_good_resp));
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (getcap_good_resp));
+    assert_memory_equal (rbuf, getcap_good_resp, rsize);
+
+    /* a new command may be sent while the second is still in flight */
+    rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    rsize = sizeof (rbuf);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (failure_resp));
+    assert_memory_equal (rbuf, failure_resp, rsize);
+
+    /* the third command is answered once a fourth one is sent */
+    rsize = sizeof (rbuf);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 100);
+    assert_int_equal (rval, TSS2_TCTI_RC_TRY_AGAIN);
+
+    rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_memory_equal (rbuf, getcap_good_resp, rsize);
+
+    rsize = sizeof (rbuf);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_memory_equal (rbuf, failure_resp, rsize);
+
+    /* nothing is in flight anymore */
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_TCTI_RC_BAD_SEQUENCE);
 }
 
 static void
@@ -447,9 +518,8 @@ main (int   argc,
         cmocka_unit_test (tcti_cmd_test_pipe_1_fail),
         cmocka_unit_test (tcti_cmd_test_pipe_2_fail),
         cmocka_unit_test (tcti_cmd_test_fork_fail),
-        cmocka_unit_test (tcti_cmd_test_fdopen_1_fail),
-        cmocka_unit_test (tcti_cmd_test_fdopen_2_fail),
         cmocka_unit_test (tcti_cmd_test_sigprocmask_1_fail),
+        cmocka_unit_test (tcti_cmd_test_pipeline_conf_fail),
         /*
          * Tests that **do** require a teardown routine as they
          * **do** fork/exec successfully and thus get a TCTI_CONTEXT
@@ -478,6 +548,12 @@ main (int   argc,
         cmocka_unit_test_teardown (
             tcti_cmd_test_get_info,
             test_teardown),
+        cmocka_unit_test_teardown (
+            tcti_cmd_test_receive_timeout,
+            test_teardown),
+        cmocka_unit_test_teardown (
+            tcti_cmd_test_pipeline,
+            test_teardown),
     };
 
     return cmocka_run_group_tests (tests, NULL, NULL);
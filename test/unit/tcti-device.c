@@ -14,6 +14,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <poll.h>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <sys/socket.h>
+#endif
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -439,6 +443,179 @@ tcti_device_poll_io_error (void **state)
     assert_true (rc == TSS2_TCTI_RC_IO_ERROR);
 }
 
+#ifdef HAVE_LIBURING
+ssize_t __real_read (int fd, void *buf, size_t count);
+ssize_t __real_write (int fd, const void *buffer, size_t buffer_size);
+
+/* The TPM end of the socket pair standing in for the device file. */
+static int tpm_fd = -1;
+
+/* Whether the opcode probe fails, as on kernels before 5.6. */
+static bool probe_fail = false;
+
+struct io_uring_probe *__real_io_uring_get_probe_ring (struct io_uring *ring);
+
+struct io_uring_probe *
+__wrap_io_uring_get_probe_ring (struct io_uring *ring)
+{
+    if (probe_fail) {
+        return NULL;
+    }
+    return __real_io_uring_get_probe_ring (ring);
+}
+
+/*
+ * Setup function for the io_uring tests: the device file is replaced by a
+ * socket pair since the requests submitted to the ring bypass the mocked
+ * read and write functions.
+ */
+static int
+tcti_device_ring_setup (void **state)
+{
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev;
+    int fds [2];
+
+    tcti_device_setup (state);
+    tcti_dev = (TSS2_TCTI_DEVICE_CONTEXT*)*state;
+    assert_int_equal (socketpair (AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    tcti_dev->fd = fds [0];
+    tpm_fd = fds [1];
+    tcti_device_ring_init (tcti_dev);
+
+    return 0;
+}
+
+static int
+tcti_device_ring_teardown (void **state)
+{
+    if (tpm_fd >= 0) {
+        close (tpm_fd);
+        tpm_fd = -1;
+    }
+    return tcti_device_teardown (state);
+}
+
+/*
+ * A command is written and its response read through the ring. The
+ * response size is reported and the response copied without further reads
+ * from the device.
+ */
+static void
+tcti_device_ring_success (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev = (TSS2_TCTI_DEVICE_CONTEXT*)ctx;
+    TSS2_TCTI_POLL_HANDLE handle;
+    size_t num_handles = 1;
+    uint8_t buf [BUF_SIZE] = { 0 };
+    size_t size = 0;
+    TSS2_RC rc;
+
+    if (!tcti_dev->ring_enabled) {
+        skip ();
+    }
+
+    rc = Tss2_Tcti_Transmit (ctx, BUF_SIZE, tpm2_buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+
+    rc = Tss2_Tcti_GetPollHandles (ctx, &handle, &num_handles);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (handle.fd, tcti_dev->ring.ring_fd);
+    assert_int_equal (handle.events, POLLIN);
+
+    assert_int_equal (__real_read (tpm_fd, buf, sizeof (buf)), BUF_SIZE);
+    assert_memory_equal (buf, tpm2_buf, BUF_SIZE);
+    assert_int_equal (__real_write (tpm_fd, tpm2_buf, BUF_SIZE), BUF_SIZE);
+
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, BUF_SIZE);
+
+    size = TPM_HEADER_SIZE;
+    rc = Tss2_Tcti_Receive (ctx, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, BUF_SIZE);
+
+    memset (buf, 0, sizeof (buf));
+    rc = Tss2_Tcti_Receive (ctx, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, BUF_SIZE);
+    assert_memory_equal (buf, tpm2_buf, BUF_SIZE);
+    assert_int_equal (tcti_dev->common.state, TCTI_STATE_TRANSMIT);
+}
+
+/*
+ * The device being closed instead of responding is reported by receive.
+ */
+static void
+tcti_device_ring_eof (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev = (TSS2_TCTI_DEVICE_CONTEXT*)ctx;
+    uint8_t buf [BUF_SIZE] = { 0 };
+    size_t size = BUF_SIZE;
+    TSS2_RC rc;
+
+    if (!tcti_dev->ring_enabled) {
+        skip ();
+    }
+
+    rc = Tss2_Tcti_Transmit (ctx, BUF_SIZE, tpm2_buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (__real_read (tpm_fd, buf, sizeof (buf)), BUF_SIZE);
+    close (tpm_fd);
+    tpm_fd = -1;
+
+    rc = Tss2_Tcti_Receive (ctx, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_NO_CONNECTION);
+    assert_int_equal (tcti_dev->common.state, TCTI_STATE_TRANSMIT);
+}
+
+/*
+ * A command is not submitted if the submission queue has no room for both
+ * of its requests, and no entry is taken from the queue.
+ */
+static void
+tcti_device_ring_sq_full (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev = (TSS2_TCTI_DEVICE_CONTEXT*)ctx;
+    TSS2_RC rc;
+
+    if (!tcti_dev->ring_enabled) {
+        skip ();
+    }
+
+    while (io_uring_sq_space_left (&tcti_dev->ring) > 1) {
+        assert_non_null (io_uring_get_sqe (&tcti_dev->ring));
+    }
+
+    rc = Tss2_Tcti_Transmit (ctx, BUF_SIZE, tpm2_buf);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+    assert_int_equal (io_uring_sq_space_left (&tcti_dev->ring), 1);
+    assert_int_equal (tcti_dev->common.state, TCTI_STATE_TRANSMIT);
+}
+
+/*
+ * A ring without support for read and write requests is not used, the
+ * device is accessed with read and write.
+ */
+static void
+tcti_device_ring_no_opcodes (void **state)
+{
+    TSS2_TCTI_DEVICE_CONTEXT *tcti_dev = (TSS2_TCTI_DEVICE_CONTEXT*)*state;
+    TSS2_RC rc;
+
+    probe_fail = true;
+    rc = tcti_device_ring_init (tcti_dev);
+    probe_fail = false;
+    assert_int_equal (rc, TSS2_TCTI_RC_NOT_SUPPORTED);
+    assert_false (tcti_dev->ring_enabled);
+}
+#endif /* HAVE_LIBURING */
+
 int
 main(int argc, char* argv[])
 {
@@ -475,6 +652,20 @@ main(int argc, char* argv[])
         cmocka_unit_test_setup_teardown (tcti_device_poll_io_error,
                                          tcti_device_setup,
                                          tcti_device_teardown),
+#ifdef HAVE_LIBURING
+        cmocka_unit_test_setup_teardown (tcti_device_ring_success,
+                                         tcti_device_ring_setup,
+                                         tcti_device_ring_teardown),
+        cmocka_unit_test_setup_teardown (tcti_device_ring_eof,
+                                         tcti_device_ring_setup,
+                                         tcti_device_ring_teardown),
+        cmocka_unit_test_setup_teardown (tcti_device_ring_sq_full,
+                                         tcti_device_ring_setup,
+                                         tcti_device_ring_teardown),
+        cmocka_unit_test_setup_teardown (tcti_device_ring_no_opcodes,
+                                         tcti_device_setup,
+                                         tcti_device_teardown),
+#endif
     };
     return cmocka_run_group_tests (tests, NULL, NULL);
 }
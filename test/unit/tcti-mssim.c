@@ -23,6 +23,7 @@
 
 #include "tss2-tcti/tcti-common.h"
 #include "tss2-tcti/tcti-mssim.h"
+#include "tss2-tcti/tctildr.h"
 #include "util/key-value-parse.h"
 
 /*
@@ -136,6 +137,41 @@ conf_str_to_host_port_invalid_port_0_test (void **state)
     rc = parse_key_value_string (conf, mssim_kv_callback, &mssim_conf);
     assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
 }
+/*
+ * The socket options are parsed into the socket_conf_t member of the mssim
+ * configuration.
+ */
+static void
+conf_str_socket_options_test (void **state)
+{
+    TSS2_RC rc;
+    char conf[] = "host=127.0.0.1,connect_timeout=500,io_timeout=1000,"
+                  "reconnect=3,reconnect_delay=10";
+    mssim_conf_t mssim_conf = MSSIM_CONF_DEFAULT_INIT;
+
+    rc = parse_key_value_string (conf, mssim_kv_callback, &mssim_conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_string_equal (mssim_conf.host, "127.0.0.1");
+    assert_int_equal (mssim_conf.port, 2321);
+    assert_int_equal (mssim_conf.socket.connect_timeout, 500);
+    assert_int_equal (mssim_conf.socket.io_timeout, 1000);
+    assert_int_equal (mssim_conf.socket.reconnect, 3);
+    assert_int_equal (mssim_conf.socket.reconnect_delay, 10);
+}
+/* Socket options that are not numbers and unknown keys are rejected. */
+static void
+conf_str_socket_options_invalid_test (void **state)
+{
+    TSS2_RC rc;
+    char conf_nan[] = "host=127.0.0.1,reconnect=foo";
+    char conf_unknown[] = "host=127.0.0.1,keepalive=1";
+    mssim_conf_t mssim_conf = MSSIM_CONF_DEFAULT_INIT;
+
+    rc = parse_key_value_string (conf_nan, mssim_kv_callback, &mssim_conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = parse_key_value_string (conf_unknown, mssim_kv_callback, &mssim_conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
 
 /* When passed all NULL values ensure that we get back the expected RC. */
 static void
@@ -200,6 +236,17 @@ __wrap_write (int sockfd,
 {
     return mock_type (TSS2_RC);
 }
+/*
+ * Wrap the 'writev' system call. The mock queue for this function must have
+ * an integer to return as a response.
+ */
+ssize_t
+__wrap_writev (int fd,
+               const struct iovec *iov,
+               int iovcnt)
+{
+    return mock_type (ssize_t);
+}
 /*
  * Wrap the 'poll' system call.
  */
@@ -325,8 +372,19 @@ tcti_socket_receive_null_size_test (void **state)
                             TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
 }
+/*
+ * Response as framed by the simulator: 4 byte size, the TPM response and
+ * 4 bytes of 0's.
+ */
+static uint8_t response_frame [] = { 0x00, 0x00, 0x00, 0x0c,
+                                     0x80, 0x02,
+                                     0x00, 0x00, 0x00, 0x0c,
+                                     0x00, 0x00, 0x00, 0x00,
+                                     0x01, 0x02,
+                                     0x00, 0x00, 0x00, 0x00 };
 /*
  * This test exercises the successful code path through the receive function.
+ * The whole framed response is received with a single poll and read.
  */
 static void
 tcti_socket_receive_success_test (void **state)
@@ -335,40 +393,22 @@ tcti_socket_receive_success_test (void **state)
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
     TSS2_RC rc = TSS2_RC_SUCCESS;
     size_t response_size = 0xc;
-    uint8_t response_in [] = { 0x80, 0x02,
-                               0x00, 0x00, 0x00, 0x0c,
-                               0x00, 0x00, 0x00, 0x00,
-                               0x01, 0x02,
-    /* simulator appends 4 bytes of 0's to every response */
-                               0x00, 0x00, 0x00, 0x00 };
     uint8_t response_out [12] = { 0 };
 
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
-    /* receive response size */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
-    /* receive tag */
     will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 2);
-    will_return (__wrap_read, response_in);
-    /* receive size (again)  */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
-    /* receive the rest of the command */
-    will_return (__wrap_read, 0xc - sizeof (TPM2_ST) - sizeof (UINT32));
-    will_return (__wrap_read, &response_in [6]);
-    /* receive the 4 bytes of 0's appended by the simulator */
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [12]);
+    will_return (__wrap_read, sizeof (response_frame));
+    will_return (__wrap_read, response_frame);
 
     rc = Tss2_Tcti_Receive (ctx, &response_size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
-    assert_memory_equal (response_in, response_out, response_size);
+    assert_int_equal (response_size, 0xc);
+    assert_memory_equal (&response_frame [4], response_out, response_size);
 }
 /*
+ * Query the response size first, then receive the response that has already
+ * been buffered by the first call.
  */
 static void
 tcti_socket_receive_size_success_test (void **state)
@@ -377,42 +417,59 @@ tcti_socket_receive_size_success_test (void **state)
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
     TSS2_RC rc = TSS2_RC_SUCCESS;
     size_t response_size = 0;
-    uint8_t response_in [] = { 0x80, 0x02,
-                               0x00, 0x00, 0x00, 0x0c,
-                               0x00, 0x00, 0x00, 0x00,
-                               0x01, 0x02,
-    /* simulator appends 4 bytes of 0's to every response */
-                               0x00, 0x00, 0x00, 0x00 };
     uint8_t response_out [12] = { 0 };
 
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
-    /* receive response size */
     will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
+    will_return (__wrap_read, sizeof (response_frame));
+    will_return (__wrap_read, response_frame);
     rc = Tss2_Tcti_Receive (ctx, &response_size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
 
     assert_int_equal (rc, TSS2_RC_SUCCESS);
     assert_int_equal (response_size, 0xc);
-    /* receive tag */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 2);
-    will_return (__wrap_read, response_in);
-    /* receive size (again)  */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
-    /* receive the rest of the command */
-    will_return (__wrap_read, 0xc - sizeof (TPM2_ST) - sizeof (UINT32));
-    will_return (__wrap_read, &response_in [6]);
-    /* receive the 4 bytes of 0's appended by the simulator */
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [12]);
 
     rc = Tss2_Tcti_Receive (ctx, &response_size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
-    assert_memory_equal (response_in, response_out, response_size);
+    assert_memory_equal (&response_frame [4], response_out, response_size);
+}
+/*
+ * The response arrives in pieces and the poll times out in between. The
+ * partial response is kept in the context and completed by the next call.
+ */
+static void
+tcti_socket_receive_partial_try_again_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    size_t response_size = 0xc;
+    uint8_t response_out [12] = { 0 };
+
+    /* Keep state machine check in `receive` from returning error. */
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 6);
+    will_return (__wrap_read, response_frame);
+    will_return (__wrap_poll, 0);
+    /* the poll timeout is simulated by the mock */
+    rc = Tss2_Tcti_Receive (ctx, &response_size, response_out,
+                            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (tcti_common->state, TCTI_STATE_RECEIVE);
+
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 8);
+    will_return (__wrap_read, &response_frame [6]);
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, sizeof (response_frame) - 14);
+    will_return (__wrap_read, &response_frame [14]);
+    rc = Tss2_Tcti_Receive (ctx, &response_size, response_out,
+                            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (response_size, 0xc);
+    assert_memory_equal (&response_frame [4], response_out, response_size);
+    assert_int_equal (tcti_common->state, TCTI_STATE_TRANSMIT);
 }
 /*
  * This test causes the underlying 'read' call to return 0 / EOF when we
@@ -451,13 +508,6 @@ tcti_mssim_receive_eof_second_read_test (void **state)
     TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
     TSS2_RC rc;
-    /* input response buffer */
-    uint8_t response_in [] = { 0x80, 0x02,
-                               0x00, 0x00, 0x00, 0x0c,
-                               0x00, 0x00, 0x00, 0x00,
-                               0x01, 0x02,
-    /* simulator appends 4 bytes of 0's to every response */
-                               0x00, 0x00, 0x00, 0x00 };
     /* output response buffer */
     uint8_t response_out [12] = { 0 };
     size_t size = sizeof (response_out);
@@ -467,17 +517,37 @@ tcti_mssim_receive_eof_second_read_test (void **state)
     /* setup response size for first read */
     will_return (__wrap_poll, 1);
     will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
+    will_return (__wrap_read, response_frame);
     /* setup 0 for EOF on second read */
     will_return (__wrap_poll, 1);
     will_return (__wrap_read, 0);
-    will_return (__wrap_read, response_in);
+    will_return (__wrap_read, response_frame);
     rc = Tss2_Tcti_Receive (ctx,
                             &size,
                             response_out,
                             TSS2_TCTI_TIMEOUT_BLOCK);
     assert_true (rc == TSS2_TCTI_RC_IO_ERROR);
 }
+/*
+ * A response size larger than the maximum TPM response is rejected.
+ */
+static void
+tcti_mssim_receive_too_large_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
+    TSS2_RC rc;
+    uint8_t size_in [] = { 0x00, 0x01, 0x00, 0x00 };
+    size_t size = 0;
+
+    /* Keep state machine check in `receive` from returning error. */
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, sizeof (size_in));
+    will_return (__wrap_read, size_in);
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_MALFORMED_RESPONSE);
+}
 /*
  * This test exercises the successful code path through the transmit function.
  */
@@ -492,16 +562,92 @@ tcti_socket_transmit_success_test (void **state)
                            0x01, 0x02 };
     size_t  command_size = sizeof (command);
 
-    /* send the TPM2_SEND_COMMAND code */
+    /*
+     * send the TPM2_SEND_COMMAND code, the locality, the number of bytes in
+     * the command and the command buffer with a single call
+     */
+    will_return (__wrap_writev, 4 + 1 + 4 + 0xc);
+    rc = Tss2_Tcti_Transmit (ctx, command_size, command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+/*
+ * The simulator closes the connection while we wait for a response. The
+ * receive fails, the next transmit reconnects both sockets, powers the
+ * simulator back on and sends the command on the new connection.
+ */
+static void
+tcti_mssim_reconnect_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = (TSS2_TCTI_MSSIM_CONTEXT*)ctx;
+    TSS2_RC rc;
+    uint8_t recv_buf[4] = { 0 };
+    uint8_t command [] = { 0x80, 0x02,
+                           0x00, 0x00, 0x00, 0x0c,
+                           0x00, 0x00, 0x00, 0x00,
+                           0x01, 0x02 };
+    size_t size = sizeof (command);
+
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 0);
+    will_return (__wrap_read, recv_buf);
+    rc = Tss2_Tcti_Receive (ctx, &size, command, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+    assert_int_equal (tcti_mssim->tpm_sock, INVALID_SOCKET);
+    assert_int_equal (tcti_mssim->platform_sock, INVALID_SOCKET);
+
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_connect, 0);
     will_return (__wrap_write, 4);
-    /* send the locality for the command */
-    will_return (__wrap_write, 1);
-    /* send the number of bytes in command */
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, recv_buf);
     will_return (__wrap_write, 4);
-    /* send the command buffer */
-    will_return (__wrap_write, 0xc);
-    rc = Tss2_Tcti_Transmit (ctx, command_size, command);
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, recv_buf);
+    will_return (__wrap_writev, 4 + 1 + 4 + 0xc);
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_not_equal (tcti_mssim->tpm_sock, INVALID_SOCKET);
+    assert_int_equal (tcti_mssim->reconnects, 1);
+    assert_int_equal (tcti_mssim->connect_failures, 0);
+}
+/*
+ * The reconnect counters are reported by Tss2_Tcti_Mssim_GetStats, also
+ * when called with the tctildr context that holds the mssim TCTI.
+ */
+static void
+tcti_mssim_get_stats_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = (TSS2_TCTI_MSSIM_CONTEXT*)ctx;
+    TSS2_TCTILDR_CONTEXT tctildr = { 0 };
+    TSS2_TCTI_MSSIM_STATS stats = { 0 };
+    TSS2_RC rc;
+
+    tcti_mssim->reconnects = 2;
+    tcti_mssim->connect_failures = 3;
+    rc = Tss2_Tcti_Mssim_GetStats (ctx, &stats);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.reconnects, 2);
+    assert_int_equal (stats.connect_failures, 3);
+
+    tctildr.v2.v1.magic = TCTILDR_MAGIC;
+    tctildr.tcti = ctx;
+    memset (&stats, 0, sizeof (stats));
+    rc = Tss2_Tcti_Mssim_GetStats ((TSS2_TCTI_CONTEXT*)&tctildr, &stats);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stats.reconnects, 2);
+    assert_int_equal (stats.connect_failures, 3);
+
+    rc = Tss2_Tcti_Mssim_GetStats (ctx, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
+    rc = Tss2_Tcti_Mssim_GetStats (NULL, &stats);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
+    tctildr.tcti = NULL;
+    rc = Tss2_Tcti_Mssim_GetStats ((TSS2_TCTI_CONTEXT*)&tctildr, &stats);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
 }
 
 int
@@ -515,6 +661,8 @@ main (int   argc,
         cmocka_unit_test (conf_str_to_host_ipv6_port_no_port_test),
         cmocka_unit_test (conf_str_to_host_port_invalid_port_large_test),
         cmocka_unit_test (conf_str_to_host_port_invalid_port_0_test),
+        cmocka_unit_test (conf_str_socket_options_test),
+        cmocka_unit_test (conf_str_socket_options_invalid_test),
         cmocka_unit_test (tcti_socket_init_all_null_test),
         cmocka_unit_test (tcti_socket_init_size_test),
         cmocka_unit_test (tcti_socket_init_null_conf_test),
@@ -530,15 +678,27 @@ main (int   argc,
         cmocka_unit_test_setup_teardown (tcti_socket_receive_size_success_test,
                                   tcti_socket_setup,
                                   tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_socket_receive_partial_try_again_test,
+                                         tcti_socket_setup,
+                                         tcti_socket_teardown),
         cmocka_unit_test_setup_teardown (tcti_mssim_receive_eof_first_read_test,
                                          tcti_socket_setup,
                                          tcti_socket_teardown),
         cmocka_unit_test_setup_teardown (tcti_mssim_receive_eof_second_read_test,
                                          tcti_socket_setup,
                                          tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_mssim_receive_too_large_test,
+                                         tcti_socket_setup,
+                                         tcti_socket_teardown),
         cmocka_unit_test_setup_teardown (tcti_socket_transmit_success_test,
                                   tcti_socket_setup,
-                                  tcti_socket_teardown)
+                                  tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_mssim_reconnect_test,
+                                         tcti_socket_setup,
+                                         tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_mssim_get_stats_test,
+                                         tcti_socket_setup,
+                                         tcti_socket_teardown)
     };
     return cmocka_run_group_tests (tests, NULL, NULL);
 }
@@ -8,14 +8,17 @@
 #include <config.h>
 #endif
 
+#include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -208,6 +211,9 @@ tcti_stub_get_poll_handles (
     return ret;
 }
 
+/* The last conf string passed to the mocked child TCTI */
+static char child_conf[64];
+
 TSS2_RC
 Tss2_TctiLdr_Initialize (const char *nameConf,
                          TSS2_TCTI_CONTEXT **tctiContext)
@@ -237,6 +243,8 @@ Tss2_TctiLdr_Initialize (const char *nameConf,
 
         return TPM2_RC_SUCCESS;
     } else {
+        snprintf (child_conf, sizeof (child_conf), "%s",
+                  nameConf ? nameConf : "");
         /* return mocked rc */
         return mock_type (int);
     }
@@ -476,6 +484,411 @@ tcti_pcap_init_write_fail_test (void **state)
     free (tcti);
 }
 
+/* Initialize the pcap TCTI writing to the pipe fd, optionally with a ring buffer */
+static TSS2_TCTI_CONTEXT *
+tcti_pcap_fd_init (const char *conf, const char *buffer_size, int fd)
+{
+    size_t tcti_size = 0;
+    TSS2_RC ret = TSS2_RC_SUCCESS;
+    TSS2_TCTI_CONTEXT *tcti = NULL;
+
+    ret = Tss2_Tcti_Pcap_Init (NULL, &tcti_size, NULL);
+    assert_true (ret == TSS2_RC_SUCCESS);
+
+    tcti = calloc (1, tcti_size);
+    assert_non_null (tcti);
+
+    if (buffer_size) {
+        assert_int_equal (setenv (ENV_PCAP_BUFFER_SIZE, buffer_size, 1), 0);
+    }
+    will_return (__wrap_rand, TCTI_PCAP_IP_HOST_L); /* host ip */
+    will_return (__wrap_rand, TCTI_PCAP_IP_HOST_H);
+    will_return (__wrap_rand, TCTI_PCAP_IP_TPM_L);  /* tpm ip */
+    will_return (__wrap_rand, TCTI_PCAP_IP_TPM_H);
+    will_return (__wrap_rand, TCTI_PCAP_TCP_SEQ_HOST_INT); /* host sequence no */
+    will_return (__wrap_rand, TCTI_PCAP_TCP_SEQ_TPM_INT);  /* tpm sequence no */
+    will_return (__wrap_open, fd);
+    ret = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, conf);
+    unsetenv (ENV_PCAP_BUFFER_SIZE);
+    assert_true (ret == TSS2_RC_SUCCESS);
+
+    return tcti;
+}
+
+static void
+tcti_pcap_fd_transmit (TSS2_TCTI_CONTEXT *tcti, uint8_t *buf, size_t size)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (tcti);
+    TSS2_RC rc;
+
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    will_return (tcti_stub_transmit, TSS2_RC_SUCCESS);
+    will_return (tcti_stub_transmit, size); /* assert size */
+    will_return (tcti_stub_transmit, buf); /* assert buf */
+    rc = Tss2_Tcti_Transmit (tcti, size, buf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+
+static void
+tcti_pcap_ring_test (void **state)
+{
+    uint8_t mock_transmit_buffer[] = {0x00, 0x01, 0x02};
+    size_t mock_transmit_size = sizeof(mock_transmit_buffer);
+    uint8_t expected[sizeof(pcap_header) + 2 * sizeof(pcap_tx_epb_data)];
+    uint8_t captured[sizeof(expected) + 1];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    int fds[2];
+
+    memcpy (expected, pcap_header, sizeof(pcap_header));
+    memcpy (&expected[sizeof(pcap_header)], pcap_tx_epb_data,
+            sizeof(pcap_tx_epb_data));
+    memcpy (&expected[sizeof(pcap_header) + sizeof(pcap_tx_epb_data)],
+            pcap_tx_epb_data, sizeof(pcap_tx_epb_data));
+    update_tcp_seq (&expected[sizeof(pcap_header) + sizeof(pcap_tx_epb_data)],
+                    mock_transmit_size);
+
+    assert_int_equal (pipe (fds), 0);
+    tcti = tcti_pcap_fd_init (TCTI_STUB_CONF, "4096", fds[1]);
+
+    /* the blocks are written by the writer thread, not on the command path */
+    tcti_pcap_fd_transmit (tcti, mock_transmit_buffer, mock_transmit_size);
+    tcti_pcap_fd_transmit (tcti, mock_transmit_buffer, mock_transmit_size);
+
+    /* finalize drains the ring and closes the write end of the pipe */
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    captured_size = read (fds[0], captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(expected));
+    assert_memory_equal (captured, expected, sizeof(expected));
+    close (fds[0]);
+}
+
+static void
+tcti_pcap_ring_wake_test (void **state)
+{
+    uint8_t mock_transmit_buffer[] = {0x00, 0x01, 0x02};
+    size_t mock_transmit_size = sizeof(mock_transmit_buffer);
+    uint8_t captured[sizeof(pcap_header) + sizeof(pcap_tx_epb_data)];
+    TSS2_TCTI_CONTEXT *tcti;
+    TSS2_TCTI_PCAP_CONTEXT *tcti_pcap;
+    ssize_t captured_size;
+    int fds[2];
+
+    assert_int_equal (pipe (fds), 0);
+    tcti = tcti_pcap_fd_init (TCTI_STUB_CONF, "4096", fds[1]);
+    tcti_pcap = (TSS2_TCTI_PCAP_CONTEXT *) tcti;
+
+    /* the header is written, then the idle writer parks */
+    captured_size = read (fds[0], captured, sizeof(pcap_header));
+    assert_int_equal (captured_size, sizeof(pcap_header));
+    while (!__atomic_load_n (&tcti_pcap->pcap_builder.ring.sleeping,
+                             __ATOMIC_SEQ_CST)) {
+        sched_yield ();
+    }
+
+    /* the transmit wakes the parked writer, which writes the block */
+    tcti_pcap_fd_transmit (tcti, mock_transmit_buffer, mock_transmit_size);
+    captured_size = read (fds[0], captured, sizeof(pcap_tx_epb_data));
+    assert_int_equal (captured_size, sizeof(pcap_tx_epb_data));
+    assert_memory_equal (captured, pcap_tx_epb_data, sizeof(pcap_tx_epb_data));
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+    close (fds[0]);
+}
+
+static void
+tcti_pcap_ring_overflow_test (void **state)
+{
+    uint8_t mock_transmit_buffer[] = {0x00, 0x01, 0x02};
+    size_t mock_transmit_size = sizeof(mock_transmit_buffer);
+    uint8_t captured[sizeof(pcap_header) + sizeof(pcap_tx_epb_data)];
+    TSS2_TCTI_CONTEXT *tcti;
+    TSS2_TCTI_PCAP_CONTEXT *tcti_pcap;
+    ssize_t captured_size;
+    int fds[2];
+
+    assert_int_equal (pipe (fds), 0);
+    /* the ring is too small for a single block */
+    tcti = tcti_pcap_fd_init (TCTI_STUB_CONF, "64", fds[1]);
+    tcti_pcap = (TSS2_TCTI_PCAP_CONTEXT *) tcti;
+
+    tcti_pcap_fd_transmit (tcti, mock_transmit_buffer, mock_transmit_size);
+    tcti_pcap_fd_transmit (tcti, mock_transmit_buffer, mock_transmit_size);
+
+    /* dropped packets are counted and leave a gap in the sequence numbers */
+    assert_int_equal (tcti_pcap->pcap_builder.ring.dropped, 2);
+    assert_int_equal (tcti_pcap->pcap_builder.tcp_sequence_no_host,
+                      TCTI_PCAP_TCP_SEQ_HOST_INT + 2 * mock_transmit_size);
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    captured_size = read (fds[0], captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header));
+    assert_memory_equal (captured, pcap_header, sizeof(pcap_header));
+    close (fds[0]);
+}
+
+static void
+tcti_pcap_fd_receive (TSS2_TCTI_CONTEXT *tcti, uint8_t *buf, size_t size)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (tcti);
+    uint8_t response_buffer[100];
+    size_t response_size = sizeof(response_buffer);
+    TSS2_RC rc;
+
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (tcti_stub_receive, TSS2_RC_SUCCESS);
+    will_return (tcti_stub_receive, size);
+    will_return (tcti_stub_receive, buf);
+    rc = Tss2_Tcti_Receive (tcti, &response_size, response_buffer,
+                            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+
+/* Size of the enhanced packet block of a TPM command without parameters */
+#define PCAP_CMD_EPB_SIZE 84
+#define PCAP_CMD_EPB_PAYLOAD_OFFSET 68
+
+static uint8_t pcap_get_random_cmd[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x7b
+};
+static uint8_t pcap_get_capability_cmd[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x7a
+};
+static uint8_t pcap_success_rsp[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00
+};
+static uint8_t pcap_error_rsp[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x01
+};
+
+static void
+tcti_pcap_init_conf_fail_test (void **state)
+{
+    TSS2_TCTI_PCAP_CONTEXT tcti_pcap = {0};
+    TSS2_TCTI_CONTEXT *tcti = (TSS2_TCTI_CONTEXT*) &tcti_pcap;
+    size_t tcti_size = sizeof (tcti_pcap);
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "sample=0;" TCTI_STUB_CONF);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "rotate_size=1k;" TCTI_STUB_CONF);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "unknown=1;" TCTI_STUB_CONF);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "cc=0x17b+foo;" TCTI_STUB_CONF);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+
+static void
+tcti_pcap_init_child_conf_test (void **state)
+{
+    TSS2_TCTI_PCAP_CONTEXT tcti_pcap = {0};
+    TSS2_TCTI_CONTEXT *tcti = (TSS2_TCTI_CONTEXT*) &tcti_pcap;
+    size_t tcti_size = sizeof (tcti_pcap);
+    TSS2_RC rc;
+
+    /* a ';' within the child conf does not start pcap options */
+    will_return (Tss2_TctiLdr_Initialize, TSS2_TCTI_RC_MEMORY);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "cmd:foo; bar");
+    assert_int_equal (rc, TSS2_TCTI_RC_MEMORY);
+    assert_string_equal (child_conf, "cmd:foo; bar");
+
+    will_return (Tss2_TctiLdr_Initialize, TSS2_TCTI_RC_MEMORY);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "foo; bar");
+    assert_int_equal (rc, TSS2_TCTI_RC_MEMORY);
+    assert_string_equal (child_conf, "foo; bar");
+
+    will_return (Tss2_TctiLdr_Initialize, TSS2_TCTI_RC_MEMORY);
+    rc = Tss2_Tcti_Pcap_Init (tcti, &tcti_size, "sample=2;cmd:foo; bar");
+    assert_int_equal (rc, TSS2_TCTI_RC_MEMORY);
+    assert_string_equal (child_conf, "cmd:foo; bar");
+    assert_int_equal (tcti_pcap.pcap_conf.sample, 2);
+}
+
+static void
+tcti_pcap_sample_test (void **state)
+{
+    uint8_t captured[sizeof(pcap_header) + 5 * PCAP_CMD_EPB_SIZE];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    int fds[2];
+
+    assert_int_equal (pipe (fds), 0);
+    tcti = tcti_pcap_fd_init ("sample=2;" TCTI_STUB_CONF, NULL, fds[1]);
+
+    /* every second command is captured together with its response */
+    for (int i = 0; i < 3; i++) {
+        tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+        tcti_pcap_fd_receive (tcti, pcap_success_rsp, sizeof(pcap_success_rsp));
+    }
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    captured_size = read (fds[0], captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + 4 * PCAP_CMD_EPB_SIZE);
+    close (fds[0]);
+}
+
+static void
+tcti_pcap_errors_only_test (void **state)
+{
+    uint8_t captured[sizeof(pcap_header) + 3 * PCAP_CMD_EPB_SIZE];
+    uint8_t *block = &captured[sizeof(pcap_header)];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    int fds[2];
+
+    assert_int_equal (pipe (fds), 0);
+    tcti = tcti_pcap_fd_init ("cc=0x17b+0x176,errors_only=1;" TCTI_STUB_CONF, NULL,
+                              fds[1]);
+
+    /* successful command */
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    tcti_pcap_fd_receive (tcti, pcap_success_rsp, sizeof(pcap_success_rsp));
+    /* failed command which is not in the command code filter */
+    tcti_pcap_fd_transmit (tcti, pcap_get_capability_cmd,
+                             sizeof(pcap_get_capability_cmd));
+    tcti_pcap_fd_receive (tcti, pcap_error_rsp, sizeof(pcap_error_rsp));
+    /* failed command */
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    tcti_pcap_fd_receive (tcti, pcap_error_rsp, sizeof(pcap_error_rsp));
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    captured_size = read (fds[0], captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + 2 * PCAP_CMD_EPB_SIZE);
+    assert_memory_equal (&block[PCAP_CMD_EPB_PAYLOAD_OFFSET], pcap_get_random_cmd,
+                         sizeof(pcap_get_random_cmd));
+    block += PCAP_CMD_EPB_SIZE;
+    assert_memory_equal (&block[PCAP_CMD_EPB_PAYLOAD_OFFSET], pcap_error_rsp,
+                         sizeof(pcap_error_rsp));
+    close (fds[0]);
+}
+
+/*
+ * Create an unlinked regular file for the capture and return a descriptor to
+ * write to and, in read_fd, a descriptor to read the capture back.
+ */
+static int
+tcti_pcap_tmp_file (int *read_fd)
+{
+    char path[] = "/tmp/tss2-pcap-XXXXXX";
+    int fd = mkstemp (path);
+
+    assert_true (fd >= 0);
+    *read_fd = __real_open (path, O_RDONLY, 0);
+    assert_true (*read_fd >= 0);
+    unlink (path);
+    return fd;
+}
+
+static void
+tcti_pcap_rotate_test (void **state)
+{
+    uint8_t captured[sizeof(pcap_header) + 2 * PCAP_CMD_EPB_SIZE];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    int fd, fd_rotated, read_fd, read_fd_rotated;
+
+    fd = tcti_pcap_tmp_file (&read_fd);
+    fd_rotated = tcti_pcap_tmp_file (&read_fd_rotated);
+    /* the file is full after the header and one packet */
+    tcti = tcti_pcap_fd_init ("rotate_size=200,rotate_files=1;" TCTI_STUB_CONF,
+                              NULL, fd);
+
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    will_return (__wrap_open, fd_rotated);
+    tcti_pcap_fd_receive (tcti, pcap_success_rsp, sizeof(pcap_success_rsp));
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    /* both files start with the file header */
+    captured_size = read (read_fd, captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + PCAP_CMD_EPB_SIZE);
+    assert_memory_equal (captured, pcap_header, sizeof(pcap_header));
+    assert_memory_equal (&captured[sizeof(pcap_header) + PCAP_CMD_EPB_PAYLOAD_OFFSET],
+                         pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    captured_size = read (read_fd_rotated, captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + PCAP_CMD_EPB_SIZE);
+    assert_memory_equal (captured, pcap_header, sizeof(pcap_header));
+    assert_memory_equal (&captured[sizeof(pcap_header) + PCAP_CMD_EPB_PAYLOAD_OFFSET],
+                         pcap_success_rsp, sizeof(pcap_success_rsp));
+    close (read_fd);
+    close (read_fd_rotated);
+}
+
+static void
+tcti_pcap_rotate_fifo_test (void **state)
+{
+    uint8_t captured[sizeof(pcap_header) + 3 * PCAP_CMD_EPB_SIZE];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    int fds[2];
+
+    /* a pipe is not rotated, all packets are written to it */
+    assert_int_equal (pipe (fds), 0);
+    tcti = tcti_pcap_fd_init ("rotate_size=200,rotate_files=2;" TCTI_STUB_CONF,
+                              NULL, fds[1]);
+
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    tcti_pcap_fd_receive (tcti, pcap_success_rsp, sizeof(pcap_success_rsp));
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    captured_size = read (fds[0], captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + 2 * PCAP_CMD_EPB_SIZE);
+    close (fds[0]);
+}
+
+static void
+tcti_pcap_rotate_open_fail_test (void **state)
+{
+    uint8_t captured[sizeof(pcap_header) + 3 * PCAP_CMD_EPB_SIZE];
+    TSS2_TCTI_CONTEXT *tcti;
+    ssize_t captured_size;
+    FILE *file;
+    int fd, read_fd;
+
+    /* the capture file that is shifted to pcap_file.1 by the rotation */
+    file = fopen (TCTI_PCAP_FILE, "w");
+    assert_non_null (file);
+    fclose (file);
+    unlink (TCTI_PCAP_FILE ".1");
+
+    fd = tcti_pcap_tmp_file (&read_fd);
+    tcti = tcti_pcap_fd_init ("rotate_size=200,rotate_files=2;" TCTI_STUB_CONF,
+                              NULL, fd);
+
+    /* the new file can't be opened, the file name is restored */
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+    will_return (__wrap_open, -1);
+    tcti_pcap_fd_receive (tcti, pcap_success_rsp, sizeof(pcap_success_rsp));
+    assert_int_equal (access (TCTI_PCAP_FILE, F_OK), 0);
+    assert_int_not_equal (access (TCTI_PCAP_FILE ".1", F_OK), 0);
+
+    /* the size of the current file is kept, so the rotation is retried */
+    will_return (__wrap_open, -1);
+    tcti_pcap_fd_transmit (tcti, pcap_get_random_cmd, sizeof(pcap_get_random_cmd));
+
+    Tss2_Tcti_Finalize (tcti);
+    free (tcti);
+
+    /* the capture continued in the current file */
+    captured_size = read (read_fd, captured, sizeof(captured));
+    assert_int_equal (captured_size, sizeof(pcap_header) + 3 * PCAP_CMD_EPB_SIZE);
+    close (read_fd);
+    unlink (TCTI_PCAP_FILE);
+}
+
 /* Setup functions to create the context for the pcap TCTI */
 static int
 tcti_pcap_setup (void **state)
@@ -727,6 +1140,18 @@ main (int   argc,
         cmocka_unit_test (tcti_pcap_init_tctildr_fail_test),
         cmocka_unit_test (tcti_pcap_init_open_fail_test),
         cmocka_unit_test (tcti_pcap_init_write_fail_test),
+        /* run before the tests which advance the sequence numbers of the
+           expected blocks */
+        cmocka_unit_test (tcti_pcap_ring_test),
+        cmocka_unit_test (tcti_pcap_ring_wake_test),
+        cmocka_unit_test (tcti_pcap_ring_overflow_test),
+        cmocka_unit_test (tcti_pcap_init_conf_fail_test),
+        cmocka_unit_test (tcti_pcap_init_child_conf_test),
+        cmocka_unit_test (tcti_pcap_sample_test),
+        cmocka_unit_test (tcti_pcap_errors_only_test),
+        cmocka_unit_test (tcti_pcap_rotate_test),
+        cmocka_unit_test (tcti_pcap_rotate_fifo_test),
+        cmocka_unit_test (tcti_pcap_rotate_open_fail_test),
         cmocka_unit_test_setup_teardown (tcti_pcap_receive_test,
                                          tcti_pcap_setup,
                                          tcti_pcap_teardown),
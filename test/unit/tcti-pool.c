@@ -0,0 +1,620 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/***********************************************************************
+ * Copyright (c) 2021, Intel Corporation
+ *
+ * All rights reserved.
+ ***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_pool.h"
+
+#include "tss2-tcti/tcti-common.h"
+#include "tss2-tcti/tcti-pool.h"
+#include "tss2-tcti/tctildr.h"
+
+#define TCTI_STUB_MAGIC 0x7a3c5e9d1b2f4a68ULL
+#define TCTI_STUB_FAIL_CONF "fail"
+
+static const uint8_t command [] = { 0x80, 0x01,
+                                    0x00, 0x00, 0x00, 0x0c,
+                                    0x00, 0x00, 0x01, 0x7b,
+                                    0x00, 0x08 };
+static const uint8_t response [] = { 0x80, 0x01,
+                                     0x00, 0x00, 0x00, 0x0a,
+                                     0x00, 0x00, 0x00, 0x00 };
+
+/*
+ * Child TCTI stub counting the calls it receives. The child state machine is
+ * checked by the tcti-common functions.
+ */
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    size_t transmitted;
+    size_t received;
+    size_t cancelled;
+    int locality;
+    bool cancel_fails;
+} TSS2_TCTI_STUB_CONTEXT;
+
+static TSS2_RC
+tcti_stub_transmit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_transmit_checks (&stub->common, cmd_buf, TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    stub->transmitted++;
+    stub->common.state = TCTI_STATE_RECEIVE;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    uint8_t *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_receive_checks (&stub->common, response_size,
+                                     TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (response_buffer == NULL) {
+        *response_size = sizeof (response);
+        return TSS2_RC_SUCCESS;
+    }
+    if (*response_size < sizeof (response)) {
+        *response_size = sizeof (response);
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy (response_buffer, response, sizeof (response));
+    *response_size = sizeof (response);
+    stub->received++;
+    stub->common.state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_cancel_checks (&stub->common, TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (stub->cancel_fails) {
+        return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+    }
+    stub->cancelled++;
+    stub->common.state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_set_locality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub = (TSS2_TCTI_STUB_CONTEXT*)tctiContext;
+    TSS2_RC rc;
+
+    rc = tcti_common_set_locality_checks (&stub->common, TCTI_STUB_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    stub->locality = locality;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_get_poll_handles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    *num_handles = 1;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Replacement for the tctildr functions used by the pool. Every conf string
+ * except "fail" creates a new stub child.
+ */
+TSS2_RC
+Tss2_TctiLdr_Initialize (const char *nameConf,
+                         TSS2_TCTI_CONTEXT **tctiContext)
+{
+    TSS2_TCTI_STUB_CONTEXT *stub;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common;
+
+    *tctiContext = NULL;
+    if (nameConf != NULL && strcmp (nameConf, TCTI_STUB_FAIL_CONF) == 0) {
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    stub = calloc (1, sizeof (TSS2_TCTI_STUB_CONTEXT));
+    assert_non_null (stub);
+    tcti_common = &stub->common;
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_STUB_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_stub_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_stub_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = NULL;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_stub_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_stub_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_stub_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = NULL;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    stub->locality = -1;
+
+    *tctiContext = (TSS2_TCTI_CONTEXT*)stub;
+    return TSS2_RC_SUCCESS;
+}
+
+void
+Tss2_TctiLdr_Finalize (TSS2_TCTI_CONTEXT **tctiContext)
+{
+    free (*tctiContext);
+    *tctiContext = NULL;
+}
+
+static TSS2_TCTI_STUB_CONTEXT*
+tcti_pool_stub (TSS2_TCTI_CONTEXT *ctx, size_t index)
+{
+    TSS2_TCTI_POOL_CONTEXT *tcti_pool = (TSS2_TCTI_POOL_CONTEXT*)ctx;
+
+    return (TSS2_TCTI_STUB_CONTEXT*)tcti_pool->children [index].tcti;
+}
+
+static void
+tcti_pool_next_conf_test (void **state)
+{
+    char conf [] = "mssim:host=::1,port=2321,device:/dev/tpm0,,swtpm,"
+                   "mssim:port=2331,";
+    char *iter = conf;
+
+    assert_string_equal (tcti_pool_next_conf (&iter),
+                         "mssim:host=::1,port=2321");
+    assert_string_equal (tcti_pool_next_conf (&iter), "device:/dev/tpm0");
+    assert_string_equal (tcti_pool_next_conf (&iter), "swtpm");
+    assert_string_equal (tcti_pool_next_conf (&iter), "mssim:port=2331");
+    assert_null (tcti_pool_next_conf (&iter));
+    assert_null (tcti_pool_next_conf (&iter));
+}
+
+static void
+tcti_pool_init_size_test (void **state)
+{
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Pool_Init (NULL, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    rc = Tss2_Tcti_Pool_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (TSS2_TCTI_POOL_CONTEXT));
+}
+
+static void
+tcti_pool_init_fail_test (void **state)
+{
+    TSS2_TCTI_POOL_CONTEXT tcti_pool;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Pool_Init ((TSS2_TCTI_CONTEXT*)&tcti_pool, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    rc = Tss2_Tcti_Pool_Init ((TSS2_TCTI_CONTEXT*)&tcti_pool, NULL, ",");
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    /* The first child is finalized when loading the second one fails. */
+    rc = Tss2_Tcti_Pool_Init ((TSS2_TCTI_CONTEXT*)&tcti_pool, NULL,
+                              "mssim,fail");
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+    assert_int_equal (tcti_pool.num_children, 0);
+    assert_null (tcti_pool.children [0].tcti);
+
+    rc = Tss2_Tcti_Pool_Init ((TSS2_TCTI_CONTEXT*)&tcti_pool, NULL,
+                              "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q");
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (tcti_pool.num_children, 0);
+}
+
+static int
+tcti_pool_setup (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Pool_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    ctx = calloc (1, size);
+    assert_non_null (ctx);
+    rc = Tss2_Tcti_Pool_Init (ctx, &size, "mssim:port=2321,mssim:port=2331");
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (((TSS2_TCTI_POOL_CONTEXT*)ctx)->num_children, 2);
+
+    *state = ctx;
+    return 0;
+}
+
+static int
+tcti_pool_teardown (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+    return 0;
+}
+
+/*
+ * A thread keeps its child from transmit until the response is received,
+ * the next command goes to the next idle child.
+ */
+static void
+tcti_pool_dispatch_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    uint8_t response_out [sizeof (response)];
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->transmitted, 1);
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (response));
+
+    size = 1;
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (response_out, response, sizeof (response));
+    assert_int_equal (tcti_pool_stub (ctx, 0)->received, 1);
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->transmitted, 1);
+
+    rc = Tss2_Tcti_Cancel (ctx);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->cancelled, 1);
+
+    rc = Tss2_Tcti_Cancel (ctx);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+}
+
+/*
+ * A child whose command could not be cancelled is released anyway; the
+ * response is dropped before the child takes the next command.
+ */
+static void
+tcti_pool_cancel_fail_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    uint8_t response_out [sizeof (response)];
+    size_t size = sizeof (response_out);
+    size_t i;
+    TSS2_RC rc;
+
+    tcti_pool_stub (ctx, 0)->cancel_fails = true;
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_Tcti_Cancel (ctx);
+    assert_int_equal (rc, TSS2_TCTI_RC_NOT_IMPLEMENTED);
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    /* Both children serve commands again. */
+    for (i = 0; i < 2; i++) {
+        rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        size = sizeof (response_out);
+        rc = Tss2_Tcti_Receive (ctx, &size, response_out,
+                                TSS2_TCTI_TIMEOUT_BLOCK);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal (tcti_pool_stub (ctx, 0)->transmitted, 2);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->received, 2);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->received, 1);
+}
+
+typedef struct {
+    TSS2_TCTI_CONTEXT *ctx;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool sent;
+    bool go;
+} thread_sync_t;
+
+static TSS2_RC
+tcti_pool_thread_command (TSS2_TCTI_CONTEXT *ctx, thread_sync_t *sync)
+{
+    uint8_t response_out [sizeof (response)];
+    size_t size = sizeof (response_out);
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (sync != NULL) {
+        pthread_mutex_lock (&sync->mutex);
+        sync->sent = true;
+        pthread_cond_broadcast (&sync->cond);
+        while (!sync->go) {
+            pthread_cond_wait (&sync->cond, &sync->mutex);
+        }
+        pthread_mutex_unlock (&sync->mutex);
+    }
+    return Tss2_Tcti_Receive (ctx, &size, response_out,
+                              TSS2_TCTI_TIMEOUT_BLOCK);
+}
+
+static void*
+tcti_pool_thread (void *arg)
+{
+    return (void*)(uintptr_t)tcti_pool_thread_command (arg, NULL);
+}
+
+static void*
+tcti_pool_thread_sync (void *arg)
+{
+    thread_sync_t *sync = (thread_sync_t*)arg;
+
+    return (void*)(uintptr_t)tcti_pool_thread_command (sync->ctx, sync);
+}
+
+static void*
+tcti_pool_thread_receive (void *arg)
+{
+    uint8_t response_out [sizeof (response)];
+    size_t size = sizeof (response_out);
+
+    return (void*)(uintptr_t)Tss2_Tcti_Receive (arg, &size, response_out,
+                                                TSS2_TCTI_TIMEOUT_BLOCK);
+}
+
+static TSS2_TCTI_CONTEXT*
+tcti_pool_client (TSS2_TCTI_CONTEXT *pool)
+{
+    TSS2_TCTI_CONTEXT *client;
+    size_t size = 0;
+
+    assert_int_equal (Tss2_Tcti_Pool_InitClient (NULL, &size, NULL),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (TSS2_TCTI_POOL_CLIENT_CONTEXT));
+    client = calloc (1, size);
+    assert_non_null (client);
+    assert_int_equal (Tss2_Tcti_Pool_InitClient (client, &size, pool),
+                      TSS2_RC_SUCCESS);
+    return client;
+}
+
+/*
+ * The response to a command may be received by another thread than the one
+ * that sent it, as ESYS does with _Async and _Finish on different threads.
+ */
+static void
+tcti_pool_thread_handoff_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    pthread_t thread;
+    void *thread_rc;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    assert_int_equal (pthread_create (&thread, NULL, tcti_pool_thread_receive,
+                                      ctx), 0);
+    assert_int_equal (pthread_join (thread, &thread_rc), 0);
+    assert_int_equal ((TSS2_RC)(uintptr_t)thread_rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->received, 1);
+
+    /* The child is idle again, the next command goes to the second one. */
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->transmitted, 1);
+}
+
+static void
+tcti_pool_client_init_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_POOL_CLIENT_CONTEXT client;
+    TSS2_TCTI_CONTEXT *client_ctx = (TSS2_TCTI_CONTEXT*)&client;
+    TSS2_TCTI_CONTEXT *stub = (TSS2_TCTI_CONTEXT*)tcti_pool_stub (ctx, 0);
+    TSS2_TCTILDR_CONTEXT tctildr = { 0 };
+    uint8_t response_out [sizeof (response)];
+    size_t size, i;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Pool_InitClient (NULL, NULL, ctx);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+    rc = Tss2_Tcti_Pool_InitClient (client_ctx, NULL, stub);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
+    rc = Tss2_Tcti_Pool_InitClient (client_ctx, NULL, ctx);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_ptr_equal (client.pool, ctx);
+
+    /* The pool may be passed as the tctildr context that loaded it. */
+    tctildr.v2.v1.magic = TCTILDR_MAGIC;
+    tctildr.tcti = ctx;
+    rc = Tss2_Tcti_Pool_InitClient (client_ctx, NULL,
+                                    (TSS2_TCTI_CONTEXT*)&tctildr);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_ptr_equal (client.pool, ctx);
+
+    /* A command still in flight is dropped when the client is finalized. */
+    rc = Tss2_Tcti_Transmit (client_ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    Tss2_Tcti_Finalize (client_ctx);
+    for (i = 0; i < 2; i++) {
+        rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        size = sizeof (response_out);
+        rc = Tss2_Tcti_Receive (ctx, &size, response_out,
+                                TSS2_TCTI_TIMEOUT_BLOCK);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+    }
+    assert_int_equal (tcti_pool_stub (ctx, 0)->transmitted, 2);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->received, 2);
+}
+
+/*
+ * While the pool context has a command in flight on the first child, a
+ * client on a second thread is served by the second child. With both
+ * children busy a third client waits until the pool context has received
+ * its response.
+ */
+static void
+tcti_pool_threads_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_CONTEXT *client1 = tcti_pool_client (ctx);
+    TSS2_TCTI_CONTEXT *client2 = tcti_pool_client (ctx);
+    uint8_t response_out [sizeof (response)];
+    size_t size = sizeof (response_out);
+    thread_sync_t sync = { .ctx = client1 };
+    pthread_t thread_sync, thread;
+    void *thread_rc;
+    TSS2_RC rc;
+
+    pthread_mutex_init (&sync.mutex, NULL);
+    pthread_cond_init (&sync.cond, NULL);
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    assert_int_equal (pthread_create (&thread_sync, NULL,
+                                      tcti_pool_thread_sync, &sync), 0);
+    pthread_mutex_lock (&sync.mutex);
+    while (!sync.sent) {
+        pthread_cond_wait (&sync.cond, &sync.mutex);
+    }
+    pthread_mutex_unlock (&sync.mutex);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->transmitted, 1);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->transmitted, 1);
+
+    assert_int_equal (pthread_create (&thread, NULL, tcti_pool_thread,
+                                      client2), 0);
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (pthread_join (thread, &thread_rc), 0);
+    assert_int_equal ((TSS2_RC)(uintptr_t)thread_rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->received, 2);
+
+    pthread_mutex_lock (&sync.mutex);
+    sync.go = true;
+    pthread_cond_broadcast (&sync.cond);
+    pthread_mutex_unlock (&sync.mutex);
+    assert_int_equal (pthread_join (thread_sync, &thread_rc), 0);
+    assert_int_equal ((TSS2_RC)(uintptr_t)thread_rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->received, 1);
+
+    pthread_cond_destroy (&sync.cond);
+    pthread_mutex_destroy (&sync.mutex);
+    Tss2_Tcti_Finalize (client1);
+    Tss2_Tcti_Finalize (client2);
+    free (client1);
+    free (client2);
+}
+
+/* The pool locality is applied to each child before its next command. */
+static void
+tcti_pool_locality_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    size_t num_handles = 0;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_SetLocality (ctx, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->locality, -1);
+
+    rc = Tss2_Tcti_GetPollHandles (ctx, NULL, &num_handles);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_pool_stub (ctx, 0)->locality, 1);
+    assert_int_equal (tcti_pool_stub (ctx, 1)->locality, -1);
+
+    rc = Tss2_Tcti_GetPollHandles (ctx, NULL, &num_handles);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (num_handles, 1);
+
+    rc = Tss2_Tcti_SetLocality (ctx, 2);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tcti_pool_next_conf_test),
+        cmocka_unit_test (tcti_pool_init_size_test),
+        cmocka_unit_test (tcti_pool_init_fail_test),
+        cmocka_unit_test_setup_teardown (tcti_pool_dispatch_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+        cmocka_unit_test_setup_teardown (tcti_pool_cancel_fail_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+        cmocka_unit_test_setup_teardown (tcti_pool_thread_handoff_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+        cmocka_unit_test_setup_teardown (tcti_pool_client_init_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+        cmocka_unit_test_setup_teardown (tcti_pool_threads_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+        cmocka_unit_test_setup_teardown (tcti_pool_locality_test,
+                                         tcti_pool_setup,
+                                         tcti_pool_teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
@@ -51,6 +51,23 @@ conf_str_to_host_port_success_test (void **state)
     assert_string_equal (swtpm_conf.host, "127.0.0.1");
 }
 
+/*
+ * The data and control channels can be Unix domain sockets.
+ */
+static void
+conf_str_to_path_success_test (void **state)
+{
+    TSS2_RC rc;
+    char conf[] = "path=/run/swtpm/tpm.sock,ctrl_path=/run/swtpm/ctrl.sock";
+    swtpm_conf_t swtpm_conf = { 0 };
+
+    rc = parse_key_value_string (conf, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_string_equal (swtpm_conf.path, "/run/swtpm/tpm.sock");
+    assert_string_equal (swtpm_conf.ctrl_path, "/run/swtpm/ctrl.sock");
+    assert_null (swtpm_conf.host);
+}
+
 /*
  * This tests our ability to handle conf strings that don't have the port
  * component of the URI. In this case the 'conf_str_to_host_port' function
@@ -200,6 +217,17 @@ __wrap_write (int sockfd,
 {
     return mock_type (TSS2_RC);
 }
+/*
+ * Wrap the 'poll' system call.
+ */
+int
+__wrap_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    int ret = mock_type (int);
+
+    fds->revents = fds->events;
+    return ret;
+}
 /*
  * This is a utility function used by other tests to setup a TCTI context. It
  * effectively wraps the init / allocate / init pattern as well as priming the
@@ -312,6 +340,50 @@ tcti_swtpm_init_fail_connect_test (void **state)
     free(((TSS2_TCTI_SWTPM_CONTEXT*)ctx)->conf_copy);
     free(ctx);
 }
+/*
+ * A failed connect is retried when 'reconnect' is configured and the
+ * reconnection is counted in the context and reported by GetStats.
+ */
+static void
+tcti_swtpm_init_reconnect_test (void **state)
+{
+    size_t tcti_size = 0;
+    uint8_t recv_buf[4] = { 0 };
+    TSS2_RC ret = TSS2_RC_SUCCESS;
+    TSS2_TCTI_CONTEXT *ctx = NULL;
+    TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm;
+    TSS2_TCTI_SWTPM_STATS stats = { 0 };
+
+    ret = Tss2_Tcti_Swtpm_Init (NULL, &tcti_size, NULL);
+    assert_true (ret == TSS2_RC_SUCCESS);
+    ctx = calloc (1, tcti_size);
+    assert_non_null (ctx);
+    tcti_swtpm = (TSS2_TCTI_SWTPM_CONTEXT*)ctx;
+
+    /* first connect fails, the retry and the control socket succeed */
+    will_return (__wrap_connect, -1);
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_write, 5);
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, recv_buf);
+    ret = Tss2_Tcti_Swtpm_Init (ctx, &tcti_size,
+                                "host=127.0.0.1,port=666,reconnect=1,"
+                                "reconnect_delay=1,io_timeout=1000");
+    assert_int_equal (ret, TSS2_RC_SUCCESS);
+    assert_int_equal (tcti_swtpm->swtpm_conf.socket.reconnect, 1);
+    assert_int_equal (tcti_swtpm->swtpm_conf.socket.io_timeout, 1000);
+    assert_int_equal (tcti_swtpm->reconnects, 1);
+    assert_int_equal (tcti_swtpm->connect_failures, 1);
+    assert_int_equal (Tss2_Tcti_Swtpm_GetStats (ctx, &stats), TSS2_RC_SUCCESS);
+    assert_int_equal (stats.reconnects, 1);
+    assert_int_equal (stats.connect_failures, 1);
+    assert_int_equal (Tss2_Tcti_Swtpm_GetStats (ctx, NULL),
+                      TSS2_TCTI_RC_BAD_REFERENCE);
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
 /*
  * This test ensures that the GetPollHandles function in the device TCTI
  * returns the expected value. Since this TCTI does not support async I/O
@@ -380,12 +452,10 @@ tcti_swtpm_receive_success_test (void **state)
 
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
-    /* receive response header */
-    will_return (__wrap_read, 10);
+    /* receive the whole response with one read */
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, response_size);
     will_return (__wrap_read, response_in);
-    /* receive remaining response */
-    will_return (__wrap_read, response_size - 10);
-    will_return (__wrap_read, &response_in [10]);
 
     rc = Tss2_Tcti_Receive (ctx, &response_size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
@@ -409,6 +479,7 @@ tcti_swtpm_receive_size_success_test (void **state)
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
     /* receive response header */
+    will_return (__wrap_poll, 1);
     will_return (__wrap_read, 10);
     will_return (__wrap_read, response_in);
     rc = Tss2_Tcti_Receive (ctx, &response_size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
@@ -417,6 +488,7 @@ tcti_swtpm_receive_size_success_test (void **state)
     assert_int_equal (response_size, 0xc);
 
     /* receive remaining response */
+    will_return (__wrap_poll, 1);
     will_return (__wrap_read, response_size - 10);
     will_return (__wrap_read, &response_in [10]);
 
@@ -441,6 +513,7 @@ tcti_swtpm_receive_eof_first_read_test (void **state)
 
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (__wrap_poll, 1);
     will_return (__wrap_read, 0);
     will_return (__wrap_read, buf);
     rc = Tss2_Tcti_Receive (ctx,
@@ -474,9 +547,11 @@ tcti_swtpm_receive_eof_second_read_test (void **state)
     /* Keep state machine check in `receive` from returning error. */
     tcti_common->state = TCTI_STATE_RECEIVE;
     /* setup response size for first read */
+    will_return (__wrap_poll, 1);
     will_return (__wrap_read, 4);
     will_return (__wrap_read, &response_in [2]);
     /* setup 0 for EOF on second read */
+    will_return (__wrap_poll, 1);
     will_return (__wrap_read, 0);
     will_return (__wrap_read, response_in);
     rc = Tss2_Tcti_Receive (ctx,
@@ -712,6 +787,7 @@ main (int   argc,
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test (conf_str_to_host_port_success_test),
+        cmocka_unit_test (conf_str_to_path_success_test),
         cmocka_unit_test (conf_str_to_host_port_no_port_test),
         cmocka_unit_test (conf_str_to_host_ipv6_port_success_test),
         cmocka_unit_test (conf_str_to_host_ipv6_port_no_port_test),
@@ -721,6 +797,7 @@ main (int   argc,
         cmocka_unit_test (tcti_swtpm_init_size_test),
         cmocka_unit_test (tcti_swtpm_init_null_conf_test),
         cmocka_unit_test (tcti_swtpm_get_info_test),
+        cmocka_unit_test (tcti_swtpm_init_reconnect_test),
         cmocka_unit_test_setup_teardown (tcti_swtpm_init_fail_connect_test,
                                          tcti_swtpm_setup,
                                          tcti_swtpm_teardown),